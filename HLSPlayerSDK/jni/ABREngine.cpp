@@ -0,0 +1,309 @@
+#include <math.h>
+
+#include "ABREngine.h"
+
+// dash.js defaults; they hold up for HLS segment lengths in the simulator
+// too (Tools/ABRSim).
+const double ABREngine::kFastHalfLifeSeconds = 3.0;
+const double ABREngine::kSlowHalfLifeSeconds = 8.0;
+const double ABREngine::kSafetyFactor = 0.9;
+
+const double BolaRule::kMinimumBufferSeconds = 10.0;
+
+const double DynamicRule::kSwitchToBolaSeconds = 10.0;
+const double DynamicRule::kSwitchToThroughputSeconds = 5.0;
+
+// BOLA wants the buffer target to leave some room per level above the
+// minimum, or the levels crowd into too small a range of buffer.
+static const double kBolaSecondsPerLevel = 2.0;
+
+namespace
+{
+	class Locker
+	{
+	public:
+		Locker(pthread_mutex_t *lock) : mLock(lock) { pthread_mutex_lock(mLock); }
+		~Locker() { pthread_mutex_unlock(mLock); }
+
+	private:
+		pthread_mutex_t *mLock;
+	};
+
+	int clampQuality(int quality, int count)
+	{
+		if (quality >= count)
+			quality = count - 1;
+		if (quality < 0)
+			quality = 0;
+		return quality;
+	}
+}
+
+//----------------------------------------------------------------------------
+// Rules
+
+int ThroughputRule::Choose(const ABRContext &ctx)
+{
+	if (ctx.throughput < 0)
+		return clampQuality(ctx.currentQuality, ctx.qualityCount);
+
+	double budget = ctx.throughput * ctx.safetyFactor;
+	int quality = 0;
+	for (int i = 1; i < ctx.qualityCount; ++i)
+	{
+		if (ctx.bitrates[i] <= budget)
+			quality = i;
+	}
+	return quality;
+}
+
+int BolaRule::Choose(const ABRContext &ctx)
+{
+	if (ctx.qualityCount < 2)
+		return 0;
+
+	ThroughputRule throughputRule;
+	if (ctx.bufferedSeconds < 0)
+		return throughputRule.Choose(ctx);
+
+	// With a short buffer target the minimum shrinks along with it, or the
+	// buffer would never get far enough past it to leave the lowest levels.
+	double target = ctx.bufferTargetSeconds;
+	double minimum = kMinimumBufferSeconds;
+	if (minimum > target / 3.0)
+		minimum = target / 3.0;
+	double minTarget = minimum + kBolaSecondsPerLevel * ctx.qualityCount;
+	if (target < minTarget)
+		target = minTarget;
+
+	// Utilities are log bitrates shifted so the lowest level is 1. gp and
+	// Vp are chosen so that the lowest level is picked up to the minimum
+	// buffer and the highest from about the target on.
+	double lowest = log((double)ctx.bitrates[0]);
+	double topUtility = log((double)ctx.bitrates[ctx.qualityCount - 1]) - lowest + 1.0;
+	double gp = (topUtility - 1.0) / (target / minimum - 1.0);
+	double Vp = minimum / gp;
+
+	int quality = 0;
+	double bestScore = 0;
+	for (int i = 0; i < ctx.qualityCount; ++i)
+	{
+		double utility = log((double)ctx.bitrates[i]) - lowest + 1.0;
+		double score = (Vp * (utility + gp) - ctx.bufferedSeconds) / ctx.bitrates[i];
+		if (i == 0 || score >= bestScore)
+		{
+			quality = i;
+			bestScore = score;
+		}
+	}
+
+	// BOLA-O: only step up as far as the throughput allows, or stay put.
+	int current = clampQuality(ctx.currentQuality, ctx.qualityCount);
+	if (quality > current)
+	{
+		int sustainable = throughputRule.Choose(ctx);
+		if (sustainable < quality)
+			quality = sustainable > current ? sustainable : current;
+	}
+
+	return quality;
+}
+
+int DynamicRule::Choose(const ABRContext &ctx)
+{
+	if (mUseBola && ctx.bufferedSeconds < kSwitchToThroughputSeconds)
+		mUseBola = false;
+	else if (!mUseBola && ctx.bufferedSeconds >= kSwitchToBolaSeconds)
+		mUseBola = true;
+
+	return mUseBola ? mBola.Choose(ctx) : mThroughput.Choose(ctx);
+}
+
+//----------------------------------------------------------------------------
+// ABREngine
+
+void ABREngine::Ewma::Add(double seconds, double bitsPerSecond)
+{
+	double alpha = pow(0.5, seconds / halfLife);
+	estimate = alpha * estimate + (1.0 - alpha) * bitsPerSecond;
+	totalWeight += seconds;
+}
+
+double ABREngine::Ewma::Get() const
+{
+	// Undo the pull towards the zero the estimate started from.
+	double zeroFactor = 1.0 - pow(0.5, totalWeight / halfLife);
+	return estimate / zeroFactor;
+}
+
+ABREngine::ABREngine() : mBufferTargetSeconds(30.0), mMode(MODE_THROUGHPUT), mRule(NULL)
+{
+	pthread_mutex_init(&mLock, NULL);
+
+	mFast.halfLife = kFastHalfLifeSeconds;
+	mSlow.halfLife = kSlowHalfLifeSeconds;
+	mFast.Reset();
+	mSlow.Reset();
+}
+
+ABREngine::~ABREngine()
+{
+	pthread_mutex_destroy(&mLock);
+}
+
+void ABREngine::SetLadder(const int *bitrates, int count)
+{
+	Locker locker(&mLock);
+	mBitrates.assign(bitrates, bitrates + count);
+
+	// Levels with no bitrate given still need to be usable as divisors.
+	for (size_t i = 0; i < mBitrates.size(); ++i)
+	{
+		if (mBitrates[i] <= 0)
+			mBitrates[i] = i > 0 ? mBitrates[i - 1] : 1;
+	}
+
+	GetRule_l()->Reset();
+}
+
+int ABREngine::GetQualityCount()
+{
+	Locker locker(&mLock);
+	return (int)mBitrates.size();
+}
+
+void ABREngine::SetBufferTarget(double seconds)
+{
+	Locker locker(&mLock);
+	mBufferTargetSeconds = seconds;
+}
+
+void ABREngine::SetMode(Mode mode)
+{
+	Locker locker(&mLock);
+	if (mode < 0 || mode >= MODE_COUNT)
+		return;
+
+	mMode = mode;
+	GetRule_l()->Reset();
+}
+
+ABREngine::Mode ABREngine::GetMode()
+{
+	Locker locker(&mLock);
+	return mMode;
+}
+
+const char *ABREngine::GetModeName(Mode mode)
+{
+	switch (mode)
+	{
+	case MODE_THROUGHPUT:
+		return "throughput";
+	case MODE_BOLA:
+		return "bola";
+	case MODE_DYNAMIC:
+		return "dynamic";
+	default:
+		return "unknown";
+	}
+}
+
+void ABREngine::SetRule(ABRRule *rule)
+{
+	Locker locker(&mLock);
+	mRule = rule;
+	GetRule_l()->Reset();
+}
+
+// Must be called with mLock held.
+ABRRule *ABREngine::GetRule_l()
+{
+	if (mRule)
+		return mRule;
+
+	switch (mMode)
+	{
+	case MODE_THROUGHPUT:
+		return &mThroughputRule;
+	case MODE_BOLA:
+		return &mBolaRule;
+	default:
+		return &mDynamicRule;
+	}
+}
+
+void ABREngine::AddSample(int64_t bytes, double seconds)
+{
+	if (bytes <= 0 || seconds <= 0)
+		return;
+
+	double rate = bytes * 8.0 / seconds;
+
+	Locker locker(&mLock);
+	mFast.Add(seconds, rate);
+	mSlow.Add(seconds, rate);
+
+	if (mRecent.size() == kHarmonicWindow)
+		mRecent.erase(mRecent.begin());
+	mRecent.push_back(rate);
+}
+
+double ABREngine::GetThroughput()
+{
+	Locker locker(&mLock);
+	return GetThroughput_l();
+}
+
+// Must be called with mLock held.
+double ABREngine::GetThroughput_l()
+{
+	if (mRecent.empty())
+		return -1;
+
+	double inverseSum = 0;
+	for (size_t i = 0; i < mRecent.size(); ++i)
+		inverseSum += 1.0 / mRecent[i];
+	double harmonic = mRecent.size() / inverseSum;
+
+	double estimate = mFast.Get();
+	if (mSlow.Get() < estimate)
+		estimate = mSlow.Get();
+	if (harmonic < estimate)
+		estimate = harmonic;
+	return estimate;
+}
+
+int ABREngine::SelectQuality(int currentQuality, double bufferedSeconds)
+{
+	Locker locker(&mLock);
+
+	if (mBitrates.empty())
+		return currentQuality;
+
+	ABRContext ctx;
+	ctx.bitrates = &mBitrates[0];
+	ctx.qualityCount = (int)mBitrates.size();
+	ctx.currentQuality = currentQuality;
+	ctx.bufferedSeconds = bufferedSeconds;
+	ctx.bufferTargetSeconds = mBufferTargetSeconds;
+	ctx.throughput = GetThroughput_l();
+	ctx.safetyFactor = kSafetyFactor;
+
+	return clampQuality(GetRule_l()->Choose(ctx), ctx.qualityCount);
+}
+
+void ABREngine::Reset()
+{
+	Locker locker(&mLock);
+	GetRule_l()->Reset();
+}
+
+void ABREngine::ResetThroughput()
+{
+	Locker locker(&mLock);
+	mFast.Reset();
+	mSlow.Reset();
+	mRecent.clear();
+	GetRule_l()->Reset();
+}
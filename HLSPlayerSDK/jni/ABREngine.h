@@ -0,0 +1,179 @@
+#ifndef _ABRENGINE_H_
+#define _ABRENGINE_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <vector>
+
+// What an ABRRule gets to decide from. Bitrates are in bits per second and
+// ascending, the same order as the quality levels.
+struct ABRContext
+{
+	const int *bitrates;
+	int qualityCount;
+	int currentQuality;
+	double bufferedSeconds;		// Ahead of playback, -1 if not known yet.
+	double bufferTargetSeconds;	// Where the buffer is filled up to.
+	double throughput;			// Bits per second, -1 before the first download.
+	double safetyFactor;		// Fraction of the throughput we plan to use.
+};
+
+// One way of picking a quality level. Rules may keep state between calls;
+// Reset() is called when playback restarts (seeks, new streams).
+class ABRRule
+{
+public:
+	virtual ~ABRRule() { }
+	virtual const char *GetName() = 0;
+	virtual int Choose(const ABRContext &ctx) = 0;
+	virtual void Reset() { }
+};
+
+// The highest level the throughput estimate sustains.
+class ThroughputRule : public ABRRule
+{
+public:
+	virtual const char *GetName() { return "throughput"; }
+	virtual int Choose(const ABRContext &ctx);
+};
+
+// BOLA (Spiteri et al., "BOLA: Near-Optimal Bitrate Adaptation for Online
+// Videos"): picks the level with the best utility per bit for the current
+// buffer level, so a fuller buffer buys a higher level. As in BOLA-O, it
+// won't step up past what the throughput sustains unless it's already
+// there, which keeps it from oscillating around a level the link can't
+// hold.
+class BolaRule : public ABRRule
+{
+public:
+	// Below this much buffer BOLA always picks the lowest level.
+	static const double kMinimumBufferSeconds;
+
+	virtual const char *GetName() { return "bola"; }
+	virtual int Choose(const ABRContext &ctx);
+};
+
+// Throughput while the buffer is low (startup, after a seek), BOLA once
+// there's enough of it that buffer occupancy is the better signal.
+class DynamicRule : public ABRRule
+{
+public:
+	static const double kSwitchToBolaSeconds;
+	static const double kSwitchToThroughputSeconds;
+
+	DynamicRule() : mUseBola(false) { }
+
+	virtual const char *GetName() { return "dynamic"; }
+	virtual int Choose(const ABRContext &ctx);
+	virtual void Reset() { mUseBola = false; }
+
+private:
+	ThroughputRule mThroughput;
+	BolaRule mBola;
+	bool mUseBola;
+};
+
+/*
+ * ABREngine
+ *
+ * Picks the quality level for the next segment from the bitrate ladder, the
+ * download times of past segments and the buffer level.
+ *
+ * Throughput is estimated as the lowest of a fast and a slow EWMA of the
+ * segment download rates (each weighted by download time, so a long
+ * download counts for more than a short one) and the harmonic mean of the
+ * last few downloads. The EWMAs follow sustained changes; the harmonic mean
+ * keeps one lucky burst from pulling the estimate up.
+ *
+ * The decision itself is made by an ABRRule. The built in ones are picked
+ * with SetMode, throughput being the default; SetRule plugs in any other.
+ *
+ * All methods are safe to call from any thread.
+ */
+class ABREngine
+{
+public:
+	enum Mode
+	{
+		MODE_THROUGHPUT = 0,
+		MODE_BOLA,
+		MODE_DYNAMIC,
+		MODE_COUNT
+	};
+
+	ABREngine();
+	~ABREngine();
+
+	// bitrates in bits per second, ascending; quality level i is bitrates[i].
+	void SetLadder(const int *bitrates, int count);
+	int GetQualityCount();
+
+	// Where the buffer controller fills the buffer up to.
+	void SetBufferTarget(double seconds);
+
+	void SetMode(Mode mode);
+	Mode GetMode();
+	static const char *GetModeName(Mode mode);
+
+	// Use rule instead of the built in ones, NULL to go back to them. The
+	// caller keeps ownership and must not delete it while it's set.
+	void SetRule(ABRRule *rule);
+
+	// A segment (or any other download worth counting) of bytes took
+	// seconds to come in.
+	void AddSample(int64_t bytes, double seconds);
+
+	// Bits per second, -1 before the first sample.
+	double GetThroughput();
+
+	// Quality level to request next, given the one we're on and the
+	// seconds buffered ahead of playback (-1 if not known).
+	int SelectQuality(int currentQuality, double bufferedSeconds);
+
+	// Playback restarted; rule state is dropped, the throughput estimate is
+	// kept since the link didn't change.
+	void Reset();
+
+	// Forget the throughput estimate too, e.g. for a new stream.
+	void ResetThroughput();
+
+private:
+	// EWMA of the download rate with the given half life, in seconds of
+	// download time.
+	struct Ewma
+	{
+		double halfLife;
+		double estimate;
+		double totalWeight;
+
+		void Reset() { estimate = 0; totalWeight = 0; }
+		void Add(double seconds, double bitsPerSecond);
+		double Get() const;
+	};
+
+	static const double kFastHalfLifeSeconds;
+	static const double kSlowHalfLifeSeconds;
+	static const int kHarmonicWindow = 5;
+	static const double kSafetyFactor;
+
+	pthread_mutex_t mLock;
+
+	std::vector<int> mBitrates;
+	double mBufferTargetSeconds;
+
+	Ewma mFast;
+	Ewma mSlow;
+	std::vector<double> mRecent;	// Last kHarmonicWindow rates, oldest first.
+
+	Mode mMode;
+	ThroughputRule mThroughputRule;
+	BolaRule mBolaRule;
+	DynamicRule mDynamicRule;
+	ABRRule *mRule;
+
+	ABRRule *GetRule_l();
+	double GetThroughput_l();
+};
+
+#endif /* _ABRENGINE_H_ */
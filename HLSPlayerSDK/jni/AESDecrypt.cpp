@@ -0,0 +1,393 @@
+#include "AESDecrypt.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#define HAVE_AESNI
+#include <cpuid.h>
+#include <wmmintrin.h>
+#endif
+
+#ifdef HAVE_AES_ARMV8
+#include <sys/auxv.h>
+#ifndef HWCAP_AES
+#define HWCAP_AES (1 << 3)
+#endif
+#endif
+
+#define GETU32(p) (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) | ((uint32_t)(p)[2] << 8) | ((uint32_t)(p)[3]))
+
+#define PUTU32(p, v) { (p)[0] = (unsigned char)((v) >> 24); (p)[1] = (unsigned char)((v) >> 16); \
+                       (p)[2] = (unsigned char)((v) >> 8); (p)[3] = (unsigned char)(v); }
+
+static const int kRounds = 10;
+
+//----------------------------------------------------------------------------
+// Tables, generated once rather than carried as another 5KB of constants.
+
+static uint8_t gSBox[256];
+static uint8_t gInvSBox[256];
+static uint32_t gTd[4][256];
+static pthread_once_t gTablesOnce = PTHREAD_ONCE_INIT;
+
+static inline uint8_t xtime(uint8_t x)
+{
+	return (uint8_t)((x << 1) ^ ((x & 0x80) ? 0x1b : 0));
+}
+
+static uint8_t gfMul(uint8_t a, uint8_t b)
+{
+	uint8_t r = 0;
+	while (b)
+	{
+		if (b & 1) r ^= a;
+		a = xtime(a);
+		b >>= 1;
+	}
+	return r;
+}
+
+static inline uint8_t rotl8(uint8_t x, int n)
+{
+	return (uint8_t)((x << n) | (x >> (8 - n)));
+}
+
+static inline uint32_t rotr32(uint32_t x, int n)
+{
+	return (x >> n) | (x << (32 - n));
+}
+
+static void buildTables()
+{
+	// Powers and logs of the generator 3 give us multiplicative inverses.
+	uint8_t pow[255], log[256];
+	uint8_t x = 1;
+	for (int i = 0; i < 255; ++i)
+	{
+		pow[i] = x;
+		log[x] = (uint8_t)i;
+		x ^= xtime(x);
+	}
+
+	for (int i = 0; i < 256; ++i)
+	{
+		uint8_t inv = i ? pow[(255 - log[i]) % 255] : 0;
+		uint8_t s = inv ^ rotl8(inv, 1) ^ rotl8(inv, 2) ^ rotl8(inv, 3) ^ rotl8(inv, 4) ^ 0x63;
+		gSBox[i] = s;
+		gInvSBox[s] = (uint8_t)i;
+	}
+
+	for (int i = 0; i < 256; ++i)
+	{
+		uint8_t s = gInvSBox[i];
+		uint32_t w = ((uint32_t)gfMul(s, 0x0e) << 24) | ((uint32_t)gfMul(s, 0x09) << 16) |
+				((uint32_t)gfMul(s, 0x0d) << 8) | (uint32_t)gfMul(s, 0x0b);
+		gTd[0][i] = w;
+		gTd[1][i] = rotr32(w, 8);
+		gTd[2][i] = rotr32(w, 16);
+		gTd[3][i] = rotr32(w, 24);
+	}
+}
+
+//----------------------------------------------------------------------------
+// Runtime CPU feature detection.
+
+#ifdef HAVE_AESNI
+static bool cpuHasAESNI()
+{
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+	return (ecx & bit_AES) && (edx & bit_SSE2);
+}
+#endif
+
+#ifdef HAVE_AES_ARMV8
+static bool cpuHasARMv8AES()
+{
+	return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+}
+#endif
+
+//----------------------------------------------------------------------------
+// T-table back end.
+
+#define TD_COL(a, b, c, d) \
+	(td0[(a) >> 24] ^ td1[((b) >> 16) & 0xff] ^ td2[((c) >> 8) & 0xff] ^ td3[(d) & 0xff])
+
+#define INV_COL(a, b, c, d) \
+	(((uint32_t)isb[(a) >> 24] << 24) | ((uint32_t)isb[((b) >> 16) & 0xff] << 16) | \
+	 ((uint32_t)isb[((c) >> 8) & 0xff] << 8) | (uint32_t)isb[(d) & 0xff])
+
+static void decryptTable(const uint32_t *roundKeys, unsigned char *data, size_t blocks, unsigned char *iv)
+{
+	const uint32_t *td0 = gTd[0];
+	const uint32_t *td1 = gTd[1];
+	const uint32_t *td2 = gTd[2];
+	const uint32_t *td3 = gTd[3];
+	const uint8_t *isb = gInvSBox;
+
+	// Previous ciphertext block, XORed into the next plaintext.
+	uint32_t p0 = GETU32(iv), p1 = GETU32(iv + 4), p2 = GETU32(iv + 8), p3 = GETU32(iv + 12);
+
+	for (; blocks > 0; --blocks, data += 16)
+	{
+		uint32_t c0 = GETU32(data), c1 = GETU32(data + 4), c2 = GETU32(data + 8), c3 = GETU32(data + 12);
+		const uint32_t *rk = roundKeys;
+
+		uint32_t s0 = c0 ^ rk[0], s1 = c1 ^ rk[1], s2 = c2 ^ rk[2], s3 = c3 ^ rk[3];
+		uint32_t t0, t1, t2, t3;
+
+		// Nine full rounds, two at a time so the state never has to be
+		// shuffled between registers.
+		for (int r = 0; ; ++r)
+		{
+			t0 = TD_COL(s0, s3, s2, s1) ^ rk[4];
+			t1 = TD_COL(s1, s0, s3, s2) ^ rk[5];
+			t2 = TD_COL(s2, s1, s0, s3) ^ rk[6];
+			t3 = TD_COL(s3, s2, s1, s0) ^ rk[7];
+			rk += 8;
+			if (r == (kRounds - 1) / 2)
+				break;
+
+			s0 = TD_COL(t0, t3, t2, t1) ^ rk[0];
+			s1 = TD_COL(t1, t0, t3, t2) ^ rk[1];
+			s2 = TD_COL(t2, t1, t0, t3) ^ rk[2];
+			s3 = TD_COL(t3, t2, t1, t0) ^ rk[3];
+		}
+
+		s0 = INV_COL(t0, t3, t2, t1) ^ rk[0] ^ p0;
+		s1 = INV_COL(t1, t0, t3, t2) ^ rk[1] ^ p1;
+		s2 = INV_COL(t2, t1, t0, t3) ^ rk[2] ^ p2;
+		s3 = INV_COL(t3, t2, t1, t0) ^ rk[3] ^ p3;
+
+		PUTU32(data, s0);
+		PUTU32(data + 4, s1);
+		PUTU32(data + 8, s2);
+		PUTU32(data + 12, s3);
+
+		p0 = c0; p1 = c1; p2 = c2; p3 = c3;
+	}
+
+	PUTU32(iv, p0);
+	PUTU32(iv + 4, p1);
+	PUTU32(iv + 8, p2);
+	PUTU32(iv + 12, p3);
+}
+
+#undef TD_COL
+#undef INV_COL
+
+//----------------------------------------------------------------------------
+// AES-NI back end. CBC decryption has no dependency between blocks, so four
+// are kept in flight to cover the aesdec latency.
+
+#ifdef HAVE_AESNI
+__attribute__((target("aes,sse2")))
+static void decryptAESNI(const unsigned char *roundKeyBytes, unsigned char *data, size_t blocks, unsigned char *iv)
+{
+	__m128i k[kRounds + 1];
+	for (int r = 0; r <= kRounds; ++r)
+		k[r] = _mm_loadu_si128((const __m128i *)(roundKeyBytes + 16 * r));
+
+	__m128i prev = _mm_loadu_si128((const __m128i *)iv);
+
+	for (; blocks >= 4; blocks -= 4, data += 64)
+	{
+		__m128i c0 = _mm_loadu_si128((const __m128i *)data);
+		__m128i c1 = _mm_loadu_si128((const __m128i *)(data + 16));
+		__m128i c2 = _mm_loadu_si128((const __m128i *)(data + 32));
+		__m128i c3 = _mm_loadu_si128((const __m128i *)(data + 48));
+
+		__m128i s0 = _mm_xor_si128(c0, k[0]);
+		__m128i s1 = _mm_xor_si128(c1, k[0]);
+		__m128i s2 = _mm_xor_si128(c2, k[0]);
+		__m128i s3 = _mm_xor_si128(c3, k[0]);
+
+		for (int r = 1; r < kRounds; ++r)
+		{
+			s0 = _mm_aesdec_si128(s0, k[r]);
+			s1 = _mm_aesdec_si128(s1, k[r]);
+			s2 = _mm_aesdec_si128(s2, k[r]);
+			s3 = _mm_aesdec_si128(s3, k[r]);
+		}
+
+		s0 = _mm_aesdeclast_si128(s0, k[kRounds]);
+		s1 = _mm_aesdeclast_si128(s1, k[kRounds]);
+		s2 = _mm_aesdeclast_si128(s2, k[kRounds]);
+		s3 = _mm_aesdeclast_si128(s3, k[kRounds]);
+
+		_mm_storeu_si128((__m128i *)data, _mm_xor_si128(s0, prev));
+		_mm_storeu_si128((__m128i *)(data + 16), _mm_xor_si128(s1, c0));
+		_mm_storeu_si128((__m128i *)(data + 32), _mm_xor_si128(s2, c1));
+		_mm_storeu_si128((__m128i *)(data + 48), _mm_xor_si128(s3, c2));
+		prev = c3;
+	}
+
+	for (; blocks > 0; --blocks, data += 16)
+	{
+		__m128i c = _mm_loadu_si128((const __m128i *)data);
+		__m128i s = _mm_xor_si128(c, k[0]);
+		for (int r = 1; r < kRounds; ++r)
+			s = _mm_aesdec_si128(s, k[r]);
+		s = _mm_aesdeclast_si128(s, k[kRounds]);
+		_mm_storeu_si128((__m128i *)data, _mm_xor_si128(s, prev));
+		prev = c;
+	}
+
+	_mm_storeu_si128((__m128i *)iv, prev);
+}
+#endif
+
+//----------------------------------------------------------------------------
+// ARMv8 Cryptography Extensions back end, in AESDecrypt_armv8.cpp so that only
+// it is built with the crypto extension enabled.
+
+#ifdef HAVE_AES_ARMV8
+void decryptARMv8(const unsigned char *roundKeyBytes, unsigned char *data, size_t blocks, unsigned char *iv);
+#endif
+
+//----------------------------------------------------------------------------
+
+AESDecrypt::AESDecrypt(const unsigned char *key, const unsigned char *iv, Backend backend)
+{
+	pthread_once(&gTablesOnce, buildTables);
+
+	if (backend == BACKEND_AUTO || !isSupported(backend))
+		backend = getBestBackend();
+	mBackend = backend;
+
+	// Expand the encryption schedule.
+	uint32_t ek[4 * (kRounds + 1)];
+	ek[0] = GETU32(key);
+	ek[1] = GETU32(key + 4);
+	ek[2] = GETU32(key + 8);
+	ek[3] = GETU32(key + 12);
+
+	uint8_t rcon = 1;
+	for (int i = 4; i < 4 * (kRounds + 1); ++i)
+	{
+		uint32_t t = ek[i - 1];
+		if ((i & 3) == 0)
+		{
+			t = (t << 8) | (t >> 24);
+			t = ((uint32_t)gSBox[t >> 24] << 24) | ((uint32_t)gSBox[(t >> 16) & 0xff] << 16) |
+					((uint32_t)gSBox[(t >> 8) & 0xff] << 8) | (uint32_t)gSBox[t & 0xff];
+			t ^= (uint32_t)rcon << 24;
+			rcon = xtime(rcon);
+		}
+		ek[i] = ek[i - 4] ^ t;
+	}
+
+	// Reverse it for decryption, with InvMixColumns applied to all but the
+	// outer round keys. Td undoes the S-box lookup, leaving just the mix.
+	for (int r = 0; r <= kRounds; ++r)
+	{
+		const uint32_t *src = ek + 4 * (kRounds - r);
+		for (int j = 0; j < 4; ++j)
+		{
+			uint32_t w = src[j];
+			if (r > 0 && r < kRounds)
+			{
+				w = gTd[0][gSBox[w >> 24]] ^ gTd[1][gSBox[(w >> 16) & 0xff]] ^
+						gTd[2][gSBox[(w >> 8) & 0xff]] ^ gTd[3][gSBox[w & 0xff]];
+			}
+			mRoundKeys[4 * r + j] = w;
+			PUTU32(mRoundKeyBytes + 16 * r + 4 * j, w);
+		}
+	}
+
+	memcpy(mInitialIV, iv, sizeof(mInitialIV));
+	memcpy(mIV, iv, sizeof(mIV));
+}
+
+void AESDecrypt::decrypt(unsigned char *data, size_t length)
+{
+	decrypt(data, length, mIV);
+}
+
+void AESDecrypt::decryptFromStart(unsigned char *data, size_t length) const
+{
+	unsigned char iv[16];
+	memcpy(iv, mInitialIV, sizeof(iv));
+	decrypt(data, length, iv);
+}
+
+void AESDecrypt::decrypt(unsigned char *data, size_t length, unsigned char *iv) const
+{
+	size_t blocks = length / kBlockSize;
+
+	switch (mBackend)
+	{
+#ifdef HAVE_AESNI
+	case BACKEND_AESNI:
+		decryptAESNI(mRoundKeyBytes, data, blocks, iv);
+		break;
+#endif
+#ifdef HAVE_AES_ARMV8
+	case BACKEND_ARMV8:
+		decryptARMv8(mRoundKeyBytes, data, blocks, iv);
+		break;
+#endif
+	default:
+		decryptTable(mRoundKeys, data, blocks, iv);
+		break;
+	}
+}
+
+bool AESDecrypt::isSupported(Backend backend)
+{
+	switch (backend)
+	{
+	case BACKEND_TABLE:
+		return true;
+#ifdef HAVE_AESNI
+	case BACKEND_AESNI:
+		return cpuHasAESNI();
+#endif
+#ifdef HAVE_AES_ARMV8
+	case BACKEND_ARMV8:
+		return cpuHasARMv8AES();
+#endif
+	default:
+		return false;
+	}
+}
+
+AESDecrypt::Backend AESDecrypt::getBestBackend()
+{
+	if (isSupported(BACKEND_ARMV8))
+		return BACKEND_ARMV8;
+	if (isSupported(BACKEND_AESNI))
+		return BACKEND_AESNI;
+	return BACKEND_TABLE;
+}
+
+const char *AESDecrypt::getBackendName(Backend backend)
+{
+	switch (backend)
+	{
+	case BACKEND_TABLE: return "table";
+	case BACKEND_AESNI: return "aesni";
+	case BACKEND_ARMV8: return "armv8";
+	default: return "unknown";
+	}
+}
+
+size_t AESDecrypt::getPaddingLength(const unsigned char *data, size_t length)
+{
+	if (length == 0)
+		return 0;
+
+	size_t pad = data[length - 1];
+	if (pad == 0 || pad > kBlockSize || pad > length)
+		return 0;
+
+	for (size_t i = length - pad; i < length; ++i)
+	{
+		if (data[i] != pad)
+			return 0;
+	}
+	return pad;
+}
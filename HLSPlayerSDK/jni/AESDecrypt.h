@@ -0,0 +1,73 @@
+#ifndef _AESDECRYPT_H_
+#define _AESDECRYPT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// AES-128-CBC decryption for HLS segments (EXT-X-KEY METHOD=AES-128).
+//
+// Decryption is always in place: the previous ciphertext block is kept in
+// registers while the current one is decrypted over itself, so no scratch
+// buffer the size of the range is needed. Several back ends are built in and
+// the fastest one the CPU supports is picked at runtime:
+//
+//   BACKEND_TABLE  Portable T-table implementation, always available.
+//   BACKEND_AESNI  x86 AES-NI, four blocks in flight.
+//   BACKEND_ARMV8  ARMv8 Cryptography Extensions, four blocks in flight.
+//                  Needs an arm64-v8a build, which APP_ABI doesn't have yet.
+//
+// decrypt(data, length) carries the running CBC chain in the instance and
+// must not be called from more than one thread at a time.
+class AESDecrypt
+{
+public:
+	enum Backend
+	{
+		BACKEND_AUTO = -1,
+		BACKEND_TABLE = 0,
+		BACKEND_AESNI,
+		BACKEND_ARMV8,
+		BACKEND_COUNT
+	};
+
+	static const size_t kBlockSize = 16;
+	static const size_t kKeySize = 16;
+
+	AESDecrypt(const unsigned char *key, const unsigned char *iv, Backend backend = BACKEND_AUTO);
+
+	// Decrypt length bytes (a multiple of kBlockSize) in place, carrying on
+	// the chain from wherever the previous call left it.
+	void decrypt(unsigned char *data, size_t length);
+
+	// Decrypt length bytes in place as the start of a new stream, chained
+	// from the IV given at construction. The running chain is not touched.
+	void decryptFromStart(unsigned char *data, size_t length) const;
+
+	// Decrypt length bytes in place chained from iv, which is updated to the
+	// last ciphertext block. Only reads the key, so it is safe to call from
+	// several threads at once.
+	void decrypt(unsigned char *data, size_t length, unsigned char *iv) const;
+
+	Backend getBackend() const { return mBackend; }
+
+	static bool isSupported(Backend backend);
+	static Backend getBestBackend();
+	static const char *getBackendName(Backend backend);
+
+	// Number of PKCS#7 padding bytes at the end of decrypted data, 0 if the
+	// tail doesn't look like padding.
+	static size_t getPaddingLength(const unsigned char *data, size_t length);
+
+private:
+	Backend mBackend;
+
+	// Decryption key schedule (equivalent inverse cipher), round 0 first.
+	// Big endian words for the table code, raw bytes for the hardware.
+	uint32_t mRoundKeys[44];
+	unsigned char mRoundKeyBytes[176];
+
+	unsigned char mInitialIV[16];
+	unsigned char mIV[16];
+};
+
+#endif /* _AESDECRYPT_H_ */
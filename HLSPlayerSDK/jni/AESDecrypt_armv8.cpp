@@ -0,0 +1,66 @@
+// ARMv8 Cryptography Extensions back end for AESDecrypt. Built with the crypto
+// extension enabled only on arm64-v8a (see Android.mk); AESDecrypt.cpp checks
+// for it at runtime before this gets used.
+//
+// AESD does AddRoundKey first and AESIMC is a separate step, so the schedule
+// is used one key earlier than AES-NI and the final key is XORed on at the
+// end.
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRYPTO)
+
+#include <arm_neon.h>
+#include <stddef.h>
+#include <stdint.h>
+
+static const int kRounds = 10;
+
+void decryptARMv8(const unsigned char *roundKeyBytes, unsigned char *data, size_t blocks, unsigned char *iv)
+{
+	uint8x16_t k[kRounds + 1];
+	for (int r = 0; r <= kRounds; ++r)
+		k[r] = vld1q_u8(roundKeyBytes + 16 * r);
+
+	uint8x16_t prev = vld1q_u8(iv);
+
+	for (; blocks >= 4; blocks -= 4, data += 64)
+	{
+		uint8x16_t c0 = vld1q_u8(data);
+		uint8x16_t c1 = vld1q_u8(data + 16);
+		uint8x16_t c2 = vld1q_u8(data + 32);
+		uint8x16_t c3 = vld1q_u8(data + 48);
+		uint8x16_t s0 = c0, s1 = c1, s2 = c2, s3 = c3;
+
+		for (int r = 0; r < kRounds - 1; ++r)
+		{
+			s0 = vaesimcq_u8(vaesdq_u8(s0, k[r]));
+			s1 = vaesimcq_u8(vaesdq_u8(s1, k[r]));
+			s2 = vaesimcq_u8(vaesdq_u8(s2, k[r]));
+			s3 = vaesimcq_u8(vaesdq_u8(s3, k[r]));
+		}
+
+		s0 = veorq_u8(vaesdq_u8(s0, k[kRounds - 1]), k[kRounds]);
+		s1 = veorq_u8(vaesdq_u8(s1, k[kRounds - 1]), k[kRounds]);
+		s2 = veorq_u8(vaesdq_u8(s2, k[kRounds - 1]), k[kRounds]);
+		s3 = veorq_u8(vaesdq_u8(s3, k[kRounds - 1]), k[kRounds]);
+
+		vst1q_u8(data, veorq_u8(s0, prev));
+		vst1q_u8(data + 16, veorq_u8(s1, c0));
+		vst1q_u8(data + 32, veorq_u8(s2, c1));
+		vst1q_u8(data + 48, veorq_u8(s3, c2));
+		prev = c3;
+	}
+
+	for (; blocks > 0; --blocks, data += 16)
+	{
+		uint8x16_t c = vld1q_u8(data);
+		uint8x16_t s = c;
+		for (int r = 0; r < kRounds - 1; ++r)
+			s = vaesimcq_u8(vaesdq_u8(s, k[r]));
+		s = veorq_u8(vaesdq_u8(s, k[kRounds - 1]), k[kRounds]);
+		vst1q_u8(data, veorq_u8(s, prev));
+		prev = c;
+	}
+
+	vst1q_u8(iv, prev);
+}
+#endif
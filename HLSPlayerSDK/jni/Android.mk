@@ -1,5 +1,19 @@
 LOCAL_PATH := $(call my-dir)
 
+# None of the arm64-v8a branches in this file are built yet: arm64-v8a isn't
+# in APP_ABI (Application.mk) because androidVideoShim looks libstagefright up
+# by its 32 bit mangled symbol names, which a 64 bit build won't find.
+
+# AESDecrypt's ARMv8 Cryptography Extensions back end. Only this file may be
+# built with the crypto extension; AESDecrypt.cpp checks for it at runtime.
+ifeq ($(TARGET_ARCH_ABI),arm64-v8a)
+include $(CLEAR_VARS)
+LOCAL_MODULE    := aesdecrypt_armv8
+LOCAL_SRC_FILES := AESDecrypt_armv8.cpp
+LOCAL_CFLAGS    := -march=armv8-a+crypto
+include $(BUILD_STATIC_LIBRARY)
+endif
+
 include $(CLEAR_VARS)
 
 LOCAL_MODULE    := HLSPlayerSDK
@@ -24,9 +38,9 @@ sbrdec_sources := $(sbrdec_sources:$(LOCAL_PATH)/fdk-aac-master/libSBRdec/src/%=
 
 # Core Player Code
 LOCAL_SRC_FILES += HLSPlayerSDK.cpp HLSSegment.cpp HLSPlayer.cpp AudioTrack.cpp  RefCounted.cpp 
-LOCAL_SRC_FILES += androidVideoShim.cpp androidVideoShim_ColorConverter.cpp androidVideoShim_ColorConverter444.cpp
-LOCAL_SRC_FILES += aes.c AudioPlayer.cpp AudioFDK.cpp ESDS.cpp
-LOCAL_SRC_FILES += HLSSegmentCache.cpp debug.cpp constants.cpp
+LOCAL_SRC_FILES += androidVideoShim.cpp androidVideoShim_ColorConverter.cpp androidVideoShim_ColorConverter444.cpp YUVRowConverter.cpp
+LOCAL_SRC_FILES += AESDecrypt.cpp DecryptPool.cpp AudioPlayer.cpp AudioFDK.cpp AudioClock.cpp AudioCommandQueue.cpp AudioSLES.cpp OpenSLOutput.cpp ESDS.cpp
+LOCAL_SRC_FILES += HLSSegmentCache.cpp debug.cpp constants.cpp FrameScheduler.cpp MonotonicWait.cpp SegmentProbe.cpp BufferController.cpp ABREngine.cpp CodecReaper.cpp ConversionPool.cpp
 
 # MPEG 2 TS Extractor
 LOCAL_SRC_FILES += mpeg2ts_parser/AAtomizer.cpp mpeg2ts_parser/ABitReader.cpp mpeg2ts_parser/ABuffer.cpp mpeg2ts_parser/AMessage.cpp
@@ -44,6 +58,47 @@ LOCAL_SRC_FILES += $(pcmutils_sources:%=fdk-aac-master/libPCMutils/src/%)
 
 LOCAL_CFLAGS += -DHAVE_SYS_UIO_H -Wno-multichar -Wno-pmf-conversions -g
 
+ifeq ($(TARGET_ARCH_ABI),arm64-v8a)
+LOCAL_CFLAGS += -DHAVE_AES_ARMV8
+LOCAL_STATIC_LIBRARIES += aesdecrypt_armv8
+endif
+
+# YUVRowConverter's NEON back end. NEON is optional on armeabi-v7a, so only
+# that file gets built with it there and cpufeatures checks for it at runtime.
+# arm64-v8a always has it (not built, see the top of this file).
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+LOCAL_SRC_FILES += YUVRowConverter_neon.cpp.neon
+LOCAL_CFLAGS += -DHAVE_YUV_NEON
+LOCAL_STATIC_LIBRARIES += cpufeatures
+endif
+ifeq ($(TARGET_ARCH_ABI),arm64-v8a)
+LOCAL_SRC_FILES += YUVRowConverter_neon.cpp
+LOCAL_CFLAGS += -DHAVE_YUV_NEON
+endif
+
+# ATSParser's NEON sync byte scan, set up the same way.
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+LOCAL_SRC_FILES += mpeg2ts_parser/ATSParser_neon.cpp.neon
+LOCAL_CFLAGS += -DHAVE_TS_NEON
+endif
+ifeq ($(TARGET_ARCH_ABI),arm64-v8a)
+LOCAL_SRC_FILES += mpeg2ts_parser/ATSParser_neon.cpp
+LOCAL_CFLAGS += -DHAVE_TS_NEON
+endif
+
+# fdk-aac's NEON QMF, FFT and DCT kernels, set up the same way; FDK_neon.cpp
+# does the runtime check. Tools/AACBench's "make check" tests them against the
+# C code. arm64-v8a isn't built, see the top of this file.
+fdk_neon_sources := qmf_neon.cpp fft_rad2_neon.cpp dct_neon.cpp
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+LOCAL_SRC_FILES += $(fdk_neon_sources:%=fdk-aac-master/libFDK/src/neon/%.neon)
+LOCAL_CFLAGS += -DHAVE_FDK_NEON
+endif
+ifeq ($(TARGET_ARCH_ABI),arm64-v8a)
+LOCAL_SRC_FILES += $(fdk_neon_sources:%=fdk-aac-master/libFDK/src/neon/%)
+LOCAL_CFLAGS += -DHAVE_FDK_NEON
+endif
+
 # -fdump-class-hierarchy
 LOCAL_C_INCLUDES += $(TOP)/system/core/include ./libyuv/
 LOCAL_C_INCLUDES += $(LOCAL_PATH)/fdk-aac-master/libAACdec/include
@@ -54,6 +109,8 @@ LOCAL_C_INCLUDES += $(LOCAL_PATH)/fdk-aac-master/libSBRdec/include
 LOCAL_C_INCLUDES += $(LOCAL_PATH)/fdk-aac-master/libPCMutils/include
 
 
-LOCAL_LDLIBS += -lz -lm -llog -landroid
+LOCAL_LDLIBS += -lz -lm -llog -landroid -lOpenSLES
 
 include $(BUILD_SHARED_LIBRARY)
+
+$(call import-module,android/cpufeatures)
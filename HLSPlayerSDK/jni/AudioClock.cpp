@@ -0,0 +1,154 @@
+#include <androidVideoShim.h>
+#include "AudioClock.h"
+#include "FrameScheduler.h"
+
+#include <sched.h>
+
+// Head positions further than this from where the clock thinks it is are
+// taken as a jump and re-anchor it.
+static const int64_t kClockResyncUs = 100000;
+
+// How far the clock may run past the last head position it was given. Stops
+// it running on when the track stalls.
+static const int64_t kMaxExtrapolationUs = 100000;
+
+// The clock aims to make up any difference from the head position over this
+// long...
+static const int64_t kSlewUs = 500000;
+
+// ...but never runs more than this far off real time (parts per million).
+static const int32_t kMaxSlewPPM = 50000;
+
+AudioClock::AudioClock() : mSequence(0), mLastHeadUs(0), mHasHead(false)
+{
+	memset(&mState, 0, sizeof(mState));
+	mState.ratePPM = 1000000;
+	pthread_mutex_init(&mWriteLock, NULL);
+}
+
+AudioClock::~AudioClock()
+{
+	pthread_mutex_destroy(&mWriteLock);
+}
+
+void AudioClock::Read(State& state) const
+{
+	for (;;)
+	{
+		uint32_t sequence = mSequence;
+		__sync_synchronize();
+		if (sequence & 1)
+		{
+			sched_yield();
+			continue;
+		}
+
+		state = mState;
+		__sync_synchronize();
+		if (sequence == mSequence)
+			return;
+	}
+}
+
+// Must be called with mWriteLock held.
+void AudioClock::Publish(const State& state)
+{
+	++mSequence;
+	__sync_synchronize();
+	mState = state;
+	__sync_synchronize();
+	++mSequence;
+}
+
+int64_t AudioClock::Interpolate(const State& state, int64_t nowUs)
+{
+	if (!state.running)
+		return state.anchorUs;
+
+	int64_t elapsedUs = nowUs - state.anchorRealUs;
+	if (elapsedUs < 0)
+		elapsedUs = 0;
+
+	int64_t positionUs = state.anchorUs + elapsedUs * state.ratePPM / 1000000;
+	if (positionUs > state.limitUs)
+		positionUs = state.limitUs;
+	return positionUs;
+}
+
+void AudioClock::Reset()
+{
+	AutoLock locker(&mWriteLock, __func__);
+	mHasHead = false;
+	mLastHeadUs = 0;
+
+	State state = mState;
+	state.anchorUs = 0;
+	state.anchorRealUs = FrameScheduler::NowUs();
+	state.limitUs = 0;
+	state.ratePPM = 1000000;
+	state.running = false;
+	Publish(state);
+}
+
+void AudioClock::SetOffsetUs(int64_t offsetUs)
+{
+	AutoLock locker(&mWriteLock, __func__);
+	State state = mState;
+	state.offsetUs = offsetUs;
+	Publish(state);
+}
+
+void AudioClock::Update(int64_t headUs, bool running)
+{
+	int64_t nowUs = FrameScheduler::NowUs();
+	AutoLock locker(&mWriteLock, __func__);
+
+	State state = mState;
+
+	// The head position only moves in steps, an unchanged value tells us
+	// nothing new while we're running.
+	if (mHasHead && running && state.running && headUs == mLastHeadUs)
+		return;
+
+	int64_t predictedUs = Interpolate(state, nowUs);
+	int64_t diffUs = headUs - predictedUs;
+
+	if (!mHasHead || !running || !state.running || diffUs > kClockResyncUs || diffUs < -kClockResyncUs)
+	{
+		// Starting, stopping or somewhere else entirely: take the head
+		// position as it is.
+		if (mHasHead && running && state.running)
+			LOGTIMING("Re-anchoring audio clock: head=%lld predicted=%lld", headUs, predictedUs);
+		state.anchorUs = headUs;
+		state.ratePPM = 1000000;
+	}
+	else
+	{
+		// Carry on from where we are, at whatever rate closes the gap over
+		// kSlewUs.
+		int64_t slewPPM = diffUs * 1000000 / kSlewUs;
+		if (slewPPM > kMaxSlewPPM)
+			slewPPM = kMaxSlewPPM;
+		else if (slewPPM < -kMaxSlewPPM)
+			slewPPM = -kMaxSlewPPM;
+
+		state.anchorUs = predictedUs;
+		state.ratePPM = 1000000 + (int32_t)slewPPM;
+	}
+
+	state.anchorRealUs = nowUs;
+	state.limitUs = headUs + kMaxExtrapolationUs;
+	state.running = running;
+	Publish(state);
+
+	mHasHead = true;
+	mLastHeadUs = headUs;
+}
+
+int64_t AudioClock::GetTimeUs() const
+{
+	int64_t nowUs = FrameScheduler::NowUs();
+	State state;
+	Read(state);
+	return state.offsetUs + Interpolate(state, nowUs);
+}
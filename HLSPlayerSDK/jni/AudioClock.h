@@ -0,0 +1,70 @@
+#ifndef _AUDIOCLOCK_H_
+#define _AUDIOCLOCK_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+ * AudioClock
+ *
+ * The audio player's playback position, for readers that can't afford to
+ * ask the track (GetTimeStamp() runs once per video frame).
+ *
+ * The audio thread feeds in the head position as it polls it; in between,
+ * the clock runs off CLOCK_MONOTONIC. Rather than step to each new head
+ * position, it speeds up or slows down slightly to converge on it, so the
+ * time it reports moves smoothly instead of in the track's coarse steps.
+ * Only a real jump (seek, underrun, resume) re-anchors it.
+ *
+ * GetTimeUs() never blocks: the state it reads is published through a
+ * sequence lock, and a read that overlaps an update simply retries.
+ * Updates are serialized by a mutex among themselves.
+ */
+class AudioClock
+{
+public:
+	AudioClock();
+	~AudioClock();
+
+	// Back to position 0, stopped. The track's head position resets on
+	// stop and flush, so this goes with those.
+	void Reset();
+
+	// Media time of head position 0.
+	void SetOffsetUs(int64_t offsetUs);
+
+	// The track's head position, converted to time, and whether it's
+	// currently playing.
+	void Update(int64_t headUs, bool running);
+
+	// Offset plus interpolated position.
+	int64_t GetTimeUs() const;
+
+private:
+	// Everything GetTimeUs() needs. Position mAnchorUs was current at
+	// mAnchorRealUs, and has advanced since at mRatePPM parts per million
+	// of real time, up to mLimitUs.
+	struct State
+	{
+		int64_t offsetUs;
+		int64_t anchorUs;
+		int64_t anchorRealUs;
+		int64_t limitUs;
+		int32_t ratePPM;
+		bool running;
+	};
+
+	// Odd while an update is being written.
+	volatile uint32_t mSequence;
+	State mState;
+
+	pthread_mutex_t mWriteLock;
+	int64_t mLastHeadUs;
+	bool mHasHead;
+
+	void Read(State& state) const;
+	void Publish(const State& state);
+	static int64_t Interpolate(const State& state, int64_t nowUs);
+};
+
+#endif /* _AUDIOCLOCK_H_ */
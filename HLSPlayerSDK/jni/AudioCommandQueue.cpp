@@ -0,0 +1,78 @@
+#include <androidVideoShim.h>
+#include "AudioCommandQueue.h"
+#include "constants.h"
+
+AudioCommandQueue::AudioCommandQueue() : mPushPos(0), mPopPos(0)
+{
+	for (int i = 0; i < kCapacity; ++i)
+		mSlots[i].sequence = i;
+}
+
+AudioCommandQueue::~AudioCommandQueue()
+{
+}
+
+bool AudioCommandQueue::Push(int state, int data)
+{
+	uint32_t pos = mPushPos;
+	for (;;)
+	{
+		Slot& slot = mSlots[pos % kCapacity];
+		int32_t diff = (int32_t)(slot.sequence - pos);
+		if (diff == 0)
+		{
+			// Free and nobody else has claimed it yet.
+			uint32_t seen = __sync_val_compare_and_swap(&mPushPos, pos, pos + 1);
+			if (seen == pos)
+			{
+				slot.command.state = state;
+				slot.command.data = data;
+				__sync_synchronize();
+				slot.sequence = pos + 1;
+				break;
+			}
+			pos = seen;
+		}
+		else if (diff < 0)
+		{
+			// Still holds a command kCapacity pushes ago that hasn't been popped.
+			LOGE("Audio command queue is full, dropping %s", getStateString(state));
+			return false;
+		}
+		else
+		{
+			// Another thread got there first.
+			pos = mPushPos;
+		}
+	}
+
+	mWakeSem.Post();
+	return true;
+}
+
+bool AudioCommandQueue::Pop(Command& command)
+{
+	Slot& slot = mSlots[mPopPos % kCapacity];
+	if (slot.sequence != mPopPos + 1)
+		return false;
+
+	__sync_synchronize();
+	command = slot.command;
+	__sync_synchronize();
+	slot.sequence = mPopPos + kCapacity;
+	++mPopPos;
+	return true;
+}
+
+void AudioCommandQueue::Wake()
+{
+	mWakeSem.Post();
+}
+
+void AudioCommandQueue::Wait(int64_t timeoutUs)
+{
+	if (timeoutUs == kWaitForever)
+		mWakeSem.Wait();
+	else
+		mWakeSem.WaitUs(timeoutUs);
+}
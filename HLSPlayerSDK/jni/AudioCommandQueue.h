@@ -0,0 +1,61 @@
+#ifndef _AUDIOCOMMANDQUEUE_H_
+#define _AUDIOCOMMANDQUEUE_H_
+
+#include <stdint.h>
+
+#include "MonotonicWait.h"
+
+/*
+ * AudioCommandQueue
+ *
+ * State changes (stop, pause) queued up for an audio player's Update() to
+ * carry out on the audio thread, and the one thing that thread sleeps on.
+ *
+ * Push() may be called from any number of threads at once; Pop() and Wait()
+ * only from the audio thread. The queue is a fixed ring of kCapacity slots,
+ * each stamped with a sequence number so pushers claim slots with a single
+ * compare and swap and the popper knows when one is filled in; nobody takes
+ * a lock.
+ *
+ * Wait() sleeps until something is pushed, Wake() is called, or the
+ * timeout passes, whichever comes first. Players call Wake() for anything
+ * else the audio thread should look at straight away (play, a new source).
+ */
+class AudioCommandQueue
+{
+public:
+	struct Command
+	{
+		int state; // The state you want to go to
+		int data; // Associated data (if you need to encode some flags or other information)
+	};
+
+	enum { kWaitForever = -1 };
+
+	AudioCommandQueue();
+	~AudioCommandQueue();
+
+	// False if the queue is full.
+	bool Push(int state, int data);
+	bool Pop(Command& command);
+
+	void Wake();
+	void Wait(int64_t timeoutUs);
+
+private:
+	enum { kCapacity = 16 };
+
+	struct Slot
+	{
+		volatile uint32_t sequence;
+		Command command;
+	};
+
+	Slot mSlots[kCapacity];
+	volatile uint32_t mPushPos;
+	uint32_t mPopPos;
+
+	MonotonicSemaphore mWakeSem;
+};
+
+#endif /* _AUDIOCOMMANDQUEUE_H_ */
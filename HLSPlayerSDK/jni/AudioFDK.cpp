@@ -12,6 +12,7 @@
 #include <unistd.h>
 #include <AudioFDK.h>
 #include <ESDS.h>
+#include <FrameScheduler.h>
 
 extern HLSPlayerSDK* gHLSPlayerSDK;
 
@@ -23,15 +24,37 @@ extern HLSPlayerSDK* gHLSPlayerSDK;
 #define ENCODING_PCM_8BIT 3
 #define ENCODING_PCM_16BIT 2
 #define MODE_STREAM 1
+#define WRITE_BLOCKING 0
+
+// How much decoded audio we collect before writing it to the track. Each
+// write is a JNI call and a wakeup of the track's mixer, so we don't want one
+// per AAC frame, but holding on to more than this just adds to our latency.
+static const int kTargetWriteLatencyMs = 50;
+
+// Largest frame the decoder can produce: 2048 samples (HE-AAC) for up to 8
+// channels. It doesn't bounds check its output, so this much room has to be
+// free at the write position before every decode.
+static const int kMaxFrameBytes = 2048 * 8 * sizeof(INT_PCM);
+
+// How often the audio thread asks the track where its head is. The clock
+// interpolates in between, so this only bounds how quickly it notices drift.
+// It's also the longest the audio thread sleeps while playing.
+static const int64_t kClockPollUs = 20000;
+
+// How much audio we keep queued in the track. Once there's more, the audio
+// thread sleeps until it has drained to this rather than decoding further
+// ahead. Allows for the kTargetWriteLatencyMs we hold on to before writing.
+static const int64_t kTargetBufferUs = 150000;
 
 
 using namespace android_video_shim;
 
 AudioFDK::AudioFDK(JavaVM* jvm) : mJvm(jvm), mAudioTrack(NULL), mGetMinBufferSize(NULL), mPlay(NULL), mPause(NULL), mStop(NULL), mFlush(NULL), buffer(NULL),
 		mRelease(NULL), mGetTimestamp(NULL), mCAudioTrack(NULL), mWrite(NULL), mGetPlaybackHeadPosition(NULL), mSetPositionNotificationPeriod(NULL),
+		mWriteByteBuffer(NULL), mBufferClear(NULL), mPCMBuffer(NULL), mPCMBufferSize(0), mPCMOffset(0), mPCMWriteSize(0), mPCMByteBuffer(NULL),
 		mSampleRate(0), mNumChannels(0), mBufferSizeInBytes(0), mChannelMask(0), mTrack(NULL), mPlayState(INITIALIZED),
 		mTimeStampOffset(0), samplesWritten(0), mWaiting(true), mNeedsTimeStampOffset(true), mAACDecoder(NULL), mESDSType(TT_UNKNOWN), mESDSData(NULL), mESDSSize(0),
-		mPlayingSilence(false)
+		mPlayingSilence(false), mLastClockPollUs(0), mLastHeadFrames(0)
 {
 	if (!mJvm)
 	{
@@ -42,8 +65,10 @@ AudioFDK::AudioFDK(JavaVM* jvm) : mJvm(jvm), mAudioTrack(NULL), mGetMinBufferSiz
 	LOGI(" AudioTrack updateMutex err = %d", err);
 	err = initRecursivePthreadMutex(&lock);
 	LOGI(" AudioTrack lock mutex err = %d", err);
-	err = initRecursivePthreadMutex(&stateQueueLock);
-	LOGI(" AudioTrack stateQueueLock mutex err = %d", err);
+
+	// Plain (non recursive) mutex, we wait on it.
+	pthread_mutex_init(&stateLock, NULL);
+	pthread_cond_init(&stateCond, NULL);
 }
 
 AudioFDK::~AudioFDK()
@@ -77,16 +102,21 @@ void AudioFDK::Close()
 			env->CallNonvirtualVoidMethod(mTrack, mCAudioTrack, mStop);
 			env->CallNonvirtualVoidMethod(mTrack, mCAudioTrack, mRelease);
 			env->DeleteGlobalRef(buffer);
+			env->DeleteGlobalRef(mPCMByteBuffer);
 			env->DeleteGlobalRef(mTrack);
 			env->DeleteGlobalRef(mCAudioTrack);
 		}
 		buffer = NULL;
+		mPCMByteBuffer = NULL;
 		mTrack = NULL;
 		mCAudioTrack = NULL;
 
-		if (mAACDecoder) aacDecoder_Close(mAACDecoder);
+		free(mPCMBuffer);
+		mPCMBuffer = NULL;
+		mPCMBufferSize = 0;
+		mPCMOffset = 0;
 
-		sem_destroy(&semPause);
+		if (mAACDecoder) aacDecoder_Close(mAACDecoder);
 	}
 }
 
@@ -101,14 +131,6 @@ bool AudioFDK::Init()
 	JNIEnv* env = NULL;
 	if (!gHLSPlayerSDK->GetEnv(&env)) return false;
 
-
-	int err = sem_init(&semPause, 0, 0);
-	if (err != 0)
-	{
-		LOGE("Failed to init audio pause semaphore : %d", err);
-		return false;
-	}
-
 	if (!mCAudioTrack)
 	{
 		/* Cache AudioTrack class and it's method id's
@@ -136,6 +158,29 @@ bool AudioFDK::Init()
 		mWrite = env->GetMethodID(mCAudioTrack, "write", "([BII)I");
 		mSetPositionNotificationPeriod = env->GetMethodID(mCAudioTrack, "setPositionNotificationPeriod", "(I)I");
 		mGetPlaybackHeadPosition = env->GetMethodID(mCAudioTrack, "getPlaybackHeadPosition", "()I");
+
+		// Writing from a direct ByteBuffer saves copying every frame into a
+		// java array, but it only exists from API 21.
+		mWriteByteBuffer = env->GetMethodID(mCAudioTrack, "write", "(Ljava/nio/ByteBuffer;II)I");
+		if (env->ExceptionCheck())
+		{
+			env->ExceptionClear();
+			mWriteByteBuffer = NULL;
+		}
+
+		jclass cBuffer = env->FindClass("java/nio/Buffer");
+		if (cBuffer)
+		{
+			mBufferClear = env->GetMethodID(cBuffer, "clear", "()Ljava/nio/Buffer;");
+			env->DeleteLocalRef(cBuffer);
+		}
+		if (env->ExceptionCheck() || !mBufferClear)
+		{
+			env->ExceptionClear();
+			mWriteByteBuffer = NULL;
+		}
+
+		LOGI("Writing audio from a %s", mWriteByteBuffer ? "direct ByteBuffer" : "byte array");
 	}
 	return true;
 }
@@ -159,6 +204,7 @@ bool AudioFDK::Set(sp<MediaSource> audioSource, bool alreadyStarted)
 	if (!alreadyStarted && mAudioSource.get()) mAudioSource->start(NULL);
 
 	mWaiting = false;
+	mCommands.Wake();
 	return UpdateFormatInfo();
 }
 
@@ -171,6 +217,7 @@ bool AudioFDK::Set23(sp<MediaSource23> audioSource, bool alreadyStarted)
 	mAudioSource23 = audioSource;
 	if (!alreadyStarted && mAudioSource23.get()) mAudioSource23->start(NULL);
 	mWaiting = false;
+	mCommands.Wake();
 	return UpdateFormatInfo();
 }
 
@@ -302,12 +349,10 @@ bool AudioFDK::Start()
 	SetState(PLAYING, __func__);
 
 	if (lastPlayState == PAUSED || lastPlayState == SEEKING || lastPlayState == INITIALIZED)
-	{
-		LOGI("Playing Audio Thread: state = %s | semPause.count = %d", lastPlayState==PAUSED?"PAUSED":(lastPlayState==SEEKING?"SEEKING":(lastPlayState==INITIALIZED?"INITIALIZED":"Not Possible!")), semPause.count );
-		sem_post(&semPause);
-	}
+		LOGI("Playing Audio Thread: state = %s", getStateString(lastPlayState));
 	mWaiting = false;
 	samplesWritten = 0;
+	mCommands.Wake();
 	return true;
 }
 
@@ -320,13 +365,6 @@ bool AudioFDK::InitJavaTrack()
 
 	AutoLock locker(&lock, __func__);
 
-	LOGI("Setting buffer = NULL");
-	if (buffer)
-	{
-		env->DeleteGlobalRef(buffer);
-		buffer = NULL;
-	}
-
 	if(mSampleRate == 0)
 	{
 		LOGE("Zero sample rate");
@@ -371,20 +409,118 @@ bool AudioFDK::InitJavaTrack()
 
 	LOGI("Generating java AudioTrack reference");
 	mTrack = env->NewGlobalRef(env->NewObject(mCAudioTrack, mAudioTrack, STREAM_MUSIC, mSampleRate, channelConfig, ENCODING_PCM_16BIT, mBufferSizeInBytes * 2, MODE_STREAM ));
+	samplesWritten = 0;
+	mLastHeadFrames = 0;
+	mClock.Reset();
 
 	LOGI("Calling java AudioTrack Play");
 	env->CallNonvirtualVoidMethod(mTrack, mCAudioTrack, mPlay);
 
-	if(!buffer)
+	// Write in batches of kTargetWriteLatencyMs, but never more than the
+	// silence writes, which the PCM buffer is sized for.
+	mPCMWriteSize = mSampleRate * mNumChannels * sizeof(INT_PCM) * kTargetWriteLatencyMs / 1000;
+	if (mPCMWriteSize > mBufferSizeInBytes)
+		mPCMWriteSize = mBufferSizeInBytes;
+
+	if (!AllocatePCMBuffer(env, mBufferSizeInBytes + kMaxFrameBytes))
+		return false;
+
+	return mTrack != NULL;
+}
+
+/*
+ * AllocatePCMBuffer
+ *
+ * Make sure the PCM buffer (and the java object the track reads it through)
+ * holds at least size bytes. Only ever grows, and keeps anything already in it,
+ * so it's safe to call with decoded audio pending.
+ */
+bool AudioFDK::AllocatePCMBuffer(JNIEnv* env, int size)
+{
+	if (mPCMBuffer && size <= mPCMBufferSize)
+		return true;
+
+	char* pcm = (char*)realloc(mPCMBuffer, size);
+	if (!pcm)
 	{
-		buffer = env->NewByteArray(mBufferSizeInBytes);
-		buffer = (jarray)env->NewGlobalRef(buffer);
+		LOGE("Failed to allocate %d byte PCM buffer", size);
+		return false;
 	}
+	mPCMBuffer = pcm;
+	mPCMBufferSize = size;
 
+	if (mPCMByteBuffer)
+	{
+		env->DeleteGlobalRef(mPCMByteBuffer);
+		mPCMByteBuffer = NULL;
+	}
+	if (buffer)
+	{
+		env->DeleteGlobalRef(buffer);
+		buffer = NULL;
+	}
 
-	return mTrack != NULL;
+	if (mWriteByteBuffer)
+	{
+		jobject byteBuffer = env->NewDirectByteBuffer(mPCMBuffer, mPCMBufferSize);
+		if (byteBuffer)
+		{
+			mPCMByteBuffer = env->NewGlobalRef(byteBuffer);
+			env->DeleteLocalRef(byteBuffer);
+		}
+		else
+		{
+			LOGE("NewDirectByteBuffer failed, falling back to a byte array");
+			env->ExceptionClear();
+		}
+	}
+
+	if (!mPCMByteBuffer)
+	{
+		jarray array = env->NewByteArray(mPCMBufferSize);
+		if (!array)
+		{
+			LOGE("Failed to allocate %d byte java audio buffer", mPCMBufferSize);
+			return false;
+		}
+		buffer = (jarray)env->NewGlobalRef(array);
+		env->DeleteLocalRef(array);
+	}
+
+	LOGI("PCM buffer is %d bytes, writing every %d bytes", mPCMBufferSize, mPCMWriteSize);
+	return true;
 }
 
+/*
+ * WritePCM
+ *
+ * Hand everything pending in the PCM buffer to the track. Blocks while the
+ * track is full.
+ */
+void AudioFDK::WritePCM(JNIEnv* env)
+{
+	if (mPCMOffset > 0 && mTrack)
+	{
+		int written = 0;
+		if (mPCMByteBuffer)
+		{
+			// The track reads from, and advances, the buffer's position.
+			jobject b = env->CallObjectMethod(mPCMByteBuffer, mBufferClear);
+			if (b) env->DeleteLocalRef(b);
+			written = env->CallNonvirtualIntMethod(mTrack, mCAudioTrack, mWriteByteBuffer, mPCMByteBuffer, mPCMOffset, WRITE_BLOCKING);
+		}
+		else
+		{
+			env->SetByteArrayRegion((jbyteArray)buffer, 0, mPCMOffset, (const jbyte*)mPCMBuffer);
+			written = env->CallNonvirtualIntMethod(mTrack, mCAudioTrack, mWrite, buffer, 0, mPCMOffset);
+		}
+
+		LOGAUDIO("Wrote %d of %d bytes to the java audio track", written, mPCMOffset);
+		if (written > 0)
+			samplesWritten += written;
+	}
+	mPCMOffset = 0;
+}
 
 void AudioFDK::Play()
 {
@@ -397,12 +533,7 @@ void AudioFDK::Play()
 	SetState(PLAYING, __func__);
 
 	if (lastPlayState == PAUSED || lastPlayState == SEEKING || lastPlayState == INITIALIZED)
-	{
-		LOGI("Playing Audio Thread: state = %s | semPause.count = %d", lastPlayState==PAUSED?"PAUSED":(lastPlayState==SEEKING?"SEEKING":(lastPlayState==INITIALIZED?"INITIALIZED":"Not Possible!")), semPause.count );
-		sem_post(&semPause);
-	}
-
-	LOGI("Audio State = PLAYING: semPause.count = %d", semPause.count);
+		LOGI("Playing Audio Thread: state = %s", getStateString(lastPlayState));
 
 	AutoLock locker(&lock, __func__);
 	if (mTrack)
@@ -412,7 +543,7 @@ void AudioFDK::Play()
 			env->CallNonvirtualVoidMethod(mTrack, mCAudioTrack, mPlay);
 	}
 
-	samplesWritten = 0;
+	mCommands.Wake();
 }
 
 /*
@@ -433,38 +564,20 @@ bool AudioFDK::Stop(bool seeking)
 		return true;
 	}
 
-	int lastPlayState = mPlayState;
-
-	// push the target state on to the queue
-	pushTargetState(STOPPED, seeking ? 1 : 0 );
-
-	// Release the thread to continue if we're puased or seeking
-	if (lastPlayState == PAUSED)
-	{
-		LOGI("Stopping Audio Thread: state = PAUSED | semPause.count = %d", semPause.count );
-		sem_post(&semPause);
-	}
-	else if (lastPlayState == SEEKING)
-	{
-		LOGI("Stopping Audio Thread: state = SEEKING | semPause.count = %d", semPause.count );
-		sem_post(&semPause);
-	}
+	// push the target state on to the queue, which also wakes the audio thread if it's paused or seeking
+	LOGI("Pushing target state %s", getStateString(STOPPED));
+	mCommands.Push(STOPPED, seeking ? 1 : 0 );
 
 	// Now, we'll wait until the state is stopped (or is seeking, if we are seeking)
 	// TODO: UPDATE THIS AS NECESSARY IF YOU ADD NEW STATES... If additional states are added to the queue, we might actually
 	// miss when this gets changed. For our purposes here, with stop being the only possible action
 	// at the moment, it will suffice, I think.
 
-	bool logOnce = false;
+	AutoLock stateLocker(&stateLock, __func__);
+	if (mPlayState != SEEKING && mPlayState != STOPPED)
+		LOGI("Waiting for state - curState=%s", getStateString(mPlayState));
 	while ( mPlayState != SEEKING && mPlayState != STOPPED)
-	{
-		if (!logOnce)
-		{
-			LOGI("Waiting for state - curState=%s", getStateString(mPlayState));
-			logOnce=true;
-		}
-		sched_yield();
-	}
+		pthread_cond_wait(&stateCond, &stateLock);
 
 	LOGI("Done Waiting. curState=%s", getStateString(mPlayState));
 
@@ -477,7 +590,8 @@ void AudioFDK::Pause()
 	LOGTRACE("%s", __func__);
 	if (mPlayState == PAUSED) return;
 
-	pushTargetState(PAUSED, 0);
+	LOGI("Pushing target state %s", getStateString(PAUSED));
+	mCommands.Push(PAUSED, 0);
 
 }
 
@@ -492,6 +606,9 @@ void AudioFDK::Flush()
 
 	AutoLock updateLocker(&updateMutex, __func__);
 	samplesWritten = 0;
+	mPCMOffset = 0;
+	mLastHeadFrames = 0;
+	mClock.Reset();
 
 }
 
@@ -506,27 +623,61 @@ void AudioFDK::SetTimeStampOffset(double offsetSecs)
 	LOGTRACE("%s", __func__);
 	LOGTIMING("Setting mTimeStampOffset to: %f", offsetSecs);
 	mTimeStampOffset = offsetSecs;
+	mClock.SetOffsetUs((int64_t)(offsetSecs * 1000000));
 	mNeedsTimeStampOffset = false;
 }
 
-int64_t AudioFDK::GetTimeStamp()
+/*
+ * PollClock
+ *
+ * Feed the track's head position to mClock, unless it was done less than
+ * kClockPollUs ago and force isn't set.
+ */
+void AudioFDK::PollClock(bool force)
 {
-	LOGTRACE("%s", __func__);
+	int64_t nowUs = FrameScheduler::NowUs();
+	if (!force && nowUs - mLastClockPollUs < kClockPollUs)
+		return;
+	mLastClockPollUs = nowUs;
+
 	JNIEnv* env;
-	if (!gHLSPlayerSDK->GetEnv(&env)) return 0;
+	if (!gHLSPlayerSDK->GetEnv(&env)) return;
 
 	AutoLock locker(&lock, __func__);
+	if (!mTrack || mSampleRate <= 0)
+		return;
 
-	if(!mTrack || !mCAudioTrack)
-	{
-		LOGI("No track! aborting...");
-		return mTimeStampOffset * NANOSEC_PER_MS;
-	}
+	uint32_t frames = env->CallNonvirtualIntMethod(mTrack, mCAudioTrack, mGetPlaybackHeadPosition);
+	mLastHeadFrames = frames;
+	mClock.Update((int64_t)frames * 1000000 / mSampleRate, mPlayState == PLAYING);
+}
+
+/*
+ * GetPendingUs
+ *
+ * How much of what we've written the track has yet to play, going by the
+ * head position PollClock() last saw.
+ */
+int64_t AudioFDK::GetPendingUs()
+{
+	int frameBytes = mNumChannels * sizeof(INT_PCM);
+	if (frameBytes <= 0 || mSampleRate <= 0)
+		return 0;
+
+	int64_t pendingFrames = samplesWritten / frameBytes - mLastHeadFrames;
+	if (pendingFrames < 0)
+		return 0;
+	return pendingFrames * 1000000 / mSampleRate;
+}
+
+int64_t AudioFDK::GetTimeStamp()
+{
+	LOGTRACE("%s", __func__);
 
-	double frames = env->CallNonvirtualIntMethod(mTrack, mCAudioTrack, mGetPlaybackHeadPosition);
-	double secs = frames / (double)mSampleRate;
-	LOGTIMING("TIMESTAMP: secs = %f | mTimeStampOffset = %f | timeStampUS = %lld", secs, mTimeStampOffset, (int64_t)((secs + mTimeStampOffset) * 1000000));
-	return ((secs + mTimeStampOffset) * NANOSEC_PER_MS);
+	// No lock and no JNI; the audio thread keeps mClock up to date.
+	int64_t timeStampUs = mClock.GetTimeUs();
+	LOGTIMING("TIMESTAMP: timeStampUS = %lld", timeStampUs);
+	return timeStampUs;
 }
 
 bool AudioFDK::ReadUntilTime(double timeSecs)
@@ -587,6 +738,7 @@ bool AudioFDK::ReadUntilTime(double timeSecs)
 	}
 
 	mTimeStampOffset = ((double)timeUs / 1000000.0f);
+	mClock.SetOffsetUs(timeUs);
 	return true;
 }
 
@@ -596,12 +748,13 @@ int AudioFDK::Update()
 	LOGTHREAD("Audio Update Thread Running - waiting = %s", mWaiting ? "true" : "false");
 
 	// Check to see if there is a target state on the queue.
-	if (targetStateCount() > 0)
+	// If there is at least one target state, handle that one state, and then return if it makes sense to do so,
+	// or allow it to run through the rest of the update, if that makes sense for the state.
+	// Additional items on the queue will be handled the next time through.
+	AudioCommandQueue::Command ts;
+	if (mCommands.Pop(ts))
 	{
-		// If there is at least one target state, handle that one state, and then return if it makes sense to do so,
-		// or allow it to run through the rest of the update, if that makes sense for the state.
-		// Additional items on the queue will be handled the next time through.
-		TargetState ts = popTargetState();
+		LOGI("Popped target state %s", getStateString(ts.state));
 		switch (ts.state)
 		{
 		case STOPPED:
@@ -618,35 +771,32 @@ int AudioFDK::Update()
 				if (gHLSPlayerSDK->GetEnv(&env))
 					env->CallNonvirtualVoidMethod(mTrack, mCAudioTrack, mPause);
 				SetState(PAUSED, __func__);
+				PollClock(true);
 			}
 			break;
 		}
 	}
 
-	if (mWaiting) return AUDIOTHREAD_WAIT;
+	// Keep the clock fed, including while we wait on the source and the
+	// track plays out what it has.
+	if (mPlayState == PLAYING)
+		PollClock();
+
+	if (mWaiting)
+	{
+		// Nothing to decode until we're given a source or started again, but
+		// wake up now and then to keep the clock going while the track plays
+		// out what it has.
+		mCommands.Wait(kClockPollUs);
+		return AUDIOTHREAD_WAIT;
+	}
 	if (mPlayState != PLAYING)
 	{
-		while (mPlayState == INITIALIZED)
-		{
-			LOGI("Audio Thread initialized. Waiting to start | semPause.count = %d", semPause.count);
-			sem_wait(&semPause);
-			return AUDIOTHREAD_CONTINUE; // Make sure we check the state queue, before continuing
-		}
-
-		if (mPlayState == PAUSED)
+		if (mPlayState == INITIALIZED || mPlayState == PAUSED || mPlayState == SEEKING)
 		{
-			LOGI("Pausing Audio Thread: state = PAUSED | semPause.count = %d", semPause.count );
-
-
-			sem_wait(&semPause);
-			return AUDIOTHREAD_CONTINUE; // Make sure we check the state queue, before continuing
-		}
-
-		if (mPlayState == SEEKING)
-		{
-			LOGI("Pausing Audio Thread: state = SEEKING | semPause.count = %d", semPause.count );
-			sem_wait(&semPause);
-			LOGI("Resuming Audio Thread: state = %d | semPause.count = %d", mPlayState, semPause.count );
+			LOGI("Pausing Audio Thread: state = %s", getStateString(mPlayState));
+			mCommands.Wait(AudioCommandQueue::kWaitForever);
+			LOGI("Resuming Audio Thread: state = %s", getStateString(mPlayState));
 			return AUDIOTHREAD_CONTINUE; // Make sure we check the state queue, before continuing
 		}
 
@@ -659,8 +809,14 @@ int AudioFDK::Update()
 		}
 	}
 
-
-
+	// Let the track drain to kTargetBufferUs before decoding any more.
+	int64_t pendingUs = GetPendingUs();
+	if (pendingUs > kTargetBufferUs)
+	{
+		int64_t waitUs = pendingUs - kTargetBufferUs;
+		mCommands.Wait(waitUs < kClockPollUs ? waitUs : kClockPollUs);
+		return AUDIOTHREAD_CONTINUE;
+	}
 
 	JNIEnv* env;
 	if (!gHLSPlayerSDK->GetEnv(&env))
@@ -683,7 +839,7 @@ int AudioFDK::Update()
 		res = OK;
 	}
 
-	if (res == OK && mTrack)
+	if (res == OK && mTrack && mPCMBuffer)
 	{
 		//LOGI("Finished reading from the media buffer");
 		RUNDEBUG( {if (mediaBuffer) mediaBuffer->meta_data()->dumpToLog();} );
@@ -736,98 +892,64 @@ int AudioFDK::Update()
 				LOGV("Valid = %d", valid);
 				dataOffset = bufSize - valid;
 
-#define BUFFER_SIZE (8192 * 2)
-
-				INT_PCM* tmpBuffer = (INT_PCM*)malloc(BUFFER_SIZE);
-
-
-				LOGAUDIO("MediaBufferSize = %d, mBufferSizeInBytes = %d", mbufSize, mBufferSizeInBytes );
-				if (mbufSize <= mBufferSizeInBytes)
+				LOGAUDIO("MediaBufferSize = %d, pending = %d, mPCMWriteSize = %d", mbufSize, mPCMOffset, mPCMWriteSize);
+				err = AAC_DEC_OK;
+				while (err == AAC_DEC_OK)
 				{
-					err = AAC_DEC_OK;
+					if (mPCMBufferSize - mPCMOffset < kMaxFrameBytes)
+						WritePCM(env);
 
-					void* pBuffer = env->GetPrimitiveArrayCritical(buffer, NULL);
-					int offset = 0;
-					while (err == AAC_DEC_OK)
+					// Decode straight into the PCM buffer, behind whatever is already pending.
+					INT_PCM* frameBuffer = (INT_PCM*)(mPCMBuffer + mPCMOffset);
+					err = aacDecoder_DecodeFrame(mAACDecoder, frameBuffer, (mPCMBufferSize - mPCMOffset) / sizeof(INT_PCM), 0 );
+					if (err != AAC_DEC_OK)
 					{
-						LOGAUDIO("tmpBuffer size = %d", BUFFER_SIZE);
-
-						memset(tmpBuffer, 0xCD, BUFFER_SIZE);
-
-						err = aacDecoder_DecodeFrame(mAACDecoder, (INT_PCM*)tmpBuffer, BUFFER_SIZE, 0 );
-						if (err != AAC_DEC_OK)
-						{
-							if (err == AAC_DEC_NOT_ENOUGH_BITS)
-								LOGAUDIO("aacDecoder_DecodeFrame() NOT ENOUGH BITS");
-							else
-								LOGE("aacDecoder_DecodeFrame() failed: %x", err);
-						}
+						if (err == AAC_DEC_NOT_ENOUGH_BITS)
+							LOGAUDIO("aacDecoder_DecodeFrame() NOT ENOUGH BITS");
 						else
+							LOGE("aacDecoder_DecodeFrame() failed: %x", err);
+					}
+					else
+					{
+						LOGAUDIO("Decoded Frame");
+						CStreamInfo* streamInfo = aacDecoder_GetStreamInfo(mAACDecoder);
+						int frameSize = streamInfo->frameSize;
+						int channels = streamInfo->numChannels;
+						int frameBytes = frameSize * sizeof(INT_PCM) * channels;
+						LOGAUDIO("offset = %d, frameSize = %d, channels=%d, sampleRate=%d", mPCMOffset, frameSize, channels, streamInfo->sampleRate);
+
+						bool reinitJava = false;
+						if (streamInfo->sampleRate != mSampleRate)
 						{
-							LOGAUDIO("Decoded Frame");
-							int frameSize = 0;
-							CStreamInfo* streamInfo = aacDecoder_GetStreamInfo(mAACDecoder);
-							bool reinitJava = false;
-							if (streamInfo->sampleRate != mSampleRate)
-							{
-								if (streamInfo->sampleRate > mSampleRate)
-								{
-									LOGAUDIO("Sample Rate changed from %d to %d", mSampleRate, streamInfo->sampleRate);
-									mSampleRate = streamInfo->sampleRate;
-									reinitJava = true;
-								}
-							}
-							if (streamInfo->numChannels != mNumChannels)
+							if (streamInfo->sampleRate > mSampleRate)
 							{
-								LOGAUDIO("Num Channels changed from %d to %d", mNumChannels, streamInfo->numChannels);
-								mNumChannels = streamInfo->numChannels;
+								LOGAUDIO("Sample Rate changed from %d to %d", mSampleRate, streamInfo->sampleRate);
+								mSampleRate = streamInfo->sampleRate;
 								reinitJava = true;
 							}
+						}
+						if (streamInfo->numChannels != mNumChannels)
+						{
+							LOGAUDIO("Num Channels changed from %d to %d", mNumChannels, streamInfo->numChannels);
+							mNumChannels = streamInfo->numChannels;
+							reinitJava = true;
+						}
 
-							if (reinitJava)
-							{
-								env->ReleasePrimitiveArrayCritical(buffer, pBuffer, 0);
-								InitJavaTrack();
-								pBuffer = env->GetPrimitiveArrayCritical(buffer, NULL);
-								mNeedsTimeStampOffset = true;
-							}
-
-							frameSize = streamInfo->frameSize;
-							int channels = streamInfo->numChannels;
-							LOGAUDIO("offset = %d, frameSize = %d, tmpBufferSize=%d, channels=%d, sampleRate=%d", offset, frameSize, BUFFER_SIZE, channels, streamInfo->sampleRate);
-
-							//LogBytes("Begin Frame", "End Frame", (char*)tmpBuffer, sizeof(tmpBuffer));
-
-							int copySize = frameSize * sizeof(INT_PCM) * channels;
-
-							if (offset + copySize > mBufferSizeInBytes)
-							{
-								// We need to empty our buffer and make a new one!!!
-								env->ReleasePrimitiveArrayCritical(buffer, pBuffer, 0);
-								LOGAUDIO("offset (%d) + sizeof(tmpBuffer) (%d) > mBufferSizeinBytes (%d) -- Writing to java audio track and getting new java buffer.", offset, BUFFER_SIZE, mBufferSizeInBytes);
-								samplesWritten += env->CallNonvirtualIntMethod(mTrack, mCAudioTrack, mWrite, buffer, 0, offset  );
-
-
-								pBuffer = env->GetPrimitiveArrayCritical(buffer, NULL);
-								offset = 0;
-							}
-							LOGAUDIO("Copying %d bytes to buffer at offset %d", copySize, offset);
-							memcpy(((char*)pBuffer) + offset, tmpBuffer, copySize);
-							offset += copySize;
+						if (reinitJava)
+						{
+							// What's pending is in the old format, so it goes to the old
+							// track. This frame moves to the front for the new one.
+							WritePCM(env);
+							memmove(mPCMBuffer, frameBuffer, frameBytes);
+							InitJavaTrack();
+							mNeedsTimeStampOffset = true;
 						}
 
+						mPCMOffset += frameBytes;
+						if (mPCMOffset >= mPCMWriteSize)
+							WritePCM(env);
 					}
-
-					env->ReleasePrimitiveArrayCritical(buffer, pBuffer, 0);
-					LOGAUDIO("offset (%d) + sizeof(tmpBuffer) (%d) > mBufferSizeinBytes (%d) -- Writing to java audio track and getting new java buffer.", offset, BUFFER_SIZE, mBufferSizeInBytes);
-					samplesWritten += env->CallNonvirtualIntMethod(mTrack, mCAudioTrack, mWrite, buffer, 0, offset  );
-				}
-				else
-				{
-					LOGV("MediaBufferSize > mBufferSizeInBytes");
 				}
-
-				free(tmpBuffer);
 			}
 		}
 		else
@@ -839,15 +961,11 @@ int AudioFDK::Update()
 				if (videoTimeUs >= 0)
 					SetTimeStampOffset(((double) videoTimeUs / (double)NANOSEC_PER_MS));
 			}
-			void* pBuffer = env->GetPrimitiveArrayCritical(buffer, NULL);
-			if (pBuffer)
-			{
-				memset(pBuffer, 0, mBufferSizeInBytes);
-				int len = mBufferSizeInBytes / 2;
-				env->ReleasePrimitiveArrayCritical(buffer, pBuffer, 0);
-				LOGAUDIO("Writing zeros to the audio buffer - mTrack = %p", mTrack);
-				samplesWritten += env->CallNonvirtualIntMethod(mTrack, mCAudioTrack, mWrite, buffer, 0, mBufferSizeInBytes  );
-			}
+			WritePCM(env);
+			memset(mPCMBuffer, 0, mBufferSizeInBytes);
+			mPCMOffset = mBufferSizeInBytes;
+			LOGAUDIO("Writing zeros to the audio buffer - mTrack = %p", mTrack);
+			WritePCM(env);
 		}
 
 		env->PopLocalFrame(NULL);
@@ -857,6 +975,9 @@ int AudioFDK::Update()
 	{
 		LOGI("Format Changed");
 
+		// Play out what we decoded in the old format.
+		WritePCM(env);
+
 		// Flush our existing track.
 		Flush();
 
@@ -868,6 +989,7 @@ int AudioFDK::Update()
 	else if (res == ERROR_END_OF_STREAM)
 	{
 		LOGE("End of Audio Stream");
+		WritePCM(env);
 		mWaiting = true;
 		if (gHLSPlayerSDK)
 		{
@@ -889,46 +1011,9 @@ int AudioFDK::Update()
 int AudioFDK::getBufferSize()
 {
 	LOGTRACE("%s", __func__);
-	JNIEnv* env;
-	if (!gHLSPlayerSDK->GetEnv(&env)) return 0;
-
-	AutoLock locker(&lock, __func__);
-
-	if(!mTrack)
-	{
-		LOGE("No track! aborting...");
+	if (mSampleRate <= 0)
 		return 0;
-	}
-
-	long long frames = env->CallNonvirtualIntMethod(mTrack, mCAudioTrack, mGetPlaybackHeadPosition);
-
-	return (samplesWritten / 2) - frames;
-}
-
-void AudioFDK::pushTargetState(int state, int data)
-{
-	AutoLock(&stateQueueLock, __func__);
-	LOGI("Pushing target state %s", getStateString(state));
-	mTargetStates.push_back(TargetState { state, data } );
-}
-
-int AudioFDK::targetStateCount()
-{
-	AutoLock(&stateQueueLock, __func__);
-	return mTargetStates.size();
-}
-
-AudioFDK::TargetState AudioFDK::popTargetState()
-{
-	AutoLock(&stateQueueLock, __func__);
-	TargetState rval = { -1 , 0 };
-	if (mTargetStates.size() > 0)
-	{
-		rval = mTargetStates.front();
-		mTargetStates.pop_front();
-	}
-	LOGI("Popped target state %s", getStateString(rval.state));
-	return rval;
+	return GetPendingUs() * mSampleRate / 1000000;
 }
 
 /*
@@ -953,6 +1038,7 @@ bool AudioFDK::doStop(int data)
 	AutoLock locker(&lock, __func__);
 	AutoLock updateLocker(&updateMutex, __func__);
 
+	mPCMOffset = 0;
 	if (mTrack != NULL)
 	{
 
@@ -965,6 +1051,7 @@ bool AudioFDK::doStop(int data)
 			env->CallNonvirtualVoidMethod(mTrack, mCAudioTrack, mRelease);
 			env->DeleteGlobalRef(mTrack);
 			mTrack = NULL;
+			mClock.Reset();
 		}
 
 	}
@@ -973,6 +1060,7 @@ bool AudioFDK::doStop(int data)
 		SetState(SEEKING, __func__);
 	else
 		SetState(STOPPED, __func__);
+	PollClock(true);
 
 	return true;
 }
@@ -981,7 +1069,9 @@ bool AudioFDK::doStop(int data)
 void AudioFDK::SetState(int state, const char* func)
 {
 	LOGI("Changing AudioFDK state from %s to %s in %s", getStateString(mPlayState), getStateString(state), func);
+	AutoLock locker(&stateLock, __func__);
 	mPlayState = state;
+	pthread_cond_broadcast(&stateCond);
 }
 
 int AudioFDK::GetState()
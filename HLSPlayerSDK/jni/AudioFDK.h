@@ -13,8 +13,9 @@
 #include <semaphore.h>
 #include <RefCounted.h>
 #include <AudioPlayer.h>
+#include <AudioClock.h>
+#include <AudioCommandQueue.h>
 #include <aacdecoder_lib.h>
-#include <list>
 
 class AudioFDK: public AudioPlayer {
 public:
@@ -56,31 +57,27 @@ private:
 
 
 	/*
-	 * TargetState, and it's associated methods (pushTargetSTate, targetStateCount, and popTargetState),
-	 * are used to queue up actions that will be handled in the Update method when the audio thread
-	 * makes the next call to it. This is used to synchronize these actions so that they don't interrupt
-	 * the decoding of frames and the interaction with the java audio track.
-	 *
+	 * mCommands queues up actions (stop, pause) that will be handled in the Update method when the
+	 * audio thread makes the next call to it. This is used to synchronize these actions so that they
+	 * don't interrupt the decoding of frames and the interaction with the java audio track. It's also
+	 * what the audio thread sleeps on whenever it has nothing to do: paused, waiting for a source, or
+	 * with the track holding as much as we want it to.
 	 */
-	struct TargetState
-	{
-		int state; // The state you want to go to
-		int data; // Associated data (if you need to encode some flags or other information)
-	};
-	std::list<TargetState> mTargetStates;
-
-	void pushTargetState(int state, int data); // Push a target state onto the state queue
-	int targetStateCount(); // Get the number of states on the queue
-	TargetState popTargetState(); // Retrieve the first state on the queue
-
-
+	AudioCommandQueue mCommands;
 
 	bool doStop(int data);
 
+	int64_t GetPendingUs();
+
 	void SetTimeStampOffset(double offsetSecs);
 
+	void PollClock(bool force = false);
+
 	bool InitJavaTrack();
 
+	bool AllocatePCMBuffer(JNIEnv* env, int size);
+	void WritePCM(JNIEnv* env);
+
 	HANDLE_AACDECODER mAACDecoder;
 
 	uint32_t mESDSType;
@@ -96,12 +93,26 @@ private:
 	jmethodID mRelease;
 	jmethodID mGetTimestamp;
 	jmethodID mWrite;
+	jmethodID mWriteByteBuffer; // write(ByteBuffer, int, int), API 21+
+	jmethodID mBufferClear;
 	jmethodID mFlush;
 	jmethodID mSetPositionNotificationPeriod;
 	jmethodID mGetPlaybackHeadPosition;
 
 	jobject mTrack;
-	jarray buffer;
+	jarray buffer; // Only used when we can't write a direct ByteBuffer
+
+	/*
+	 * Decoded PCM waiting to go to the track. The decoder writes straight into
+	 * mPCMBuffer at mPCMOffset, and it's handed to the track once mPCMWriteSize
+	 * bytes have built up. mPCMByteBuffer is a direct ByteBuffer over the same
+	 * memory, so on API 21+ the track reads it without another copy.
+	 */
+	char* mPCMBuffer;
+	int mPCMBufferSize;
+	int mPCMOffset;
+	int mPCMWriteSize;
+	jobject mPCMByteBuffer;
 
 	JavaVM* mJvm;
 
@@ -120,12 +131,20 @@ private:
 	double mTimeStampOffset;
 	bool mNeedsTimeStampOffset;
 
+	// What GetTimeStamp() reads. Only the audio thread asks the track for
+	// its head position, at most every kClockPollUs, and feeds it in here.
+	AudioClock mClock;
+	int64_t mLastClockPollUs;
+	uint32_t mLastHeadFrames;
+
 	long long samplesWritten;
 
-	sem_t semPause;
 	pthread_mutex_t updateMutex;
 	pthread_mutex_t lock;
-	pthread_mutex_t stateQueueLock;
+
+	// Signalled on every state change, for Stop() to wait on.
+	pthread_mutex_t stateLock;
+	pthread_cond_t stateCond;
 
 };
 
@@ -8,15 +8,20 @@
 
 #include "AudioTrack.h"
 #include "AudioFDK.h"
+#include "AudioSLES.h"
 
 
-AudioPlayer* MakeAudioPlayer(JavaVM* jvm, bool useOMX )
+AudioPlayer* MakeAudioPlayer(JavaVM* jvm, bool useOMX, bool useOpenSL )
 {
 	if (!jvm) return NULL;
 	if (useOMX)
 	{
 		return new AudioTrack(jvm);
 	}
+	else if (useOpenSL && OpenSLOutput::IsSupported())
+	{
+		return new AudioSLES();
+	}
 	else
 	{
 		return new AudioFDK(jvm);
@@ -79,10 +79,11 @@ public:
 /*
  * MakeAudioPlayer
  *
- * Creates an AudioTrack if useOMX is set to true, otherwise, creates an AudioFDK
+ * Creates an AudioTrack if useOMX is set to true. Otherwise creates an AudioSLES if
+ * useOpenSL is set and OpenSL ES is available, and an AudioFDK if not.
  * AudioTrack is retained for testing/verification purposes.
  *
  */
-AudioPlayer* MakeAudioPlayer(JavaVM* jvm, bool useOMX = false);
+AudioPlayer* MakeAudioPlayer(JavaVM* jvm, bool useOMX = false, bool useOpenSL = false);
 
 #endif /* AUDIOPLAYER_H_ */
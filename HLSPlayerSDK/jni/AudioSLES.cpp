@@ -0,0 +1,749 @@
+/*
+ * AudioSLES.cpp
+ *
+ * AAC decoding with FDK, played through OpenSL ES instead of a java AudioTrack.
+ */
+
+#include <jni.h>
+#include "constants.h"
+#include "HLSPlayerSDK.h"
+#include "HLSPlayer.h"
+#include <unistd.h>
+#include <AudioSLES.h>
+#include <ESDS.h>
+
+extern HLSPlayerSDK* gHLSPlayerSDK;
+
+// Largest frame the decoder can produce once it's limited to stereo: 2048
+// samples (HE-AAC) for 2 channels. It doesn't bounds check its output, so
+// this much room has to be free at the write position before every decode.
+static const int kMaxFrameBytes = 2048 * 2 * sizeof(INT_PCM);
+
+// How much silence to write at a time when there's nothing to decode.
+static const int kSilenceMs = 20;
+
+// How much audio we keep queued in the output. Once there's more, the audio
+// thread sleeps until it has drained to this rather than blocking in
+// BeginWrite(), where it wouldn't see a stop or pause.
+static const int64_t kTargetBufferUs = 100000;
+
+// The longest the audio thread sleeps at a time while playing.
+static const int64_t kMaxSleepUs = 20000;
+
+
+using namespace android_video_shim;
+
+AudioSLES::AudioSLES() : mAACDecoder(NULL), mESDSType(TT_UNKNOWN), mESDSData(NULL), mESDSSize(0), mFrameBuffer(NULL),
+		mSampleRate(0), mNumChannels(0), mPlayState(INITIALIZED), mWaiting(true), mPlayingSilence(false),
+		mTimeStampOffset(0), mNeedsTimeStampOffset(true)
+{
+	int err = initRecursivePthreadMutex(&updateMutex);
+	LOGI(" AudioSLES updateMutex err = %d", err);
+	err = initRecursivePthreadMutex(&lock);
+	LOGI(" AudioSLES lock mutex err = %d", err);
+
+	// Plain (non recursive) mutex, we wait on it.
+	pthread_mutex_init(&stateLock, NULL);
+	pthread_cond_init(&stateCond, NULL);
+}
+
+AudioSLES::~AudioSLES()
+{
+	free(mFrameBuffer);
+}
+
+void AudioSLES::unload()
+{
+	LOGI("Unloading");
+	if (mOutput.IsOpen())
+	{
+		// we're not closed!!!
+		LOGI("Closing");
+		Close();
+	}
+	delete this;
+}
+
+void AudioSLES::Close()
+{
+	Stop();
+
+	AutoLock locker(&lock, __func__);
+	mOutput.Close();
+
+	if (mAACDecoder) aacDecoder_Close(mAACDecoder);
+	mAACDecoder = NULL;
+}
+
+bool AudioSLES::Init()
+{
+	if (!mFrameBuffer)
+	{
+		mFrameBuffer = (char*)malloc(kMaxFrameBytes);
+		if (!mFrameBuffer)
+		{
+			LOGE("Failed to allocate %d byte frame buffer", kMaxFrameBytes);
+			return false;
+		}
+	}
+
+	if (!OpenSLOutput::IsSupported())
+	{
+		LOGE("OpenSL ES is not available");
+		return false;
+	}
+
+	return true;
+}
+
+void AudioSLES::ClearAudioSource()
+{
+	Set(NULL, true);
+	Set23(NULL, true);
+}
+
+bool AudioSLES::Set(sp<MediaSource> audioSource, bool alreadyStarted)
+{
+	if (mAudioSource.get())
+	{
+		mAudioSource->stop();
+		mAudioSource.clear();
+	}
+
+	LOGI("Set with %p", audioSource.get());
+	mAudioSource = audioSource;
+	if (!alreadyStarted && mAudioSource.get()) mAudioSource->start(NULL);
+
+	mWaiting = false;
+	mCommands.Wake();
+	return UpdateFormatInfo();
+}
+
+bool AudioSLES::Set23(sp<MediaSource23> audioSource, bool alreadyStarted)
+{
+	if (mAudioSource23.get())
+		mAudioSource23->stop();
+
+	LOGI("Set23 with %p", audioSource.get());
+	mAudioSource23 = audioSource;
+	if (!alreadyStarted && mAudioSource23.get()) mAudioSource23->start(NULL);
+	mWaiting = false;
+	mCommands.Wake();
+	return UpdateFormatInfo();
+}
+
+bool AudioSLES::UpdateFormatInfo()
+{
+	LOGI("Updating Format Info");
+	sp<MetaData> format;
+
+	mPlayingSilence = false;
+	if(mAudioSource.get())
+		format = mAudioSource->getFormat();
+	else if(mAudioSource23.get())
+		format = mAudioSource23->getFormat();
+	else
+	{
+		LOGE("We do not have an audio source. Setting a base format for feeding silence.");
+		mSampleRate=44100;
+		mNumChannels = 2;
+		mPlayingSilence = true;
+		return true;
+	}
+
+	format->dumpToLog();
+
+	const char* mime;
+	bool success = format->findCString(kKeyMIMEType, &mime);
+	if (!success)
+	{
+		LOGE("Could not find mime type");
+		return false;
+	}
+	if (strcasecmp(mime, MEDIA_MIMETYPE_AUDIO_AAC))
+	{
+		LOGE("Mime Type was not audio/mp4a-latm. Was: %s", mime);
+		return false;
+	}
+
+	success = format->findInt32(kKeySampleRate, &mSampleRate);
+	if (!success)
+	{
+		LOGE("Could not find audio sample rate");
+		return false;
+	}
+
+	success = format->findInt32(kKeyChannelCount, &mNumChannels);
+	if (!success)
+	{
+		LOGE("Could not find channel count");
+		return false;
+	}
+
+	if (mNumChannels > 2)
+	{
+		LOGI("Downmixing %d channels to stereo", mNumChannels);
+		mNumChannels = 2;
+	}
+
+	if (!format->findData(kKeyESDS, &mESDSType, &mESDSData, &mESDSSize))
+	{
+		// Uh - what do we do now?
+		LOGE("Couldn't find ESDS data");
+	}
+
+	return true;
+}
+
+bool AudioSLES::Start()
+{
+	LOGTRACE("%s", __func__);
+	AutoLock locker(&lock, __func__);
+
+	LOGI("Updating Format Info");
+	// Refresh our format information.
+	if(!UpdateFormatInfo())
+	{
+		LOGE("Failed to update format info!");
+		return false;
+	}
+
+	ESDS esds((const char*)mESDSData, mESDSSize);
+	if (status_t ec = esds.InitCheck() != OK)
+	{
+		LOGE("ESDS is not okay: 0x%4.4x", ec);
+		mPlayingSilence = true;
+	}
+
+
+	if (!mPlayingSilence)
+	{
+		if (mAACDecoder) aacDecoder_Close(mAACDecoder);
+		mAACDecoder = aacDecoder_Open(TT_MP4_ADIF, 1); // This is what SoftAAC2 does in initDecoder()
+		if (mAACDecoder != NULL)
+		{
+			// The output can't take more than two channels.
+			AAC_DECODER_ERROR decoderErr = aacDecoder_SetParam(mAACDecoder, AAC_PCM_MAX_OUTPUT_CHANNELS, 2);
+			if (decoderErr != AAC_DEC_OK)
+				LOGE("Could not limit aac decoder to stereo: 0x%4.4x", decoderErr);
+
+			const void* codec_specific_data;
+			size_t codec_specific_data_size;
+			esds.getCodecSpecificInfo(&codec_specific_data, &codec_specific_data_size);
+
+
+			UCHAR* inBuffer[1] = { (UCHAR*)codec_specific_data };
+			UINT inBufferLength[1] = { codec_specific_data_size };
+			decoderErr = aacDecoder_ConfigRaw(mAACDecoder, inBuffer, inBufferLength);
+			if (decoderErr != AAC_DEC_OK)
+			{
+				LOGE("aac ESDS length = %d, ptr=%p", mESDSSize, mESDSData);
+				UCHAR* d = (UCHAR*)mESDSData;
+				LogBytes("Begin ESDSData", "End ESDSData", (char*)d, mESDSSize);
+
+				LOGE("aacDecoder_ConfigRaw decoderErr = 0x%4.4x", decoderErr );
+				return false;
+			}
+		}
+		else
+		{
+			LOGE("Could not open aac decoder");
+		}
+	}
+
+	if (!InitOutput())
+		return false;
+
+
+	int lastPlayState = mPlayState;
+
+	SetState(PLAYING, __func__);
+
+	if (lastPlayState == PAUSED || lastPlayState == SEEKING || lastPlayState == INITIALIZED)
+		LOGI("Playing Audio Thread: state = %s", getStateString(lastPlayState));
+	mWaiting = false;
+	mCommands.Wake();
+	return true;
+}
+
+/*
+ * InitOutput
+ *
+ * (Re)open the output in the current format and start it playing.
+ */
+bool AudioSLES::InitOutput()
+{
+	AutoLock locker(&lock, __func__);
+
+	if(mSampleRate == 0)
+	{
+		LOGE("Zero sample rate");
+		return false;
+	}
+
+	LOGI("Opening OpenSL ES output mNumChannels=%d | mSampleRate=%d", mNumChannels, mSampleRate);
+	if (!mOutput.Open(mSampleRate, mNumChannels, kMaxFrameBytes))
+		return false;
+
+	mOutput.Play();
+	return true;
+}
+
+/*
+ * WriteSilence
+ *
+ * Keep the output fed while there's nothing to decode.
+ */
+void AudioSLES::WriteSilence()
+{
+	int frameBytes = mOutput.GetChannels() * sizeof(INT_PCM);
+	int bytes = mOutput.GetSampleRate() * kSilenceMs / 1000 * frameBytes;
+	if (bytes > kMaxFrameBytes)
+		bytes = kMaxFrameBytes - kMaxFrameBytes % frameBytes;
+
+	char* out = mOutput.BeginWrite(bytes);
+	if (!out)
+		return;
+
+	memset(out, 0, bytes);
+	mOutput.EndWrite(bytes);
+	LOGAUDIO("Wrote %d bytes of silence", bytes);
+}
+
+void AudioSLES::Play()
+{
+	LOGTRACE("%s", __func__);
+	LOGI("Trying to play: state = %d", mPlayState);
+	mWaiting = false;
+	if (mPlayState == PLAYING) return;
+	int lastPlayState = mPlayState;
+
+	SetState(PLAYING, __func__);
+
+	if (lastPlayState == PAUSED || lastPlayState == SEEKING || lastPlayState == INITIALIZED)
+		LOGI("Playing Audio Thread: state = %s", getStateString(lastPlayState));
+
+	AutoLock locker(&lock, __func__);
+	mOutput.Play();
+	mCommands.Wake();
+}
+
+/*
+ * Stop
+ *
+ * Queue a stop request, and wait for the audio thread to carry it out.
+ *
+ * 	seeking : true if you are stopping because of a seek, false, otherwise
+ *
+ */
+bool AudioSLES::Stop(bool seeking)
+{
+	LOGTRACE("%s", __func__);
+	if (mPlayState == STOPPED) return true;
+
+	// push the target state on to the queue, which also wakes the audio thread if it's paused or seeking
+	LOGI("Pushing target state %s", getStateString(STOPPED));
+	mCommands.Push(STOPPED, seeking ? 1 : 0 );
+
+	AutoLock stateLocker(&stateLock, __func__);
+	if (mPlayState != SEEKING && mPlayState != STOPPED)
+		LOGI("Waiting for state - curState=%s", getStateString(mPlayState));
+	while ( mPlayState != SEEKING && mPlayState != STOPPED)
+		pthread_cond_wait(&stateCond, &stateLock);
+
+	LOGI("Done Waiting. curState=%s", getStateString(mPlayState));
+
+	return true;
+}
+
+void AudioSLES::Pause()
+{
+	LOGTRACE("%s", __func__);
+	if (mPlayState == PAUSED) return;
+
+	LOGI("Pushing target state %s", getStateString(PAUSED));
+	mCommands.Push(PAUSED, 0);
+}
+
+void AudioSLES::Flush()
+{
+	LOGTRACE("%s", __func__);
+	if (mPlayState == PLAYING) return;
+
+	AutoLock updateLocker(&updateMutex, __func__);
+	AutoLock locker(&lock, __func__);
+	mOutput.Flush();
+}
+
+void AudioSLES::forceTimeStampUpdate()
+{
+	LOGTRACE("%s", __func__);
+	mNeedsTimeStampOffset = true;
+}
+
+void AudioSLES::SetTimeStampOffset(double offsetSecs)
+{
+	LOGTRACE("%s", __func__);
+	LOGTIMING("Setting mTimeStampOffset to: %f", offsetSecs);
+	mTimeStampOffset = offsetSecs;
+	mNeedsTimeStampOffset = false;
+}
+
+int64_t AudioSLES::GetTimeStamp()
+{
+	LOGTRACE("%s", __func__);
+
+	// No lock and no JNI: the frame count is kept by the output's callback.
+	int sampleRate = mSampleRate;
+	if (!mOutput.IsOpen() || sampleRate <= 0)
+		return mTimeStampOffset * NANOSEC_PER_MS;
+
+	double secs = mOutput.GetFramesPlayed() / (double)sampleRate;
+	LOGTIMING("TIMESTAMP: secs = %f | mTimeStampOffset = %f | timeStampUS = %lld", secs, mTimeStampOffset, (int64_t)((secs + mTimeStampOffset) * 1000000));
+	return ((secs + mTimeStampOffset) * NANOSEC_PER_MS);
+}
+
+bool AudioSLES::ReadUntilTime(double timeSecs)
+{
+	LOGTRACE("%s", __func__);
+	status_t res = ERROR_END_OF_STREAM;
+	MediaBuffer* mediaBuffer = NULL;
+
+	int64_t targetTimeUs = (int64_t)(timeSecs * 1000000.0f);
+	int64_t timeUs = 0;
+
+	LOGI("Starting read to %f seconds: targetTimeUs = %lld", timeSecs, targetTimeUs);
+	while (timeUs < targetTimeUs)
+	{
+		if(mAudioSource.get())
+			res = mAudioSource->read(&mediaBuffer, NULL);
+		else if(mAudioSource23.get())
+			res = mAudioSource23->read(&mediaBuffer, NULL);
+		else
+		{
+			// Set timeUs to our target, and let the loop fall out so that we can get the timestamp
+			// set properly.
+			timeUs = targetTimeUs;
+			continue;
+		}
+
+
+		if (res == OK)
+		{
+			bool rval = mediaBuffer->meta_data()->findInt64(kKeyTime, &timeUs);
+			if (!rval)
+			{
+				LOGI("Frame did not have time value: STOPPING");
+				timeUs = 0;
+			}
+
+			RUNDEBUG(mediaBuffer->meta_data()->dumpToLog());
+			LOGTIMING("key time = %lld | target time = %lld", timeUs, targetTimeUs);
+		}
+		else if (res == INFO_FORMAT_CHANGED)
+		{
+			LOGI("Audio Stream Format Changed");
+		}
+		else if (res == ERROR_END_OF_STREAM)
+		{
+			LOGE("End of Audio Stream");
+			return false;
+		}
+
+		if (mediaBuffer != NULL)
+		{
+			mediaBuffer->release();
+			mediaBuffer = NULL;
+		}
+
+		sched_yield();
+	}
+
+	mTimeStampOffset = ((double)timeUs / 1000000.0f);
+	return true;
+}
+
+int AudioSLES::Update()
+{
+	LOGTRACE("%s", __func__);
+	LOGTHREAD("Audio Update Thread Running - waiting = %s", mWaiting ? "true" : "false");
+
+	// Check to see if there is a target state on the queue.
+	AudioCommandQueue::Command ts;
+	if (mCommands.Pop(ts))
+	{
+		LOGI("Popped target state %s", getStateString(ts.state));
+		switch (ts.state)
+		{
+		case STOPPED:
+			if (doStop(ts.data))
+			{
+				LOGI("Stopped: state=%s", getStateString(mPlayState));
+				return AUDIOTHREAD_CONTINUE;
+			}
+			break;
+		case PAUSED:
+			{
+				AutoLock locker(&lock, __func__);
+				mOutput.Pause();
+				SetState(PAUSED, __func__);
+			}
+			break;
+		}
+	}
+
+	if (mWaiting)
+	{
+		// Nothing to decode until we're given a source or started again.
+		mCommands.Wait(AudioCommandQueue::kWaitForever);
+		return AUDIOTHREAD_WAIT;
+	}
+	if (mPlayState != PLAYING)
+	{
+		if (mPlayState == INITIALIZED || mPlayState == PAUSED || mPlayState == SEEKING)
+		{
+			LOGI("Pausing Audio Thread: state = %s", getStateString(mPlayState));
+			mCommands.Wait(AudioCommandQueue::kWaitForever);
+			LOGI("Resuming Audio Thread: state = %s", getStateString(mPlayState));
+			return AUDIOTHREAD_CONTINUE; // Make sure we check the state queue, before continuing
+		}
+
+		if (mPlayState == STOPPED)
+		{
+			LOGI("mPlayState == STOPPED. Ending audio update thread!");
+			return AUDIOTHREAD_FINISH; // We don't really want to add more stuff to the buffer
+			// and potentially run past the end of buffered source data
+			// if we're not actively playing
+		}
+	}
+
+	// Let the output drain to kTargetBufferUs before decoding any more.
+	int64_t pendingUs = GetPendingUs();
+	if (pendingUs > kTargetBufferUs)
+	{
+		int64_t waitUs = pendingUs - kTargetBufferUs;
+		mCommands.Wait(waitUs < kMaxSleepUs ? waitUs : kMaxSleepUs);
+		return AUDIOTHREAD_CONTINUE;
+	}
+
+	AutoLock updateLocker(&updateMutex, __func__);
+
+	MediaBuffer* mediaBuffer = NULL;
+
+	status_t res = OK;
+
+	if(mAudioSource.get())
+		res = mAudioSource->read(&mediaBuffer, NULL);
+	else if(mAudioSource23.get())
+		res = mAudioSource23->read(&mediaBuffer, NULL);
+	else
+	{
+		res = OK;
+	}
+
+	if (res == OK && mOutput.IsOpen())
+	{
+		RUNDEBUG( {if (mediaBuffer) mediaBuffer->meta_data()->dumpToLog();} );
+
+		if (mediaBuffer && mAACDecoder)
+		{
+			int64_t timeUs;
+			bool rval = mediaBuffer->meta_data()->findInt64(kKeyTime, &timeUs);
+			if (!rval)
+			{
+				timeUs = 0;
+
+			}
+			LOGTIMING("Audio timeUs=%lld | mNeedsTimeStampOffset=%s", timeUs, mNeedsTimeStampOffset ? "True":"False");
+
+			// If we need the timestamp offset (our audio starts at 0, which is not quite accurate and won't match
+			// the video time), set it. This should only be the case when we first start a stream.
+			if (mNeedsTimeStampOffset)
+			{
+				LOGTIMING("Need to set mTimeStampOffset = %lld", timeUs);
+				SetTimeStampOffset(((double)timeUs / 1000000.0f));
+			}
+
+			size_t mbufSize = mediaBuffer->range_length();
+
+			AAC_DECODER_ERROR err;
+			UINT valid = mbufSize;
+			UINT bufSize = mbufSize;
+			unsigned char* data = (unsigned char*)mediaBuffer->data();
+
+			int dataOffset = 0;
+
+			while (valid > 0)
+			{
+				bufSize = bufSize - dataOffset;
+				unsigned char* dataBuffer = data + dataOffset;
+
+				err = aacDecoder_Fill(mAACDecoder, &dataBuffer, &bufSize , &valid);
+				if (err != AAC_DEC_OK)
+				{
+					LOGE("aacDecoder_Fill() failed: %x", err);
+					mediaBuffer->release();
+					return AUDIOTHREAD_FINISH;
+				}
+
+				dataOffset = bufSize - valid;
+
+				err = AAC_DEC_OK;
+				while (err == AAC_DEC_OK)
+				{
+					// Decode straight into the output's ring. If it has no room
+					// the frame is decoded anyway, to keep the decoder in step,
+					// and dropped.
+					char* out = mOutput.BeginWrite(kMaxFrameBytes);
+					if (!out)
+						out = mFrameBuffer;
+
+					err = aacDecoder_DecodeFrame(mAACDecoder, (INT_PCM*)out, kMaxFrameBytes / sizeof(INT_PCM), 0 );
+					if (err != AAC_DEC_OK)
+					{
+						if (err == AAC_DEC_NOT_ENOUGH_BITS)
+							LOGAUDIO("aacDecoder_DecodeFrame() NOT ENOUGH BITS");
+						else
+							LOGE("aacDecoder_DecodeFrame() failed: %x", err);
+						continue;
+					}
+
+					CStreamInfo* streamInfo = aacDecoder_GetStreamInfo(mAACDecoder);
+					int frameBytes = streamInfo->frameSize * sizeof(INT_PCM) * streamInfo->numChannels;
+					LOGAUDIO("frameSize = %d, channels=%d, sampleRate=%d", streamInfo->frameSize, streamInfo->numChannels, streamInfo->sampleRate);
+
+					bool reopen = false;
+					if (streamInfo->sampleRate > mSampleRate)
+					{
+						LOGAUDIO("Sample Rate changed from %d to %d", mSampleRate, streamInfo->sampleRate);
+						mSampleRate = streamInfo->sampleRate;
+						reopen = true;
+					}
+					if (streamInfo->numChannels != mNumChannels)
+					{
+						LOGAUDIO("Num Channels changed from %d to %d", mNumChannels, streamInfo->numChannels);
+						mNumChannels = streamInfo->numChannels;
+						reopen = true;
+					}
+
+					if (reopen)
+					{
+						// Reopening frees the ring, so keep the frame aside meanwhile.
+						if (out != mFrameBuffer)
+							memcpy(mFrameBuffer, out, frameBytes);
+						InitOutput();
+						mNeedsTimeStampOffset = true;
+
+						out = mOutput.BeginWrite(frameBytes);
+						if (out)
+							memcpy(out, mFrameBuffer, frameBytes);
+					}
+
+					if (out && out != mFrameBuffer)
+						mOutput.EndWrite(frameBytes);
+				}
+			}
+		}
+		else
+		{
+			if (mNeedsTimeStampOffset)
+			{
+				LOGTIMING("Need to set mTimeStampOffset");
+				int64_t videoTimeUs = gHLSPlayerSDK->GetPlayer()->GetLastTimeUS();
+				if (videoTimeUs >= 0)
+					SetTimeStampOffset(((double) videoTimeUs / (double)NANOSEC_PER_MS));
+			}
+			WriteSilence();
+		}
+	}
+	else if (res == INFO_FORMAT_CHANGED)
+	{
+		LOGI("Format Changed");
+
+		// Flush our existing output.
+		Flush();
+
+		// Create new one.
+		Start();
+
+		Update();
+	}
+	else if (res == ERROR_END_OF_STREAM)
+	{
+		LOGE("End of Audio Stream");
+		mWaiting = true;
+		if (gHLSPlayerSDK)
+		{
+			if (gHLSPlayerSDK->GetPlayer())
+			{
+				gHLSPlayerSDK->GetPlayer()->SetState(FOUND_DISCONTINUITY);
+			}
+		}
+		return AUDIOTHREAD_WAIT;
+	}
+
+	if (mediaBuffer != NULL)
+		mediaBuffer->release();
+
+	return AUDIOTHREAD_CONTINUE;
+}
+
+
+int AudioSLES::getBufferSize()
+{
+	LOGTRACE("%s", __func__);
+	return mOutput.GetFramesPending();
+}
+
+int64_t AudioSLES::GetPendingUs()
+{
+	int sampleRate = mOutput.GetSampleRate();
+	if (!mOutput.IsOpen() || sampleRate <= 0)
+		return 0;
+	return (int64_t)mOutput.GetFramesPending() * 1000000 / sampleRate;
+}
+
+/*
+ * doStop()
+ *
+ * Perform the actual stop
+ *
+ */
+bool AudioSLES::doStop(int data)
+{
+	LOGTRACE("%s", __func__);
+	bool seeking = (data == 1);
+
+	AutoLock locker(&lock, __func__);
+	AutoLock updateLocker(&updateMutex, __func__);
+
+	mOutput.Stop();
+	if(seeking)
+	{
+		if (mAACDecoder) aacDecoder_Close(mAACDecoder);
+		mAACDecoder = NULL;
+		mOutput.Close();
+	}
+
+	LOGAUDIO("Stop completed");
+	if (seeking)
+		SetState(SEEKING, __func__);
+	else
+		SetState(STOPPED, __func__);
+
+	return true;
+}
+
+
+void AudioSLES::SetState(int state, const char* func)
+{
+	LOGI("Changing AudioSLES state from %s to %s in %s", getStateString(mPlayState), getStateString(state), func);
+	AutoLock locker(&stateLock, __func__);
+	mPlayState = state;
+	pthread_cond_broadcast(&stateCond);
+}
+
+int AudioSLES::GetState()
+{
+	return mPlayState;
+}
@@ -0,0 +1,113 @@
+/*
+ * AudioSLES.h
+ *
+ * AAC decoding with FDK, played through OpenSL ES instead of a java AudioTrack.
+ */
+
+#ifndef AUDIOSLES_H_
+#define AUDIOSLES_H_
+
+#include <androidVideoShim.h>
+#include <semaphore.h>
+#include <RefCounted.h>
+#include <AudioPlayer.h>
+#include <OpenSLOutput.h>
+#include <AudioCommandQueue.h>
+#include <aacdecoder_lib.h>
+
+/*
+ * AudioSLES
+ *
+ * Behaves as AudioFDK does - same states, same target state queue, same
+ * timestamps - but never touches java. The decoder writes straight into
+ * OpenSLOutput's ring, and the playback position is a counter the output's
+ * callback keeps, so GetTimeStamp() and getBufferSize() are just reads.
+ *
+ * The output only takes mono and stereo, so the decoder downmixes anything
+ * wider to stereo.
+ */
+class AudioSLES: public AudioPlayer {
+public:
+	AudioSLES();
+	virtual ~AudioSLES();
+
+	bool Init();
+	void Close();
+
+	virtual void unload(); // from RefCounted
+
+	bool Start();
+	void Play();
+	void Pause();
+	void Flush();
+	bool Stop(bool seeking = false);
+
+	bool Set(android_video_shim::sp<android_video_shim::MediaSource> audioSource, bool alreadyStarted = false);
+	bool Set23(android_video_shim::sp<android_video_shim::MediaSource23> audioSource, bool alreadyStarted = false);
+	void ClearAudioSource();
+
+	int Update();
+
+	int64_t GetTimeStamp();
+
+	void forceTimeStampUpdate();
+
+	int getBufferSize();
+
+	bool UpdateFormatInfo();
+
+	bool ReadUntilTime(double timeSecs);
+
+	int GetState();
+
+private:
+
+	void SetState(int state, const char* func = "");
+
+	// See AudioFDK.
+	AudioCommandQueue mCommands;
+
+	bool doStop(int data);
+
+	int64_t GetPendingUs();
+
+	void SetTimeStampOffset(double offsetSecs);
+
+	bool InitOutput();
+	void WriteSilence();
+
+	HANDLE_AACDECODER mAACDecoder;
+
+	uint32_t mESDSType;
+	const void* mESDSData;
+	size_t mESDSSize;
+
+	OpenSLOutput mOutput;
+
+	// Somewhere to decode when the output has no room, and to keep a frame
+	// while the output is reopened for it.
+	char* mFrameBuffer;
+
+	android_video_shim::sp<android_video_shim::MediaSource> mAudioSource;
+	android_video_shim::sp<android_video_shim::MediaSource23> mAudioSource23;
+
+	int mSampleRate;
+	int mNumChannels;
+
+	int mPlayState;
+	bool mWaiting;
+	bool mPlayingSilence;
+
+	double mTimeStampOffset;
+	bool mNeedsTimeStampOffset;
+
+	pthread_mutex_t updateMutex;
+	pthread_mutex_t lock;
+
+	// Signalled on every state change, for Stop() to wait on.
+	pthread_mutex_t stateLock;
+	pthread_cond_t stateCond;
+
+};
+
+#endif /* AUDIOSLES_H_ */
@@ -11,9 +11,12 @@
 #include "HLSPlayerSDK.h"
 #include "HLSPlayer.h"
 #include <unistd.h>
+#include <time.h>
 
 extern HLSPlayerSDK* gHLSPlayerSDK;
 
+// How long Update() sleeps at a time while it has no source to read.
+static const int kWaitingSleepMs = 100;
 
 using namespace android_video_shim;
 
@@ -142,6 +145,7 @@ bool AudioTrack::Set(sp<MediaSource> audioSource, bool alreadyStarted)
 	if (!alreadyStarted && mAudioSource.get()) mAudioSource->start(NULL);
 
 	mWaiting = false;
+	semSource.Post();
 	return UpdateFormatInfo();
 }
 
@@ -155,6 +159,7 @@ bool AudioTrack::Set23(sp<MediaSource23> audioSource, bool alreadyStarted)
 	mAudioSource23 = audioSource;
 	if (!alreadyStarted && mAudioSource23.get()) mAudioSource23->start(NULL);
 	mWaiting = false;
+	semSource.Post();
 	return UpdateFormatInfo();
 }
 
@@ -495,7 +500,14 @@ int AudioTrack::Update()
 {
 	LOGTRACE("%s", __func__);
 	LOGTHREAD("Audio Update Thread Running");
-	if (mWaiting) return AUDIOTHREAD_WAIT;
+	if (mWaiting)
+	{
+		// Nothing to read until we're given a source; Set and Set23 post
+		// semSource. Anything else that clears mWaiting is picked up within
+		// kWaitingSleepMs.
+		semSource.WaitUs(kWaitingSleepMs * 1000);
+		return AUDIOTHREAD_WAIT;
+	}
 	if (mPlayState != PLAYING)
 	{
 		while (mPlayState == INITIALIZED)
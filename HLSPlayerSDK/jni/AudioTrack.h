@@ -13,6 +13,7 @@
 #include <semaphore.h>
 #include <RefCounted.h>
 #include <AudioPlayer.h>
+#include "MonotonicWait.h"
 
 class AudioTrack : public AudioPlayer {
 public:
@@ -85,6 +86,7 @@ private:
 	long long samplesWritten;
 
 	sem_t semPause;
+	MonotonicSemaphore semSource;	// Posted when Set/Set23 give us something to read.
     pthread_mutex_t updateMutex;
     pthread_mutex_t lock;
 
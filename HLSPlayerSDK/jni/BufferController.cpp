@@ -0,0 +1,71 @@
+#include <androidVideoShim.h>
+#include "BufferController.h"
+
+// What SEGMENTS_TO_BUFFER = 2 came to with typical 10 second segments.
+static const double kDefaultLowSeconds = 20.0;
+static const double kDefaultHighSeconds = 30.0;
+
+BufferController::BufferController() : mLowSeconds(kDefaultLowSeconds), mHighSeconds(kDefaultHighSeconds),
+		mBufferedSeconds(-1), mFilling(true)
+{
+	pthread_mutex_init(&mLock, NULL);
+}
+
+BufferController::~BufferController()
+{
+	pthread_mutex_destroy(&mLock);
+}
+
+void BufferController::SetWatermarks(double lowSeconds, double highSeconds)
+{
+	AutoLock locker(&mLock, __func__);
+
+	if (lowSeconds < 0)
+		lowSeconds = 0;
+	if (highSeconds < lowSeconds)
+		highSeconds = lowSeconds;
+
+	LOGI("Buffer watermarks %.1f s / %.1f s", lowSeconds, highSeconds);
+	mLowSeconds = lowSeconds;
+	mHighSeconds = highSeconds;
+}
+
+double BufferController::GetLowWatermark()
+{
+	AutoLock locker(&mLock, __func__);
+	return mLowSeconds;
+}
+
+double BufferController::GetHighWatermark()
+{
+	AutoLock locker(&mLock, __func__);
+	return mHighSeconds;
+}
+
+bool BufferController::Update(double bufferedSeconds)
+{
+	AutoLock locker(&mLock, __func__);
+
+	mBufferedSeconds = bufferedSeconds;
+
+	if (bufferedSeconds < mLowSeconds)
+		mFilling = true;
+	else if (bufferedSeconds >= mHighSeconds)
+		mFilling = false;
+
+	LOGV("Buffered %.2f s (%.1f / %.1f), %s", bufferedSeconds, mLowSeconds, mHighSeconds, mFilling ? "filling" : "draining");
+	return mFilling;
+}
+
+double BufferController::GetBufferedSeconds()
+{
+	AutoLock locker(&mLock, __func__);
+	return mBufferedSeconds;
+}
+
+void BufferController::Reset()
+{
+	AutoLock locker(&mLock, __func__);
+	mBufferedSeconds = -1;
+	mFilling = true;
+}
@@ -0,0 +1,47 @@
+#ifndef _BUFFERCONTROLLER_H_
+#define _BUFFERCONTROLLER_H_
+
+#include <pthread.h>
+
+/*
+ * BufferController
+ *
+ * Decides when HLSPlayer asks for another segment, from how many seconds of
+ * media are buffered ahead of playback rather than how many segments are.
+ *
+ * Segments are requested whenever the level drops below the low watermark
+ * and keep being requested until it reaches the high one, then not again
+ * until it has drained back down to the low one. The high watermark can be
+ * overshot by up to a segment, the level isn't known until it's fed.
+ *
+ * All methods are safe to call from any thread.
+ */
+class BufferController
+{
+public:
+	BufferController();
+	~BufferController();
+
+	void SetWatermarks(double lowSeconds, double highSeconds);
+	double GetLowWatermark();
+	double GetHighWatermark();
+
+	// Feed in the current buffer level. Returns true if another segment
+	// should be requested.
+	bool Update(double bufferedSeconds);
+
+	// Last level given to Update, -1 before the first.
+	double GetBufferedSeconds();
+
+	// Start filling again from empty, e.g. after a seek.
+	void Reset();
+
+private:
+	pthread_mutex_t mLock;
+	double mLowSeconds;
+	double mHighSeconds;
+	double mBufferedSeconds;
+	bool mFilling;
+};
+
+#endif /* _BUFFERCONTROLLER_H_ */
@@ -0,0 +1,205 @@
+#include "CodecReaper.h"
+#include "FrameScheduler.h"
+#include "debug.h"
+
+#include <unistd.h>
+
+using namespace android_video_shim;
+
+// How often the reaper checks whether a codec it let go of is gone yet.
+static const useconds_t kPollIntervalUs = 1000;
+
+// Someone is holding on to a codec for good. Stop waiting for it, so the
+// ones behind it still get torn down.
+static const int64_t kGiveUpUs = 10000000;
+
+// Never destroyed; its thread lives as long as the process.
+CodecReaper& CodecReaper::Get()
+{
+	static CodecReaper* reaper = new CodecReaper();
+	return *reaper;
+}
+
+CodecReaper::CodecReaper() : mThreadStarted(false), mBusy(false), mLastTeardownUs(0), mMaxTeardownUs(0),
+		mTotalTeardownUs(0), mTeardownCount(0)
+{
+	pthread_mutex_init(&mLock, NULL);
+	pthread_cond_init(&mCond, NULL);
+}
+
+CodecReaper::~CodecReaper()
+{
+	pthread_cond_destroy(&mCond);
+	pthread_mutex_destroy(&mLock);
+}
+
+void CodecReaper::Retire(const sp<MediaSource>& codec)
+{
+	if (codec.get() == NULL) return;
+
+	Retiree retiree;
+	retiree.codec = codec;
+	Enqueue(retiree);
+}
+
+void CodecReaper::Retire(const sp<MediaSource23>& codec)
+{
+	if (codec.get() == NULL) return;
+
+	Retiree retiree;
+	retiree.codec23 = codec;
+	Enqueue(retiree);
+}
+
+void CodecReaper::Enqueue(const Retiree& retiree)
+{
+	pthread_mutex_lock(&mLock);
+
+	if (!mThreadStarted)
+	{
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, ThreadFunc, this) != 0)
+		{
+			// Nothing to hand it to, so tear it down here like we used to.
+			pthread_mutex_unlock(&mLock);
+			LOGE("Failed to start codec reaper thread, tearing down on the calling thread");
+			Retiree local = retiree;
+			local.retiredUs = FrameScheduler::NowUs();
+			Reap(local);
+			return;
+		}
+		pthread_detach(thread);
+		mThreadStarted = true;
+	}
+
+	while (mQueue.size() + (mBusy ? 1 : 0) >= kMaxPending)
+	{
+		LOGI("%d codecs already being torn down, waiting", kMaxPending);
+		pthread_cond_wait(&mCond, &mLock);
+	}
+
+	mQueue.push_back(retiree);
+	mQueue.back().retiredUs = FrameScheduler::NowUs();
+	pthread_cond_broadcast(&mCond);
+
+	pthread_mutex_unlock(&mLock);
+}
+
+void* CodecReaper::ThreadFunc(void* arg)
+{
+	LOGTHREAD("codec reaper STARTING");
+	((CodecReaper*)arg)->Run();
+	return NULL;
+}
+
+void CodecReaper::Run()
+{
+	pthread_mutex_lock(&mLock);
+	for (;;)
+	{
+		while (mQueue.empty())
+			pthread_cond_wait(&mCond, &mLock);
+
+		Retiree retiree = mQueue.front();
+		mQueue.pop_front();
+		mBusy = true;
+
+		pthread_mutex_unlock(&mLock);
+		Reap(retiree);
+		pthread_mutex_lock(&mLock);
+
+		mBusy = false;
+		pthread_cond_broadcast(&mCond);
+	}
+}
+
+// Same as clearOMX used to do in place: stop, let go, and wait for the last
+// reference to go away.
+void CodecReaper::Reap(Retiree& retiree)
+{
+	wp<RefBase> tmp;
+	if (retiree.codec.get())
+	{
+		LOGI("Stopping && Clearing OMX %p", retiree.codec.get());
+		retiree.codec->stop();
+		tmp = retiree.codec;
+		retiree.codec.clear();
+	}
+	else
+	{
+		LOGI("Stopping && Clearing OMX %p", retiree.codec23.get());
+		retiree.codec23->stop();
+		tmp = retiree.codec23;
+		retiree.codec23.clear();
+	}
+
+	while (tmp.promote() != NULL)
+	{
+		if (FrameScheduler::NowUs() - retiree.retiredUs > kGiveUpUs)
+		{
+			LOGE("Codec still referenced after %lld ms, giving up on it", kGiveUpUs / 1000);
+			break;
+		}
+		usleep(kPollIntervalUs);
+	}
+
+	int64_t teardownUs = FrameScheduler::NowUs() - retiree.retiredUs;
+
+	pthread_mutex_lock(&mLock);
+	mLastTeardownUs = teardownUs;
+	if (teardownUs > mMaxTeardownUs) mMaxTeardownUs = teardownUs;
+	mTotalTeardownUs += teardownUs;
+	++mTeardownCount;
+	LOGI("Codec teardown took %lld ms (average %lld ms, max %lld ms over %d, %d still queued)",
+			teardownUs / 1000, mTotalTeardownUs / mTeardownCount / 1000, mMaxTeardownUs / 1000,
+			mTeardownCount, (int)mQueue.size());
+	pthread_mutex_unlock(&mLock);
+}
+
+void CodecReaper::WaitForIdle()
+{
+	pthread_mutex_lock(&mLock);
+	while (!mQueue.empty() || mBusy)
+		pthread_cond_wait(&mCond, &mLock);
+	pthread_mutex_unlock(&mLock);
+}
+
+int CodecReaper::GetPendingCount()
+{
+	pthread_mutex_lock(&mLock);
+	int count = mQueue.size() + (mBusy ? 1 : 0);
+	pthread_mutex_unlock(&mLock);
+	return count;
+}
+
+int64_t CodecReaper::GetLastTeardownUs()
+{
+	pthread_mutex_lock(&mLock);
+	int64_t us = mLastTeardownUs;
+	pthread_mutex_unlock(&mLock);
+	return us;
+}
+
+int64_t CodecReaper::GetMaxTeardownUs()
+{
+	pthread_mutex_lock(&mLock);
+	int64_t us = mMaxTeardownUs;
+	pthread_mutex_unlock(&mLock);
+	return us;
+}
+
+int64_t CodecReaper::GetAverageTeardownUs()
+{
+	pthread_mutex_lock(&mLock);
+	int64_t us = mTeardownCount ? mTotalTeardownUs / mTeardownCount : 0;
+	pthread_mutex_unlock(&mLock);
+	return us;
+}
+
+int CodecReaper::GetTeardownCount()
+{
+	pthread_mutex_lock(&mLock);
+	int count = mTeardownCount;
+	pthread_mutex_unlock(&mLock);
+	return count;
+}
@@ -0,0 +1,81 @@
+#ifndef _CODECREAPER_H_
+#define _CODECREAPER_H_
+
+#include <androidVideoShim.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include <list>
+
+/*
+ * CodecReaper
+ *
+ * Tears down retired OMX codecs on its own thread, so seeks and quality
+ * switches don't sit waiting (usually under HLSPlayer::lock) for the media
+ * server to let go of them.
+ *
+ * Retire() takes over the caller's reference. The reaper thread stop()s
+ * the codec, drops the reference and waits until whoever else held one
+ * has let go too, which is the point the codec is actually destroyed and
+ * its hardware free for the next one. At most kMaxPending codecs are in
+ * flight; Retire() blocks while that many are, rather than let them pile
+ * up in the media server.
+ *
+ * Teardown latency, from Retire() until the codec is destroyed, is logged
+ * for each codec and kept as a running average and maximum.
+ *
+ * All methods are safe to call from any thread.
+ */
+class CodecReaper
+{
+public:
+	enum { kMaxPending = 4 };
+
+	static CodecReaper& Get();
+
+	void Retire(const android_video_shim::sp<android_video_shim::MediaSource>& codec);
+	void Retire(const android_video_shim::sp<android_video_shim::MediaSource23>& codec);
+
+	// Blocks until nothing is left to tear down. For when a new codec can't
+	// be created while old ones still hold on to the hardware.
+	void WaitForIdle();
+	int GetPendingCount();
+
+	// Teardown latency, in microseconds, over every codec torn down so far.
+	int64_t GetLastTeardownUs();
+	int64_t GetMaxTeardownUs();
+	int64_t GetAverageTeardownUs();
+	int GetTeardownCount();
+
+private:
+	CodecReaper();
+	~CodecReaper();
+
+	struct Retiree
+	{
+		android_video_shim::sp<android_video_shim::MediaSource> codec;
+		android_video_shim::sp<android_video_shim::MediaSource23> codec23;
+		int64_t retiredUs;
+	};
+
+	void Enqueue(const Retiree& retiree);
+	void Run();
+	void Reap(Retiree& retiree);
+	static void* ThreadFunc(void* arg);
+
+	pthread_mutex_t mLock;
+	pthread_cond_t mCond;
+	bool mThreadStarted;
+
+	// Retirees still to be torn down, plus the one being torn down if
+	// mBusy; together never more than kMaxPending.
+	std::list<Retiree> mQueue;
+	bool mBusy;
+
+	int64_t mLastTeardownUs;
+	int64_t mMaxTeardownUs;
+	int64_t mTotalTeardownUs;
+	int mTeardownCount;
+};
+
+#endif /* _CODECREAPER_H_ */
@@ -0,0 +1,148 @@
+#include <unistd.h>
+
+#include "ConversionPool.h"
+#include "debug.h"
+
+pthread_mutex_t ConversionPool::mRunLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t ConversionPool::mLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t ConversionPool::mWorkCond = PTHREAD_COND_INITIALIZER;
+pthread_cond_t ConversionPool::mDoneCond = PTHREAD_COND_INITIALIZER;
+int ConversionPool::mWorkerCount = 0;
+int ConversionPool::mCoreCount = 0;
+
+ConversionPool::StripFunc ConversionPool::mFunc = NULL;
+void *ConversionPool::mArg = NULL;
+size_t ConversionPool::mHeight = 0;
+size_t ConversionPool::mStripRows = 0;
+int ConversionPool::mStripCount = 0;
+int ConversionPool::mNextStrip = 0;
+int ConversionPool::mStripsLeft = 0;
+
+const size_t ConversionPool::kMinStripPixels;
+
+int ConversionPool::getStripCount(size_t width, size_t height)
+{
+	pthread_mutex_lock(&mLock);
+	if (mCoreCount == 0)
+	{
+		long cores = sysconf(_SC_NPROCESSORS_ONLN);
+		mCoreCount = cores < 1 ? 1 : cores > kMaxStrips ? kMaxStrips : (int)cores;
+	}
+	int count = mCoreCount;
+	pthread_mutex_unlock(&mLock);
+
+	size_t bySize = (width * height) / kMinStripPixels;
+	if (bySize < (size_t)count)
+		count = bySize < 1 ? 1 : (int)bySize;
+	return count;
+}
+
+void ConversionPool::run(StripFunc func, void *arg, size_t width, size_t height, size_t rowAlignment)
+{
+	int strips = getStripCount(width, height);
+	if (rowAlignment < 1)
+		rowAlignment = 1;
+
+	size_t stripRows = (height + strips - 1) / strips;
+	stripRows = (stripRows + rowAlignment - 1) / rowAlignment * rowAlignment;
+	if (stripRows == 0 || stripRows >= height)
+	{
+		func(arg, 0, height);
+		return;
+	}
+	strips = (int)((height + stripRows - 1) / stripRows);
+
+	pthread_mutex_lock(&mRunLock);
+	pthread_mutex_lock(&mLock);
+
+	startWorkers_l();
+
+	mFunc = func;
+	mArg = arg;
+	mHeight = height;
+	mStripRows = stripRows;
+	mStripCount = strips;
+	mNextStrip = 0;
+	mStripsLeft = strips;
+	pthread_cond_broadcast(&mWorkCond);
+
+	// Do our share rather than sit idle; if the workers are busy or never
+	// started, this converts the whole frame.
+	while (convertNextStrip_l())
+		;
+
+	while (mStripsLeft > 0)
+		pthread_cond_wait(&mDoneCond, &mLock);
+
+	mFunc = NULL;
+	mArg = NULL;
+
+	pthread_mutex_unlock(&mLock);
+	pthread_mutex_unlock(&mRunLock);
+}
+
+// Must be called with mLock held. Converts one strip of the current frame,
+// unlocking while it does; false if there was none left to hand out.
+bool ConversionPool::convertNextStrip_l()
+{
+	if (mNextStrip >= mStripCount)
+		return false;
+
+	int strip = mNextStrip++;
+	StripFunc func = mFunc;
+	void *arg = mArg;
+	size_t firstRow = strip * mStripRows;
+	size_t lastRow = firstRow + mStripRows < mHeight ? firstRow + mStripRows : mHeight;
+
+	pthread_mutex_unlock(&mLock);
+	func(arg, firstRow, lastRow);
+	pthread_mutex_lock(&mLock);
+
+	if (--mStripsLeft == 0)
+		pthread_cond_broadcast(&mDoneCond);
+	return true;
+}
+
+// Must be called with mLock held.
+void ConversionPool::startWorkers_l()
+{
+	if (mWorkerCount > 0)
+		return;
+
+	// The caller converts a strip of its own.
+	int count = mCoreCount - 1;
+	if (count < 1)
+		count = 1;
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	for (int i = 0; i < count; ++i)
+	{
+		pthread_t thread;
+		if (pthread_create(&thread, &attr, workerThread, NULL) == 0)
+			++mWorkerCount;
+	}
+
+	pthread_attr_destroy(&attr);
+
+	LOGI("Started %d color conversion workers", mWorkerCount);
+}
+
+void *ConversionPool::workerThread(void *arg)
+{
+	LOGTHREAD("color conversion worker STARTING");
+
+	pthread_mutex_lock(&mLock);
+
+	for (;;)
+	{
+		while (mNextStrip >= mStripCount)
+			pthread_cond_wait(&mWorkCond, &mLock);
+
+		convertNextStrip_l();
+	}
+
+	return NULL;
+}
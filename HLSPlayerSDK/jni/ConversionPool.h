@@ -0,0 +1,55 @@
+#ifndef _CONVERSIONPOOL_H_
+#define _CONVERSIONPOOL_H_
+
+#include <pthread.h>
+#include <stddef.h>
+
+// Splits a frame into horizontal strips and converts them on a small pool
+// of persistent worker threads, for the software render path's color
+// conversion (ColorConverter_Local and ColorConverter444).
+//
+// The calling thread converts strips too, and run() returns once every
+// strip is done, so a conversion behaves exactly as it did on one thread.
+// Frames too small to be worth splitting are converted straight on the
+// caller. Only one frame is converted at a time; other callers wait.
+class ConversionPool
+{
+public:
+	// Converts rows [firstRow, lastRow) of the frame described by arg.
+	typedef void (*StripFunc)(void *arg, size_t firstRow, size_t lastRow);
+
+	// Converts rows 0 to height of a width pixel wide frame. Strips start
+	// on multiples of rowAlignment (two rows for 4:2:0 chroma, a block row
+	// for tiled formats).
+	static void run(StripFunc func, void *arg, size_t width, size_t height, size_t rowAlignment);
+
+	// How many strips a frame that size is split into: one per core, but
+	// never strips so small the hand off costs more than it saves.
+	static int getStripCount(size_t width, size_t height);
+
+private:
+	static const int kMaxStrips = 8;
+	static const size_t kMinStripPixels = 64 * 1024;
+
+	static pthread_mutex_t mRunLock;
+	static pthread_mutex_t mLock;
+	static pthread_cond_t mWorkCond;
+	static pthread_cond_t mDoneCond;
+	static int mWorkerCount;
+	static int mCoreCount;
+
+	// The frame being converted.
+	static StripFunc mFunc;
+	static void *mArg;
+	static size_t mHeight;
+	static size_t mStripRows;
+	static int mStripCount;
+	static int mNextStrip;			// Next strip to hand out.
+	static int mStripsLeft;			// Strips not yet converted.
+
+	static void startWorkers_l();
+	static void *workerThread(void *arg);
+	static bool convertNextStrip_l();
+};
+
+#endif
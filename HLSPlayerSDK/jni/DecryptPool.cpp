@@ -0,0 +1,315 @@
+#include <string.h>
+#include <unistd.h>
+
+#include "DecryptPool.h"
+#include "HLSSegmentCache.h"
+#include "androidVideoShim.h"
+
+//----------------------------------------------------------------------------
+// CryptoRegistry
+
+CryptoRegistry::Shard CryptoRegistry::mShards[CryptoRegistry::kShardCount];
+volatile int CryptoRegistry::mNextHandle = 1000;
+
+int CryptoRegistry::add(AESDecrypt *ctx)
+{
+	int handle = __sync_fetch_and_add(&mNextHandle, 1);
+
+	Shard &shard = shardFor(handle);
+	AutoLock locker(&shard.lock, __func__);
+	Entry &entry = shard.entries[handle];
+	entry.ctx = ctx;
+	entry.refCount = 0;
+	entry.removed = false;
+	return handle;
+}
+
+void CryptoRegistry::remove(int handle)
+{
+	Shard &shard = shardFor(handle);
+	AutoLock locker(&shard.lock, __func__);
+
+	std::map<int, Entry>::iterator i = shard.entries.find(handle);
+	if (i == shard.entries.end() || i->second.removed)
+	{
+		LOGE("Failed to locate cryptostate %d! Ignoring free request...", handle);
+		return;
+	}
+
+	i->second.removed = true;
+	if (i->second.refCount == 0)
+	{
+		delete i->second.ctx;
+		shard.entries.erase(i);
+	}
+}
+
+AESDecrypt *CryptoRegistry::acquire(int handle)
+{
+	Shard &shard = shardFor(handle);
+	AutoLock locker(&shard.lock, __func__);
+
+	std::map<int, Entry>::iterator i = shard.entries.find(handle);
+	if (i == shard.entries.end() || i->second.removed)
+		return NULL;
+
+	++i->second.refCount;
+	return i->second.ctx;
+}
+
+void CryptoRegistry::release(int handle)
+{
+	Shard &shard = shardFor(handle);
+	AutoLock locker(&shard.lock, __func__);
+
+	std::map<int, Entry>::iterator i = shard.entries.find(handle);
+	if (i == shard.entries.end())
+		return;
+
+	if (--i->second.refCount == 0 && i->second.removed)
+	{
+		delete i->second.ctx;
+		shard.entries.erase(i);
+	}
+}
+
+//----------------------------------------------------------------------------
+// DecryptPool
+
+pthread_mutex_t DecryptPool::mLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t DecryptPool::mWorkCond = PTHREAD_COND_INITIALIZER;
+pthread_cond_t DecryptPool::mDoneCond = PTHREAD_COND_INITIALIZER;
+std::deque<DecryptPool::Job *> DecryptPool::mQueue;
+DecryptPool::JobMap DecryptPool::mJobs;
+int DecryptPool::mNextJob = 1;
+int DecryptPool::mWorkerCount = 0;
+JavaVM *DecryptPool::mJVM = NULL;
+
+const int64_t DecryptPool::kPending;
+const int64_t DecryptPool::kChunkSize;
+
+int DecryptPool::submit(JNIEnv *env, int cryptoHandle, const char *uri, jobject buffer, int64_t length)
+{
+	unsigned char *data = (unsigned char*)env->GetDirectBufferAddress(buffer);
+	if (data == NULL || length < 0 || env->GetDirectBufferCapacity(buffer) < length)
+	{
+		LOGE("Bad buffer for %s", uri);
+		return -1;
+	}
+
+	{
+		CryptoRef ctx(cryptoHandle);
+		if (!ctx.get())
+		{
+			LOGE("Failed to locate cryptostate %d! Ignoring decrypt request...", cryptoHandle);
+			return -1;
+		}
+	}
+
+	// A trailing partial block can't be valid ciphertext, it's left as is.
+	int64_t blockLength = length & ~(int64_t)(AESDecrypt::kBlockSize - 1);
+	if (blockLength != length)
+		LOGE("Segment length %lld isn't a multiple of the AES block size", length);
+
+	Job *job = new Job();
+	job->uri = uri;
+	job->cryptoHandle = cryptoHandle;
+	job->buffer = env->NewGlobalRef(buffer);
+	job->data = data;
+	job->length = length;
+	job->chunkCount = (int)((blockLength + kChunkSize - 1) / kChunkSize);
+	if (job->chunkCount == 0)
+		job->chunkCount = 1;
+	job->nextChunk = 0;
+	job->chunksLeft = job->chunkCount;
+	job->failed = false;
+	job->done = false;
+	job->result = -1;
+	job->refCount = 2;
+
+	// Every chunk after the first chains from the last ciphertext block of
+	// the one before; grab them all before anything is decrypted over them.
+	job->chunkIVs.resize(job->chunkCount * AESDecrypt::kBlockSize);
+	for (int i = 1; i < job->chunkCount; ++i)
+		memcpy(&job->chunkIVs[i * AESDecrypt::kBlockSize], data + i * kChunkSize - AESDecrypt::kBlockSize, AESDecrypt::kBlockSize);
+
+	AutoLock locker(&mLock, __func__);
+
+	if (!mJVM)
+		env->GetJavaVM(&mJVM);
+	startWorkers_l();
+
+	job->id = mNextJob++;
+	mJobs[job->id] = job;
+	mQueue.push_back(job);
+	pthread_cond_broadcast(&mWorkCond);
+
+	LOGV("Queued %s for decryption as job %d, %d chunks", uri, job->id, job->chunkCount);
+	return job->id;
+}
+
+int64_t DecryptPool::getResult(int id, bool wait)
+{
+	AutoLock locker(&mLock, __func__);
+
+	JobMap::iterator i = mJobs.find(id);
+	if (i == mJobs.end())
+		return -1;
+
+	Job *job = i->second;
+	while (wait && !job->done)
+		pthread_cond_wait(&mDoneCond, &mLock);
+
+	return job->done ? job->result : kPending;
+}
+
+void DecryptPool::release(JNIEnv *env, int id)
+{
+	AutoLock locker(&mLock, __func__);
+
+	JobMap::iterator i = mJobs.find(id);
+	if (i == mJobs.end())
+		return;
+
+	Job *job = i->second;
+	mJobs.erase(i);
+
+	// Nobody wants the result any more, don't decrypt what's left.
+	job->failed = true;
+	unref_l(env, job);
+}
+
+// Must be called with mLock held.
+void DecryptPool::unref_l(JNIEnv *env, Job *job)
+{
+	if (--job->refCount > 0)
+		return;
+
+	JobMap::iterator i = mJobs.find(job->id);
+	if (i != mJobs.end() && i->second == job)
+		mJobs.erase(i);
+
+	env->DeleteGlobalRef(job->buffer);
+	delete job;
+}
+
+// Must be called with mLock held.
+void DecryptPool::startWorkers_l()
+{
+	if (mWorkerCount > 0)
+		return;
+
+	// Leave a core for decode and rendering.
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	int count = (int)cores - 1;
+	if (count < 1)
+		count = 1;
+	if (count > kMaxWorkers)
+		count = kMaxWorkers;
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	for (int i = 0; i < count; ++i)
+	{
+		pthread_t thread;
+		if (pthread_create(&thread, &attr, workerThread, NULL) == 0)
+			++mWorkerCount;
+	}
+
+	pthread_attr_destroy(&attr);
+
+	LOGI("Started %d decrypt workers (%s)", mWorkerCount, AESDecrypt::getBackendName(AESDecrypt::getBestBackend()));
+}
+
+void *DecryptPool::workerThread(void *arg)
+{
+	JNIEnv *env = NULL;
+	mJVM->AttachCurrentThread(&env, NULL);
+
+	pthread_mutex_lock(&mLock);
+
+	for (;;)
+	{
+		while (mQueue.empty())
+			pthread_cond_wait(&mWorkCond, &mLock);
+
+		Job *job = mQueue.front();
+		int chunk = job->nextChunk++;
+		if (job->nextChunk == job->chunkCount)
+			mQueue.pop_front();
+		bool failed = job->failed;
+
+		pthread_mutex_unlock(&mLock);
+
+		if (!failed)
+		{
+			int64_t blockLength = job->length & ~(int64_t)(AESDecrypt::kBlockSize - 1);
+			int64_t start = chunk * kChunkSize;
+			int64_t length = blockLength - start < kChunkSize ? blockLength - start : kChunkSize;
+
+			CryptoRef ctx(job->cryptoHandle);
+			if (!ctx.get())
+				failed = true;
+			else if (chunk == 0)
+				ctx->decryptFromStart(job->data, length);
+			else
+				ctx->decrypt(job->data + start, length, &job->chunkIVs[chunk * AESDecrypt::kBlockSize]);
+		}
+
+		pthread_mutex_lock(&mLock);
+
+		if (failed)
+			job->failed = true;
+
+		if (--job->chunksLeft > 0)
+			continue;
+
+		if (!job->failed)
+		{
+			int64_t blockLength = job->length & ~(int64_t)(AESDecrypt::kBlockSize - 1);
+			job->result = job->length;
+			if (blockLength == job->length)
+				job->result -= AESDecrypt::getPaddingLength(job->data, job->length);
+		}
+		job->done = true;
+		pthread_cond_broadcast(&mDoneCond);
+
+		// Hand it straight to the native store if the demuxer is waiting on
+		// it; if not yet, Java hands it over when asked. Java leaves pending
+		// jobs to us, so a failed one has to let the store fall back to Java
+		// or the demuxer would wait on it forever.
+		pthread_mutex_unlock(&mLock);
+		if (!job->failed)
+			HLSSegmentCache::storeNativeSegment(env, job->uri.c_str(), job->buffer, job->result);
+		else
+			HLSSegmentCache::failNativeSegment(job->uri.c_str(), true);
+		pthread_mutex_lock(&mLock);
+
+		unref_l(env, job);
+	}
+
+	return NULL;
+}
+
+extern "C"
+{
+	jint Java_com_kaltura_hlsplayersdk_cache_SegmentCacheItem_submitDecrypt(JNIEnv *env, jobject caller, jint handle, jstring juri, jobject buffer, jlong length)
+	{
+		const char *uri = env->GetStringUTFChars(juri, 0);
+		int job = DecryptPool::submit(env, handle, uri, buffer, length);
+		env->ReleaseStringUTFChars(juri, uri);
+		return job;
+	}
+
+	jlong Java_com_kaltura_hlsplayersdk_cache_SegmentCacheItem_getDecryptResult(JNIEnv *env, jobject caller, jint job, jboolean wait)
+	{
+		return DecryptPool::getResult(job, wait);
+	}
+
+	void Java_com_kaltura_hlsplayersdk_cache_SegmentCacheItem_releaseDecrypt(JNIEnv *env, jobject caller, jint job)
+	{
+		DecryptPool::release(env, job);
+	}
+}
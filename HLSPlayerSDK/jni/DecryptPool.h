@@ -0,0 +1,132 @@
+#ifndef _DECRYPTPOOL_H_
+#define _DECRYPTPOOL_H_
+
+#include <jni.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "AESDecrypt.h"
+
+// Crypto contexts by handle, for the JNI entry points and the decrypt pool.
+//
+// Handles are spread over shards that each have their own lock, so lookups
+// from the pool workers and the Java threads rarely contend. Contexts are
+// reference counted; remove() hides a context straight away but it isn't
+// deleted until the last CryptoRef on it goes away.
+class CryptoRegistry
+{
+public:
+	static int add(AESDecrypt *ctx);
+	static void remove(int handle);
+
+	static AESDecrypt *acquire(int handle);
+	static void release(int handle);
+
+private:
+	struct Entry
+	{
+		AESDecrypt *ctx;
+		int refCount;
+		bool removed;
+	};
+
+	struct Shard
+	{
+		pthread_mutex_t lock;
+		std::map<int, Entry> entries;
+
+		Shard() { pthread_mutex_init(&lock, NULL); }
+	};
+
+	static const int kShardCount = 16;
+	static Shard mShards[kShardCount];
+	static volatile int mNextHandle;
+
+	static Shard &shardFor(int handle) { return mShards[(unsigned)handle % kShardCount]; }
+};
+
+// Scoped CryptoRegistry::acquire/release.
+class CryptoRef
+{
+public:
+	CryptoRef(int handle) : mHandle(handle), mCtx(CryptoRegistry::acquire(handle)) { }
+	~CryptoRef() { if (mCtx) CryptoRegistry::release(mHandle); }
+
+	AESDecrypt *get() const { return mCtx; }
+	AESDecrypt *operator->() const { return mCtx; }
+
+private:
+	int mHandle;
+	AESDecrypt *mCtx;
+};
+
+// Decrypts whole segments on a small pool of worker threads as soon as their
+// download completes, so playback reads find them already decrypted.
+//
+// Each segment is split into chunks with the IV of every chunk (the last
+// ciphertext block before it) saved up front, so one segment can be spread
+// over all the workers and decrypted in place. Segments the native store is
+// waiting on are handed to it by the worker that finishes them.
+class DecryptPool
+{
+public:
+	// Returned by getResult() for a job that hasn't finished.
+	static const int64_t kPending = -2;
+
+	// Queue length bytes of buffer (a direct ByteBuffer holding the segment
+	// ciphertext) for decryption. Returns a job id, or -1.
+	static int submit(JNIEnv *env, int cryptoHandle, const char *uri, jobject buffer, int64_t length);
+
+	// Size of the decrypted segment with padding removed, -1 on failure, or
+	// kPending if the job isn't done and wait is false.
+	static int64_t getResult(int job, bool wait);
+
+	// Forget a job. The buffer is let go once the workers are done with it.
+	static void release(JNIEnv *env, int job);
+
+private:
+	struct Job
+	{
+		int id;
+		std::string uri;
+		int cryptoHandle;
+		jobject buffer;				// Global ref.
+		unsigned char *data;
+		int64_t length;
+
+		int chunkCount;
+		int nextChunk;				// Next chunk to hand to a worker.
+		int chunksLeft;				// Chunks not yet decrypted.
+		std::vector<unsigned char> chunkIVs;
+
+		bool failed;
+		bool done;
+		int64_t result;
+		int refCount;				// The caller's, plus one while queued or storing.
+	};
+
+	typedef std::map<int, Job *> JobMap;
+
+	static pthread_mutex_t mLock;
+	static pthread_cond_t mWorkCond;
+	static pthread_cond_t mDoneCond;
+	static std::deque<Job *> mQueue;
+	static JobMap mJobs;
+	static int mNextJob;
+	static int mWorkerCount;
+	static JavaVM *mJVM;
+
+	static const int64_t kChunkSize = 128 * 1024;
+	static const int kMaxWorkers = 4;
+
+	static void startWorkers_l();
+	static void *workerThread(void *arg);
+	static void unref_l(JNIEnv *env, Job *job);
+};
+
+#endif
@@ -0,0 +1,186 @@
+#include <androidVideoShim.h>
+#include "FrameScheduler.h"
+#include "MonotonicWait.h"
+
+#include <time.h>
+
+// Audio positions further than this from where the clock thinks it is are
+// taken as a jump (seek, discontinuity, underrun) and re-anchor the clock.
+static const int64_t kClockResyncUs = 100000;
+
+// How far the clock may run past the last audio position it was given. Stops
+// video running on when audio stalls.
+static const int64_t kMaxExtrapolationUs = 100000;
+
+// Frames no later than this are never dropped, whatever the jitter.
+static const int64_t kMinDropThresholdUs = 20000;
+
+// Beyond this we're behind no matter what the jitter says.
+static const int64_t kMaxDropThresholdUs = 250000;
+
+// Render at least one frame in this many so the picture keeps moving even
+// when the decoder can't keep up.
+static const int kMaxConsecutiveDrops = 4;
+
+FrameScheduler::FrameScheduler() : mGeneration(0), mHasClock(false), mAnchorMediaUs(0), mAnchorRealUs(0),
+		mLastAudioUs(0), mJitterUs(0), mLastLateUs(0), mHasLateness(false), mConsecutiveDrops(0)
+{
+	// Plain (non recursive) mutex, we wait on it.
+	pthread_mutex_init(&mLock, NULL);
+	MonotonicCondInit(&mCond);
+}
+
+FrameScheduler::~FrameScheduler()
+{
+	pthread_cond_destroy(&mCond);
+	pthread_mutex_destroy(&mLock);
+}
+
+int64_t FrameScheduler::NowUs()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000ll + now.tv_nsec / 1000;
+}
+
+void FrameScheduler::Reset()
+{
+	AutoLock locker(&mLock, __func__);
+	mHasClock = false;
+	mHasLateness = false;
+	mJitterUs = 0;
+	mConsecutiveDrops = 0;
+	++mGeneration;
+	pthread_cond_broadcast(&mCond);
+}
+
+int64_t FrameScheduler::GetMediaTimeUs_l(int64_t nowUs)
+{
+	int64_t mediaUs = mAnchorMediaUs + (nowUs - mAnchorRealUs);
+	if (mediaUs > mLastAudioUs + kMaxExtrapolationUs)
+		mediaUs = mLastAudioUs + kMaxExtrapolationUs;
+	return mediaUs;
+}
+
+void FrameScheduler::UpdateClock(int64_t mediaTimeUs)
+{
+	int64_t nowUs = NowUs();
+	AutoLock locker(&mLock, __func__);
+
+	if (!mHasClock)
+	{
+		mHasClock = true;
+		mAnchorMediaUs = mLastAudioUs = mediaTimeUs;
+		mAnchorRealUs = nowUs;
+		return;
+	}
+
+	// The head position only moves in steps, an unchanged value tells us
+	// nothing new.
+	if (mediaTimeUs == mLastAudioUs)
+		return;
+
+	int64_t predictedUs = GetMediaTimeUs_l(nowUs);
+	int64_t diffUs = mediaTimeUs - predictedUs;
+	mLastAudioUs = mediaTimeUs;
+
+	if (diffUs > 0 || diffUs < -kClockResyncUs)
+	{
+		// Audio is ahead of us, or somewhere else entirely: re-anchor.
+		LOGTIMING("Re-anchoring media clock: audio=%lld predicted=%lld", mediaTimeUs, predictedUs);
+		mAnchorMediaUs = mediaTimeUs;
+		mAnchorRealUs = nowUs;
+	}
+	// Slightly behind is just the head position lagging, keep running rather
+	// than step backwards.
+}
+
+bool FrameScheduler::HasClock()
+{
+	AutoLock locker(&mLock, __func__);
+	return mHasClock;
+}
+
+int64_t FrameScheduler::GetMediaTimeUs()
+{
+	int64_t nowUs = NowUs();
+	AutoLock locker(&mLock, __func__);
+	return mHasClock ? GetMediaTimeUs_l(nowUs) : 0;
+}
+
+int64_t FrameScheduler::GetDueTimeUs(int64_t mediaTimeUs)
+{
+	int64_t nowUs = NowUs();
+	AutoLock locker(&mLock, __func__);
+	if (!mHasClock)
+		return nowUs;
+
+	return nowUs + (mediaTimeUs - GetMediaTimeUs_l(nowUs));
+}
+
+int FrameScheduler::GetGeneration()
+{
+	AutoLock locker(&mLock, __func__);
+	return mGeneration;
+}
+
+void FrameScheduler::Interrupt()
+{
+	AutoLock locker(&mLock, __func__);
+	++mGeneration;
+	pthread_cond_broadcast(&mCond);
+}
+
+bool FrameScheduler::WaitUntil(int64_t dueUs, int generation)
+{
+	AutoLock locker(&mLock, __func__);
+
+	while (generation == mGeneration)
+	{
+		int64_t nowUs = NowUs();
+		if (nowUs >= dueUs)
+			return true;
+
+		MonotonicCondWait(&mCond, &mLock, dueUs - nowUs);
+	}
+
+	return false;
+}
+
+bool FrameScheduler::ShouldDrop(int64_t lateUs, int64_t frameDurationUs)
+{
+	AutoLock locker(&mLock, __func__);
+
+	if (mHasLateness)
+	{
+		int64_t deviationUs = lateUs - mLastLateUs;
+		if (deviationUs < 0)
+			deviationUs = -deviationUs;
+
+		// Don't let one long stall (segment switch, GC) blow the estimate up.
+		if (deviationUs > kMaxDropThresholdUs)
+			deviationUs = kMaxDropThresholdUs;
+
+		mJitterUs += (deviationUs - mJitterUs) / 16;
+	}
+	mLastLateUs = lateUs;
+	mHasLateness = true;
+
+	// Lateness within a frame plus twice the usual jitter is noise we'd
+	// only make worse by dropping.
+	int64_t thresholdUs = frameDurationUs + 2 * mJitterUs;
+	if (thresholdUs < kMinDropThresholdUs)
+		thresholdUs = kMinDropThresholdUs;
+	if (thresholdUs > kMaxDropThresholdUs)
+		thresholdUs = kMaxDropThresholdUs;
+
+	if (lateUs <= thresholdUs || mConsecutiveDrops >= kMaxConsecutiveDrops)
+	{
+		mConsecutiveDrops = 0;
+		return false;
+	}
+
+	LOGTIMING("Dropping frame: late=%lld threshold=%lld jitter=%lld", lateUs, thresholdUs, mJitterUs);
+	++mConsecutiveDrops;
+	return true;
+}
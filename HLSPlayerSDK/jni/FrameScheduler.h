@@ -0,0 +1,71 @@
+#ifndef _FRAMESCHEDULER_H_
+#define _FRAMESCHEDULER_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+ * FrameScheduler
+ *
+ * Decides when each decoded video frame goes on screen.
+ *
+ * The media clock is anchored to the audio head position every time
+ * UpdateClock() is given a new one and runs off CLOCK_MONOTONIC in between,
+ * so it never steps backwards on the coarse head position updates and
+ * doesn't cost a JNI call to read. WaitUntil() sleeps on a condition
+ * variable until a frame is due; Interrupt() (seek, pause, stop) wakes it
+ * early. ShouldDrop() keeps a rolling estimate of how much frame lateness
+ * jitters and only drops frames that are later than that explains.
+ *
+ * All methods are safe to call from any thread.
+ */
+class FrameScheduler
+{
+public:
+	FrameScheduler();
+	~FrameScheduler();
+
+	// Forget the clock anchor and jitter history and wake any waiter.
+	void Reset();
+
+	// Feed in the current audio position.
+	void UpdateClock(int64_t mediaTimeUs);
+	bool HasClock();
+	int64_t GetMediaTimeUs();
+
+	// Monotonic time (see NowUs) at which mediaTimeUs is due on screen.
+	int64_t GetDueTimeUs(int64_t mediaTimeUs);
+
+	// Generation changes on every Interrupt/Reset; pass what you saw when
+	// the frame was picked. Returns false if interrupted before dueUs.
+	int GetGeneration();
+	bool WaitUntil(int64_t dueUs, int generation);
+	void Interrupt();
+
+	// Called with how late (positive) or early a frame would be presented.
+	// Returns true if it should be dropped instead.
+	bool ShouldDrop(int64_t lateUs, int64_t frameDurationUs);
+
+	static int64_t NowUs();
+
+private:
+	pthread_mutex_t mLock;
+	pthread_cond_t mCond;
+	int mGeneration;
+
+	// Clock anchor: media time mAnchorMediaUs was current at mAnchorRealUs.
+	bool mHasClock;
+	int64_t mAnchorMediaUs;
+	int64_t mAnchorRealUs;
+	int64_t mLastAudioUs;
+
+	// Jitter estimate, RFC 3550 style: mean deviation of successive lateness.
+	int64_t mJitterUs;
+	int64_t mLastLateUs;
+	bool mHasLateness;
+	int mConsecutiveDrops;
+
+	int64_t GetMediaTimeUs_l(int64_t nowUs);
+};
+
+#endif /* _FRAMESCHEDULER_H_ */
@@ -37,6 +37,7 @@ using namespace android_video_shim;
 
 
 int SEGMENTS_TO_BUFFER = 2; // The number of segments to buffer in addition to the currently playing segment
+int DEMUX_WATERMARK_MS = 3000; // How far ahead of the decoders the demux threads keep the track queues
 
 // I did not add this to a class or a header because I don't expect it to be used in any other file
 // All the other timing is based off the audio
@@ -81,19 +82,11 @@ void* audio_thread_func(void* arg)
 	int refCount = audioTrack->addRef();
 	LOGI("mJAudioTrack refCount = %d", refCount);
 
-	int rval;
-	while ( audioTrack->refCount() > 1 &&  (rval = audioTrack->Update()) != AUDIOTHREAD_FINISH)
-	{
-		if (rval == AUDIOTHREAD_WAIT)
-		{
-			sched_yield();
-		}
-		else if(audioTrack->getBufferSize() > (44100/10))
-		{
-			//LOGI("Buffer full enough yielding");
-			sched_yield();
-		}
-	}
+	// Update() sleeps whenever there's nothing for it to do: on its command
+	// queue while paused, waiting for a source or letting the output drain,
+	// or in the track write itself.
+	while ( audioTrack->refCount() > 1 && audioTrack->Update() != AUDIOTHREAD_FINISH)
+		;
 
 	refCount = audioTrack->release();
 	JavaVM* jvm = gHLSPlayerSDK->getJVM();
@@ -104,6 +97,102 @@ void* audio_thread_func(void* arg)
 }
 
 
+// Runs an extractor's demux loop. arg is a heap allocated sp that keeps the
+// extractor alive until the loop returns; dropping it may destroy the
+// extractor here, which can call into Java to release segments.
+void* demux_thread_func(void* arg)
+{
+	LOGTRACE("%s", __func__);
+	LOGTHREAD("demux_thread_func STARTING");
+	sp<android::MPEG2TSExtractor>* extractor = (sp<android::MPEG2TSExtractor>*)arg;
+
+	status_t err = (*extractor)->demuxUntilStopped();
+	delete extractor;
+
+	JavaVM* jvm = gHLSPlayerSDK->getJVM();
+	if (jvm) jvm->DetachCurrentThread();
+	LOGI("demux thread finished err=%d", err);
+	LOGTHREAD("demux_thread_func ENDING");
+	return NULL;
+}
+
+// Extractors for the next cached data source. The MPEG2TSExtractor
+// constructor blocks until the first segment has been read, so they're
+// built on their own thread and the player only polls IsDone(). The thread
+// and the player each hold a reference and whoever lets go last deletes it;
+// the player may well be gone first.
+struct SwitchPreparation
+{
+	SwitchPreparation(const sp<HLSDataSource>& dataSource, const sp<HLSDataSource>& altAudioDataSource) :
+		dataSource(dataSource), altAudioDataSource(altAudioDataSource), videoIndex(-1), audioIndex(-1),
+		mDone(false), mRefs(2)
+	{
+		pthread_mutex_init(&mLock, NULL);
+	}
+
+	~SwitchPreparation()
+	{
+		pthread_mutex_destroy(&mLock);
+	}
+
+	void Build()
+	{
+		sp<android::MPEG2TSExtractor> main = new android::MPEG2TSExtractor(dataSource);
+		sp<android::MPEG2TSExtractor> altAudio;
+		if (altAudioDataSource.get()) altAudio = new android::MPEG2TSExtractor(altAudioDataSource);
+
+		AutoLock locker(&mLock, __func__);
+		extractor = main;
+		altAudioExtractor = altAudio;
+		mDone = true;
+	}
+
+	bool IsDone()
+	{
+		AutoLock locker(&mLock, __func__);
+		return mDone;
+	}
+
+	void Release()
+	{
+		pthread_mutex_lock(&mLock);
+		bool last = --mRefs == 0;
+		pthread_mutex_unlock(&mLock);
+		if (last) delete this;
+	}
+
+	sp<HLSDataSource> dataSource;
+	sp<HLSDataSource> altAudioDataSource;
+	sp<android::MPEG2TSExtractor> extractor;
+	sp<android::MPEG2TSExtractor> altAudioExtractor;
+
+	// The tracks that were queued, set once the player has checked them.
+	int videoIndex;
+	int audioIndex;
+
+private:
+	pthread_mutex_t mLock;
+	bool mDone;
+	int mRefs;
+};
+
+// Builds a SwitchPreparation, then drops this thread's reference to it,
+// which may release the extractors and data sources here.
+void* prepare_switch_thread_func(void* arg)
+{
+	LOGTRACE("%s", __func__);
+	LOGTHREAD("prepare_switch_thread_func STARTING");
+	SwitchPreparation* prep = (SwitchPreparation*)arg;
+
+	prep->Build();
+	prep->Release();
+
+	JavaVM* jvm = gHLSPlayerSDK->getJVM();
+	if (jvm) jvm->DetachCurrentThread();
+	LOGTHREAD("prepare_switch_thread_func ENDING");
+	return NULL;
+}
+
 HLSPlayer::HLSPlayer(JavaVM* jvm) : mExtractorFlags(0),
 mHeight(0), mWidth(0), mCropHeight(0), mCropWidth(0), mBitrate(0), mActiveAudioTrackIndex(-1),
 mVideoBuffer(NULL), mWindow(NULL), mSurface(NULL), mRenderedFrameCount(0),
@@ -114,7 +203,8 @@ mSegmentTimeOffset(0), mVideoFrameDelta(0), mLastVideoTimeUs(-1), mVideoStartDel
 mSegmentForTimeMethodID(NULL), mFrameCount(0), mDataSource(NULL), audioThread(0),
 mScreenHeight(0), mScreenWidth(0), mAudioPlayer(NULL), mStartTimeMS(0), mUseOMXRenderer(true),
 mNotifyFormatChangeComplete(NULL), mNotifyAudioTrackChangeComplete(NULL),
-mDroppedFrameIndex(0), mDroppedFrameLastSecond(0), mPostErrorID(NULL), mPadWidth(0)
+mDroppedFrameIndex(0), mDroppedFrameLastSecond(0), mPostErrorID(NULL), mPadWidth(0), mResizePending(false),
+mSeekTimeUs(-1), mLastBufferCheckMS(0), mWantsMoreSegments(true), mSwitch(NULL), mSwitchState(SWITCH_NONE)
 {
 	LOGTRACE("%s", __func__);
 	status_t status = mClient.connect();
@@ -122,6 +212,9 @@ mDroppedFrameIndex(0), mDroppedFrameLastSecond(0), mPostErrorID(NULL), mPadWidth
 	
 	int err = initRecursivePthreadMutex(&lock);
 	LOGI(" HLSPlayer mutex err = %d", err);
+
+	err = initRecursivePthreadMutex(&mRenderLock);
+	LOGI(" HLSPlayer render mutex err = %d", err);
 }
 
 HLSPlayer::~HLSPlayer()
@@ -144,6 +237,7 @@ void HLSPlayer::Close(JNIEnv* env)
 	}
 	if (mWindow)
 	{
+		AutoLock renderLocker(&mRenderLock, __func__);
 		ANativeWindow_release(mWindow);
 		mWindow = NULL;
 	}
@@ -165,8 +259,19 @@ void HLSPlayer::Reset()
 	Stop();
 	LogState();
 
+	// Wake Update if it's waiting to present a frame, then wait for it to
+	// let go of the decoder and window.
+	mScheduler.Reset();
+	AutoLock renderLocker(&mRenderLock, __func__);
+
 	ClearScreen();
 
+	mBufferController.Reset();
+	mABR.Reset();
+	mLastBufferCheckMS = 0;
+
+	ClearSeamlessSwitch();
+	StopDemuxThreads();
 	mDataSource.clear();
 	mAlternateAudioDataSource.clear();
 	mAudioTrack.clear();
@@ -220,6 +325,23 @@ int HLSPlayer::GetSegmentCountToBuffer()
 	return SEGMENTS_TO_BUFFER;
 }
 
+void HLSPlayer::SetDemuxWatermarkMS(int watermarkMS)
+{
+	AutoLock locker(&lock, __func__);
+	LOGI("Setting demux watermark to %d ms", watermarkMS);
+	DEMUX_WATERMARK_MS = watermarkMS;
+
+	if (mExtractor != NULL)
+		mExtractor->setBufferWatermarkUs(DEMUX_WATERMARK_MS * 1000ll);
+	if (mAlternateAudioExtractor != NULL)
+		mAlternateAudioExtractor->setBufferWatermarkUs(DEMUX_WATERMARK_MS * 1000ll);
+}
+
+int HLSPlayer::GetDemuxWatermarkMS()
+{
+	return DEMUX_WATERMARK_MS;
+}
+
 ///
 /// Set Surface. Takes a java surface object
 ///
@@ -441,6 +563,8 @@ void HLSPlayer::SetNativeWindow(::ANativeWindow* window)
 	LOGTRACE("%s", __func__);
 	AutoLock locker(&lock, __func__);
 
+	AutoLock renderLocker(&mRenderLock, __func__);
+
 	LOGI("window = %p", window);
 	if (mWindow)
 	{
@@ -461,7 +585,7 @@ sp<HLSDataSource> MakeHLSDataSource()
 	return ds;
 }
 
-status_t HLSPlayer::FeedSegment(const char* path, int32_t quality, int continuityEra, const char* altAudioPath, int audioIndex, double time, int cryptoId, int altAudioCryptoId )
+status_t HLSPlayer::FeedSegment(const char* path, int32_t quality, int continuityEra, const char* altAudioPath, int audioIndex, double time, double duration, int cryptoId, int altAudioCryptoId )
 {
 	LOGTRACE("%s", __func__);
 	AutoLock locker(&lock, __func__);
@@ -469,6 +593,11 @@ status_t HLSPlayer::FeedSegment(const char* path, int32_t quality, int continuit
 
 	bool sameEra = false;
 
+	// Java feeds one segment per request, so the cached WantsMoreSegments
+	// answer is stale now; without this a single check window could pull
+	// in a segment per frame and overshoot the high watermark.
+	mLastBufferCheckMS = 0;
+
 	if (mDataSource == NULL)
 	{
 		LOGI("Creating New Datasource");
@@ -503,12 +632,12 @@ status_t HLSPlayer::FeedSegment(const char* path, int32_t quality, int continuit
 	{
 		if (GetState() == WAITING_ON_DATA && noCurrentSegments)
 		{
-			RestartPlayer(path, quality, continuityEra, altAudioPath, audioIndex, time, cryptoId, altAudioCryptoId);
+			RestartPlayer(path, quality, continuityEra, altAudioPath, audioIndex, time, duration, cryptoId, altAudioCryptoId);
 			return OK;
 		}
 		LOGI("Same Era!");
 		// Yay! We can just append!
-		err = mDataSource->append(path, quality, continuityEra, time, cryptoId);
+		err = mDataSource->append(path, quality, continuityEra, time, duration, cryptoId);
 		if (err == INFO_DISCONTINUITY)
 		{
 			LOGE("Could not append to data source! This shouldn't happen as we already checked the validity of the append.");
@@ -516,7 +645,7 @@ status_t HLSPlayer::FeedSegment(const char* path, int32_t quality, int continuit
 
 		if (mAlternateAudioDataSource.get() && altAudioPath)
 		{
-			err = mAlternateAudioDataSource->append(altAudioPath, audioIndex, 0, time, altAudioCryptoId);
+			err = mAlternateAudioDataSource->append(altAudioPath, audioIndex, 0, time, duration, altAudioCryptoId);
 			if (err == INFO_DISCONTINUITY)
 			{
 				LOGE("Could not append to alternate audio data source! This shouldn't happen as we already checked the validity of the append.");
@@ -533,7 +662,7 @@ status_t HLSPlayer::FeedSegment(const char* path, int32_t quality, int continuit
 		if (mDataSourceCache.size() > 0 && mDataSourceCache.back().isSameEra(quality, continuityEra, audioIndex))
 		{
 			LOGI("Adding to end of existing era");
-			err = mDataSourceCache.back().dataSource->append(path, quality, continuityEra, time, cryptoId);
+			err = mDataSourceCache.back().dataSource->append(path, quality, continuityEra, time, duration, cryptoId);
 			if (err == INFO_DISCONTINUITY)
 			{
 				LOGE("Could not append to data source! This shouldn't happen as we already checked the validity of the append.");
@@ -541,7 +670,7 @@ status_t HLSPlayer::FeedSegment(const char* path, int32_t quality, int continuit
 
 			if (mDataSourceCache.back().altAudioDataSource.get() && altAudioPath)
 			{
-				err = mDataSourceCache.back().altAudioDataSource->append(altAudioPath, audioIndex, 0, time, altAudioCryptoId);
+				err = mDataSourceCache.back().altAudioDataSource->append(altAudioPath, audioIndex, 0, time, duration, altAudioCryptoId);
 				if (err == INFO_DISCONTINUITY)
 				{
 					LOGE("Could not append to alternate audio data source! This shouldn't happen as we already checked the validity of the append.");
@@ -553,11 +682,11 @@ status_t HLSPlayer::FeedSegment(const char* path, int32_t quality, int continuit
 			LOGI("Making New Datasource!");
 			DataSourceCacheObject dsc;
 			dsc.dataSource = MakeHLSDataSource();
-			dsc.dataSource->append(path, quality, continuityEra, time, cryptoId);
+			dsc.dataSource->append(path, quality, continuityEra, time, duration, cryptoId);
 			if (altAudioPath != NULL)
 			{
 				dsc.altAudioDataSource = MakeHLSDataSource();
-				dsc.altAudioDataSource->append(altAudioPath, audioIndex, 0, time, altAudioCryptoId);
+				dsc.altAudioDataSource->append(altAudioPath, audioIndex, 0, time, duration, altAudioCryptoId);
 			}
 			mDataSourceCache.push_back(dsc);
 		}
@@ -584,6 +713,8 @@ bool HLSPlayer::InitTracks()
 	LOGI("Entered: mDataSource=%p", mDataSource.get());
 	if (!mDataSource.get()) return false;
 
+	StopDemuxThreads();
+
 	LOGI("Creating internal MEPG2 TS media extractor");
 	mExtractor = new android::MPEG2TSExtractor(mDataSource);
 	if (mExtractor == NULL)
@@ -753,15 +884,283 @@ bool HLSPlayer::InitTracks()
 
 	LOGI("Initialized tracks: mVideoTrack=%p mVideoTrack23=%p mAudioTrack=%p mAudioTrack23=%p", mVideoTrack.get(), mVideoTrack23.get(), mAudioTrack.get(), mAudioTrack23.get());
 
+	// Seeking happens in the demuxer, which finds the IDR frame before the target
+	// and drops what the decoders don't need, so ReadUntilTime has little to decode.
+	if (mSeekTimeUs >= 0)
+	{
+		LOGI("Seeking extractors to %lld us", mSeekTimeUs);
+		mExtractor->seekTo(mSeekTimeUs);
+		if (mAlternateAudioExtractor != NULL) mAlternateAudioExtractor->seekTo(mSeekTimeUs);
+		mSeekTimeUs = -1;
+	}
+
+	// From here on the decoders only dequeue; TS parsing and segment reads
+	// happen on the demux threads.
+	StartDemuxThread(mExtractor);
+	StartDemuxThread(mAlternateAudioExtractor);
+
 	return true;
 }
 
+void HLSPlayer::StartDemuxThread(sp<android::MPEG2TSExtractor>& extractor)
+{
+	LOGTRACE("%s", __func__);
+	if (extractor == NULL) return;
+
+	extractor->setBufferWatermarkUs(DEMUX_WATERMARK_MS * 1000ll);
+
+	// Switch reads over to dequeuing before the thread can start parsing, so
+	// the two never feed the parser at once, and so a StopDemuxThreads that
+	// comes in before the thread gets going isn't undone.
+	extractor->startDemuxing();
+
+	pthread_t demuxThread;
+	sp<android::MPEG2TSExtractor>* ref = new sp<android::MPEG2TSExtractor>(extractor);
+	if (pthread_create(&demuxThread, NULL, demux_thread_func, (void*)ref) != 0)
+	{
+		// Reads keep demuxing on the calling thread, as before.
+		LOGE("Failed to start demux thread for extractor %p", extractor.get());
+		extractor->cancelDemuxing();
+		delete ref;
+		return;
+	}
+
+	// The thread holds its own reference and is never joined; StopDemuxThreads
+	// only asks it to return.
+	pthread_detach(demuxThread);
+}
+
+void HLSPlayer::StopDemuxThreads()
+{
+	LOGTRACE("%s", __func__);
+	if (mExtractor != NULL) mExtractor->stopDemuxing();
+	if (mAlternateAudioExtractor != NULL) mAlternateAudioExtractor->stopDemuxing();
+}
+
+// Quality switches within a continuity era don't need the decoders torn
+// down when the new formats match the old: PTS carries on across levels
+// and the tracks can read straight on from the new extractors, with the
+// new SPS/PPS sent in band. Called from SelectFrame while playing, this
+// moves the next cached data source through preparing, queueing and
+// finally committing once the video track has moved over. Anything that
+// doesn't fit, or isn't ready by the time the current source runs out,
+// goes through ApplyFormatChange as before.
+void HLSPlayer::UpdateSeamlessSwitch()
+{
+	LOGTRACE("%s", __func__);
+	if (mDataSource == NULL || mDataSourceCache.size() == 0) return;
+
+	const DataSourceCacheObject& next = mDataSourceCache.front();
+
+	if (mSwitchState == SWITCH_NONE)
+	{
+		// A new era can change anything, and its timestamps start over.
+		if (next.dataSource->getContinuityEra() != mDataSource->getContinuityEra()) return;
+
+		SwitchPreparation* prep = new SwitchPreparation(next.dataSource, next.altAudioDataSource);
+
+		pthread_t prepareThread;
+		if (pthread_create(&prepareThread, NULL, prepare_switch_thread_func, (void*)prep) != 0)
+		{
+			LOGE("Failed to start switch preparation thread");
+			delete prep;
+			mSwitchState = SWITCH_REJECTED;
+			return;
+		}
+		pthread_detach(prepareThread);
+
+		LOGI("Preparing switch to quality %d", next.dataSource->getQualityLevel());
+		mSwitch = prep;
+		mSwitchState = SWITCH_PREPARING;
+		return;
+	}
+
+	if (mSwitch == NULL || mSwitch->dataSource != next.dataSource) return;
+
+	if (mSwitchState == SWITCH_PREPARING)
+	{
+		if (!mSwitch->IsDone()) return;
+
+		if (QueueSeamlessSwitch())
+		{
+			mSwitchState = SWITCH_QUEUED;
+		}
+		else
+		{
+			LOGI("Formats differ, switching to quality %d will restart the decoders", next.dataSource->getQualityLevel());
+			mSwitchState = SWITCH_REJECTED;
+		}
+	}
+	else if (mSwitchState == SWITCH_QUEUED)
+	{
+		sp<android::MPEG2TSExtractor> current;
+		if (mVideoTrack.get())
+			current = android::MPEG2TSExtractor::getTrackExtractor(mVideoTrack.get());
+		else
+			current = android::MPEG2TSExtractor::getTrackExtractor23(mVideoTrack23.get());
+
+		if (current == mSwitch->extractor) CommitSeamlessSwitch();
+	}
+}
+
+static bool SameFormat(const sp<MetaData>& a, const sp<MetaData>& b, bool video)
+{
+	if (a == NULL || b == NULL) return a == b;
+
+	const char* mimeA;
+	const char* mimeB;
+	if (!a->findCString(kKeyMIMEType, &mimeA) || !b->findCString(kKeyMIMEType, &mimeB)) return false;
+	if (strcasecmp(mimeA, mimeB)) return false;
+
+	if (video)
+	{
+		// The output buffers and the renderer are sized for these.
+		int32_t wA, hA, wB, hB;
+		if (!a->findInt32(kKeyWidth, &wA) || !a->findInt32(kKeyHeight, &hA)) return false;
+		if (!b->findInt32(kKeyWidth, &wB) || !b->findInt32(kKeyHeight, &hB)) return false;
+		if (wA != wB || hA != hB) return false;
+
+		// Same profile and level, so the decoder as configured can take it.
+		if (!strcasecmp(mimeA, MEDIA_MIMETYPE_VIDEO_AVC))
+		{
+			uint32_t type;
+			const uint8_t* avccA;
+			const uint8_t* avccB;
+			size_t sizeA, sizeB;
+			if (!a->findData(kKeyAVCC, &type, (const void**)&avccA, &sizeA)) return false;
+			if (!b->findData(kKeyAVCC, &type, (const void**)&avccB, &sizeB)) return false;
+			if (sizeA < 4 || sizeB < 4) return false;
+			if (avccA[1] != avccB[1] || avccA[3] != avccB[3]) return false;
+		}
+	}
+	else
+	{
+		int32_t rateA, rateB, channelsA, channelsB;
+		if (!a->findInt32(kKeySampleRate, &rateA) || !b->findInt32(kKeySampleRate, &rateB)) return false;
+		if (!a->findInt32(kKeyChannelCount, &channelsA) || !b->findInt32(kKeyChannelCount, &channelsB)) return false;
+		if (rateA != rateB || channelsA != channelsB) return false;
+	}
+
+	return true;
+}
+
+static int FindTrack(const sp<android::MPEG2TSExtractor>& extractor, const char* mimePrefix)
+{
+	if (extractor == NULL) return -1;
+
+	for (size_t i = 0; i < extractor->countTracks(); ++i)
+	{
+		const char* mime;
+		if (extractor->getTrackMetaData(i)->findCString(kKeyMIMEType, &mime) && !strncasecmp(mime, mimePrefix, 6))
+			return i;
+	}
+	return -1;
+}
+
+// Checks the prepared extractors against the current tracks and, if the
+// decoders can carry on into them, starts them demuxing and queues them
+// behind the current tracks.
+bool HLSPlayer::QueueSeamlessSwitch()
+{
+	LOGTRACE("%s", __func__);
+	if (mSwitch->extractor == NULL) return false;
+
+	// Audio comes from the alternate audio extractor if there is one.
+	if ((mAlternateAudioExtractor != NULL) != (mSwitch->altAudioExtractor != NULL)) return false;
+	sp<android::MPEG2TSExtractor> audioExtractor = mSwitch->altAudioExtractor != NULL ? mSwitch->altAudioExtractor : mSwitch->extractor;
+
+	int videoIndex = FindTrack(mSwitch->extractor, "video/");
+	int audioIndex = FindTrack(audioExtractor, "audio/");
+	if (videoIndex < 0) return false;
+
+	sp<MetaData> videoMeta = mSwitch->extractor->getTrackMetaData(videoIndex);
+	sp<MetaData> audioMeta = audioIndex >= 0 ? audioExtractor->getTrackMetaData(audioIndex) : NULL;
+	if (!SameFormat(mVideoTrack_md, videoMeta, true) || !SameFormat(mAudioTrack_md, audioMeta, false)) return false;
+
+	StartDemuxThread(mSwitch->extractor);
+	StartDemuxThread(mSwitch->altAudioExtractor);
+
+	if (mVideoTrack.get())
+	{
+		android::MPEG2TSExtractor::setNextTrack(mVideoTrack.get(), mSwitch->extractor, videoIndex);
+		if (audioIndex >= 0) android::MPEG2TSExtractor::setNextTrack(mAudioTrack.get(), audioExtractor, audioIndex);
+	}
+	else
+	{
+		android::MPEG2TSExtractor::setNextTrack23(mVideoTrack23.get(), mSwitch->extractor, videoIndex);
+		if (audioIndex >= 0) android::MPEG2TSExtractor::setNextTrack23(mAudioTrack23.get(), audioExtractor, audioIndex);
+	}
+
+	mSwitch->videoIndex = videoIndex;
+	mSwitch->audioIndex = audioIndex;
+
+	LOGI("Queued switch to quality %d on extractor %p", mSwitch->dataSource->getQualityLevel(), mSwitch->extractor.get());
+	return true;
+}
+
+// The video track has moved over to the prepared extractor, so it and its
+// data source become the current ones, as ApplyFormatChange would leave
+// them but with the decoders and clock untouched. Audio follows on its own
+// when its current source runs out.
+void HLSPlayer::CommitSeamlessSwitch()
+{
+	LOGTRACE("%s", __func__);
+	int curQuality = mDataSource->getQualityLevel();
+	int curAudioTrack = -1;
+	if (mAlternateAudioDataSource.get()) curAudioTrack = mAlternateAudioDataSource->getQualityLevel();
+
+	mDataSource = mSwitch->dataSource;
+	mAlternateAudioDataSource = mSwitch->altAudioDataSource;
+	mDataSourceCache.pop_front();
+
+	mExtractor = mSwitch->extractor;
+	mAlternateAudioExtractor = mSwitch->altAudioExtractor;
+	mVideoTrack_md = mExtractor->getTrackMetaData(mSwitch->videoIndex);
+	if (mSwitch->audioIndex >= 0)
+	{
+		sp<android::MPEG2TSExtractor> audioExtractor = mAlternateAudioExtractor != NULL ? mAlternateAudioExtractor : mExtractor;
+		mAudioTrack_md = audioExtractor->getTrackMetaData(mSwitch->audioIndex);
+		mActiveAudioTrackIndex = mSwitch->audioIndex;
+	}
+
+	mSwitch->Release();
+	mSwitch = NULL;
+	mSwitchState = SWITCH_NONE;
+
+	mDataSource->logContinuityInfo();
+
+	int newQuality = mDataSource->getQualityLevel();
+	int newAudioTrack = -1;
+	if (mAlternateAudioDataSource.get()) newAudioTrack = mAlternateAudioDataSource->getQualityLevel();
+
+	LOGI("Switched from quality %d to %d without restarting the decoders", curQuality, newQuality);
+	NotifyFormatChange(curQuality, newQuality, curAudioTrack, newAudioTrack);
+}
+
+// Drops any switch in progress. One that was queued is stopped, so the
+// tracks end rather than move over.
+void HLSPlayer::ClearSeamlessSwitch()
+{
+	LOGTRACE("%s", __func__);
+	if (mSwitch != NULL)
+	{
+		if (mSwitchState == SWITCH_QUEUED)
+		{
+			mSwitch->extractor->stopDemuxing();
+			if (mSwitch->altAudioExtractor != NULL) mSwitch->altAudioExtractor->stopDemuxing();
+		}
+		mSwitch->Release();
+		mSwitch = NULL;
+	}
+	mSwitchState = SWITCH_NONE;
+}
+
 bool HLSPlayer::CreateAudioPlayer()
 {
 	LOGTRACE("%s", __func__);
 	AutoLock locker(&lock, __func__);
 	LOGI("Constructing Audio Player");
-	mAudioPlayer = MakeAudioPlayer(mJvm, USE_OMX_AUDIO);
+	mAudioPlayer = MakeAudioPlayer(mJvm, USE_OMX_AUDIO, USE_OPENSL_AUDIO);
 	if (!mAudioPlayer)
 		return false;
 
@@ -910,10 +1309,17 @@ bool HLSPlayer::InitSources()
 			LOGI("OMXCodec::Create - failed to use google decoder, relying on system...");
 			mVideoSource = OMXCodec::Create(iomx, vidFormat, false, mVideoTrack, NULL, 0);
 		}
+		if(!mVideoSource.get() && CodecReaper::Get().GetPendingCount() > 0)
+		{
+			// The decoder we just retired may still be holding the hardware.
+			LOGI("OMXCodec::Create - failed with codecs still being torn down, waiting for them and retrying");
+			CodecReaper::Get().WaitForIdle();
+			mVideoSource = OMXCodec::Create(iomx, vidFormat, false, mVideoTrack, NULL, 0);
+		}
 		LOGI("   - got %p back", mVideoSource.get());
 		const char* decoder;
-		mVideoSource->getFormat()->findCString(kKeyDecoderComponent, &decoder);
-		if (!strcasecmp(decoder, "OMX.qcom.video.decoder.avc"))
+		if (mVideoSource.get() && mVideoSource->getFormat()->findCString(kKeyDecoderComponent, &decoder)
+				&& !strcasecmp(decoder, "OMX.qcom.video.decoder.avc"))
 		{
 			mPadWidth = 64;
 			LOGI("Padding width to %d for decoder %s", mPadWidth, decoder);
@@ -932,6 +1338,12 @@ bool HLSPlayer::InitSources()
 			LOGI("OMXCodec::Create - failed to use google decoder, relying on system...");
 			mVideoSource23 = OMXCodec::Create23(iomx, vidFormat, false, mVideoTrack23, NULL, 0);
 		}
+		if(!mVideoSource23.get() && CodecReaper::Get().GetPendingCount() > 0)
+		{
+			LOGI("OMXCodec::Create - failed with codecs still being torn down, waiting for them and retrying");
+			CodecReaper::Get().WaitForIdle();
+			mVideoSource23 = OMXCodec::Create23(iomx, vidFormat, false, mVideoTrack23, NULL, 0);
+		}
 		LOGV("   - got %p back", mVideoSource23.get());
 	}
 	
@@ -1170,9 +1582,202 @@ int HLSPlayer::GetBufferedSegmentCount()
 	return segCount;
 }
 
+#define BUFFER_CHECK_INTERVAL_MS 250
+
+/*
+ * WantsMoreSegments
+ *
+ * 	Seconds buffered ahead of playback are what's demuxed and queued on the
+ * 	tracks plus what's still unread in the data sources. With alternate
+ * 	audio, the side with less counts. Segments waiting on a discontinuity
+ * 	in mDataSourceCache add on top.
+ *
+ * 	The BufferController decides from that level. If any segment came in
+ * 	without a duration, falls back to counting segments against
+ * 	SEGMENTS_TO_BUFFER.
+ *
+ * 	Walking the sources takes their locks, so this is only done every
+ * 	BUFFER_CHECK_INTERVAL_MS; in between the last answer is returned.
+ *
+ */
+bool HLSPlayer::WantsMoreSegments()
+{
+	AutoLock locker(&lock, __func__);
+
+	uint32_t now = getTimeMS();
+	if (mLastBufferCheckMS != 0 && now - mLastBufferCheckMS < BUFFER_CHECK_INTERVAL_MS)
+		return mWantsMoreSegments;
+	mLastBufferCheckMS = now;
+
+	bool known = mDataSource.get() != NULL;
+	double buffered = 0;
+
+	if (known)
+	{
+		double unread = 0;
+		known = ((HLSDataSource*) mDataSource.get())->getUnreadDuration(&unread);
+		buffered = unread;
+		if (mExtractor.get())
+			buffered += mExtractor->getBufferedDurationUs() / 1000000.0;
+	}
+
+	if (known && mAlternateAudioDataSource.get())
+	{
+		double unread = 0;
+		known = ((HLSDataSource*) mAlternateAudioDataSource.get())->getUnreadDuration(&unread);
+		if (mAlternateAudioExtractor.get())
+			unread += mAlternateAudioExtractor->getBufferedDurationUs() / 1000000.0;
+		if (unread < buffered)
+			buffered = unread;
+	}
+
+	DATASRC_CACHE::iterator cur = mDataSourceCache.begin();
+	DATASRC_CACHE::iterator end = mDataSourceCache.end();
+	while (known && cur != end)
+	{
+		double unread = 0;
+		known = (*cur).dataSource->getUnreadDuration(&unread);
+		buffered += unread;
+		++cur;
+	}
+
+	if (known)
+	{
+		mWantsMoreSegments = mBufferController.Update(buffered);
+		LOGV("Buffered %f seconds, %s", buffered, mWantsMoreSegments ? "filling" : "full");
+	}
+	else
+	{
+		mWantsMoreSegments = GetBufferedSegmentCount() < SEGMENTS_TO_BUFFER;
+	}
+
+	return mWantsMoreSegments;
+}
+
+void HLSPlayer::SetBufferWatermarks(double lowSeconds, double highSeconds)
+{
+	LOGI("Setting buffer watermarks to %f - %f seconds", lowSeconds, highSeconds);
+	mBufferController.SetWatermarks(lowSeconds, highSeconds);
+	mABR.SetBufferTarget(mBufferController.GetHighWatermark());
+	mLastBufferCheckMS = 0;
+}
+
+double HLSPlayer::GetLowBufferWatermark()
+{
+	return mBufferController.GetLowWatermark();
+}
+
+double HLSPlayer::GetHighBufferWatermark()
+{
+	return mBufferController.GetHighWatermark();
+}
+
+double HLSPlayer::GetBufferedSeconds()
+{
+	return mBufferController.GetBufferedSeconds();
+}
+
+void HLSPlayer::SetABRLadder(const int* bitrates, int count)
+{
+	LOGI("Setting ABR ladder, %d levels", count);
+	mABR.SetLadder(bitrates, count);
+	mABR.SetBufferTarget(mBufferController.GetHighWatermark());
+}
+
+void HLSPlayer::SetABRMode(int mode)
+{
+	LOGI("Setting ABR mode to %s", ABREngine::GetModeName((ABREngine::Mode)mode));
+	mABR.SetMode((ABREngine::Mode)mode);
+}
+
+void HLSPlayer::NoteSegmentDownload(int64_t bytes, double seconds)
+{
+	mABR.AddSample(bytes, seconds);
+	LOGV("Downloaded %lld bytes in %f seconds, throughput estimate %f bps", bytes, seconds, mABR.GetThroughput());
+}
+
+/*
+ * SelectQuality
+ *
+ * 	The quality level ABR wants the next segment at, from the download
+ * 	rates seen so far and the buffer level WantsMoreSegments last saw.
+ *
+ */
+int HLSPlayer::SelectQuality(int currentQuality)
+{
+	int quality = mABR.SelectQuality(currentQuality, mBufferController.GetBufferedSeconds());
+	if (quality != currentQuality)
+		LOGI("ABR: %d -> %d (buffered %f s, throughput %f bps)", currentQuality, quality,
+				mBufferController.GetBufferedSeconds(), mABR.GetThroughput());
+	return quality;
+}
+
+double HLSPlayer::GetThroughputEstimate()
+{
+	return mABR.GetThroughput();
+}
+
 long lastTouchTimeMS = 0;
 
 int HLSPlayer::Update()
+{
+	LOGTRACE("%s", __func__);
+
+	MediaBuffer* frame = NULL;
+	int64_t dueUs = -1;
+	int generation = 0;
+	int rval = SelectFrame(&frame, &dueUs, &generation);
+
+	if (dueUs < 0)
+		return rval;
+
+	// Nothing below holds lock, so Seek, Pause and FeedSegment callers aren't
+	// kept waiting while we sleep towards the frame's due time.
+	bool onTime = mScheduler.WaitUntil(dueUs, generation);
+	if (!frame)
+		return rval;
+
+	// SelectFrame left mRenderLock held for us.
+	bool rendered = false;
+	if (onTime)
+	{
+		rendered = RenderBuffer(frame);
+		if (rendered)
+		{
+			++mRenderedFrameCount;
+			LOGV("mRenderedFrameCount = %d", mRenderedFrameCount);
+		}
+	}
+	frame->release();
+	pthread_mutex_unlock(&mRenderLock);
+
+	if (mResizePending)
+	{
+		mResizePending = false;
+		NoteHWRendererMode(mUseOMXRenderer, mWidth, mHeight, 4);
+	}
+
+	if (!onTime)
+	{
+		LOGI("Frame wait interrupted, discarding frame");
+		return 0;
+	}
+
+	if (!rendered)
+	{
+		LOGI("Render Buffer returned false: STOPPING");
+		SetState(CUE_STOP);
+		return -1;
+	}
+
+	return rval;
+}
+
+// Does everything Update needs lock for: state handling, segment requests,
+// pulling frames from the decoder and dropping late ones. Either hands back
+// a frame to present at *dueUs (with mRenderLock held), or just a time to
+// wait until before trying again, or neither.
+int HLSPlayer::SelectFrame(MediaBuffer** frame, int64_t* dueUs, int* generation)
 {
 	LOGTRACE("%s", __func__);
 	AutoLock locker(&lock, __func__);
@@ -1216,11 +1821,9 @@ int HLSPlayer::Update()
 	{
 		if (mDataSource != NULL)
 		{
-			int segCount = GetBufferedSegmentCount();
-
-			if (segCount < SEGMENTS_TO_BUFFER)
+			if (WantsMoreSegments())
 			{
-				//LOGI("**** WAITING_ON_DATA: Requesting next segment... bufferedSegments: %d", segCount);
+				//LOGI("**** WAITING_ON_DATA: Requesting next segment... bufferedSegments: %d", GetBufferedSegmentCount());
 				RequestNextSegment();
 			}
 		}
@@ -1261,14 +1864,15 @@ int HLSPlayer::Update()
 
 	if (mDataSource != NULL)
 	{
-		int segCount = GetBufferedSegmentCount();
-		LOGV("Segment Count %d, checking buffers...", segCount);
-		if (segCount < SEGMENTS_TO_BUFFER)
+		LOGV("Segment Count %d, checking buffers...", GetBufferedSegmentCount());
+		if (WantsMoreSegments())
 		{
 			RequestNextSegment();
 		}
 	}
 
+	UpdateSeamlessSwitch();
+
 
 	bool rval = -1;
 	for (;;)
@@ -1385,20 +1989,26 @@ int HLSPlayer::Update()
 
 			LOGTIMING("audioTime = %lld | videoTime = %lld | diff = %lld | mVideoFrameDelta = %lld", audioTime, timeUs, audioTime - timeUs, mVideoFrameDelta);
 
-			int64_t delta = (audioTime + mVideoStartDelta) - timeUs;
-
 			mLastVideoTimeUs = timeUs;
-			if (delta < -10000) // video is running ahead
+
+			// Work out when this frame is due from the media clock rather
+			// than comparing against the audio time directly.
+			mScheduler.UpdateClock(audioTime + mVideoStartDelta);
+			int64_t nowUs = FrameScheduler::NowUs();
+			int64_t frameDueUs = mScheduler.GetDueTimeUs(timeUs);
+
+			if (frameDueUs - nowUs > MAX_FRAME_WAIT_US) // video is running ahead
 			{
-				unsigned long sleepyTime = (-delta >  50000 ? 40000 : -10000 - delta);
-				LOGTIMING("Video is running ahead - waiting til next time : delta = %lld : sleeping %lld", delta, -10000 - delta);
-				//sched_yield();
-				usleep(sleepyTime);
-				break; // skip out - don't render it yet
+				// Keep the frame, doze for a bit outside the lock and look
+				// again; the clock may have moved by then.
+				LOGTIMING("Video is running ahead - waiting til next time : due in %lld", frameDueUs - nowUs);
+				*dueUs = nowUs + MAX_FRAME_WAIT_US;
+				*generation = mScheduler.GetGeneration();
+				break;
 			}
-			else if (delta > 40000) // video is running behind
+			else if (mScheduler.ShouldDrop(nowUs - frameDueUs, mVideoFrameDelta)) // video is running behind
 			{
-				LOGTIMING("Video is running behind - skipping frame : delta = %lld", delta);
+				LOGTIMING("Video is running behind - skipping frame : late by %lld", nowUs - frameDueUs);
 				// Do we need to catch up?
 				mVideoBuffer->release();
 				mVideoBuffer = NULL;
@@ -1407,25 +2017,16 @@ int HLSPlayer::Update()
 			}
 			else
 			{
-				LOGTIMING("audioTime = %lld | videoTime = %lld | diff = %lld | mVideoFrameDelta = %lld", audioTime, timeUs, audioTime - timeUs, mVideoFrameDelta);
-
-				// We appear to have a valid buffer?! and we're in time!
-				if (RenderBuffer(mVideoBuffer))
-				{
-					++mRenderedFrameCount;
-					rval = mRenderedFrameCount;
-					LOGV("mRenderedFrameCount = %d", mRenderedFrameCount);
-				}
-				else
-				{
-					LOGI("Render Buffer returned false: STOPPING");
-					SetState(CUE_STOP);
-					rval=-1;
-				}
-				mVideoBuffer->release();
+				// Hand the frame to Update to present at its due time. It
+				// renders under mRenderLock only; taking that here, before we
+				// let go of lock, means teardown can't free the decoder in
+				// between.
+				pthread_mutex_lock(&mRenderLock);
+				*frame = mVideoBuffer;
+				*dueUs = frameDueUs;
+				*generation = mScheduler.GetGeneration();
 				mVideoBuffer = NULL;
 				break;
-
 			}
 		}
 
@@ -1871,7 +2472,7 @@ bool HLSPlayer::RenderBuffer(MediaBuffer* buffer)
 				sched_yield();
 				mHeight = videoBufferHeight;
 				mWidth = videoBufferWidth;
-				NoteHWRendererMode(mUseOMXRenderer, mWidth, mHeight, 4);
+				mResizePending = true; // Update notes it once mRenderLock is released
 				return true;
 			}
 
@@ -2033,7 +2634,8 @@ bool HLSPlayer::RenderBuffer(MediaBuffer* buffer)
 					cc.convert(videoBits, ALIGN(videoBufferWidth, 32), ALIGN(videoBufferHeight, 32), a, b, c, d,
 					       pixels,  windowBuffer.stride, windowBuffer.height, a, b, c, d);
 				else if(lcc.isValid()) */
-					lcc.convertQCOMYUV420SemiPlanar(ALIGN(videoBufferWidth, 32), ALIGN(videoBufferHeight, 32), videoBits, 0, pixels, windowBuffer.stride * 2);
+					lcc.convertQCOMYUV420SemiPlanar(ALIGN(videoBufferWidth, 32), ALIGN(videoBufferHeight, 32), videoBits, 0, pixels, windowBuffer.stride * 2,
+							0, ALIGN(videoBufferHeight, 32));
 #undef ALIGN
 			}
 			else if(colf == OMX_COLOR_Format16bitRGB565)
@@ -2311,6 +2913,19 @@ void HLSPlayer::StopEverything()
 	mAudioSource23.clear();
 	if (mAudioPlayer) mAudioPlayer->Stop(true); // Passing true means we're seeking.
 
+	ClearSeamlessSwitch();
+	StopDemuxThreads();
+
+	// Whatever was buffered is about to be thrown away.
+	mBufferController.Reset();
+	mABR.Reset();
+	mLastBufferCheckMS = 0;
+
+	// As in Reset: wake any pending frame wait and keep Update out while
+	// the video decoder goes away.
+	mScheduler.Reset();
+	AutoLock renderLocker(&mRenderLock, __func__);
+
 	mAudioTrack.clear();
 	mAudioTrack23.clear();
 	mVideoTrack.clear();
@@ -2465,7 +3080,7 @@ void HLSPlayer::NotifyFormatChange(int curQuality, int newQuality, int curAudio,
 
 }
 
-void HLSPlayer::RestartPlayer(const char* path, int32_t quality, int continuityEra, const char* altAudioPath, int audioIndex, double time, int cryptoId, int altAudioCryptoId)
+void HLSPlayer::RestartPlayer(const char* path, int32_t quality, int continuityEra, const char* altAudioPath, int audioIndex, double time, double duration, int cryptoId, int altAudioCryptoId)
 {
 	LOGTRACE("%s", __func__);
 	AutoLock locker(&lock, __func__);
@@ -2482,7 +3097,7 @@ void HLSPlayer::RestartPlayer(const char* path, int32_t quality, int continuityE
 	mDataSourceCache.clear();
 	LOGI("Data sources cleared");
 
-	FeedSegment(path, quality, continuityEra, altAudioPath, audioIndex, time, cryptoId, altAudioCryptoId);
+	FeedSegment(path, quality, continuityEra, altAudioPath, audioIndex, time, duration, cryptoId, altAudioCryptoId);
 
 	if (!mDataSource.get())
 	{
@@ -2613,7 +3228,10 @@ void HLSPlayer::Seek(double time)
 
 	int segCount = ((HLSDataSource*) mDataSource.get())->getPreloadedSegmentCount();
 	LOGI("segCount=%d", segCount);
-	if (!InitSources())
+	mSeekTimeUs = (int64_t)(time * 1000000.0f);
+	bool initialized = InitSources();
+	mSeekTimeUs = -1;
+	if (!initialized)
 	{
 		LOGE("InitSources failed!");
 		SetState(CUE_STOP);
@@ -2729,7 +3347,6 @@ bool HLSPlayer::ReadUntilTime(double timeSecs)
 			mediaBuffer->release();
 			mediaBuffer = NULL;
 		}
-		sched_yield();
 	}
 
 	mLastVideoTimeUs = timeUs;
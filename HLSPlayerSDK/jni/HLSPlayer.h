@@ -18,11 +18,16 @@
 #include <unistd.h>
 
 #include "AudioPlayer.h"
+#include "FrameScheduler.h"
+#include "BufferController.h"
+#include "ABREngine.h"
+#include "CodecReaper.h"
 
 #include <pthread.h>
 #include <list>
 
 #define MAX_DROPPED_FRAME_SECONDS 5
+#define MAX_FRAME_WAIT_US 50000 // Longest Update sleeps before re-checking the clock
 
 namespace android
 {
@@ -30,6 +35,7 @@ namespace android
 }
 
 class HLSSegment;
+struct SwitchPreparation;
 
 class HLSPlayer
 {
@@ -41,9 +47,20 @@ public:
 	void Reset();
 
 	void SetSurface(JNIEnv* env, jobject surface);
-	android_video_shim::status_t FeedSegment(const char* path, int32_t quality, int continuityEra, const char* altAudioPath, int audioIndex, double time, int cryptoId, int altCryptoId );
+	android_video_shim::status_t FeedSegment(const char* path, int32_t quality, int continuityEra, const char* altAudioPath, int audioIndex, double time, double duration, int cryptoId, int altCryptoId );
 	void SetSegmentCountToBuffer(int segmentCount);
 	int GetSegmentCountToBuffer();
+	void SetBufferWatermarks(double lowSeconds, double highSeconds);
+	double GetLowBufferWatermark();
+	double GetHighBufferWatermark();
+	double GetBufferedSeconds();
+	void SetABRLadder(const int* bitrates, int count);
+	void SetABRMode(int mode);
+	void NoteSegmentDownload(int64_t bytes, double seconds);
+	int SelectQuality(int currentQuality);
+	double GetThroughputEstimate();
+	void SetDemuxWatermarkMS(int watermarkMS);
+	int GetDemuxWatermarkMS();
 
 	bool Play(double time);
 	void Stop();
@@ -81,13 +98,22 @@ private:
 	bool CreateAudioPlayer();
 	bool EnsureAudioPlayerCreatedAndSourcesSet();
 	bool CreateVideoPlayer();
+	int SelectFrame(android_video_shim::MediaBuffer** frame, int64_t* dueUs, int* generation);
 	bool RenderBuffer(android_video_shim::MediaBuffer* buffer);
 	void LogState();
-	void RestartPlayer(const char* path, int32_t quality, int continuityEra, const char* altAudioPath, int audioIndex, double time, int cryptoId, int altAudioCryptoId);
+	void RestartPlayer(const char* path, int32_t quality, int continuityEra, const char* altAudioPath, int audioIndex, double time, double duration, int cryptoId, int altAudioCryptoId);
 
 	bool InitTracks();
+	void StartDemuxThread(android_video_shim::sp<android::MPEG2TSExtractor>& extractor);
+	void StopDemuxThreads();
+
+	void UpdateSeamlessSwitch();
+	bool QueueSeamlessSwitch();
+	void CommitSeamlessSwitch();
+	void ClearSeamlessSwitch();
 
 	double RequestNextSegment(bool force = false);
+	bool WantsMoreSegments();
 
 	double RequestSegmentForTime(double time);
 	void NoteVideoDimensions();
@@ -183,6 +209,7 @@ private:
 	int64_t mVideoFrameDelta;
 	int64_t mVideoStartDelta; 		// The starting time offset of the video (used in comparing audio time to video time)
 	int64_t mFrameCount;
+	int64_t mSeekTimeUs;			// Where InitTracks should seek the new extractors to, -1 for nowhere
 
 	int32_t mScreenWidth;
 	int32_t mScreenHeight;
@@ -191,6 +218,36 @@ private:
 
 	pthread_mutex_t lock;
 
+	// Held while a frame is being waited on or rendered, and by anything
+	// that changes the window, renderer or video decoder. Always taken
+	// after lock, never before.
+	pthread_mutex_t mRenderLock;
+	FrameScheduler mScheduler;
+	bool mResizePending;
+
+	// Seconds of media buffered ahead of playback, and whether to ask for
+	// more; see WantsMoreSegments().
+	BufferController mBufferController;
+	uint32_t mLastBufferCheckMS;
+	bool mWantsMoreSegments;
+
+	// Picks the quality of the next segment for auto switching.
+	ABREngine mABR;
+
+	// Switching to the next cached data source without restarting the
+	// decoders, when its formats match the current ones. Its extractors are
+	// built ahead of time on another thread, then queued behind the current
+	// tracks so reads carry on into them; see UpdateSeamlessSwitch().
+	enum SwitchState
+	{
+		SWITCH_NONE,
+		SWITCH_PREPARING,	// mSwitch is being built
+		SWITCH_QUEUED,		// the tracks will move over when they run out
+		SWITCH_REJECTED		// formats differ, ApplyFormatChange will do it
+	};
+	SwitchPreparation* mSwitch;
+	SwitchState mSwitchState;
+
 	// DroppedFrameCounter
 	int mDroppedFrameCounts[MAX_DROPPED_FRAME_SECONDS]; // each int holds the count for a single second
 	int mDroppedFrameIndex;
@@ -202,26 +259,17 @@ private:
 //----------------------------
 // template method to clear OMX
 //
-// Requires an sp<MediaSource> or sp<MediaSource23> object
+// Requires an sp<MediaSource> or sp<MediaSource23> object. The codec is
+// stopped and destroyed on the CodecReaper thread; this doesn't wait.
 //
 template<typename T>
 void clearOMX(T& t)
 {
 	if (t.get())
 	{
-		LOGI("Stopping && Clearing OMX %p", t.get());
-		t->stop();
-
-		android_video_shim::wp<android_video_shim::RefBase> tmp = NULL;
-
-		tmp = t;
-
+		LOGI("Retiring OMX %p", t.get());
+		CodecReaper::Get().Retire(t);
 		t.clear();
-
-		while (tmp.promote() != NULL)
-		{
-			usleep(1000);
-		}
 	}
 }
 
@@ -10,7 +10,8 @@
 #include <android/native_window.h>
 #include <android/native_window_jni.h>
 
-#include "aes.h"
+#include "AESDecrypt.h"
+#include "DecryptPool.h"
 #include "HLSPlayer.h"
 #include "HLSPlayerSDK.h"
 #include "debug.h"
@@ -18,90 +19,44 @@
 #include "androidVideoShim.h"
 #include "HLSSegmentCache.h"
 
-#include <unordered_map>
-
 HLSPlayerSDK* gHLSPlayerSDK = NULL;
 
 
-// AES crypto engine state.
-bool gCryptoStateMapInitialized = false;
-pthread_mutex_t gCryptoStateMapLock;
-int gCryptoStateMapCounter = 1000;
-std::tr1::unordered_map<int, AesCtx *> gCryptoStateMap;
-
 extern "C"
 {
 
 	jint Java_com_kaltura_hlsplayersdk_cache_SegmentCacheItem_allocAESCryptoState(JNIEnv *env, jobject caller, jbyteArray key, jbyteArray iv)
 	{
-		if(gCryptoStateMapInitialized == false)
-		{
-			initRecursivePthreadMutex(&gCryptoStateMapLock);
-			gCryptoStateMapInitialized = true;
-		}
-
-		AutoLock locker(&gCryptoStateMapLock);
-
 		jbyte *keyPtr = env->GetByteArrayElements(key, NULL);
 		jbyte *ivPtr = env->GetByteArrayElements(iv, NULL);
 
 		// Initialize the AES context.
-		AesCtx *ctx = new AesCtx();
-		AesCtxIni(ctx, (unsigned char*)ivPtr, (unsigned char*)keyPtr, KEY128, CBC);
+		AESDecrypt *ctx = new AESDecrypt((unsigned char*)keyPtr, (unsigned char*)ivPtr);
 
 		LOGI("AES KEY = %8x%8x%8x%8x", *(int*)&keyPtr[0], *(int*)&keyPtr[4], *(int*)&keyPtr[8], *(int*)&keyPtr[12]);
 		LOGI("AES IV  = %8x%8x%8x%8x", *(int*)&ivPtr[0], *(int*)&ivPtr[4], *(int*)&ivPtr[8], *(int*)&ivPtr[12]);
+		LOGI("AES backend = %s", AESDecrypt::getBackendName(ctx->getBackend()));
 
 		env->ReleaseByteArrayElements(key, keyPtr, 0);
 		env->ReleaseByteArrayElements(iv, ivPtr, 0);
 
 		// Insert and assign a handle/id.
-		int idx = gCryptoStateMapCounter++;
-		gCryptoStateMap.insert(std::make_pair<int, AesCtx*>(idx, ctx));
-		return idx;
+		return CryptoRegistry::add(ctx);
 	}
 
 	void Java_com_kaltura_hlsplayersdk_cache_SegmentCacheItem_freeCryptoState(JNIEnv, jobject caller, jint handle)
 	{
-		if(gCryptoStateMapInitialized == false)
-		{
-			initRecursivePthreadMutex(&gCryptoStateMapLock);
-			gCryptoStateMapInitialized = true;
-		}
-
-		AutoLock locker(&gCryptoStateMapLock);
-
-		std::tr1::unordered_map<int, AesCtx*>::const_iterator got = gCryptoStateMap.find(handle);
-		if(got == gCryptoStateMap.end())
-		{
-			LOGE("Failed to locate cryptostate %d! Ignoring free request...", handle);
-			return;
-		}
-
-		// Free and remove from the map.
-		gCryptoStateMap.erase(handle);
-		delete got->second;
+		// Anything decrypting with it keeps it alive until it's done.
+		CryptoRegistry::remove(handle);
 	}
 
 	jlong Java_com_kaltura_hlsplayersdk_cache_SegmentCacheItem_decrypt(JNIEnv *env, jobject caller, jint handle, jbyteArray bytes, jlong offset, jlong length)
 	{
-		// Can we modify bytes in place?
-		jboolean isCopy = false;
-		jbyte *bytesPtr = env->GetByteArrayElements(bytes, &isCopy);
-		if(isCopy)
-		{
-			LOGE("Got a copy; this could cause a lot of overhead!");
-		}
-
-		// Dummy debug to compare with AES; just writes zeroes over the "decrypted" region.
-		// memset((unsigned char*)bytesPtr + offset, 0, length);
-
 		// Get AES crypto state.
-		std::tr1::unordered_map<int, AesCtx*>::const_iterator got = gCryptoStateMap.find(handle);
-		if(got == gCryptoStateMap.end())
+		CryptoRef got(handle);
+		if(!got.get())
 		{
 			LOGE("Failed to locate cryptostate %d! Ignoring decrypt request...", handle);
-			env->ReleaseByteArrayElements(bytes, bytesPtr, 0);
 			return -1;
 		}
 
@@ -147,13 +102,22 @@ extern "C"
 			}
 		}
 
-		// Decrypt into a temporary buffer for now. We can rewrite the AES routine
-		// to do this internally with much smaller buffers.
-		void *outputBits = malloc(length);
-		AesDecrypt(got->second, (unsigned char*)bytesPtr + offset, (unsigned char*)outputBits, length);
+		// Decrypt in place. Nothing between here and the release calls back
+		// into the VM, so we can hold the array itself rather than risk
+		// GetByteArrayElements handing us a copy of the whole segment.
+		jboolean isCopy = false;
+		jbyte *bytesPtr = (jbyte*)env->GetPrimitiveArrayCritical(bytes, &isCopy);
+		if(bytesPtr == NULL)
+		{
+			LOGE("Failed to get segment bytes for cryptostate %d!", handle);
+			return -1;
+		}
+		if(isCopy)
+		{
+			LOGE("Got a copy; this could cause a lot of overhead!");
+		}
 
-		// Copy back into place.
-		memcpy(bytesPtr + offset, outputBits, length);
+		got->decrypt((unsigned char*)bytesPtr + offset, length);
 
 		// Do the final bit if needed.
 		if(convertFinalWithPadding)
@@ -161,22 +125,21 @@ extern "C"
 			assert(totalBufferLength - (offset + length) < 16);
 
 			LOGE("FINAL CASE %d %d", (int)(offset+length), (int)totalBufferLength);
-			char tmpIn[16], tmpOut[16];
+			unsigned char tmp[16];
 			int bufOffset = 0;
 			
 			// Null pad and copy last few bytes.
-			memset(tmpIn, 0, 16);
-			bufOffset=0;
+			memset(tmp, 0, 16);
 			for(int i=offset+length; i<totalBufferLength; i++)
-				tmpIn[bufOffset++] = bytesPtr[i];
+				tmp[bufOffset++] = bytesPtr[i];
 
 			// Decrypt.
-			AesDecrypt(got->second, (unsigned char*)tmpIn, (unsigned char*)tmpOut, 16);
+			got->decrypt(tmp, 16);
 
 			// Copy back out...
 			bufOffset=0;
 			for(int i=offset+length; i<totalBufferLength; i++)
-				bytesPtr[i] = tmpIn[bufOffset++];
+				bytesPtr[i] = tmp[bufOffset++];
 
 			// ... and update length.
 			length += bufOffset;
@@ -184,13 +147,43 @@ extern "C"
 		}
 
 		// Clean up.
-		free(outputBits);
-		env->ReleaseByteArrayElements(bytes, bytesPtr, 0);
+		env->ReleasePrimitiveArrayCritical(bytes, bytesPtr, 0);
 
 		// Is it meaningful to adjust the requested end point?
 		return offset + length;
 	}
 
+	jlong Java_com_kaltura_hlsplayersdk_cache_SegmentCacheItem_decryptDirect(JNIEnv *env, jobject caller, jint handle, jobject buffer, jlong length)
+	{
+		CryptoRef got(handle);
+		if(!got.get())
+		{
+			LOGE("Failed to locate cryptostate %d! Ignoring decrypt request...", handle);
+			return -1;
+		}
+
+		unsigned char *bytes = (unsigned char*)env->GetDirectBufferAddress(buffer);
+		if(bytes == NULL || length > env->GetDirectBufferCapacity(buffer))
+		{
+			LOGE("Not a direct buffer of at least %lld bytes!", length);
+			return -1;
+		}
+
+		// Whole segments only, so start the chain from the segment IV and
+		// leave the byte[] path's position alone. A trailing partial block
+		// can't be valid ciphertext; leave it as is.
+		jlong blockLength = length & ~(jlong)(AESDecrypt::kBlockSize - 1);
+		got->decryptFromStart(bytes, blockLength);
+
+		if(blockLength != length)
+		{
+			LOGE("Segment length %lld isn't a multiple of the AES block size", length);
+			return length;
+		}
+
+		return length - AESDecrypt::getPaddingLength(bytes, length);
+	}
+
 	void Java_com_kaltura_hlsplayersdk_HLSPlayerViewController_InitNativeDecoder(JNIEnv * env, jobject jcaller)
 	{
 		android_video_shim::initLibraries();
@@ -304,7 +297,7 @@ extern "C"
 		return gHLSPlayerSDK->GetPlayer()->DroppedFramesPerSecond();
 	}
 
-	void Java_com_kaltura_hlsplayersdk_HLSPlayerViewController_FeedSegment(JNIEnv* env, jobject jcaller, jstring jurl, jint quality, jint continuityEra, jstring jaltAudioUrl, jint altAudioIndex, jdouble startTime, int cryptoId, int altCryptoId )
+	void Java_com_kaltura_hlsplayersdk_HLSPlayerViewController_FeedSegment(JNIEnv* env, jobject jcaller, jstring jurl, jint quality, jint continuityEra, jstring jaltAudioUrl, jint altAudioIndex, jdouble startTime, jdouble duration, int cryptoId, int altCryptoId )
 	{
 		LOGI("Entered");
 		
@@ -324,12 +317,12 @@ extern "C"
 		if (jaltAudioUrl) // this is because GetStringUTFChars returns const char*, but dies if you pass it a NULL pointer. Why can't it just return NULL if you pass it NULL, huh?
 		{
 			const char* altAudioUrl = env->GetStringUTFChars(jaltAudioUrl, 0);
-			gHLSPlayerSDK->GetPlayer()->FeedSegment(url, quality, continuityEra, altAudioUrl, altAudioIndex, startTime, cryptoId, altCryptoId);
+			gHLSPlayerSDK->GetPlayer()->FeedSegment(url, quality, continuityEra, altAudioUrl, altAudioIndex, startTime, duration, cryptoId, altCryptoId);
 			env->ReleaseStringUTFChars(jaltAudioUrl, altAudioUrl);
 		}
 		else
 		{
-			gHLSPlayerSDK->GetPlayer()->FeedSegment(url, quality, continuityEra, NULL, altAudioIndex, startTime, cryptoId, altCryptoId);
+			gHLSPlayerSDK->GetPlayer()->FeedSegment(url, quality, continuityEra, NULL, altAudioIndex, startTime, duration, cryptoId, altCryptoId);
 		}
 		env->ReleaseStringUTFChars(jurl, url);
 	}
@@ -381,6 +374,94 @@ extern "C"
 		return 0;
 	}
 
+	void Java_com_kaltura_hlsplayersdk_HLSPlayerViewController_SetBufferWatermarks(JNIEnv* env, jobject jcaller, jdouble lowSeconds, jdouble highSeconds)
+	{
+		if (gHLSPlayerSDK != NULL && gHLSPlayerSDK->GetPlayer())
+		{
+			gHLSPlayerSDK->GetPlayer()->SetBufferWatermarks(lowSeconds, highSeconds);
+		}
+	}
+
+	jdouble Java_com_kaltura_hlsplayersdk_HLSPlayerViewController_GetLowBufferWatermark(JNIEnv* env, jobject jcaller)
+	{
+		if (gHLSPlayerSDK != NULL && gHLSPlayerSDK->GetPlayer())
+		{
+			return gHLSPlayerSDK->GetPlayer()->GetLowBufferWatermark();
+		}
+		return 0;
+	}
+
+	jdouble Java_com_kaltura_hlsplayersdk_HLSPlayerViewController_GetHighBufferWatermark(JNIEnv* env, jobject jcaller)
+	{
+		if (gHLSPlayerSDK != NULL && gHLSPlayerSDK->GetPlayer())
+		{
+			return gHLSPlayerSDK->GetPlayer()->GetHighBufferWatermark();
+		}
+		return 0;
+	}
+
+	jdouble Java_com_kaltura_hlsplayersdk_HLSPlayerViewController_GetBufferedSeconds(JNIEnv* env, jobject jcaller)
+	{
+		if (gHLSPlayerSDK != NULL && gHLSPlayerSDK->GetPlayer())
+		{
+			return gHLSPlayerSDK->GetPlayer()->GetBufferedSeconds();
+		}
+		return -1;
+	}
+
+	void Java_com_kaltura_hlsplayersdk_HLSPlayerViewController_SetABRLadder(JNIEnv* env, jobject jcaller, jintArray jbitrates)
+	{
+		if (gHLSPlayerSDK != NULL && gHLSPlayerSDK->GetPlayer())
+		{
+			jsize count = env->GetArrayLength(jbitrates);
+			jint* bitrates = env->GetIntArrayElements(jbitrates, NULL);
+			gHLSPlayerSDK->GetPlayer()->SetABRLadder((const int*)bitrates, count);
+			env->ReleaseIntArrayElements(jbitrates, bitrates, JNI_ABORT);
+		}
+	}
+
+	void Java_com_kaltura_hlsplayersdk_HLSPlayerViewController_SetABRMode(JNIEnv* env, jobject jcaller, jint mode)
+	{
+		if (gHLSPlayerSDK != NULL && gHLSPlayerSDK->GetPlayer())
+		{
+			gHLSPlayerSDK->GetPlayer()->SetABRMode(mode);
+		}
+	}
+
+	void Java_com_kaltura_hlsplayersdk_HLSPlayerViewController_NoteSegmentDownload(JNIEnv* env, jobject jcaller, jlong bytes, jdouble seconds)
+	{
+		if (gHLSPlayerSDK != NULL && gHLSPlayerSDK->GetPlayer())
+		{
+			gHLSPlayerSDK->GetPlayer()->NoteSegmentDownload(bytes, seconds);
+		}
+	}
+
+	jint Java_com_kaltura_hlsplayersdk_HLSPlayerViewController_SelectQuality(JNIEnv* env, jobject jcaller, jint currentQuality)
+	{
+		if (gHLSPlayerSDK != NULL && gHLSPlayerSDK->GetPlayer())
+		{
+			return gHLSPlayerSDK->GetPlayer()->SelectQuality(currentQuality);
+		}
+		return currentQuality;
+	}
+
+	jdouble Java_com_kaltura_hlsplayersdk_HLSPlayerViewController_GetThroughputEstimate(JNIEnv* env, jobject jcaller)
+	{
+		if (gHLSPlayerSDK != NULL && gHLSPlayerSDK->GetPlayer())
+		{
+			return gHLSPlayerSDK->GetPlayer()->GetThroughputEstimate();
+		}
+		return -1;
+	}
+
+	void Java_com_kaltura_hlsplayersdk_HLSPlayerViewController_SetDemuxWatermarkMS(JNIEnv* env, jobject jcaller, jint watermarkMS)
+	{
+		if (gHLSPlayerSDK != NULL && gHLSPlayerSDK->GetPlayer())
+		{
+			gHLSPlayerSDK->GetPlayer()->SetDemuxWatermarkMS(watermarkMS);
+		}
+	}
+
 	jboolean Java_com_kaltura_hlsplayersdk_HLSPlayerViewController_AllowAllProfiles(JNIEnv* env, jobject jcaller )
 	{
 #ifdef ALLOW_ALL_PROFILES
@@ -1,5 +1,9 @@
 #include <assert.h>
+#include <errno.h>
+#include <string.h>
 #include "HLSSegmentCache.h"
+#include "MonotonicWait.h"
+#include "androidVideoShim.h"
 
 // Interface to the HLSSegmentCache Java subsystem.
 JavaVM *HLSSegmentCache::mJVM = NULL;
@@ -7,8 +11,28 @@ jmethodID HLSSegmentCache::mPrecache = 0;
 jmethodID HLSSegmentCache::mRead = 0;
 jmethodID HLSSegmentCache::mGetSize = 0;
 jmethodID HLSSegmentCache::mTouch = 0;
+jmethodID HLSSegmentCache::mRequestNativeStore = 0;
+jmethodID HLSSegmentCache::mNativeSegmentWait = 0;
 jclass HLSSegmentCache::mClass = 0;
 
+// Native segment store.
+pthread_mutex_t HLSSegmentCache::mStoreLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t HLSSegmentCache::mStoreCond = PTHREAD_COND_INITIALIZER;
+HLSSegmentCache::NativeSegmentMap HLSSegmentCache::mStore;
+
+const int64_t HLSSegmentCache::kReadWindowSize;
+const int HLSSegmentCache::kNativeWaitSliceMS;
+
+// waitForNativeSegment times its slices on the monotonic clock. initialize()
+// may run again for a new player while a reader waits, hence the once.
+static pthread_once_t gStoreCondOnce = PTHREAD_ONCE_INIT;
+
+void HLSSegmentCache::initStoreCond()
+{
+	pthread_cond_destroy(&mStoreCond);
+	MonotonicCondInit(&mStoreCond);
+}
+
 void HLSSegmentCache::initialize(JavaVM *jvm)
 {
 	LOGI("Initializing...");
@@ -16,6 +40,8 @@ void HLSSegmentCache::initialize(JavaVM *jvm)
 	// Keep reference to the JBM.
 	mJVM = jvm;
 
+	pthread_once(&gStoreCondOnce, initStoreCond);
+
 	// Set up environment for this thread.
 	JNIEnv *env = NULL;
 	mJVM->AttachCurrentThread(&env, NULL);
@@ -55,6 +81,20 @@ void HLSSegmentCache::initialize(JavaVM *jvm)
 	if (env->ExceptionCheck())
 	{
 		LOGE("Could not find method com/kaltura/hlsplayerskd/cache/HLSSegmentCache.touch" );
+		return;
+	}
+
+	mRequestNativeStore = env->GetStaticMethodID(mClass, "requestNativeStore", "(Ljava/lang/String;I)V" );
+	if (env->ExceptionCheck())
+	{
+		LOGE("Could not find method com/kaltura/hlsplayersdk/cache/HLSSegmentCache.requestNativeStore" );
+		return;
+	}
+
+	mNativeSegmentWait = env->GetStaticMethodID(mClass, "nativeSegmentWait", "(Ljava/lang/String;Z)V" );
+	if (env->ExceptionCheck())
+	{
+		LOGE("Could not find method com/kaltura/hlsplayersdk/cache/HLSSegmentCache.nativeSegmentWait" );
 	}
 
 	LOGI("DONE");
@@ -87,8 +127,59 @@ void HLSSegmentCache::precache(const char *uri, int cryptoId)
 	env->DeleteLocalRef(juri); // Cleaning up, just in case we're called from a native thread
 }
 
+// Serve a read from the native store if the segment has been handed over.
+// Returns false if the caller has to go through Java.
+bool HLSSegmentCache::readNative(const char *uri, int64_t offset, int64_t size, void *bytes, int64_t *res)
+{
+	AutoLock locker(&mStoreLock, __func__);
+	NativeSegment *seg = waitForNativeSegment(uri);
+	if(seg && seg->state == NATIVE_READY)
+	{
+		*res = 0;
+		if(offset >= seg->size)
+			return true;
+
+		if(offset + size > seg->size)
+			size = seg->size - offset;
+
+		memcpy(bytes, seg->data + offset, size);
+		*res = size;
+		return true;
+	}
+	else if(seg && seg->state == NATIVE_FAILED)
+	{
+		LOGE("Segment %s failed to download", uri);
+		*res = 0;
+		return true;
+	}
+
+	return false;
+}
+
+bool HLSSegmentCache::getSizeNative(const char *uri, int64_t *res)
+{
+	AutoLock locker(&mStoreLock, __func__);
+	NativeSegment *seg = waitForNativeSegment(uri);
+	if(seg && seg->state == NATIVE_READY)
+	{
+		*res = seg->size;
+		return true;
+	}
+	else if(seg && seg->state == NATIVE_FAILED)
+	{
+		*res = 0;
+		return true;
+	}
+
+	return false;
+}
+
 int64_t HLSSegmentCache::read(const char *uri, int64_t offset, int64_t size, void *bytes)
 {
+	int64_t res = 0;
+	if(readNative(uri, offset, size, bytes, &res))
+		return res;
+
 	assert(mJVM); // Didn't initialize.
 	assert(mClass);
 	assert(mRead);
@@ -102,7 +193,7 @@ int64_t HLSSegmentCache::read(const char *uri, int64_t offset, int64_t size, voi
 
 	LOGV2("%s offset=%lld size=%lld bytes=%p", uri, offset, size, bytes);
 
-	int64_t res = env->CallStaticLongMethod(mClass, mRead, juri, offset, size, jbytes);
+	res = env->CallStaticLongMethod(mClass, mRead, juri, offset, size, jbytes);
 
 	env->DeleteLocalRef(jbytes);
 	env->DeleteLocalRef(juri);
@@ -112,6 +203,10 @@ int64_t HLSSegmentCache::read(const char *uri, int64_t offset, int64_t size, voi
 
 int64_t HLSSegmentCache::getSize(const char *uri)
 {
+	int64_t res = 0;
+	if(getSizeNative(uri, &res))
+		return res;
+
 	assert(mJVM); // Didn't initialize.
 
 	// Set up environment for this thread.
@@ -119,7 +214,315 @@ int64_t HLSSegmentCache::getSize(const char *uri)
 	mJVM->AttachCurrentThread(&env, NULL);
 
 	jstring juri = env->NewStringUTF(uri);
-	int64_t res = env->CallStaticLongMethod(mClass, mGetSize, juri);
+	res = env->CallStaticLongMethod(mClass, mGetSize, juri);
+	env->DeleteLocalRef(juri);
+	return res;
+}
+
+HLSSegmentHandle *HLSSegmentCache::open(const char *uri)
+{
+	assert(mJVM); // Didn't initialize.
+
+	JNIEnv *env = NULL;
+	mJVM->AttachCurrentThread(&env, NULL);
+
+	HLSSegmentHandle *seg = new HLSSegmentHandle();
+	seg->uri = strdup(uri);
+	seg->size = -1;
+	seg->window = NULL;
+	seg->windowBytes = NULL;
+
+	jstring juri = env->NewStringUTF(uri);
+	seg->juri = (jstring)env->NewGlobalRef(juri);
 	env->DeleteLocalRef(juri);
+
+	return seg;
+}
+
+void HLSSegmentCache::close(HLSSegmentHandle *seg)
+{
+	if(!seg)
+		return;
+
+	JNIEnv *env = NULL;
+	mJVM->AttachCurrentThread(&env, NULL);
+
+	env->DeleteGlobalRef(seg->juri);
+	if(seg->window)
+		env->DeleteGlobalRef(seg->window);
+
+	free(seg->windowBytes);
+	free(seg->uri);
+	delete seg;
+}
+
+void HLSSegmentCache::touch(HLSSegmentHandle *seg)
+{
+	assert(mJVM);
+
+	JNIEnv *env = NULL;
+	mJVM->AttachCurrentThread(&env, NULL);
+
+	env->CallStaticVoidMethod(mClass, mTouch, seg->juri);
+}
+
+int64_t HLSSegmentCache::read(HLSSegmentHandle *seg, int64_t offset, int64_t size, void *bytes)
+{
+	int64_t res = 0;
+	if(readNative(seg->uri, offset, size, bytes, &res))
+		return res;
+
+	assert(mJVM); // Didn't initialize.
+	assert(mClass);
+	assert(mRead);
+
+	JNIEnv *env = NULL;
+	mJVM->AttachCurrentThread(&env, NULL);
+
+	// Set up the reusable window the first time we need it.
+	if(!seg->window)
+	{
+		seg->windowBytes = (unsigned char*)malloc(kReadWindowSize);
+		jobject window = env->NewDirectByteBuffer(seg->windowBytes, kReadWindowSize);
+		seg->window = env->NewGlobalRef(window);
+		env->DeleteLocalRef(window);
+	}
+
+	LOGV2("%s offset=%lld size=%lld bytes=%p", seg->uri, offset, size, bytes);
+
+	// Pull the data through the window, a chunk at a time.
+	while(size > 0)
+	{
+		int64_t chunk = size < kReadWindowSize ? size : kReadWindowSize;
+		int64_t got = env->CallStaticLongMethod(mClass, mRead, seg->juri, offset, chunk, seg->window);
+		if(got <= 0)
+			break;
+
+		memcpy(((unsigned char*)bytes) + res, seg->windowBytes, got);
+		res += got;
+		offset += got;
+		size -= got;
+
+		// Short read means we hit the end of the segment.
+		if(got < chunk)
+			break;
+	}
+
 	return res;
 }
+
+int64_t HLSSegmentCache::getSize(HLSSegmentHandle *seg)
+{
+	if(seg->size >= 0)
+		return seg->size;
+
+	int64_t res = 0;
+	if(!getSizeNative(seg->uri, &res))
+	{
+		assert(mJVM); // Didn't initialize.
+
+		JNIEnv *env = NULL;
+		mJVM->AttachCurrentThread(&env, NULL);
+
+		res = env->CallStaticLongMethod(mClass, mGetSize, seg->juri);
+	}
+
+	// Java blocks until the download finishes, so the size won't change
+	// after this. Don't cache failures, though.
+	if(res > 0)
+		seg->size = res;
+
+	return res;
+}
+
+// Must be called with mStoreLock held. Blocks while the segment is pending;
+// returns NULL if nobody registered interest in it.
+//
+// The wait is done in kNativeWaitSliceMS slices. After each slice that
+// passes without news, Java is told we're waiting, the same as its own reads
+// do in waitForLoad, so buffering and progress still get reported. Java also
+// checks that the segment is still on its way here. That can't be done
+// holding mStoreLock, since Java calls back in with its own locks held.
+HLSSegmentCache::NativeSegment *HLSSegmentCache::waitForNativeSegment(const char *uri)
+{
+	bool waiting = false;
+
+	for(;;)
+	{
+		NativeSegmentMap::iterator i = mStore.find(uri);
+		bool pending = i != mStore.end() && i->second->state == NATIVE_PENDING;
+
+		if(!pending && !waiting)
+			return i == mStore.end() ? NULL : i->second;
+
+		if(pending)
+		{
+			LOGDATAMINING("Waiting on native segment %s", uri);
+
+			if(MonotonicCondWait(&mStoreCond, &mStoreLock, kNativeWaitSliceMS * 1000ll) != ETIMEDOUT)
+				continue;
+		}
+
+		// Either still pending after a whole slice, or done waiting and Java
+		// has to hear that too.
+		waiting = pending;
+		pthread_mutex_unlock(&mStoreLock);
+		noteNativeWait(uri, pending);
+		pthread_mutex_lock(&mStoreLock);
+
+		// The entry may have been released while the lock was dropped, so look it up again.
+	}
+}
+
+void HLSSegmentCache::noteNativeWait(const char *uri, bool waiting)
+{
+	if(!mJVM || !mNativeSegmentWait)
+		return;
+
+	JNIEnv *env = NULL;
+	mJVM->AttachCurrentThread(&env, NULL);
+
+	jstring juri = env->NewStringUTF(uri);
+	env->CallStaticVoidMethod(mClass, mNativeSegmentWait, juri, (jboolean)waiting);
+	env->DeleteLocalRef(juri);
+}
+
+void HLSSegmentCache::expect(const char *uri, int cryptoId)
+{
+	{
+		AutoLock locker(&mStoreLock, __func__);
+
+		NativeSegmentMap::iterator i = mStore.find(uri);
+		if(i != mStore.end())
+		{
+			i->second->refCount++;
+			return;
+		}
+
+		NativeSegment *seg = new NativeSegment();
+		seg->state = NATIVE_PENDING;
+		seg->buffer = NULL;
+		seg->data = NULL;
+		seg->size = 0;
+		seg->refCount = 1;
+		mStore[uri] = seg;
+	}
+
+	// Ask Java for the bytes. If the download is already complete this
+	// calls straight back into storeNativeSegment, so we can't hold the lock.
+	if(!mJVM || !mRequestNativeStore)
+	{
+		failNativeSegment(uri, true);
+		return;
+	}
+
+	JNIEnv *env = NULL;
+	mJVM->AttachCurrentThread(&env, NULL);
+
+	jstring juri = env->NewStringUTF(uri);
+	env->CallStaticVoidMethod(mClass, mRequestNativeStore, juri, cryptoId);
+	env->DeleteLocalRef(juri);
+}
+
+void HLSSegmentCache::release(const char *uri)
+{
+	jobject buffer = NULL;
+
+	{
+		AutoLock locker(&mStoreLock, __func__);
+
+		NativeSegmentMap::iterator i = mStore.find(uri);
+		if(i == mStore.end())
+			return;
+
+		NativeSegment *seg = i->second;
+		if(--seg->refCount > 0)
+			return;
+
+		buffer = seg->buffer;
+		mStore.erase(i);
+		delete seg;
+
+		// Anyone blocked on it will fall back to the Java path.
+		pthread_cond_broadcast(&mStoreCond);
+	}
+
+	if(buffer && mJVM)
+	{
+		JNIEnv *env = NULL;
+		mJVM->AttachCurrentThread(&env, NULL);
+		env->DeleteGlobalRef(buffer);
+	}
+}
+
+bool HLSSegmentCache::isExpected(const char *uri)
+{
+	AutoLock locker(&mStoreLock, __func__);
+	NativeSegmentMap::iterator i = mStore.find(uri);
+	return i != mStore.end() && i->second->state == NATIVE_PENDING;
+}
+
+bool HLSSegmentCache::storeNativeSegment(JNIEnv *env, const char *uri, jobject buffer, int64_t size)
+{
+	unsigned char *data = (unsigned char*)env->GetDirectBufferAddress(buffer);
+	if(data == NULL || env->GetDirectBufferCapacity(buffer) < size)
+	{
+		LOGE("Bad buffer handed over for %s", uri);
+		return false;
+	}
+
+	AutoLock locker(&mStoreLock, __func__);
+
+	NativeSegmentMap::iterator i = mStore.find(uri);
+	if(i == mStore.end() || i->second->state != NATIVE_PENDING)
+		return false;
+
+	NativeSegment *seg = i->second;
+	seg->buffer = env->NewGlobalRef(buffer);
+	seg->data = data;
+	seg->size = size;
+	seg->state = NATIVE_READY;
+
+	LOGI("Stored %lld bytes natively for %s", size, uri);
+
+	pthread_cond_broadcast(&mStoreCond);
+	return true;
+}
+
+void HLSSegmentCache::failNativeSegment(const char *uri, bool fallbackToJava)
+{
+	AutoLock locker(&mStoreLock, __func__);
+
+	NativeSegmentMap::iterator i = mStore.find(uri);
+	if(i == mStore.end() || i->second->state != NATIVE_PENDING)
+		return;
+
+	i->second->state = fallbackToJava ? NATIVE_UNAVAILABLE : NATIVE_FAILED;
+	pthread_cond_broadcast(&mStoreCond);
+}
+
+extern "C"
+{
+	jboolean Java_com_kaltura_hlsplayersdk_cache_HLSSegmentCache_isNativeSegmentExpected(JNIEnv *env, jobject caller, jstring juri)
+	{
+		const char *uri = env->GetStringUTFChars(juri, 0);
+		bool res = HLSSegmentCache::isExpected(uri);
+		env->ReleaseStringUTFChars(juri, uri);
+		return res;
+	}
+
+	jboolean Java_com_kaltura_hlsplayersdk_cache_HLSSegmentCache_storeNativeSegment(JNIEnv *env, jobject caller, jstring juri, jobject buffer, jlong size)
+	{
+		const char *uri = env->GetStringUTFChars(juri, 0);
+		bool res = HLSSegmentCache::storeNativeSegment(env, uri, buffer, size);
+		env->ReleaseStringUTFChars(juri, uri);
+		return res;
+	}
+
+	void Java_com_kaltura_hlsplayersdk_cache_HLSSegmentCache_failNativeSegment(JNIEnv *env, jobject caller, jstring juri, jboolean fallbackToJava)
+	{
+		const char *uri = env->GetStringUTFChars(juri, 0);
+		HLSSegmentCache::failNativeSegment(uri, fallbackToJava);
+		env->ReleaseStringUTFChars(juri, uri);
+	}
+}
@@ -3,10 +3,30 @@
 
 #include <jni.h>
 #include <sys/types.h>
+#include <pthread.h>
+
+#include <map>
+#include <string>
 
 #include "debug.h"
 
+// Per-segment state owned by HLSDataSource, so the read path doesn't have
+// to create JNI objects on every call. See HLSSegmentCache::open/close.
+struct HLSSegmentHandle
+{
+	char *uri;
+	jstring juri;				// Global ref.
+	int64_t size;				// Cached once known, -1 before that.
+	jobject window;				// Global ref to a direct ByteBuffer over windowBytes.
+	unsigned char *windowBytes;	// Allocated on the first read through Java.
+};
+
 // Interface to the HLSSegmentCache Java subsystem.
+//
+// Segments the demuxer has expressed interest in (via expect()) are handed
+// over by Java once they are downloaded and decrypted, and from then on
+// read() and getSize() are served from native memory without crossing JNI.
+// Anything not in the native store falls back to the Java cache.
 class HLSSegmentCache
 {
 private:
@@ -15,14 +35,64 @@ private:
 	static jmethodID mRead;
 	static jmethodID mGetSize;
 	static jmethodID mTouch;
+	static jmethodID mRequestNativeStore;
+	static jmethodID mNativeSegmentWait;
 	static jclass mClass;
 
+	enum NativeSegmentState
+	{
+		NATIVE_PENDING,		// Waiting on Java to hand the bytes over.
+		NATIVE_READY,		// Bytes are in data, size bytes long.
+		NATIVE_FAILED,		// Download failed for good, reads return 0.
+		NATIVE_UNAVAILABLE	// Java gave up on it (cancel), use the Java path.
+	};
+
+	struct NativeSegment
+	{
+		NativeSegmentState state;
+		jobject buffer;		// Global ref to the direct ByteBuffer backing data.
+		unsigned char *data;
+		int64_t size;
+		int refCount;
+	};
+
+	typedef std::map<std::string, NativeSegment *> NativeSegmentMap;
+
+	static pthread_mutex_t mStoreLock;
+	static pthread_cond_t mStoreCond;
+	static NativeSegmentMap mStore;
+
+	static void initStoreCond();
+	static NativeSegment *waitForNativeSegment(const char *uri);
+	static void noteNativeWait(const char *uri, bool waiting);
+	static bool readNative(const char *uri, int64_t offset, int64_t size, void *bytes, int64_t *res);
+	static bool getSizeNative(const char *uri, int64_t *res);
+
+	static const int64_t kReadWindowSize = 64 * 1024;
+	static const int kNativeWaitSliceMS = 100;
+
 public:
     static void initialize(JavaVM *jvm);
     static void precache(const char *uri, int cryptoId = -1);
     static int64_t read(const char *uri, int64_t offset, int64_t size, void *bytes);
     static int64_t getSize(const char *uri);
     static void touch(const char* uri);
+
+    // Handle based versions of the above, for repeated access to one segment.
+    static HLSSegmentHandle *open(const char *uri);
+    static void close(HLSSegmentHandle *seg);
+    static int64_t read(HLSSegmentHandle *seg, int64_t offset, int64_t size, void *bytes);
+    static int64_t getSize(HLSSegmentHandle *seg);
+    static void touch(HLSSegmentHandle *seg);
+
+    // Native segment store. expect() and release() are reference counted.
+    static void expect(const char *uri, int cryptoId = -1);
+    static void release(const char *uri);
+
+    // Called from Java (through the JNI entry points) as downloads complete.
+    static bool isExpected(const char *uri);
+    static bool storeNativeSegment(JNIEnv *env, const char *uri, jobject buffer, int64_t size);
+    static void failNativeSegment(const char *uri, bool fallbackToJava);
 };
 
 
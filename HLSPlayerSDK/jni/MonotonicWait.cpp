@@ -0,0 +1,98 @@
+#include "MonotonicWait.h"
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+static int64_t monotonicNowUs()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000ll + now.tv_nsec / 1000;
+}
+
+void MonotonicCondInit(pthread_cond_t *cond)
+{
+#if defined(HAVE_PTHREAD_COND_TIMEDWAIT_MONOTONIC)
+	pthread_cond_init(cond, NULL);
+#else
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(cond, &attr);
+	pthread_condattr_destroy(&attr);
+#endif
+}
+
+int MonotonicCondWait(pthread_cond_t *cond, pthread_mutex_t *mutex, int64_t timeoutUs)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	int64_t nsec = ts.tv_nsec + timeoutUs * 1000;
+	ts.tv_sec += nsec / 1000000000;
+	ts.tv_nsec = nsec % 1000000000;
+
+#if defined(HAVE_PTHREAD_COND_TIMEDWAIT_MONOTONIC)
+	return pthread_cond_timedwait_monotonic_np(cond, mutex, &ts);
+#else
+	return pthread_cond_timedwait(cond, mutex, &ts);
+#endif
+}
+
+MonotonicSemaphore::MonotonicSemaphore() : mCount(0), mWaiters(0)
+{
+}
+
+void MonotonicSemaphore::Post()
+{
+	__sync_fetch_and_add(&mCount, 1);
+	if (__sync_fetch_and_add(&mWaiters, 0) > 0)
+		syscall(__NR_futex, &mCount, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+bool MonotonicSemaphore::TryTake()
+{
+	for (;;)
+	{
+		int count = mCount;
+		if (count <= 0)
+			return false;
+		if (__sync_bool_compare_and_swap(&mCount, count, count - 1))
+			return true;
+	}
+}
+
+// Sleeps while the count is zero. Returns early on a post, a signal or the
+// timeout; the callers look again either way.
+void MonotonicSemaphore::Sleep(const struct timespec *timeout)
+{
+	__sync_fetch_and_add(&mWaiters, 1);
+	syscall(__NR_futex, &mCount, FUTEX_WAIT, 0, timeout, NULL, 0);
+	__sync_fetch_and_sub(&mWaiters, 1);
+}
+
+void MonotonicSemaphore::Wait()
+{
+	while (!TryTake())
+		Sleep(NULL);
+}
+
+bool MonotonicSemaphore::WaitUs(int64_t timeoutUs)
+{
+	int64_t deadlineUs = monotonicNowUs() + timeoutUs;
+	for (;;)
+	{
+		if (TryTake())
+			return true;
+
+		int64_t leftUs = deadlineUs - monotonicNowUs();
+		if (leftUs <= 0)
+			return false;
+
+		struct timespec ts;
+		ts.tv_sec = leftUs / 1000000;
+		ts.tv_nsec = (leftUs % 1000000) * 1000;
+		Sleep(&ts);
+	}
+}
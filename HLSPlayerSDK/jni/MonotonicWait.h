@@ -0,0 +1,57 @@
+#ifndef _MONOTONICWAIT_H_
+#define _MONOTONICWAIT_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+ * Timed waits that run off CLOCK_MONOTONIC, the clock FrameScheduler::NowUs()
+ * reads, so setting the wall clock (NTP, the user, a network time update)
+ * neither cuts them short nor stretches them out.
+ *
+ * pthread_cond_timedwait() takes a CLOCK_REALTIME deadline unless the
+ * condition variable was set up for CLOCK_MONOTONIC, which bionic only
+ * supports from API 21. Before that it has
+ * pthread_cond_timedwait_monotonic_np() instead. Set the condition variable
+ * up with MonotonicCondInit() and MonotonicCondWait() uses whichever the
+ * platform has.
+ *
+ * sem_timedwait() only ever takes a CLOCK_REALTIME deadline (bionic's
+ * monotonic variant is API 28), so MonotonicSemaphore stands in for sem_t
+ * where a timed wait is needed.
+ */
+
+void MonotonicCondInit(pthread_cond_t *cond);
+
+// Waits at most timeoutUs for cond. Returns what pthread_cond_timedwait()
+// would: 0 when signalled (or woken spuriously), ETIMEDOUT on timeout.
+int MonotonicCondWait(pthread_cond_t *cond, pthread_mutex_t *mutex, int64_t timeoutUs);
+
+/*
+ * MonotonicSemaphore
+ *
+ * A counting semaphore on a futex. Waits are given a relative timeout,
+ * which the kernel measures on CLOCK_MONOTONIC. Post() takes no lock and
+ * only makes a system call when someone is waiting, so it's safe from audio
+ * callbacks.
+ */
+class MonotonicSemaphore
+{
+public:
+	MonotonicSemaphore();
+
+	void Post();
+	void Wait();
+
+	// False if timeoutUs passed without a post.
+	bool WaitUs(int64_t timeoutUs);
+
+private:
+	bool TryTake();
+	void Sleep(const struct timespec *timeout);
+
+	volatile int mCount;
+	volatile int mWaiters;
+};
+
+#endif /* _MONOTONICWAIT_H_ */
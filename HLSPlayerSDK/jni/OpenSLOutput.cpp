@@ -0,0 +1,376 @@
+/*
+ * OpenSLOutput.cpp
+ *
+ * 16 bit PCM output through an OpenSL ES buffer queue player.
+ */
+
+#include "OpenSLOutput.h"
+#include "debug.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// How much audio each buffer handed to the player holds, at most. It's
+// also how often the callback runs, and how finely GetFramesPlayed()
+// moves.
+static const int kPeriodMs = 10;
+
+// How much decoded audio the ring holds (rounded up to a power of two).
+static const int kRingMs = 250;
+
+// How long BeginWrite() waits for the player to make room before deciding
+// it isn't going to.
+static const int kWriteTimeoutMs = 1000;
+
+// One engine and output mix for the whole process, created the first time
+// they're needed and never destroyed; Android only allows a single engine.
+static SLObjectItf gEngineObj = NULL;
+static SLEngineItf gEngine = NULL;
+static SLObjectItf gOutputMixObj = NULL;
+static pthread_once_t gEngineOnce = PTHREAD_ONCE_INIT;
+
+static void createEngine()
+{
+	SLObjectItf engineObj = NULL;
+	SLEngineItf engine = NULL;
+	SLObjectItf outputMixObj = NULL;
+
+	SLresult res = slCreateEngine(&engineObj, 0, NULL, 0, NULL, NULL);
+	if (res == SL_RESULT_SUCCESS)
+		res = (*engineObj)->Realize(engineObj, SL_BOOLEAN_FALSE);
+	if (res == SL_RESULT_SUCCESS)
+		res = (*engineObj)->GetInterface(engineObj, SL_IID_ENGINE, &engine);
+	if (res == SL_RESULT_SUCCESS)
+		res = (*engine)->CreateOutputMix(engine, &outputMixObj, 0, NULL, NULL);
+	if (res == SL_RESULT_SUCCESS)
+		res = (*outputMixObj)->Realize(outputMixObj, SL_BOOLEAN_FALSE);
+
+	if (res != SL_RESULT_SUCCESS)
+	{
+		LOGE("Failed to create OpenSL ES engine: %d", (int)res);
+		if (outputMixObj) (*outputMixObj)->Destroy(outputMixObj);
+		if (engineObj) (*engineObj)->Destroy(engineObj);
+		return;
+	}
+
+	gEngineObj = engineObj;
+	gEngine = engine;
+	gOutputMixObj = outputMixObj;
+	LOGI("Created OpenSL ES engine");
+}
+
+static uint32_t nextPowerOfTwo(uint32_t x)
+{
+	uint32_t p = 1;
+	while (p < x)
+		p <<= 1;
+	return p;
+}
+
+OpenSLOutput::OpenSLOutput() : mPlayerObj(NULL), mPlay(NULL), mBufferQueue(NULL), mSampleRate(0), mChannels(0),
+		mFrameBytes(0), mPeriodBytes(0), mRing(NULL), mRingSize(0), mSilence(NULL), mWritten(0), mQueued(0), mPlayed(0),
+		mFramesPlayed(0), mInFlightHead(0), mInFlightCount(0), mActive(0), mInCallback(0), mStopWaiting(0), mPlaying(false), mStarted(false)
+{
+	sem_init(&mIdleSem, 0, 0);
+}
+
+OpenSLOutput::~OpenSLOutput()
+{
+	Close();
+	sem_destroy(&mIdleSem);
+}
+
+bool OpenSLOutput::IsSupported()
+{
+	pthread_once(&gEngineOnce, createEngine);
+	return gEngine != NULL;
+}
+
+bool OpenSLOutput::Open(int sampleRate, int channels, int maxWriteBytes)
+{
+	Close();
+
+	if (!IsSupported())
+		return false;
+
+	if (sampleRate <= 0 || channels < 1 || channels > 2)
+	{
+		LOGE("Unsupported output format: %d Hz, %d channels", sampleRate, channels);
+		return false;
+	}
+
+	mSampleRate = sampleRate;
+	mChannels = channels;
+	mFrameBytes = channels * sizeof(int16_t);
+	mPeriodBytes = sampleRate * kPeriodMs / 1000 * mFrameBytes;
+
+	// Room for the writes, plus everything the player can hold, twice over.
+	uint32_t ringBytes = sampleRate * kRingMs / 1000 * mFrameBytes;
+	if (ringBytes < (uint32_t)maxWriteBytes * 2)
+		ringBytes = maxWriteBytes * 2;
+	if (ringBytes < (uint32_t)mPeriodBytes * kQueueDepth * 2)
+		ringBytes = mPeriodBytes * kQueueDepth * 2;
+	mRingSize = nextPowerOfTwo(ringBytes);
+
+	mRing = (char*)malloc(mRingSize + maxWriteBytes);
+	mSilence = (char*)calloc(1, mPeriodBytes);
+	if (!mRing || !mSilence)
+	{
+		LOGE("Failed to allocate %u byte PCM ring", mRingSize);
+		Close();
+		return false;
+	}
+
+	SLDataLocator_AndroidSimpleBufferQueue locator = { SL_DATALOCATOR_ANDROIDSIMPLEBUFFERQUEUE, kQueueDepth };
+	SLDataFormat_PCM format =
+	{
+		SL_DATAFORMAT_PCM,
+		(SLuint32)channels,
+		(SLuint32)sampleRate * 1000,	// In milliHertz.
+		SL_PCMSAMPLEFORMAT_FIXED_16,
+		SL_PCMSAMPLEFORMAT_FIXED_16,
+		channels == 1 ? SL_SPEAKER_FRONT_CENTER : SL_SPEAKER_FRONT_LEFT | SL_SPEAKER_FRONT_RIGHT,
+		SL_BYTEORDER_LITTLEENDIAN
+	};
+	SLDataSource source = { &locator, &format };
+
+	SLDataLocator_OutputMix outputMix = { SL_DATALOCATOR_OUTPUTMIX, gOutputMixObj };
+	SLDataSink sink = { &outputMix, NULL };
+
+	const SLInterfaceID ids[] = { SL_IID_ANDROIDSIMPLEBUFFERQUEUE };
+	const SLboolean required[] = { SL_BOOLEAN_TRUE };
+
+	SLresult res = (*gEngine)->CreateAudioPlayer(gEngine, &mPlayerObj, &source, &sink, 1, ids, required);
+	if (res == SL_RESULT_SUCCESS)
+		res = (*mPlayerObj)->Realize(mPlayerObj, SL_BOOLEAN_FALSE);
+	if (res == SL_RESULT_SUCCESS)
+		res = (*mPlayerObj)->GetInterface(mPlayerObj, SL_IID_PLAY, &mPlay);
+	if (res == SL_RESULT_SUCCESS)
+		res = (*mPlayerObj)->GetInterface(mPlayerObj, SL_IID_ANDROIDSIMPLEBUFFERQUEUE, &mBufferQueue);
+	if (res == SL_RESULT_SUCCESS)
+		res = (*mBufferQueue)->RegisterCallback(mBufferQueue, BufferQueueCallback, this);
+
+	if (res != SL_RESULT_SUCCESS)
+	{
+		LOGE("Failed to create OpenSL ES player for %d Hz, %d channels: %d", sampleRate, channels, (int)res);
+		Close();
+		return false;
+	}
+
+	Reset();
+	LOGI("Opened OpenSL ES output: %d Hz, %d channels, %u byte ring, %d byte periods", sampleRate, channels, mRingSize, mPeriodBytes);
+	return true;
+}
+
+void OpenSLOutput::Close()
+{
+	if (mPlayerObj)
+	{
+		Stop();
+		(*mPlayerObj)->Destroy(mPlayerObj);
+	}
+	mPlayerObj = NULL;
+	mPlay = NULL;
+	mBufferQueue = NULL;
+
+	free(mRing);
+	mRing = NULL;
+	mRingSize = 0;
+	free(mSilence);
+	mSilence = NULL;
+}
+
+// Only while the callback can't run.
+void OpenSLOutput::Reset()
+{
+	mWritten = 0;
+	mQueued = 0;
+	mPlayed = 0;
+	mFramesPlayed = 0;
+	mInFlightHead = 0;
+	mInFlightCount = 0;
+	mStarted = false;
+	__sync_synchronize();
+}
+
+void OpenSLOutput::Play()
+{
+	if (!mPlayerObj || mPlaying)
+		return;
+
+	if (!mStarted)
+	{
+		// Nothing is queued yet, so there are no callbacks to do this for us.
+		// Only then let them in: one let go just as Stop() returned may still
+		// turn up.
+		while (mInFlightCount < kQueueDepth && EnqueueNext())
+			;
+		__sync_lock_test_and_set(&mActive, 1);
+		mStarted = true;
+	}
+
+	(*mPlay)->SetPlayState(mPlay, SL_PLAYSTATE_PLAYING);
+	mPlaying = true;
+}
+
+void OpenSLOutput::Pause()
+{
+	if (!mPlayerObj || !mPlaying)
+		return;
+
+	(*mPlay)->SetPlayState(mPlay, SL_PLAYSTATE_PAUSED);
+	mPlaying = false;
+}
+
+void OpenSLOutput::Stop()
+{
+	if (!mPlayerObj)
+		return;
+
+	// A callback may already be on its way in when the player stops; wait
+	// for it to see mActive and leave before the queue goes. A post left
+	// over from a callback that got out before we looked only costs another
+	// time round.
+	__sync_lock_test_and_set(&mActive, 0);
+	(*mPlay)->SetPlayState(mPlay, SL_PLAYSTATE_STOPPED);
+	__sync_fetch_and_or(&mStopWaiting, 1);
+	while (__sync_fetch_and_add(&mInCallback, 0) > 0)
+		sem_wait(&mIdleSem);
+	__sync_fetch_and_and(&mStopWaiting, 0);
+
+	(*mBufferQueue)->Clear(mBufferQueue);
+	mPlaying = false;
+	Reset();
+
+	// Anyone waiting for room doesn't need to any more.
+	mSpaceSem.Post();
+}
+
+void OpenSLOutput::Flush()
+{
+	if (!mPlaying)
+		Stop();
+}
+
+char* OpenSLOutput::BeginWrite(int bytes)
+{
+	if (!mRing)
+		return NULL;
+
+	int64_t deadlineUs = 0;
+	for (;;)
+	{
+		// Nothing may be written over until the player is done with it.
+		uint32_t played = mPlayed;
+		__sync_synchronize();
+		if (mRingSize - (mWritten - played) >= (uint32_t)bytes)
+			break;
+
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		int64_t nowUs = now.tv_sec * 1000000ll + now.tv_nsec / 1000;
+		if (!deadlineUs)
+			deadlineUs = nowUs + kWriteTimeoutMs * 1000ll;
+
+		if (!mPlaying || nowUs >= deadlineUs)
+		{
+			LOGE("PCM ring full and %s, dropping audio", mPlaying ? "not draining" : "not playing");
+			return NULL;
+		}
+
+		mSpaceSem.WaitUs(kPeriodMs * 1000);
+	}
+
+	return mRing + (mWritten & (mRingSize - 1));
+}
+
+void OpenSLOutput::EndWrite(int bytes)
+{
+	if (!mRing || bytes <= 0)
+		return;
+
+	// Whatever ran past the end of the ring belongs at its start.
+	uint32_t pos = mWritten & (mRingSize - 1);
+	if (pos + bytes > mRingSize)
+		memcpy(mRing, mRing + mRingSize, pos + bytes - mRingSize);
+
+	// Publishes the PCM along with the count.
+	__sync_fetch_and_add(&mWritten, (uint32_t)bytes);
+}
+
+int OpenSLOutput::GetFramesPending() const
+{
+	if (!mFrameBytes)
+		return 0;
+	return (int)((mWritten - mPlayed) / mFrameBytes);
+}
+
+void OpenSLOutput::BufferQueueCallback(SLAndroidSimpleBufferQueueItf bufferQueue, void* context)
+{
+	OpenSLOutput* output = (OpenSLOutput*)context;
+
+	__sync_fetch_and_add(&output->mInCallback, 1);
+	if (__sync_fetch_and_add(&output->mActive, 0))
+		output->OnBufferDone();
+	if (__sync_sub_and_fetch(&output->mInCallback, 1) == 0 && __sync_fetch_and_add(&output->mStopWaiting, 0))
+		sem_post(&output->mIdleSem);
+}
+
+// On OpenSL's callback thread: a buffer has been played. Asks the queue how
+// many it still holds rather than trusting that this call is for our oldest,
+// so a late callback can't retire a buffer that's still to play.
+void OpenSLOutput::OnBufferDone()
+{
+	SLAndroidSimpleBufferQueueState state;
+	if ((*mBufferQueue)->GetState(mBufferQueue, &state) != SL_RESULT_SUCCESS)
+		return;
+
+	while (mInFlightCount > (int)state.count)
+	{
+		uint32_t bytes = mInFlight[mInFlightHead];
+		mInFlightHead = (mInFlightHead + 1) % kQueueDepth;
+		--mInFlightCount;
+
+		if (bytes > 0)
+		{
+			__sync_fetch_and_add(&mPlayed, bytes);
+			__sync_fetch_and_add(&mFramesPlayed, bytes / mFrameBytes);
+			mSpaceSem.Post();
+		}
+	}
+
+	while (mInFlightCount < kQueueDepth && EnqueueNext())
+		;
+}
+
+// Hands the player the next slice of the ring, or silence if there's none.
+bool OpenSLOutput::EnqueueNext()
+{
+	uint32_t written = mWritten;
+	__sync_synchronize();
+
+	uint32_t pos = mQueued & (mRingSize - 1);
+	uint32_t bytes = written - mQueued;
+	if (bytes > (uint32_t)mPeriodBytes)
+		bytes = mPeriodBytes;
+	if (bytes > mRingSize - pos)
+		bytes = mRingSize - pos;
+	bytes -= bytes % mFrameBytes;
+
+	SLresult res;
+	if (bytes > 0)
+		res = (*mBufferQueue)->Enqueue(mBufferQueue, mRing + pos, bytes);
+	else
+		res = (*mBufferQueue)->Enqueue(mBufferQueue, mSilence, mPeriodBytes);
+
+	if (res != SL_RESULT_SUCCESS)
+		return false;
+
+	mInFlight[(mInFlightHead + mInFlightCount) % kQueueDepth] = bytes;
+	++mInFlightCount;
+	if (bytes > 0)
+		__sync_fetch_and_add(&mQueued, bytes);
+	return true;
+}
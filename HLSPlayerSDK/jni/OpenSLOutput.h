@@ -0,0 +1,124 @@
+/*
+ * OpenSLOutput.h
+ *
+ * 16 bit PCM output through an OpenSL ES buffer queue player.
+ */
+
+#ifndef OPENSLOUTPUT_H_
+#define OPENSLOUTPUT_H_
+
+#include <SLES/OpenSLES.h>
+#include <SLES/OpenSLES_Android.h>
+#include <semaphore.h>
+#include <stdint.h>
+
+#include "MonotonicWait.h"
+
+/*
+ * OpenSLOutput
+ *
+ * PCM goes into a ring buffer that the producer (AudioSLES's decoder)
+ * writes straight into: BeginWrite() hands out room at the write position,
+ * EndWrite() publishes what was put there. The buffer queue callback hands
+ * the player slices of the ring itself, so nothing is copied on the way
+ * out, and a slice isn't written over until the player is done with it.
+ *
+ * One thread produces; the callback, on OpenSL's thread, consumes. They
+ * share nothing but counters, updated atomically, and the callback never
+ * takes a lock or blocks. When the ring runs dry the callback queues
+ * silence to keep the player running, as AudioTrack does on an underrun,
+ * and that silence doesn't count as played.
+ *
+ * GetFramesPlayed() is the equivalent of AudioTrack's playback head
+ * position: frames the player has finished with since the last Stop() or
+ * Flush(). It's a plain counter read, safe from any thread.
+ *
+ * The rest aren't safe to call at the same time as each other, except that
+ * Play() and Pause() may be called while the producer is in BeginWrite();
+ * AudioSLES's locks see to that.
+ */
+class OpenSLOutput
+{
+public:
+	OpenSLOutput();
+	~OpenSLOutput();
+
+	// Whether an OpenSL ES engine is available at all.
+	static bool IsSupported();
+
+	// maxWriteBytes is the most BeginWrite() will ever be asked for.
+	bool Open(int sampleRate, int channels, int maxWriteBytes);
+	void Close();
+	bool IsOpen() const { return mPlayerObj != NULL; }
+
+	void Play();
+	void Pause();
+	void Stop();	// Stops, and drops anything not yet played.
+	void Flush();	// Drops anything not yet played. Only while not playing.
+
+	// Room for at least bytes of PCM, contiguous, at the write position.
+	// Blocks while the ring is that full; NULL if the player doesn't drain
+	// it (not playing, or stuck).
+	char* BeginWrite(int bytes);
+	void EndWrite(int bytes);
+
+	uint32_t GetFramesPlayed() const { return mFramesPlayed; }
+	int GetFramesPending() const;
+
+	int GetSampleRate() const { return mSampleRate; }
+	int GetChannels() const { return mChannels; }
+
+private:
+	static void BufferQueueCallback(SLAndroidSimpleBufferQueueItf bufferQueue, void* context);
+	void OnBufferDone();
+	bool EnqueueNext();
+	void Reset();
+
+	SLObjectItf mPlayerObj;
+	SLPlayItf mPlay;
+	SLAndroidSimpleBufferQueueItf mBufferQueue;
+
+	int mSampleRate;
+	int mChannels;
+	int mFrameBytes;
+	int mPeriodBytes;
+
+	// The ring. Its size is a power of two so the byte counters below can
+	// wrap. The slack past the end takes writes that run over it; EndWrite()
+	// moves them round to the start.
+	char* mRing;
+	uint32_t mRingSize;
+	char* mSilence;
+
+	// Byte counters, only ever increasing (modulo 2^32). Each is written by
+	// one side only: mWritten by the producer, mQueued and mPlayed by the
+	// callback.
+	volatile uint32_t mWritten;
+	volatile uint32_t mQueued;
+	volatile uint32_t mPlayed;
+
+	volatile uint32_t mFramesPlayed;
+
+	// Sizes of the slices the player holds, oldest first; 0 for silence.
+	enum { kQueueDepth = 4 };
+	uint32_t mInFlight[kQueueDepth];
+	int mInFlightHead;
+	int mInFlightCount;
+
+	// Whether the callback may touch the queue, and how many callbacks are
+	// running, so Stop() can wait for them to get out of the way. While
+	// mStopWaiting is set, the callback that brings mInCallback to zero
+	// posts mIdleSem.
+	volatile int mActive;
+	volatile int mInCallback;
+	volatile int mStopWaiting;
+	sem_t mIdleSem;
+	volatile bool mPlaying;
+	bool mStarted;		// The queue has been primed since the last Stop().
+
+	// Posted by the callback each time it frees room in the ring. Not a
+	// sem_t so that BeginWrite()'s timed wait runs off the monotonic clock.
+	MonotonicSemaphore mSpaceSem;
+};
+
+#endif /* OPENSLOUTPUT_H_ */
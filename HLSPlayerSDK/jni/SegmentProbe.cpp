@@ -0,0 +1,135 @@
+#include <jni.h>
+
+#include "SegmentProbe.h"
+#include "debug.h"
+
+using namespace android;
+
+int64_t SegmentProbe::Result::getStartPTS() const
+{
+	int64_t start = -1;
+	if (hasVideo && video.firstPTS >= 0)
+		start = video.firstPTS;
+	if (hasAudio && audio.firstPTS >= 0 && (start < 0 || audio.firstPTS < start))
+		start = audio.firstPTS;
+	return start;
+}
+
+int64_t SegmentProbe::Result::getDurationPTS() const
+{
+	int64_t duration = 0;
+	if (hasVideo && video.firstPTS >= 0 && video.lastPTS - video.firstPTS > duration)
+		duration = video.lastPTS - video.firstPTS;
+	if (hasAudio && audio.firstPTS >= 0 && audio.lastPTS - audio.firstPTS > duration)
+		duration = audio.lastPTS - audio.firstPTS;
+	return duration;
+}
+
+bool SegmentProbe::probe(const unsigned char *data, size_t length, size_t headBytes, size_t tailBytes, Result *result)
+{
+	sp<ATSParser> parser = new ATSParser(ATSParser::PROBE_ONLY | ATSParser::TS_TIMESTAMPS_ARE_ABSOLUTE);
+
+	size_t headEnd = (headBytes == 0 || headBytes > length) ? length : headBytes;
+
+	size_t offset = 0;
+	while (offset < headEnd && !parser->probeComplete())
+	{
+		size_t step = headEnd - offset < kProbeStep ? headEnd - offset : kProbeStep;
+		size_t consumed = 0;
+		if (parser->feedTSPackets(data + offset, step, &consumed) != OK)
+		{
+			LOGE("Failed to parse segment head at %u", (unsigned)offset);
+			return false;
+		}
+
+		if (consumed == 0)
+			break;
+		offset += consumed;
+	}
+
+	// The last PTS values come from the tail. A stream with no PES packet
+	// starting in it (sparse audio, say) gets the window before it as well,
+	// and so on back to where the head left off. Windows start on a packet
+	// boundary so no packet is split between two of them.
+	size_t tailEnd = length;
+	while (tailBytes > 0 && tailEnd > offset)
+	{
+		size_t start = offset;
+		if (tailEnd - offset > tailBytes)
+		{
+			start = tailEnd - tailBytes;
+			start -= start % kTSPacketSize;
+			if (start < offset)
+				start = offset;
+		}
+
+		ATSParser::ProbeInfo before[ATSParser::NUM_SOURCE_TYPES];
+		for (int i = 0; i < ATSParser::NUM_SOURCE_TYPES; ++i)
+		{
+			if (!parser->getProbeInfo((ATSParser::SourceType)i, &before[i]))
+				before[i].firstPTS = -1;
+		}
+
+		if (start != offset)
+			parser->resetStreams(start);
+
+		size_t consumed = 0;
+		if (parser->feedTSPackets(data + start, tailEnd - start, &consumed) != OK)
+		{
+			LOGE("Failed to parse segment tail at %u", (unsigned)start);
+			return false;
+		}
+		tailEnd = start;
+
+		bool found = true;
+		for (int i = 0; i < ATSParser::NUM_SOURCE_TYPES; ++i)
+		{
+			ATSParser::ProbeInfo after;
+			if (before[i].firstPTS >= 0 && parser->getProbeInfo((ATSParser::SourceType)i, &after)
+					&& after.lastPTS == before[i].lastPTS)
+				found = false;
+		}
+		if (found)
+			break;
+	}
+
+	result->hasVideo = parser->getProbeInfo(ATSParser::VIDEO, &result->video);
+	result->hasAudio = parser->getProbeInfo(ATSParser::AUDIO, &result->audio);
+
+	LOGV("Probed %u + %u of %u bytes: video %lld-%lld%s, audio %lld-%lld", (unsigned)offset, (unsigned)(length - tailEnd), (unsigned)length,
+			result->hasVideo ? result->video.firstPTS : -1, result->hasVideo ? result->video.lastPTS : -1,
+			result->hasVideo && result->video.hasSyncFrame ? " (IDR)" : "",
+			result->hasAudio ? result->audio.firstPTS : -1, result->hasAudio ? result->audio.lastPTS : -1);
+
+	return result->getStartPTS() >= 0;
+}
+
+extern "C"
+{
+	// Fills out with video first/last PTS, audio first/last PTS (-1 where
+	// missing) and 1 or 0 for whether the video has an IDR.
+	jboolean Java_com_kaltura_hlsplayersdk_manifest_SegmentProbe_nativeProbe(JNIEnv *env, jclass caller, jbyteArray jdata, jint length, jint headBytes, jint tailBytes, jlongArray jout)
+	{
+		if (length < 0 || env->GetArrayLength(jdata) < length || env->GetArrayLength(jout) < 5)
+			return false;
+
+		SegmentProbe::Result result;
+		unsigned char *data = (unsigned char *)env->GetPrimitiveArrayCritical(jdata, NULL);
+		if (!data)
+			return false;
+		bool found = SegmentProbe::probe(data, length, headBytes, tailBytes, &result);
+		env->ReleasePrimitiveArrayCritical(jdata, data, JNI_ABORT);
+
+		if (!found)
+			return false;
+
+		jlong out[5];
+		out[0] = result.hasVideo ? result.video.firstPTS : -1;
+		out[1] = result.hasVideo ? result.video.lastPTS : -1;
+		out[2] = result.hasAudio ? result.audio.firstPTS : -1;
+		out[3] = result.hasAudio ? result.audio.lastPTS : -1;
+		out[4] = result.hasVideo && result.video.hasSyncFrame;
+		env->SetLongArrayRegion(jout, 0, 5, out);
+		return true;
+	}
+}
@@ -0,0 +1,48 @@
+#ifndef _SEGMENTPROBE_H_
+#define _SEGMENTPROBE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mpeg2ts_parser/ATSParser.h"
+
+// Finds the start time, end time and IDR presence of a TS segment without
+// demuxing it, for the segment start time discovery StreamHandler does for
+// live and seeking.
+//
+// The head of the segment goes through an ATSParser in PROBE_ONLY mode a
+// few packets at a time until every stream has a PTS and the video has an
+// IDR; the last PTS values then come from just the tail of the segment.
+class SegmentProbe
+{
+public:
+	struct Result
+	{
+		bool hasVideo;
+		bool hasAudio;
+		android::ATSParser::ProbeInfo video;
+		android::ATSParser::ProbeInfo audio;
+
+		// First PTS of the earliest stream, -1 if none was found.
+		int64_t getStartPTS() const;
+
+		// Longest first to last PTS span of any stream, in 90kHz ticks. The
+		// span ends where the last PES packet starts, its own duration isn't
+		// included.
+		int64_t getDurationPTS() const;
+	};
+
+	// Probe length bytes of segment. Parsing of the start stops once the
+	// answer is known or headBytes have been looked at (0 for no limit); the
+	// last PTS values come from the final tailBytes (0 to skip that), or
+	// further back for streams that have no PES packet starting in those.
+	static bool probe(const unsigned char *data, size_t length, size_t headBytes, size_t tailBytes, Result *result);
+
+private:
+	static const size_t kTSPacketSize = 188;
+
+	// Bytes fed between checks for a complete answer.
+	static const size_t kProbeStep = 16 * kTSPacketSize;
+};
+
+#endif
@@ -0,0 +1,350 @@
+#include "YUVRowConverter.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#define HAVE_YUV_SSE2
+#include <cpuid.h>
+#include <emmintrin.h>
+#endif
+
+#if defined(HAVE_YUV_NEON) && defined(__arm__)
+#include <cpu-features.h>
+#endif
+
+typedef void (*RowFunc)(const uint8_t *y, const uint8_t *u, const uint8_t *v, size_t chromaStep,
+		uint16_t *dst, size_t width, bool swapRB);
+typedef void (*CbYCrYRowFunc)(const uint8_t *src, uint16_t *dst, size_t width);
+
+#ifdef HAVE_YUV_NEON
+// YUVRowConverter_neon.cpp, built with NEON enabled.
+void convertRowNEON(const uint8_t *y, const uint8_t *u, const uint8_t *v, size_t chromaStep,
+		uint16_t *dst, size_t width, bool swapRB);
+void convertCbYCrYRowNEON(const uint8_t *src, uint16_t *dst, size_t width);
+#endif
+
+//----------------------------------------------------------------------------
+// C back end. The vector ones finish their rows with it, so convertRowC
+// and convertCbYCrYRowC are visible to YUVRowConverter_neon.cpp too.
+
+// B = 1.164 * (Y - 16) + 2.018 * (U - 128)
+// G = 1.164 * (Y - 16) - 0.813 * (V - 128) - 0.391 * (U - 128)
+// R = 1.164 * (Y - 16) + 1.596 * (V - 128)
+//
+// B = 298/256 * (Y - 16) + 517/256 * (U - 128)
+// G = .................. - 208/256 * (V - 128) - 100/256 * (U - 128)
+// R = .................. + 409/256 * (V - 128)
+//
+// Results range from -277 to 534 before clamping to 0..255.
+
+// Without branches, which random looking video mispredicts.
+static inline uint8_t clamp(signed x)
+{
+	x &= ~(x >> 31);
+	x |= (255 - x) >> 31;
+	return (uint8_t)x;
+}
+
+// Picked at compile time so the per pixel loops don't branch on it.
+template<bool swapRB>
+static inline uint16_t pack565(signed r, signed g, signed b)
+{
+	if (swapRB)
+		return ((clamp(b) >> 3) << 11) | ((clamp(g) >> 2) << 5) | (clamp(r) >> 3);
+	return ((clamp(r) >> 3) << 11) | ((clamp(g) >> 2) << 5) | (clamp(b) >> 3);
+}
+
+template<bool swapRB>
+static inline uint16_t convertPixelC(signed y, signed u_b, signed uv_g, signed v_r)
+{
+	signed tmp = (y - 16) * 298;
+	return pack565<swapRB>((tmp + v_r) / 256, (tmp + uv_g) / 256, (tmp + u_b) / 256);
+}
+
+template<bool swapRB>
+static void convertRowC(const uint8_t *y, const uint8_t *u, const uint8_t *v, size_t chromaStep,
+		uint16_t *dst, size_t width)
+{
+	for (size_t x = 0; x < width; x += 2)
+	{
+		signed uu = (signed)u[0] - 128;
+		signed vv = (signed)v[0] - 128;
+		u += chromaStep;
+		v += chromaStep;
+
+		signed u_b = uu * 517;
+		signed uv_g = -vv * 208 - uu * 100;
+		signed v_r = vv * 409;
+
+		dst[x] = convertPixelC<swapRB>(y[x], u_b, uv_g, v_r);
+		if (x + 1 < width)
+			dst[x + 1] = convertPixelC<swapRB>(y[x + 1], u_b, uv_g, v_r);
+	}
+}
+
+void convertRowC(const uint8_t *y, const uint8_t *u, const uint8_t *v, size_t chromaStep,
+		uint16_t *dst, size_t width, bool swapRB)
+{
+	if (swapRB)
+		convertRowC<true>(y, u, v, chromaStep, dst, width);
+	else
+		convertRowC<false>(y, u, v, chromaStep, dst, width);
+}
+
+void convertCbYCrYRowC(const uint8_t *src, uint16_t *dst, size_t width)
+{
+	for (size_t x = 0; x < width; x += 2)
+	{
+		signed u = (signed)src[2 * x] - 128;
+		signed v = (signed)src[2 * x + 2] - 128;
+
+		signed u_b = u * 517;
+		signed uv_g = -v * 208 - u * 100;
+		signed v_r = v * 409;
+
+		dst[x] = convertPixelC<false>(src[2 * x + 1], u_b, uv_g, v_r);
+		if (x + 1 < width)
+			dst[x + 1] = convertPixelC<false>(src[2 * x + 3], u_b, uv_g, v_r);
+	}
+}
+
+//----------------------------------------------------------------------------
+// SSE2 back end. 16 bit lanes throughout, except where the products need
+// 32: those go through _mm_madd_epi16 on (luma, chroma) pairs.
+
+#ifdef HAVE_YUV_SSE2
+static bool cpuHasSSE2()
+{
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+	return (edx & bit_SSE2) != 0;
+}
+
+// Two 16 bit coefficients for _mm_madd_epi16, lo applied to the even lanes.
+static inline __m128i coefficients(int16_t lo, int16_t hi)
+{
+	return _mm_set1_epi32((int)(((uint32_t)(uint16_t)hi << 16) | (uint16_t)lo));
+}
+
+// (a * ca + b * cb) >> 8 for 8 lanes, saturated to 0..255 in the low 8 bytes.
+static inline __m128i channelSSE2(__m128i a, __m128i b, __m128i c)
+{
+	__m128i lo = _mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), c), 8);
+	__m128i hi = _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), c), 8);
+	return _mm_packus_epi16(_mm_packs_epi32(lo, hi), _mm_setzero_si128());
+}
+
+// Green has three terms; the chroma ones are summed in 32 bits too.
+static inline __m128i greenSSE2(__m128i y, __m128i u, __m128i v)
+{
+	__m128i cy = coefficients(298, -100);
+	__m128i cv = coefficients(-208, 0);
+	__m128i zero = _mm_setzero_si128();
+
+	__m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(y, u), cy), _mm_madd_epi16(_mm_unpacklo_epi16(v, zero), cv));
+	__m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(y, u), cy), _mm_madd_epi16(_mm_unpackhi_epi16(v, zero), cv));
+	lo = _mm_srai_epi32(lo, 8);
+	hi = _mm_srai_epi32(hi, 8);
+	return _mm_packus_epi16(_mm_packs_epi32(lo, hi), zero);
+}
+
+// y, u and v are 8 lanes of 16 bit luma and chroma, one per pixel, with
+// the 16 and 128 offsets already taken off. The arithmetic shift rounds
+// negatives down where the C code rounds them towards zero, but either way
+// they clamp to 0.
+static inline void convert8SSE2(__m128i y, __m128i u, __m128i v, uint16_t *dst, bool swapRB)
+{
+	__m128i zero = _mm_setzero_si128();
+
+	__m128i b = _mm_unpacklo_epi8(channelSSE2(y, u, coefficients(298, 517)), zero);
+	__m128i g = _mm_unpacklo_epi8(greenSSE2(y, u, v), zero);
+	__m128i r = _mm_unpacklo_epi8(channelSSE2(y, v, coefficients(298, 409)), zero);
+
+	if (swapRB)
+	{
+		__m128i t = r;
+		r = b;
+		b = t;
+	}
+
+	__m128i rgb = _mm_or_si128(_mm_or_si128(
+			_mm_slli_epi16(_mm_srli_epi16(r, 3), 11),
+			_mm_slli_epi16(_mm_srli_epi16(g, 2), 5)),
+			_mm_srli_epi16(b, 3));
+	_mm_storeu_si128((__m128i *)dst, rgb);
+}
+
+static inline __m128i lumaSSE2(const uint8_t *y)
+{
+	return _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)y), _mm_setzero_si128()), _mm_set1_epi16(16));
+}
+
+static void convertRowSSE2(const uint8_t *y, const uint8_t *u, const uint8_t *v, size_t chromaStep,
+		uint16_t *dst, size_t width, bool swapRB)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i offset = _mm_set1_epi16(128);
+
+	size_t x = 0;
+	if (chromaStep == 1)
+	{
+		for (; x + 8 <= width; x += 8)
+		{
+			int32_t u4, v4;
+			memcpy(&u4, u + x / 2, 4);
+			memcpy(&v4, v + x / 2, 4);
+
+			__m128i uu = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(u4), zero), offset);
+			__m128i vv = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(v4), zero), offset);
+			convert8SSE2(lumaSSE2(y + x), _mm_unpacklo_epi16(uu, uu), _mm_unpacklo_epi16(vv, vv), dst + x, swapRB);
+		}
+	}
+	else if (chromaStep == 2 && (u + 1 == v || v + 1 == u))
+	{
+		// Four interleaved pairs give each chroma sample twice over with
+		// the 16 bit lane shuffles.
+		const uint8_t *uv = u < v ? u : v;
+		bool uFirst = u < v;
+		for (; x + 8 <= width; x += 8)
+		{
+			__m128i c = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(uv + x)), zero), offset);
+			__m128i first = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+			__m128i second = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+			convert8SSE2(lumaSSE2(y + x), uFirst ? first : second, uFirst ? second : first, dst + x, swapRB);
+		}
+	}
+
+	if (x < width)
+		convertRowC(y + x, u + (x / 2) * chromaStep, v + (x / 2) * chromaStep, chromaStep, dst + x, width - x, swapRB);
+}
+
+static void convertCbYCrYRowSSE2(const uint8_t *src, uint16_t *dst, size_t width)
+{
+	__m128i offset = _mm_set1_epi16(128);
+
+	size_t x = 0;
+	for (; x + 8 <= width; x += 8)
+	{
+		__m128i p = _mm_loadu_si128((const __m128i *)(src + 2 * x));
+		__m128i y = _mm_sub_epi16(_mm_srli_epi16(p, 8), _mm_set1_epi16(16));
+		__m128i c = _mm_sub_epi16(_mm_and_si128(p, _mm_set1_epi16(0xff)), offset);
+		__m128i u = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+		__m128i v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+		convert8SSE2(y, u, v, dst + x, false);
+	}
+
+	if (x < width)
+		convertCbYCrYRowC(src + 2 * x, dst + x, width - x);
+}
+#endif
+
+//----------------------------------------------------------------------------
+
+static RowFunc gRowFunc = convertRowC;
+static CbYCrYRowFunc gCbYCrYRowFunc = convertCbYCrYRowC;
+static YUVRowConverter::Backend gBackend = YUVRowConverter::BACKEND_C;
+static pthread_once_t gBackendOnce = PTHREAD_ONCE_INIT;
+
+static void applyBackend(YUVRowConverter::Backend backend)
+{
+	switch (backend)
+	{
+#ifdef HAVE_YUV_NEON
+	case YUVRowConverter::BACKEND_NEON:
+		gRowFunc = convertRowNEON;
+		gCbYCrYRowFunc = convertCbYCrYRowNEON;
+		break;
+#endif
+#ifdef HAVE_YUV_SSE2
+	case YUVRowConverter::BACKEND_SSE2:
+		gRowFunc = convertRowSSE2;
+		gCbYCrYRowFunc = convertCbYCrYRowSSE2;
+		break;
+#endif
+	default:
+		backend = YUVRowConverter::BACKEND_C;
+		gRowFunc = convertRowC;
+		gCbYCrYRowFunc = convertCbYCrYRowC;
+		break;
+	}
+	gBackend = backend;
+}
+
+static void selectBestBackend()
+{
+	applyBackend(YUVRowConverter::getBestBackend());
+}
+
+void YUVRowConverter::convertRow(const uint8_t *y, const uint8_t *u, const uint8_t *v, size_t chromaStep,
+		uint16_t *dst, size_t width, bool swapRB)
+{
+	pthread_once(&gBackendOnce, selectBestBackend);
+	gRowFunc(y, u, v, chromaStep, dst, width, swapRB);
+}
+
+void YUVRowConverter::convertCbYCrYRow(const uint8_t *src, uint16_t *dst, size_t width)
+{
+	pthread_once(&gBackendOnce, selectBestBackend);
+	gCbYCrYRowFunc(src, dst, width);
+}
+
+void YUVRowConverter::setBackend(Backend backend)
+{
+	pthread_once(&gBackendOnce, selectBestBackend);
+
+	if (backend == BACKEND_AUTO || !isSupported(backend))
+		backend = getBestBackend();
+	applyBackend(backend);
+}
+
+YUVRowConverter::Backend YUVRowConverter::getBackend()
+{
+	pthread_once(&gBackendOnce, selectBestBackend);
+	return gBackend;
+}
+
+bool YUVRowConverter::isSupported(Backend backend)
+{
+	switch (backend)
+	{
+	case BACKEND_C:
+		return true;
+#ifdef HAVE_YUV_NEON
+	case BACKEND_NEON:
+#if defined(__arm__)
+		return android_getCpuFamily() == ANDROID_CPU_FAMILY_ARM
+				&& (android_getCpuFeatures() & ANDROID_CPU_ARM_FEATURE_NEON) != 0;
+#else
+		return true; // Always there on arm64.
+#endif
+#endif
+#ifdef HAVE_YUV_SSE2
+	case BACKEND_SSE2:
+		return cpuHasSSE2();
+#endif
+	default:
+		return false;
+	}
+}
+
+YUVRowConverter::Backend YUVRowConverter::getBestBackend()
+{
+	if (isSupported(BACKEND_NEON))
+		return BACKEND_NEON;
+	if (isSupported(BACKEND_SSE2))
+		return BACKEND_SSE2;
+	return BACKEND_C;
+}
+
+const char *YUVRowConverter::getBackendName(Backend backend)
+{
+	switch (backend)
+	{
+	case BACKEND_C: return "c";
+	case BACKEND_NEON: return "neon";
+	case BACKEND_SSE2: return "sse2";
+	default: return "unknown";
+	}
+}
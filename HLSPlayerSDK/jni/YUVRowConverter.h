@@ -0,0 +1,55 @@
+#ifndef _YUVROWCONVERTER_H_
+#define _YUVROWCONVERTER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// One row at a time YUV to RGB565 conversion for the software renderer
+// (ColorConverter_Local and ColorConverter444), with the BT.601 fixed point
+// math those have always used. Several back ends are built in and the
+// fastest one the CPU supports is picked at runtime; all of them produce
+// exactly the same pixels:
+//
+//   BACKEND_C     The original per pixel code, always available.
+//   BACKEND_NEON  16 pixels at a time. Needs an armeabi-v7a build
+//                 (HAVE_YUV_NEON) and NEON on the CPU. arm64-v8a is wired
+//                 up too, but isn't in APP_ABI yet.
+//   BACKEND_SSE2  8 pixels at a time, on x86 builds with SSE2.
+//
+// Pixels go in pairs sharing a chroma sample. An odd width converts the
+// last pixel on its own.
+class YUVRowConverter
+{
+public:
+	enum Backend
+	{
+		BACKEND_AUTO = -1,
+		BACKEND_C = 0,
+		BACKEND_NEON,
+		BACKEND_SSE2,
+		BACKEND_COUNT
+	};
+
+	// Planar or semi-planar chroma: pixels 2i and 2i + 1 take theirs from
+	// u[i * chromaStep] and v[i * chromaStep], so interleaved chroma is
+	// u = uv, v = uv + 1 (or the other way round) with a step of 2. swapRB
+	// puts blue in the top bits instead of red, as the semi-planar
+	// converters do.
+	static void convertRow(const uint8_t *y, const uint8_t *u, const uint8_t *v, size_t chromaStep,
+			uint16_t *dst, size_t width, bool swapRB);
+
+	// Packed Cb Y0 Cr Y1.
+	static void convertCbYCrYRow(const uint8_t *src, uint16_t *dst, size_t width);
+
+	// Switches every later conversion over; falls back to the best
+	// supported back end if this one isn't. Not safe to call while another
+	// thread is converting. For benchmarks and testing.
+	static void setBackend(Backend backend);
+	static Backend getBackend();
+
+	static bool isSupported(Backend backend);
+	static Backend getBestBackend();
+	static const char *getBackendName(Backend backend);
+};
+
+#endif /* _YUVROWCONVERTER_H_ */
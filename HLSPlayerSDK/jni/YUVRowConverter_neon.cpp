@@ -0,0 +1,111 @@
+// NEON back end for YUVRowConverter. Built with NEON enabled only on the
+// ABIs that can have it (see Android.mk); armeabi-v7a checks for it at
+// runtime before this gets used.
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+
+#include <arm_neon.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The C back end, for the ends of rows.
+void convertRowC(const uint8_t *y, const uint8_t *u, const uint8_t *v, size_t chromaStep,
+		uint16_t *dst, size_t width, bool swapRB);
+void convertCbYCrYRowC(const uint8_t *src, uint16_t *dst, size_t width);
+
+// Each chroma lane twice over, for the two pixels that share it.
+static inline int32x4x2_t duplicate(int32x4_t c)
+{
+	return vzipq_s32(c, c);
+}
+
+// (luma + chroma) >> 8 for 8 pixels, saturated to 0..255. The arithmetic
+// shift rounds negatives down where the C code rounds them towards zero,
+// but either way they clamp to 0.
+static inline uint8x8_t channel(int32x4_t yLo, int32x4_t yHi, int32x4x2_t c)
+{
+	int16x8_t x = vcombine_s16(vshrn_n_s32(vaddq_s32(yLo, c.val[0]), 8), vshrn_n_s32(vaddq_s32(yHi, c.val[1]), 8));
+	return vqmovun_s16(x);
+}
+
+static inline uint16x8_t pack565(uint8x8_t r, uint8x8_t g, uint8x8_t b)
+{
+	uint16x8_t rgb = vshll_n_u8(r, 8);
+	rgb = vsriq_n_u16(rgb, vshll_n_u8(g, 8), 5);
+	return vsriq_n_u16(rgb, vshll_n_u8(b, 8), 11);
+}
+
+// 8 pixels from 8 luma samples and the 4 chroma samples (offset taken off)
+// they share.
+static inline void convert8(uint8x8_t y8, int16x4_t u, int16x4_t v, uint16_t *dst, bool swapRB)
+{
+	int16x8_t y = vreinterpretq_s16_u16(vsubl_u8(y8, vdup_n_u8(16)));
+	int32x4_t yLo = vmull_n_s16(vget_low_s16(y), 298);
+	int32x4_t yHi = vmull_n_s16(vget_high_s16(y), 298);
+
+	int32x4x2_t ub = duplicate(vmull_n_s16(u, 517));
+	int32x4x2_t uvg = duplicate(vmlal_n_s16(vmull_n_s16(u, -100), v, -208));
+	int32x4x2_t vr = duplicate(vmull_n_s16(v, 409));
+
+	uint8x8_t b = channel(yLo, yHi, ub);
+	uint8x8_t g = channel(yLo, yHi, uvg);
+	uint8x8_t r = channel(yLo, yHi, vr);
+
+	vst1q_u16(dst, swapRB ? pack565(b, g, r) : pack565(r, g, b));
+}
+
+// 16 pixels: y0 and y1 are pixels 0-7 and 8-15, u and v their 8 chroma
+// samples.
+static inline void convert16(uint8x8_t y0, uint8x8_t y1, uint8x8_t u8, uint8x8_t v8, uint16_t *dst, bool swapRB)
+{
+	int16x8_t u = vreinterpretq_s16_u16(vsubl_u8(u8, vdup_n_u8(128)));
+	int16x8_t v = vreinterpretq_s16_u16(vsubl_u8(v8, vdup_n_u8(128)));
+
+	convert8(y0, vget_low_s16(u), vget_low_s16(v), dst, swapRB);
+	convert8(y1, vget_high_s16(u), vget_high_s16(v), dst + 8, swapRB);
+}
+
+void convertRowNEON(const uint8_t *y, const uint8_t *u, const uint8_t *v, size_t chromaStep,
+		uint16_t *dst, size_t width, bool swapRB)
+{
+	size_t x = 0;
+	if (chromaStep == 1)
+	{
+		for (; x + 16 <= width; x += 16)
+		{
+			uint8x16_t yy = vld1q_u8(y + x);
+			convert16(vget_low_u8(yy), vget_high_u8(yy), vld1_u8(u + x / 2), vld1_u8(v + x / 2), dst + x, swapRB);
+		}
+	}
+	else if (chromaStep == 2 && (u + 1 == v || v + 1 == u))
+	{
+		bool uFirst = u < v;
+		const uint8_t *uv = uFirst ? u : v;
+		for (; x + 16 <= width; x += 16)
+		{
+			uint8x16_t yy = vld1q_u8(y + x);
+			uint8x8x2_t c = vld2_u8(uv + x);
+			convert16(vget_low_u8(yy), vget_high_u8(yy), c.val[uFirst ? 0 : 1], c.val[uFirst ? 1 : 0], dst + x, swapRB);
+		}
+	}
+
+	if (x < width)
+		convertRowC(y + x, u + (x / 2) * chromaStep, v + (x / 2) * chromaStep, chromaStep, dst + x, width - x, swapRB);
+}
+
+void convertCbYCrYRowNEON(const uint8_t *src, uint16_t *dst, size_t width)
+{
+	size_t x = 0;
+	for (; x + 16 <= width; x += 16)
+	{
+		// Cb, Y0, Cr, Y1 for 8 pixel pairs; the luma goes back in order.
+		uint8x8x4_t p = vld4_u8(src + 2 * x);
+		uint8x8x2_t yy = vzip_u8(p.val[1], p.val[3]);
+		convert16(yy.val[0], yy.val[1], p.val[0], p.val[2], dst + x, false);
+	}
+
+	if (x < width)
+		convertCbYCrYRowC(src + 2 * x, dst + x, width - x);
+}
+
+#endif
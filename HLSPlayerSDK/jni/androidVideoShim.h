@@ -1220,15 +1220,60 @@ namespace android_video_shim
         virtual ~DataSource() {}
     };
 
+    class MediaBufferObserver;
+
     class MediaBuffer
     {
     public:
+        char padding[1024]; // Padding to make sure we have enough RAM for the platform object.
+
+        // The platform constructors build the real object in this storage,
+        // and release() frees it with the platform's delete, so it comes
+        // from malloc at the padded size, zeroed.
+        static void *operator new(size_t size)
+        {
+            void *p = calloc(1, size);
+            assert(p);
+            return p;
+        }
+
+        static void operator delete(void *p)
+        {
+            free(p);
+        }
 
         MediaBuffer()
         {
             assert(0); // We don't want to make our own with this path.
         }
 
+        // Wraps data we own without copying it. Only valid if
+        // canWrapExternalData() says the platform has what we need.
+        MediaBuffer(void *data, size_t size)
+        {
+            typedef void (*localFuncCast)(void *thiz, void *data, unsigned int size);
+            localFuncCast lfc = (localFuncCast)searchSymbol("_ZN7android11MediaBufferC1EPvj");
+            assert(lfc);
+            LOGV2("MediaBuffer::ctor with data = %p", lfc);
+            lfc(this, data, size);
+        }
+
+        static bool canWrapExternalData()
+        {
+            return searchSymbol("_ZN7android11MediaBufferC1EPvj")
+                && searchSymbol("_ZN7android11MediaBuffer11setObserverEPNS_19MediaBufferObserverE")
+                && searchSymbol("_ZN7android11MediaBuffer7add_refEv");
+        }
+
+        void setObserver(MediaBufferObserver *observer)
+        {
+            typedef void (*localFuncCast)(void *thiz, MediaBufferObserver *observer);
+            localFuncCast lfc = (localFuncCast)searchSymbol("_ZN7android11MediaBuffer11setObserverEPNS_19MediaBufferObserverE");
+            assert(lfc);
+            LOGV2("MediaBuffer::setObserver = %p", lfc);
+            lfc(this, observer);
+        }
+
         MediaBuffer(size_t size)
         {
             typedef void (*localFuncCast)(void *thiz, unsigned int size);
@@ -1253,7 +1298,11 @@ namespace android_video_shim
         // Increments the reference count.
         void add_ref()
         {
-            assert(0);
+            typedef void (*localFuncCast)(void *thiz);
+            localFuncCast lfc = (localFuncCast)searchSymbol("_ZN7android11MediaBuffer7add_refEv");
+            assert(lfc);
+            LOGV2("MediaBuffer::add_ref = %p", lfc);
+            lfc(this);
         }
 
         void *data()
@@ -1332,9 +1381,6 @@ namespace android_video_shim
             assert(0);
         }
 
-        // Dummy memory to make sure we can hold everything.
-        char dummy[256];
-
     };
 
     class MediaSource : public virtual RefBase
@@ -2158,7 +2204,8 @@ namespace android_video_shim
     {
     public:
         HLSDataSource(): mSourceIdx(0), mSegmentStartOffset(0), mOffsetAdjustment(0),
-        				 mContinuityEra(0), mQuality(0), mStartTime(0)
+        				 mContinuityEra(0), mQuality(0), mStartTime(0), mSegmentReadCount(0), mReleasedIdx(0),
+        				 mSegmentReadOffset(0)
         {
             // Initialize our mutex.
             int err = initRecursivePthreadMutex(&lock);
@@ -2255,15 +2302,24 @@ namespace android_video_shim
 
         virtual ~HLSDataSource()
         {
-
+            clearSources();
         }
 
         void clearSources()
         {
             AutoLock locker(&lock, __func__);
+            for (int i = mReleasedIdx; i < mSources.size(); ++i)
+            {
+            	HLSSegmentCache::release(mSources[i]->uri);
+            	HLSSegmentCache::close(mSources[i]);
+            }
         	mSources.clear();
+        	mDurations.clear();
+        	mSegmentReadOffset = 0;
+        	mReleasedIdx = 0;
         	mSourceIdx = 0;
         	mOffsetAdjustment = 0;
+        	mSegmentReadCount = 0;
         }
 
         bool isSameEra(int quality, int continuityEra)
@@ -2271,7 +2327,8 @@ namespace android_video_shim
         	return mSources.size() == 0 || (mSources.size() > 0 && quality == mQuality && continuityEra == mContinuityEra);
         }
 
-        status_t append(const char* uri, int quality, int continuityEra, double startTime, int cryptoId)
+        // duration is the segment's length in seconds, 0 if not known.
+        status_t append(const char* uri, int quality, int continuityEra, double startTime, double duration, int cryptoId)
         {
             AutoLock locker(&lock, __func__);
 
@@ -2284,18 +2341,18 @@ namespace android_video_shim
             mQuality = quality;
             mContinuityEra = continuityEra;
 
-            // Small memory leak, look out.
-            uri = strdup(uri);
-
-            // Stick it in our sources.
-            mSources.push_back(uri);
+            // Stick it in our sources, and have the segment cache hand
+            // the bytes over to native memory once they're ready.
+            mSources.push_back(HLSSegmentCache::open(uri));
+            mDurations.push_back(duration);
+            HLSSegmentCache::expect(uri, cryptoId);
 
             return OK;
         }
 
         void logContinuityInfo()
         {
-        	LOGI("Quality = %d | Continuity Era = %d | Time = %f | First URI = %s ", mQuality, mContinuityEra, mStartTime, *mSources.begin()  );
+        	LOGI("Quality = %d | Continuity Era = %d | Time = %f | First URI = %s ", mQuality, mContinuityEra, mStartTime, mSources.size() > mReleasedIdx ? mSources[mReleasedIdx]->uri : "(none)"  );
         }
 
         int getQualityLevel()
@@ -2313,6 +2370,14 @@ namespace android_video_shim
         	return mStartTime;
         }
 
+        // Number of HLSSegmentCache::read calls (each one a JNI round trip)
+        // made against the current segment so far.
+        uint32_t getSegmentReadCount()
+        {
+            AutoLock locker(&lock, __func__);
+            return mSegmentReadCount;
+        }
+
         int getPreloadedSegmentCount()
         {
             AutoLock locker(&lock, __func__);
@@ -2320,6 +2385,36 @@ namespace android_video_shim
             return res;
         }
 
+        // Seconds of media not yet read: the segments after the current one,
+        // and the part of the current one past the last read, going by how
+        // much of its size that is. False if a segment's duration or the
+        // current one's size isn't known.
+        bool getUnreadDuration(double *seconds)
+        {
+            AutoLock locker(&lock, __func__);
+
+            *seconds = 0;
+            for (int i = mSourceIdx; i < mSources.size(); ++i)
+            {
+            	if (mDurations[i] <= 0)
+            		return false;
+
+            	if (i > mSourceIdx || mSegmentReadOffset == 0)
+            	{
+            		*seconds += mDurations[i];
+            		continue;
+            	}
+
+            	int64_t size = mSources[i]->size;
+            	if (size <= 0)
+            		return false;
+            	if (mSegmentReadOffset < size)
+            		*seconds += mDurations[i] * (double)(size - mSegmentReadOffset) / (double)size;
+            }
+
+            return true;
+        }
+
         void touch()
         {
             AutoLock locker(&lock, __func__);
@@ -2350,7 +2445,7 @@ namespace android_video_shim
                 return 0;
             }
 
-            LOGDATAMINING("Attempting _readAt mSources[mSourceIdx]=%s %lld %p %d mOffsetAdjustment=%lld", mSources[mSourceIdx], offset, data, size, mOffsetAdjustment);
+            LOGDATAMINING("Attempting _readAt mSources[mSourceIdx]=%s %lld %p %d mOffsetAdjustment=%lld", mSources[mSourceIdx]->uri, offset, data, size, mOffsetAdjustment);
 
             // Calculate adjusted offset based on reads so far. The TSExtractor
             // always reads in order.
@@ -2369,6 +2464,12 @@ namespace android_video_shim
 
                     assert(mSourceIdx > 0);
 
+                    if(mSourceIdx <= mReleasedIdx)
+                    {
+                        LOGE("Can't walk back from %s, the segments before it are closed", mSources[mSourceIdx]->uri);
+                        return 0;
+                    }
+
                     // Walk back to preceding source!
                     int64_t sourceSize = HLSSegmentCache::getSize(mSources[mSourceIdx-1]);
                     LOGDATAMINING("Retreating by %lld bytes!", sourceSize);
@@ -2377,14 +2478,17 @@ namespace android_video_shim
                     adjOffset += sourceSize;
 
                     mSourceIdx--;
+                    mSegmentReadCount = 0;
+                    mSegmentReadOffset = 0;
                 }
 
                 // Attempt a read. Blocking and tries VERY hard not to fail.
                 ssize_t lastReadSize = HLSSegmentCache::read(mSources[mSourceIdx], adjOffset + readSize, sizeLeft, ((unsigned char*)data) + readSize);
+                mSegmentReadCount++;
 
                 if (sizeLeft - lastReadSize < 0)
                 {
-                	LOGW("NEGATIVE SIZE LEFT: sizeLeft=%d lastReadSize=%d source=%s", sizeLeft, lastReadSize, mSources[mSourceIdx]); // Something happened to the segment - maybe it's 404
+                	LOGW("NEGATIVE SIZE LEFT: sizeLeft=%d lastReadSize=%d source=%s", sizeLeft, lastReadSize, mSources[mSourceIdx]->uri); // Something happened to the segment - maybe it's 404
 
                 	sizeLeft = 0;
                 	readSize = 0;
@@ -2395,6 +2499,7 @@ namespace android_video_shim
                 // Account for read.
                 sizeLeft -= lastReadSize;
                 readSize += lastReadSize;
+                mSegmentReadOffset = adjOffset + readSize;
 
                 // If done reading, then we can break out.
                 if(sizeLeft == 0)
@@ -2410,7 +2515,22 @@ namespace android_video_shim
                     mOffsetAdjustment += sourceSize;
                     adjOffset -= sourceSize;
 
+                    LOGI("Finished segment %s (%lld bytes) in %u segment cache reads", mSources[mSourceIdx]->uri, sourceSize, mSegmentReadCount);
+
                     mSourceIdx++;
+                    mSegmentReadCount = 0;
+                    mSegmentReadOffset = 0;
+
+                    // Keep one segment behind us for walk back, let go of
+                    // anything older. Its handle goes too, so the Java
+                    // string, URI copy and read window don't pile up over
+                    // a long session.
+                    while(mReleasedIdx + 1 < mSourceIdx)
+                    {
+                    	HLSSegmentCache::release(mSources[mReleasedIdx]->uri);
+                    	HLSSegmentCache::close(mSources[mReleasedIdx]);
+                    	mSources[mReleasedIdx++] = NULL;
+                    }
                 }
                 else
                 {
@@ -2420,6 +2540,12 @@ namespace android_video_shim
                 }
             }
 
+            // Learn the size of the segment we're in once, so
+            // getUnreadDuration() can tell how far through it we are. It's
+            // been read from, so this doesn't wait on a download.
+            if(readSize > 0 && mSources[mSourceIdx]->size < 0)
+                HLSSegmentCache::getSize(mSources[mSourceIdx]);
+
             // Make sure we didn't do anything weird.
             if(safety == 0)
             {
@@ -2456,13 +2582,17 @@ namespace android_video_shim
     private:
 
         pthread_mutex_t lock;
-        std::vector< const char * > mSources;
+        std::vector< HLSSegmentHandle * > mSources;
+        std::vector< double > mDurations; // Seconds, parallel to mSources.
         uint32_t mSourceIdx;
         off64_t mSegmentStartOffset;
         off64_t mOffsetAdjustment;
         int mQuality;
         int mContinuityEra;
         double mStartTime;
+        uint32_t mSegmentReadCount;
+        uint32_t mReleasedIdx; // Sources before this have been released from the native store and closed (NULL).
+        int64_t mSegmentReadOffset; // End of the last read within the current source.
 
     };
 
@@ -16,6 +16,8 @@
  */
 
 #include "androidVideoShim_ColorConverter.h"
+#include "ConversionPool.h"
+#include "YUVRowConverter.h"
 
 namespace android_video_shim {
 
@@ -30,13 +32,10 @@ static const size_t NV12TILE_BLOCK_GROUP_SIZE =  NV12TILE_BLOCK_SIZE*4;
 ColorConverter_Local::ColorConverter_Local(
         OMX_COLOR_FORMATTYPE from, OMX_COLOR_FORMATTYPE to)
     : mSrcFormat(from),
-      mDstFormat(to),
-      mClip(NULL) {
+      mDstFormat(to) {
 }
 
 ColorConverter_Local::~ColorConverter_Local() {
-    delete[] mClip;
-    mClip = NULL;
 }
 
 bool ColorConverter_Local::isValid() const {
@@ -58,11 +57,47 @@ bool ColorConverter_Local::isValid() const {
     }
 }
 
+namespace {
+struct StripArgs {
+    ColorConverter_Local *converter;
+    size_t width, height;
+    const void *srcBits;
+    size_t srcSkip;
+    void *dstBits;
+    size_t dstSkip;
+};
+}
+
+static void convertStrip(void *arg, size_t firstRow, size_t lastRow) {
+    StripArgs *args = (StripArgs *)arg;
+    args->converter->convertRows(
+            args->width, args->height, args->srcBits, args->srcSkip,
+            args->dstBits, args->dstSkip, firstRow, lastRow);
+}
+
 void ColorConverter_Local::convert(
         size_t width, size_t height,
         const void *srcBits, size_t srcSkip,
         void *dstBits, size_t dstSkip) {
     CHECK_EQ(mDstFormat, OMX_COLOR_Format16bitRGB565);
+
+    StripArgs args = { this, width, height, srcBits, srcSkip, dstBits, dstSkip };
+
+    // Strips start on even rows, so on a chroma row of their own, and tiled
+    // frames are split between block rows.
+    size_t rowAlignment = 2;
+    if (mSrcFormat == QOMX_COLOR_FormatYUV420PackedSemiPlanar64x32Tile2m8ka) {
+        rowAlignment = NV12TILE_BLOCK_HEIGHT;
+    }
+
+    ConversionPool::run(convertStrip, &args, width, height, rowAlignment);
+}
+
+void ColorConverter_Local::convertRows(
+        size_t width, size_t height,
+        const void *srcBits, size_t srcSkip,
+        void *dstBits, size_t dstSkip,
+        size_t firstRow, size_t lastRow) {
     size_t alignedWidth = ((width + 31) & -32);
 
     int baseColorFormat, temp1, temp2;
@@ -70,33 +105,39 @@ void ColorConverter_Local::convert(
     switch (mSrcFormat) {
         case OMX_COLOR_FormatYUV420Planar:
             convertYUV420Planar(
-                    width, height, srcBits, srcSkip, dstBits, dstSkip);
+                    width, height, srcBits, srcSkip, dstBits, dstSkip,
+                    firstRow, lastRow);
             break;
 
         case OMX_COLOR_FormatCbYCrY:
             convertCbYCrY(
-                    width, height, srcBits, srcSkip, dstBits, dstSkip);
+                    width, height, srcBits, srcSkip, dstBits, dstSkip,
+                    firstRow, lastRow);
             break;
 
         case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
             convertQCOMYUV420SemiPlanar(
-                    width, height, srcBits, srcSkip, dstBits, dstSkip);
+                    width, height, srcBits, srcSkip, dstBits, dstSkip,
+                    firstRow, lastRow);
             break;
 
         case OMX_COLOR_FormatYUV420SemiPlanar:
             if(alignedWidth != width) {
                 convertYUV420SemiPlanar32Aligned(
-                        width, height, srcBits, srcSkip, dstBits, 2 * alignedWidth, alignedWidth);
+                        width, height, srcBits, srcSkip, dstBits, 2 * alignedWidth, alignedWidth,
+                        firstRow, lastRow);
             }
             else {
                 convertYUV420SemiPlanar(
-                        width, height, srcBits, srcSkip, dstBits, dstSkip);
+                        width, height, srcBits, srcSkip, dstBits, dstSkip,
+                        firstRow, lastRow);
             }
             break;
 
         case QOMX_COLOR_FormatYUV420PackedSemiPlanar64x32Tile2m8ka:
             convertNV12Tile(
-                    width, height, srcBits, srcSkip, dstBits, dstSkip);
+                    width, height, srcBits, srcSkip, dstBits, dstSkip,
+                    firstRow, lastRow);
             break;
 
         default:
@@ -110,51 +151,21 @@ void ColorConverter_Local::convert(
 void ColorConverter_Local::convertCbYCrY(
         size_t width, size_t height,
         const void *srcBits, size_t srcSkip,
-        void *dstBits, size_t dstSkip) {
+        void *dstBits, size_t dstSkip,
+        size_t firstRow, size_t lastRow) {
     CHECK_EQ(srcSkip, 0);  // Doesn't really make sense for YUV formats.
     CHECK(dstSkip >= width * 2);
     CHECK((dstSkip & 3) == 0);
 
-    uint8_t *kAdjustedClip = initClip();
-
     uint32_t *dst_ptr = (uint32_t *)dstBits;
 
     const uint8_t *src = (const uint8_t *)srcBits;
 
-    for (size_t y = 0; y < height; ++y) {
-        for (size_t x = 0; x < width; x += 2) {
-            signed y1 = (signed)src[2 * x + 1] - 16;
-            signed y2 = (signed)src[2 * x + 3] - 16;
-            signed u = (signed)src[2 * x] - 128;
-            signed v = (signed)src[2 * x + 2] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
-
-            dst_ptr[x / 2] = (rgb2 << 16) | rgb1;
-        }
+    src += firstRow * width * 2;
+    dst_ptr += firstRow * (dstSkip / 4);
+
+    for (size_t y = firstRow; y < lastRow; ++y) {
+        YUVRowConverter::convertCbYCrYRow(src, (uint16_t *)dst_ptr, (width + 1) & ~1);
 
         src += width * 2;
         dst_ptr += dstSkip / 4;
@@ -164,13 +175,12 @@ void ColorConverter_Local::convertCbYCrY(
 void ColorConverter_Local::convertYUV420Planar(
         size_t width, size_t height,
         const void *srcBits, size_t srcSkip,
-        void *dstBits, size_t dstSkip) {
+        void *dstBits, size_t dstSkip,
+        size_t firstRow, size_t lastRow) {
     CHECK_EQ(srcSkip, 0);  // Doesn't really make sense for YUV formats.
     CHECK(dstSkip >= width * 2);
     CHECK((dstSkip & 3) == 0);
 
-    uint8_t *kAdjustedClip = initClip();
-
     uint32_t *dst_ptr = (uint32_t *)dstBits;
     const uint8_t *src_y = (const uint8_t *)srcBits;
 
@@ -180,59 +190,15 @@ void ColorConverter_Local::convertYUV420Planar(
     const uint8_t *src_v =
         (const uint8_t *)src_u + (width / 2) * (height / 2);
 
-    for (size_t y = 0; y < height; ++y) {
-        for (size_t x = 0; x < width; x += 2) {
-            // B = 1.164 * (Y - 16) + 2.018 * (U - 128)
-            // G = 1.164 * (Y - 16) - 0.813 * (V - 128) - 0.391 * (U - 128)
-            // R = 1.164 * (Y - 16) + 1.596 * (V - 128)
-
-            // B = 298/256 * (Y - 16) + 517/256 * (U - 128)
-            // G = .................. - 208/256 * (V - 128) - 100/256 * (U - 128)
-            // R = .................. + 409/256 * (V - 128)
-
-            // min_B = (298 * (- 16) + 517 * (- 128)) / 256 = -277
-            // min_G = (298 * (- 16) - 208 * (255 - 128) - 100 * (255 - 128)) / 256 = -172
-            // min_R = (298 * (- 16) + 409 * (- 128)) / 256 = -223
-
-            // max_B = (298 * (255 - 16) + 517 * (255 - 128)) / 256 = 534
-            // max_G = (298 * (255 - 16) - 208 * (- 128) - 100 * (- 128)) / 256 = 432
-            // max_R = (298 * (255 - 16) + 409 * (255 - 128)) / 256 = 481
-
-            // clip range -278 .. 535
-
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
+    // Strips start on even rows, so on a chroma row of their own.
+    src_y += firstRow * width;
+    src_u += (firstRow / 2) * (width / 2);
+    src_v += (firstRow / 2) * (width / 2);
+    dst_ptr += firstRow * (dstSkip / 4);
 
-            signed u = (signed)src_u[x / 2] - 128;
-            signed v = (signed)src_v[x / 2] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
-
-            dst_ptr[x / 2] = (rgb2 << 16) | rgb1;
-        }
+    for (size_t y = firstRow; y < lastRow; ++y) {
+        YUVRowConverter::convertRow(
+                src_y, src_u, src_v, 1, (uint16_t *)dst_ptr, (width + 1) & ~1, false);
 
         src_y += width;
 
@@ -248,54 +214,25 @@ void ColorConverter_Local::convertYUV420Planar(
 void ColorConverter_Local::convertQCOMYUV420SemiPlanar(
         size_t width, size_t height,
         const void *srcBits, size_t srcSkip,
-        void *dstBits, size_t dstSkip) {
+        void *dstBits, size_t dstSkip,
+        size_t firstRow, size_t lastRow) {
     CHECK_EQ(srcSkip, 0);  // Doesn't really make sense for YUV formats.
     CHECK(dstSkip >= width * 2);
     CHECK((dstSkip & 3) == 0);
 
-    uint8_t *kAdjustedClip = initClip();
-
     uint32_t *dst_ptr = (uint32_t *)dstBits;
     const uint8_t *src_y = (const uint8_t *)srcBits;
 
     const uint8_t *src_u =
         (const uint8_t *)src_y + width * height;
 
-    for (size_t y = 0; y < height; ++y) {
-        for (size_t x = 0; x < width; x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed u = (signed)src_u[x & ~1] - 128;
-            signed v = (signed)src_u[(x & ~1) + 1] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
+    src_y += firstRow * width;
+    src_u += (firstRow / 2) * width;
+    dst_ptr += firstRow * (dstSkip / 4);
 
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[b1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[r1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[b2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[r2] >> 3);
-
-            dst_ptr[x / 2] = (rgb2 << 16) | rgb1;
-        }
+    for (size_t y = firstRow; y < lastRow; ++y) {
+        YUVRowConverter::convertRow(
+                src_y, src_u, src_u + 1, 2, (uint16_t *)dst_ptr, (width + 1) & ~1, true);
 
         src_y += width;
 
@@ -310,54 +247,25 @@ void ColorConverter_Local::convertQCOMYUV420SemiPlanar(
 void ColorConverter_Local::convertYUV420SemiPlanar(
         size_t width, size_t height,
         const void *srcBits, size_t srcSkip,
-        void *dstBits, size_t dstSkip) {
+        void *dstBits, size_t dstSkip,
+        size_t firstRow, size_t lastRow) {
     CHECK_EQ(srcSkip, 0);  // Doesn't really make sense for YUV formats.
     CHECK(dstSkip >= width * 2);
     CHECK((dstSkip & 3) == 0);
 
-    uint8_t *kAdjustedClip = initClip();
-
     uint32_t *dst_ptr = (uint32_t *)dstBits;
     const uint8_t *src_y = (const uint8_t *)srcBits;
 
     const uint8_t *src_u =
         (const uint8_t *)src_y + width * height;
 
-    for (size_t y = 0; y < height; ++y) {
-        for (size_t x = 0; x < width; x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed v = (signed)src_u[x & ~1] - 128;
-            signed u = (signed)src_u[(x & ~1) + 1] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
+    src_y += firstRow * width;
+    src_u += (firstRow / 2) * width;
+    dst_ptr += firstRow * (dstSkip / 4);
 
-            uint32_t rgb1 =
-                ((kAdjustedClip[b1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[r1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[b2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[r2] >> 3);
-
-            dst_ptr[x / 2] = (rgb2 << 16) | rgb1;
-        }
+    for (size_t y = firstRow; y < lastRow; ++y) {
+        YUVRowConverter::convertRow(
+                src_y, src_u + 1, src_u, 2, (uint16_t *)dst_ptr, (width + 1) & ~1, true);
 
         src_y += width;
 
@@ -369,21 +277,6 @@ void ColorConverter_Local::convertYUV420SemiPlanar(
     }
 }
 
-uint8_t *ColorConverter_Local::initClip() {
-    static const signed kClipMin = -278;
-    static const signed kClipMax = 535;
-
-    if (mClip == NULL) {
-        mClip = new uint8_t[kClipMax - kClipMin + 1];
-
-        for (signed i = kClipMin; i <= kClipMax; ++i) {
-            mClip[i - kClipMin] = (i < 0) ? 0 : (i > 255) ? 255 : (uint8_t)i;
-        }
-    }
-
-    return &mClip[-kClipMin];
-}
-
 // GetTiledMemBlockNum
 // Calculate the block number within tiled memory where the given frame space
 // block resides.
@@ -459,30 +352,8 @@ void ColorConverter_Local::nv12TileComputeRGB(
 
     uint8_t *dest_ptr = *dstPtr;
 
-    uint8_t *kAdjustedClip = initClip();
-
-    for(size_t i = 0; i < blockWidth; i++) {
-        signed y1 = (signed)blockY[i] - 16;;
-        signed u = (signed)blockUV[i & ~1] - 128;
-        signed v = (signed)blockUV[(i & ~1)+1]- 128;
-
-        signed u_b = u * 517;
-        signed u_g = -u * 100;
-        signed v_g = -v * 208;
-        signed v_r = v * 409;
-
-        signed tmp1 = y1 * 298;
-        signed b1 = (tmp1 + u_b) / 256;
-        signed g1 = (tmp1 + v_g + u_g) / 256;
-        signed r1 = (tmp1 + v_r) / 256;
-        uint32_t rgb1 =
-            ((kAdjustedClip[r1] >> 3) << 11)
-            | ((kAdjustedClip[g1] >> 2) << 5)
-            | (kAdjustedClip[b1] >> 3);
-
-        dest_ptr[i * 2] =  rgb1 & 0xFF;
-        dest_ptr[(i * 2) + 1] = (rgb1 >> 8) & 0xFF;
-    }
+    YUVRowConverter::convertRow(
+            blockY, blockUV, blockUV + 1, 2, (uint16_t *)dest_ptr, blockWidth, false);
 
     dest_ptr += dstSkip;
     *dstPtr = dest_ptr;
@@ -518,7 +389,8 @@ void ColorConverter_Local::nv12TileTraverseBlock(
 void ColorConverter_Local::convertNV12Tile(
         size_t width, size_t height,
         const void *srcBits, size_t srcSkip,
-        void *dstBits, size_t dstSkip) {
+        void *dstBits, size_t dstSkip,
+        size_t firstRow, size_t lastRow) {
 
     CHECK_EQ(srcSkip, 0);  // Doesn't really make sense for YUV formats.
     CHECK(dstSkip >= width * 2);
@@ -552,8 +424,10 @@ void ColorConverter_Local::convertNV12Tile(
     const uint8_t *src_y   = (const uint8_t*)srcBits;
     const uint8_t *src_uv = src_y + size_y;
 
-    // Iterate
-    for(size_t by = 0, rows_left = height; by < nby_y;
+    // Iterate over the block rows in this strip; it starts on a block row
+    // and ends on one or at the bottom of the frame.
+    size_t last_by = (lastRow - 1) / NV12TILE_BLOCK_HEIGHT + 1;
+    for(size_t by = firstRow / NV12TILE_BLOCK_HEIGHT, rows_left = height - firstRow; by < last_by;
             by++, rows_left -= NV12TILE_BLOCK_HEIGHT) {
         for(size_t bx = 0, cols_left = width; bx < abx;
                 bx++, cols_left -= NV12TILE_BLOCK_WIDTH) {
@@ -591,56 +465,27 @@ void ColorConverter_Local::convertYUV420SemiPlanar32Aligned(
             size_t width, size_t height,
             const void *srcBits, size_t srcSkip,
             void *dstBits, size_t dstSkip,
-            size_t alignedWidth) {
+            size_t alignedWidth, size_t firstRow, size_t lastRow) {
     CHECK_EQ(srcSkip, 0);  // Doesn't really make sense for YUV formats.
     CHECK(dstSkip >= alignedWidth * 2);
     CHECK((dstSkip & 3) == 0);
 
-    uint8_t *kAdjustedClip = initClip();
-
     uint32_t *dst_ptr = (uint32_t *)dstBits;
     const uint8_t *src_y = (const uint8_t *)srcBits;
 
     const uint8_t *src_u =
         (const uint8_t *)src_y + width * height;
 
-    for (size_t y = 0; y < height; ++y) {
-        for (size_t x = 0; x < alignedWidth; x += 2) {
-            if(x > width)
-                continue;
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed v = (signed)src_u[x & ~1] - 128;
-            signed u = (signed)src_u[(x & ~1) + 1] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[b1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[r1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[b2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[r2] >> 3);
-
-            dst_ptr[x / 2] = (rgb2 << 16) | rgb1;
-        }
+    src_y += firstRow * width;
+    src_u += (firstRow / 2) * width;
+    dst_ptr += firstRow * (dstSkip / 4);
+
+    for (size_t y = firstRow; y < lastRow; ++y) {
+        // Every pair starting at or before width, within the aligned row.
+        size_t rowWidth = (width & ~1) + 2;
+        YUVRowConverter::convertRow(
+                src_y, src_u + 1, src_u, 2, (uint16_t *)dst_ptr,
+                rowWidth < alignedWidth ? rowWidth : alignedWidth, true);
 
         src_y += width;
 
@@ -32,36 +32,46 @@ struct ColorConverter_Local {
             const void *srcBits, size_t srcSkip,
             void *dstBits, size_t dstSkip);
 
+    // Rows [firstRow, lastRow) of the frame; convert() hands these out to
+    // the ConversionPool strip by strip.
+    void convertRows(
+            size_t width, size_t height,
+            const void *srcBits, size_t srcSkip,
+            void *dstBits, size_t dstSkip,
+            size_t firstRow, size_t lastRow);
+
 //private:
     OMX_COLOR_FORMATTYPE mSrcFormat, mDstFormat;
-    uint8_t *mClip;
-
-    uint8_t *initClip();
 
     void convertCbYCrY(
             size_t width, size_t height,
             const void *srcBits, size_t srcSkip,
-            void *dstBits, size_t dstSkip);
+            void *dstBits, size_t dstSkip,
+            size_t firstRow, size_t lastRow);
 
     void convertYUV420Planar(
             size_t width, size_t height,
             const void *srcBits, size_t srcSkip,
-            void *dstBits, size_t dstSkip);
+            void *dstBits, size_t dstSkip,
+            size_t firstRow, size_t lastRow);
 
     void convertQCOMYUV420SemiPlanar(
             size_t width, size_t height,
             const void *srcBits, size_t srcSkip,
-            void *dstBits, size_t dstSkip);
+            void *dstBits, size_t dstSkip,
+            size_t firstRow, size_t lastRow);
 
     void convertYUV420SemiPlanar(
             size_t width, size_t height,
             const void *srcBits, size_t srcSkip,
-            void *dstBits, size_t dstSkip);
+            void *dstBits, size_t dstSkip,
+            size_t firstRow, size_t lastRow);
 
     void convertNV12Tile(
         size_t width, size_t height,
         const void *srcBits, size_t srcSkip,
-        void *dstBits, size_t dstSkip);
+        void *dstBits, size_t dstSkip,
+        size_t firstRow, size_t lastRow);
 
     size_t nv12TileGetTiledMemBlockNum(
         size_t bx, size_t by,
@@ -81,7 +91,7 @@ struct ColorConverter_Local {
             size_t width, size_t height,
             const void *srcBits, size_t srcSkip,
             void *dstBits, size_t dstSkip,
-            size_t alignedWidth);
+            size_t alignedWidth, size_t firstRow, size_t lastRow);
 
     //ColorConverter(const ColorConverter &);
     //ColorConverter &operator=(const ColorConverter &);
@@ -16,6 +16,8 @@
 
 
 #include "androidVideoShim_ColorConverter444.h"
+#include "ConversionPool.h"
+#include "YUVRowConverter.h"
 //#define LOG_NDEBUG 0
 #define LOG_TAG "ColorConverter444"
 
@@ -28,13 +30,10 @@ ColorConverter444::ColorConverter444(
         OMX_COLOR_FORMATTYPE from, OMX_COLOR_FORMATTYPE to)
     : mSrcFormat(from),
       mDstFormat(to),
-      mClip(NULL),
       mSrcBitsLen(0) {
 }
 
 ColorConverter444::~ColorConverter444() {
-    delete[] mClip;
-    mClip = NULL;
 }
 
 bool ColorConverter444::isValid() const {
@@ -100,115 +99,95 @@ status_t ColorConverter444::convert(
             dstWidth, dstHeight,
             dstCropLeft, dstCropTop, dstCropRight, dstCropBottom);
 
-    status_t err;
+    if (!((src.mCropLeft & 1) == 0
+            && src.cropWidth() == dst.cropWidth()
+            && src.cropHeight() == dst.cropHeight())) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    switch (mSrcFormat) {
+        case OMX_COLOR_FormatYUV420Planar:
+        case OMX_COLOR_FormatCbYCrY:
+        case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
+        case OMX_COLOR_FormatYUV420SemiPlanar:
+        case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
+            break;
+
+        default:
+        {
+            CHECK(!"Should not be here. Unknown color conversion.");
+            return ERROR_UNSUPPORTED;
+        }
+    }
 
 	mSrcBitsLen = srcBitsLen;
 
+    // Strips start on even rows, so on a chroma row of their own.
+    StripArgs args = { this, &src, &dst };
+    ConversionPool::run(convertStrip, &args, src.cropWidth(), src.cropHeight(), 2);
+
+    return OK;
+}
+
+void ColorConverter444::convertStrip(void *arg, size_t firstRow, size_t lastRow) {
+    StripArgs *args = (StripArgs *)arg;
+    args->converter->convertRows(*args->src, *args->dst, firstRow, lastRow);
+}
+
+void ColorConverter444::convertRows(
+        const BitmapParams &src, const BitmapParams &dst,
+        size_t firstRow, size_t lastRow) {
     switch (mSrcFormat) {
         case OMX_COLOR_FormatYUV420Planar:
-            err = convertYUV420Planar(src, dst);
+            convertYUV420Planar(src, dst, firstRow, lastRow);
             break;
 
         case OMX_COLOR_FormatCbYCrY:
-            err = convertCbYCrY(src, dst);
+            convertCbYCrY(src, dst, firstRow, lastRow);
             break;
 
         case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
-            err = convertQCOMYUV420SemiPlanar(src, dst);
+            convertQCOMYUV420SemiPlanar(src, dst, firstRow, lastRow);
             break;
 
         case OMX_COLOR_FormatYUV420SemiPlanar:
-            err = convertYUV420SemiPlanar(src, dst);
+            convertYUV420SemiPlanar(src, dst, firstRow, lastRow);
             break;
 
         case OMX_TI_COLOR_FormatYUV420PackedSemiPlanar:
-            err = convertTIYUV420PackedSemiPlanar(src, dst);
+            convertTIYUV420PackedSemiPlanar(src, dst, firstRow, lastRow);
             break;
 
         default:
-        {
-            CHECK(!"Should not be here. Unknown color conversion.");
             break;
-        }
     }
-
-    return err;
 }
 
-status_t ColorConverter444::convertCbYCrY(
-        const BitmapParams &src, const BitmapParams &dst) {
+void ColorConverter444::convertCbYCrY(
+        const BitmapParams &src, const BitmapParams &dst,
+        size_t firstRow, size_t lastRow) {
     // XXX Untested
 
-    uint8_t *kAdjustedClip = initClip();
-
-    if (!((src.mCropLeft & 1) == 0
-        && src.cropWidth() == dst.cropWidth()
-        && src.cropHeight() == dst.cropHeight())) {
-        return ERROR_UNSUPPORTED;
-    }
-
     uint16_t *dst_ptr = (uint16_t *)dst.mBits
         + dst.mCropTop * dst.mWidth + dst.mCropLeft;
 
     const uint8_t *src_ptr = (const uint8_t *)src.mBits
         + (src.mCropTop * dst.mWidth + src.mCropLeft) * 2;
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_ptr[2 * x + 1] - 16;
-            signed y2 = (signed)src_ptr[2 * x + 3] - 16;
-            signed u = (signed)src_ptr[2 * x] - 128;
-            signed v = (signed)src_ptr[2 * x + 2] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+    src_ptr += firstRow * src.mWidth * 2;
+    dst_ptr += firstRow * dst.mWidth;
+
+    for (size_t y = firstRow; y < lastRow; ++y) {
+        YUVRowConverter::convertCbYCrYRow(src_ptr, dst_ptr, src.cropWidth());
 
         src_ptr += src.mWidth * 2;
         dst_ptr += dst.mWidth;
     }
-
-    return OK;
 }
 
-status_t ColorConverter444::convertYUV420Planar(
-        const BitmapParams &src, const BitmapParams &dst) {
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
-        return ERROR_UNSUPPORTED;
-    }
-
-    uint8_t *kAdjustedClip = initClip();
-
+void ColorConverter444::convertYUV420Planar(
+        const BitmapParams &src, const BitmapParams &dst,
+        size_t firstRow, size_t lastRow) {
     uint16_t *dst_ptr = (uint16_t *)dst.mBits
         + dst.mCropTop * dst.mWidth + dst.mCropLeft;
 
@@ -222,63 +201,14 @@ status_t ColorConverter444::convertYUV420Planar(
     const uint8_t *src_v =
         src_u + (src.mWidth / 2) * (src.mHeight / 2);
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            // B = 1.164 * (Y - 16) + 2.018 * (U - 128)
-            // G = 1.164 * (Y - 16) - 0.813 * (V - 128) - 0.391 * (U - 128)
-            // R = 1.164 * (Y - 16) + 1.596 * (V - 128)
-
-            // B = 298/256 * (Y - 16) + 517/256 * (U - 128)
-            // G = .................. - 208/256 * (V - 128) - 100/256 * (U - 128)
-            // R = .................. + 409/256 * (V - 128)
-
-            // min_B = (298 * (- 16) + 517 * (- 128)) / 256 = -277
-            // min_G = (298 * (- 16) - 208 * (255 - 128) - 100 * (255 - 128)) / 256 = -172
-            // min_R = (298 * (- 16) + 409 * (- 128)) / 256 = -223
-
-            // max_B = (298 * (255 - 16) + 517 * (255 - 128)) / 256 = 534
-            // max_G = (298 * (255 - 16) - 208 * (- 128) - 100 * (- 128)) / 256 = 432
-            // max_R = (298 * (255 - 16) + 409 * (255 - 128)) / 256 = 481
-
-            // clip range -278 .. 535
-
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed u = (signed)src_u[x / 2] - 128;
-            signed v = (signed)src_v[x / 2] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+    src_y += firstRow * src.mWidth;
+    src_u += (firstRow / 2) * (src.mWidth / 2);
+    src_v += (firstRow / 2) * (src.mWidth / 2);
+    dst_ptr += firstRow * dst.mWidth;
+
+    for (size_t y = firstRow; y < lastRow; ++y) {
+        YUVRowConverter::convertRow(
+                src_y, src_u, src_v, 1, dst_ptr, src.cropWidth(), false);
 
         src_y += src.mWidth;
 
@@ -289,20 +219,11 @@ status_t ColorConverter444::convertYUV420Planar(
 
         dst_ptr += dst.mWidth;
     }
-
-    return OK;
 }
 
-status_t ColorConverter444::convertQCOMYUV420SemiPlanar(
-        const BitmapParams &src, const BitmapParams &dst) {
-    uint8_t *kAdjustedClip = initClip();
-
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
-        return ERROR_UNSUPPORTED;
-    }
-
+void ColorConverter444::convertQCOMYUV420SemiPlanar(
+        const BitmapParams &src, const BitmapParams &dst,
+        size_t firstRow, size_t lastRow) {
     uint16_t *dst_ptr = (uint16_t *)dst.mBits
         + dst.mCropTop * dst.mWidth + dst.mCropLeft;
 
@@ -313,45 +234,13 @@ status_t ColorConverter444::convertQCOMYUV420SemiPlanar(
         (const uint8_t *)src_y + src.mWidth * src.mHeight
         + src.mCropTop * src.mWidth + src.mCropLeft;
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed u = (signed)src_u[x & ~1] - 128;
-            signed v = (signed)src_u[(x & ~1) + 1] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[b1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[r1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[b2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[r2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+    src_y += firstRow * src.mWidth;
+    src_u += (firstRow / 2) * src.mWidth;
+    dst_ptr += firstRow * dst.mWidth;
+
+    for (size_t y = firstRow; y < lastRow; ++y) {
+        YUVRowConverter::convertRow(
+                src_y, src_u, src_u + 1, 2, dst_ptr, src.cropWidth(), true);
 
         src_y += src.mWidth;
 
@@ -361,22 +250,13 @@ status_t ColorConverter444::convertQCOMYUV420SemiPlanar(
 
         dst_ptr += dst.mWidth;
     }
-
-    return OK;
 }
 
-status_t ColorConverter444::convertYUV420SemiPlanar(
-        const BitmapParams &src, const BitmapParams &dst) {
+void ColorConverter444::convertYUV420SemiPlanar(
+        const BitmapParams &src, const BitmapParams &dst,
+        size_t firstRow, size_t lastRow) {
     // XXX Untested
 
-    uint8_t *kAdjustedClip = initClip();
-
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
-        return ERROR_UNSUPPORTED;
-    }
-
 
     // Constrain the height to the size of our src bits when the image is cropped so that the converter
     // doesn't read someone else's data and make funny green lines
@@ -397,45 +277,13 @@ status_t ColorConverter444::convertYUV420SemiPlanar(
         (const uint8_t *)src_y + src.mWidth * (src.mHeight - uvPlaneOffset)
         + src.mCropTop * src.mWidth + src.mCropLeft;
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed v = (signed)src_u[x & ~1] - 128;
-            signed u = (signed)src_u[(x & ~1) + 1] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[b1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[r1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[b2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[r2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+    src_y += firstRow * src.mWidth;
+    src_u += (firstRow / 2) * src.mWidth;
+    dst_ptr += firstRow * dst.mWidth;
+
+    for (size_t y = firstRow; y < lastRow; ++y) {
+        YUVRowConverter::convertRow(
+                src_y, src_u + 1, src_u, 2, dst_ptr, src.cropWidth(), true);
 
         src_y += src.mWidth;
 
@@ -445,20 +293,11 @@ status_t ColorConverter444::convertYUV420SemiPlanar(
 
         dst_ptr += dst.mWidth;
     }
-
-    return OK;
 }
 
-status_t ColorConverter444::convertTIYUV420PackedSemiPlanar(
-        const BitmapParams &src, const BitmapParams &dst) {
-    uint8_t *kAdjustedClip = initClip();
-
-    if (!((src.mCropLeft & 1) == 0
-            && src.cropWidth() == dst.cropWidth()
-            && src.cropHeight() == dst.cropHeight())) {
-        return ERROR_UNSUPPORTED;
-    }
-
+void ColorConverter444::convertTIYUV420PackedSemiPlanar(
+        const BitmapParams &src, const BitmapParams &dst,
+        size_t firstRow, size_t lastRow) {
     uint16_t *dst_ptr = (uint16_t *)dst.mBits
         + dst.mCropTop * dst.mWidth + dst.mCropLeft;
 
@@ -467,45 +306,13 @@ status_t ColorConverter444::convertTIYUV420PackedSemiPlanar(
     const uint8_t *src_u =
         (const uint8_t *)src_y + src.mWidth * (src.mHeight - src.mCropTop / 2);
 
-    for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
-            signed y1 = (signed)src_y[x] - 16;
-            signed y2 = (signed)src_y[x + 1] - 16;
-
-            signed u = (signed)src_u[x & ~1] - 128;
-            signed v = (signed)src_u[(x & ~1) + 1] - 128;
-
-            signed u_b = u * 517;
-            signed u_g = -u * 100;
-            signed v_g = -v * 208;
-            signed v_r = v * 409;
-
-            signed tmp1 = y1 * 298;
-            signed b1 = (tmp1 + u_b) / 256;
-            signed g1 = (tmp1 + v_g + u_g) / 256;
-            signed r1 = (tmp1 + v_r) / 256;
-
-            signed tmp2 = y2 * 298;
-            signed b2 = (tmp2 + u_b) / 256;
-            signed g2 = (tmp2 + v_g + u_g) / 256;
-            signed r2 = (tmp2 + v_r) / 256;
-
-            uint32_t rgb1 =
-                ((kAdjustedClip[r1] >> 3) << 11)
-                | ((kAdjustedClip[g1] >> 2) << 5)
-                | (kAdjustedClip[b1] >> 3);
-
-            uint32_t rgb2 =
-                ((kAdjustedClip[r2] >> 3) << 11)
-                | ((kAdjustedClip[g2] >> 2) << 5)
-                | (kAdjustedClip[b2] >> 3);
-
-            if (x + 1 < src.cropWidth()) {
-                *(uint32_t *)(&dst_ptr[x]) = (rgb2 << 16) | rgb1;
-            } else {
-                dst_ptr[x] = rgb1;
-            }
-        }
+    src_y += firstRow * src.mWidth;
+    src_u += (firstRow / 2) * src.mWidth;
+    dst_ptr += firstRow * dst.mWidth;
+
+    for (size_t y = firstRow; y < lastRow; ++y) {
+        YUVRowConverter::convertRow(
+                src_y, src_u, src_u + 1, 2, dst_ptr, src.cropWidth(), false);
 
         src_y += src.mWidth;
 
@@ -515,23 +322,6 @@ status_t ColorConverter444::convertTIYUV420PackedSemiPlanar(
 
         dst_ptr += dst.mWidth;
     }
-
-    return OK;
-}
-
-uint8_t *ColorConverter444::initClip() {
-    static const signed kClipMin = -278;
-    static const signed kClipMax = 535;
-
-    if (mClip == NULL) {
-        mClip = new uint8_t[kClipMax - kClipMin + 1];
-
-        for (signed i = kClipMin; i <= kClipMax; ++i) {
-            mClip[i - kClipMin] = (i < 0) ? 0 : (i > 255) ? 255 : (uint8_t)i;
-        }
-    }
-
-    return &mClip[-kClipMin];
 }
 
 }  // namespace android
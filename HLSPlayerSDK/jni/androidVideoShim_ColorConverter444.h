@@ -59,25 +59,41 @@ private:
 
 	size_t mSrcBitsLen;
 
-    OMX_COLOR_FORMATTYPE mSrcFormat, mDstFormat;
-    uint8_t *mClip;
+    // What convertStrip() needs to convert a strip of the frame for the
+    // ConversionPool.
+    struct StripArgs {
+        ColorConverter444 *converter;
+        const BitmapParams *src;
+        const BitmapParams *dst;
+    };
+
+    static void convertStrip(void *arg, size_t firstRow, size_t lastRow);
 
-    uint8_t *initClip();
+    void convertRows(
+            const BitmapParams &src, const BitmapParams &dst,
+            size_t firstRow, size_t lastRow);
+
+    OMX_COLOR_FORMATTYPE mSrcFormat, mDstFormat;
 
-    status_t convertCbYCrY(
-            const BitmapParams &src, const BitmapParams &dst);
+    void convertCbYCrY(
+            const BitmapParams &src, const BitmapParams &dst,
+            size_t firstRow, size_t lastRow);
 
-    status_t convertYUV420Planar(
-            const BitmapParams &src, const BitmapParams &dst);
+    void convertYUV420Planar(
+            const BitmapParams &src, const BitmapParams &dst,
+            size_t firstRow, size_t lastRow);
 
-    status_t convertQCOMYUV420SemiPlanar(
-            const BitmapParams &src, const BitmapParams &dst);
+    void convertQCOMYUV420SemiPlanar(
+            const BitmapParams &src, const BitmapParams &dst,
+            size_t firstRow, size_t lastRow);
 
-    status_t convertYUV420SemiPlanar(
-            const BitmapParams &src, const BitmapParams &dst);
+    void convertYUV420SemiPlanar(
+            const BitmapParams &src, const BitmapParams &dst,
+            size_t firstRow, size_t lastRow);
 
-    status_t convertTIYUV420PackedSemiPlanar(
-            const BitmapParams &src, const BitmapParams &dst);
+    void convertTIYUV420PackedSemiPlanar(
+            const BitmapParams &src, const BitmapParams &dst,
+            size_t firstRow, size_t lastRow);
 
     ColorConverter444(const ColorConverter444 &);
     ColorConverter444 &operator=(const ColorConverter444 &);
@@ -94,6 +94,7 @@ amm-info@iis.fraunhofer.de
 #include "aacdecoder.h"
 #include "tpdec_lib.h"
 #include "FDK_core.h" /* FDK_tools version info */
+#include "FDK_bench.h"
 
 
  #include "sbrdecoder.h"
@@ -873,11 +874,13 @@ LINKSPEC_CPP AAC_DECODER_ERROR aacDecoder_DecodeFrame(
     self->extGain[0] = FL2FXCONST_DBL(1.0f/(float)(1<<TDL_GAIN_SCALING));
 
 
+    FDK_BENCH_ENTER(FDK_BENCH_CORE);
     ErrorStatus = CAacDecoder_DecodeFrame(self,
                                           flags | (fTpConceal ? AACDEC_CONCEAL : 0),
                                           pTimeData,
                                           timeDataSize,
                                           interleaved);
+    FDK_BENCH_LEAVE();
 
     if (!(flags & (AACDEC_CONCEAL|AACDEC_FLUSH))) {
       TRANSPORTDEC_ERROR tpErr;
@@ -943,6 +946,7 @@ LINKSPEC_CPP AAC_DECODER_ERROR aacDecoder_DecodeFrame(
 
 
       /* apply SBR processing */
+      FDK_BENCH_ENTER(FDK_BENCH_SBR);
       sbrError = sbrDecoder_Apply ( self->hSbrDecoder,
                                     pTimeData,
                                    &self->streamInfo.numChannels,
@@ -951,6 +955,7 @@ LINKSPEC_CPP AAC_DECODER_ERROR aacDecoder_DecodeFrame(
                                     interleaved,
                                     self->frameOK,
                                    &self->psPossible);
+      FDK_BENCH_LEAVE();
 
 
      if (sbrError == SBRDEC_OK) {
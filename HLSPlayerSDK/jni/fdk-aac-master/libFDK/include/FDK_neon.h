@@ -0,0 +1,57 @@
+/** \file   FDK_neon.h
+ *  \brief  NEON versions of the QMF prototype filters, dit_fft() and the DCT-IV/DST-IV twiddling.
+ *
+ *  Built when HAVE_FDK_NEON is defined, which Android.mk does for armeabi-v7a (and for arm64-v8a,
+ *  which APP_ABI doesn't include yet, so that isn't built). The kernels live in src/neon/ and give
+ *  exactly the same output as the C code they replace; they are written for the 16 bit coefficient
+ *  tables, so FDK_NEON is only set when those are in use. NEON is optional on armeabi-v7a, so
+ *  callers check FDK_neonAvailable() before using them. Tools/AACBench builds them on the host
+ *  against a scalar stand-in for the intrinsics and checks them against the C code.
+ */
+
+#if !defined(__FDK_NEON_H__)
+#define __FDK_NEON_H__
+
+#include "qmf.h"
+
+#if defined(HAVE_FDK_NEON) && defined(SINETABLE_16BIT) && defined(WINDOWTABLE_16BIT) && defined(QMF_COEFF_16BIT) \
+    && !defined(QMF_DATA_16BIT) && !defined(QMFSYN_STATES_16BIT) && (SAMPLE_BITS == 16)
+#define FDK_NEON
+#endif
+
+#if defined(FDK_NEON)
+
+/**
+ * \brief  Check whether the CPU we run on has NEON. Always true off 32 bit ARM: arm64 always has
+ *         it, and the other builds with HAVE_FDK_NEON are host ones against a stand-in for the
+ *         intrinsics.
+ * \return 1 if the NEON kernels may be called, 0 otherwise.
+ */
+INT FDK_neonAvailable(void);
+
+/* src/neon/qmf_neon.cpp, for the symmetric filter banks. Same arguments as the C versions in qmf.cpp. */
+void qmfSynPrototypeFirSlot_neon(HANDLE_QMF_FILTER_BANK qmf,
+                                 FIXP_QMF *RESTRICT realSlot,
+                                 FIXP_QMF *RESTRICT imagSlot,
+                                 INT_PCM  *RESTRICT timeOut,
+                                 int       stride);
+
+void qmfAnaPrototypeFirSlot_neon(FIXP_QMF *analysisBuffer,
+                                 int       no_channels,
+                                 const FIXP_PFT *p_filter,
+                                 int       p_stride,
+                                 FIXP_QAS *RESTRICT pFilterStates);
+
+/* src/neon/fft_rad2_neon.cpp, a drop-in for dit_fft(). */
+void dit_fft_neon(FIXP_DBL *x, const INT ldn, const FIXP_STP *trigdata, const INT trigDataSize);
+
+/* src/neon/dct_neon.cpp, the pre and post twiddle loops around the fft() in dct_IV() and dst_IV()
+   for any M = L/2, with the tables getTables() picked for L. */
+void dct_IV_func1_neon(int M, const FIXP_WTP *twiddle, FIXP_DBL *pDat);
+void dct_IV_func2_neon(int M, const FIXP_STP *sin_twiddle, int sin_step, FIXP_DBL *pDat);
+void dst_IV_func1_neon(int M, const FIXP_WTP *twiddle, FIXP_DBL *pDat);
+void dst_IV_func2_neon(int M, const FIXP_STP *sin_twiddle, int sin_step, FIXP_DBL *pDat);
+
+#endif /* FDK_NEON */
+
+#endif /* __FDK_NEON_H__ */
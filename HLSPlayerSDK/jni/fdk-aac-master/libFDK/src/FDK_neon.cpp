@@ -0,0 +1,36 @@
+/** \file   FDK_neon.cpp
+ *  \brief  Runtime check for the NEON kernels in src/neon/.
+ *
+ *  Kept apart from the kernels so it's built without NEON enabled: on armeabi-v7a this is what
+ *  decides whether they may run at all.
+ */
+
+#include "FDK_neon.h"
+
+#if defined(FDK_NEON)
+
+#if defined(__arm__)
+#include <cpu-features.h>
+
+/* -1 until the first call. Every caller works out the same answer, so racing on it is harmless. */
+static INT neonAvailable = -1;
+
+INT FDK_neonAvailable(void)
+{
+  if (neonAvailable < 0) {
+    neonAvailable = (android_getCpuFamily() == ANDROID_CPU_FAMILY_ARM)
+                 && (android_getCpuFeatures() & ANDROID_CPU_ARM_FEATURE_NEON) != 0;
+  }
+  return neonAvailable;
+}
+
+#else
+
+INT FDK_neonAvailable(void)
+{
+  return 1; /* Always there on arm64; otherwise a host build against Tools/AACBench's stand-in. */
+}
+
+#endif
+
+#endif /* FDK_NEON */
@@ -102,6 +102,7 @@ amm-info@iis.fraunhofer.de
 
 #include "FDK_tools_rom.h"
 #include "fft.h"
+#include "FDK_neon.h"
 
 
 #if defined(__arm__)
@@ -315,6 +316,11 @@ void dct_IV(FIXP_DBL *pDat,
 
   getTables(&twiddle, &sin_twiddle, &sin_step, L);
 
+#if defined(FDK_NEON)
+  if (FDK_neonAvailable()) {
+    dct_IV_func1_neon(M, twiddle, pDat);
+  } else
+#endif /* FDK_NEON */
 #ifdef FUNCTION_dct_IV_func1
   if (M>=4 && (M&3) == 0) {
      /* ARM926: 44 cycles for 2 iterations = 22 cycles/iteration */
@@ -354,6 +360,11 @@ void dct_IV(FIXP_DBL *pDat,
 
   fft(M, pDat, pDat_e);
 
+#if defined(FDK_NEON)
+  if (FDK_neonAvailable()) {
+    dct_IV_func2_neon(M, sin_twiddle, sin_step, pDat);
+  } else
+#endif /* FDK_NEON */
 #ifdef FUNCTION_dct_IV_func2
   if (M>=4 && (M&3) == 0) {
      /* ARM926: 42 cycles for 2 iterations = 21 cycles/iteration */
@@ -441,6 +452,11 @@ void dst_IV(FIXP_DBL *pDat,
 
   getTables(&twiddle, &sin_twiddle, &sin_step, L);
 
+#if defined(FDK_NEON)
+  if (FDK_neonAvailable()) {
+    dst_IV_func1_neon(M, twiddle, pDat);
+  } else
+#endif /* FDK_NEON */
 #ifdef FUNCTION_dst_IV_func1
   if ( (M>=4) && ((M&3) == 0) ) {
     dst_IV_func1(M, twiddle, &pDat[0], &pDat[L]);
@@ -480,6 +496,11 @@ void dst_IV(FIXP_DBL *pDat,
 
   fft(M, pDat, pDat_e);
 
+#if defined(FDK_NEON)
+  if (FDK_neonAvailable()) {
+    dst_IV_func2_neon(M, sin_twiddle, sin_step, pDat);
+  } else
+#endif /* FDK_NEON */
 #ifdef FUNCTION_dst_IV_func2
   if ( (M>=4) && ((M&3) == 0) ) {
     dst_IV_func2(M>>2, sin_twiddle + sin_step, &pDat[0], &pDat[L - 1], sin_step);
@@ -92,11 +92,24 @@ amm-info@iis.fraunhofer.de
 
 #include "fft_rad2.h"
 #include "FDK_tools_rom.h"
+#include "FDK_neon.h"
 
 
 
 
 
+/* dit_fft(), or dit_fft_neon() where the CPU has NEON. */
+static inline void dit_fft_dispatch(FIXP_DBL *x, const INT ldn, const FIXP_STP *trigdata, const INT trigDataSize)
+{
+#if defined(FDK_NEON)
+  if (FDK_neonAvailable()) {
+    dit_fft_neon(x, ldn, trigdata, trigDataSize);
+    return;
+  }
+#endif
+  dit_fft(x, ldn, trigdata, trigDataSize);
+}
+
 #define F3C(x) STC(x)
 
 #define     C31       (F3C(0x91261468))      /* FL2FXCONST_DBL(-0.86602540)   */
@@ -1366,21 +1379,21 @@ void fft(int length, FIXP_DBL *pInput, INT *pScalefactor)
       fft60(pInput, pScalefactor);
       break;
     case 64:
-      dit_fft(pInput, 6, SineTable512, 512);
+      dit_fft_dispatch(pInput, 6, SineTable512, 512);
       *pScalefactor += SCALEFACTOR64;
       break;
     case 240:
       fft240(pInput, pScalefactor);
       break;
     case 256:
-      dit_fft(pInput, 8, SineTable512, 512);
+      dit_fft_dispatch(pInput, 8, SineTable512, 512);
       *pScalefactor += SCALEFACTOR256;
       break;
     case 480:
       fft480(pInput, pScalefactor);
       break;
     case 512:
-      dit_fft(pInput, 9, SineTable512, 512);
+      dit_fft_dispatch(pInput, 9, SineTable512, 512);
       *pScalefactor += SCALEFACTOR512;
       break;
     default:
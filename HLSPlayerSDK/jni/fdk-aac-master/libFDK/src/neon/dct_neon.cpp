@@ -0,0 +1,205 @@
+/** \file   dct_neon.cpp
+ *  \brief  NEON versions of the twiddle loops in dct_IV() and dst_IV() from dct.cpp.
+ *
+ *  Each vector covers four iterations of the C loop. dst_IV() only differs in signs and in which
+ *  product goes where, so both share one loop with a dst switch the compiler folds away.
+ */
+
+#include "FDK_neon.h"
+
+#if defined(FDK_NEON)
+
+#include "fixmul_neon.h"
+
+/* Four cplxMultDiv2() with the twiddles (re,im) from FX_SGL2NEON(). */
+static inline void cplxMultDiv2_neon(int32x4_t *c_Re, int32x4_t *c_Im,
+                                     int32x4_t a_Re, int32x4_t a_Im,
+                                     int32x4_t re, int32x4_t im)
+{
+  *c_Re = vsubq_s32(fMultDiv2_neon(a_Re, re), fMultDiv2_neon(a_Im, im));
+  *c_Im = vaddq_s32(fMultDiv2_neon(a_Re, im), fMultDiv2_neon(a_Im, re));
+}
+
+static inline void dct_IV_pre_neon(int M, const FIXP_WTP *twiddle, FIXP_DBL *pDat, int dst)
+{
+  FIXP_DBL *RESTRICT pDat_0 = &pDat[0];
+  FIXP_DBL *RESTRICT pDat_1 = &pDat[2*M - 2];
+  int i;
+
+  /* pDat_0 goes up through eight values and pDat_1 down through eight, last iteration first. */
+  for (i = 0; i+6 < M-1; i+=8,pDat_0+=8,pDat_1-=8)
+  {
+    int16x4x4_t tw = vld4_s16((const int16_t *)&twiddle[i]);
+    int32x4x2_t f = vld2q_s32((const int32_t *)pDat_0);
+    int32x4x2_t b = vld2q_s32((const int32_t *)pDat_1 - 6);
+    int32x4_t accu1, accu2, accu3, accu4;
+
+    accu1 = fReverse_neon(b.val[1]); accu2 = f.val[0];
+    accu3 = f.val[1];                accu4 = fReverse_neon(b.val[0]);
+    if (dst) {
+      accu2 = vnegq_s32(accu2);
+      accu4 = vnegq_s32(accu4);
+    }
+
+    /* twiddle[i], twiddle[i+1] of each iteration are the even and odd entries */
+    cplxMultDiv2_neon(&accu1, &accu2, accu1, accu2, FX_SGL2NEON(tw.val[0]), FX_SGL2NEON(tw.val[1]));
+    cplxMultDiv2_neon(&accu3, &accu4, accu4, accu3, FX_SGL2NEON(tw.val[2]), FX_SGL2NEON(tw.val[3]));
+
+    f.val[0] = accu2; f.val[1] = accu1;
+    b.val[0] = fReverse_neon(accu4); b.val[1] = fReverse_neon(vnegq_s32(accu3));
+
+    vst2q_s32((int32_t *)pDat_0, f);
+    vst2q_s32((int32_t *)pDat_1 - 6, b);
+  }
+  for (; i < M-1; i+=2,pDat_0+=2,pDat_1-=2)
+  {
+    FIXP_DBL accu1,accu2,accu3,accu4;
+
+    accu1 = pDat_1[1]; accu2 = dst ? -pDat_0[0] : pDat_0[0];
+    accu3 = pDat_0[1]; accu4 = dst ? -pDat_1[0] : pDat_1[0];
+
+    cplxMultDiv2(&accu1, &accu2, accu1, accu2, twiddle[i]);
+    cplxMultDiv2(&accu3, &accu4, accu4, accu3, twiddle[i+1]);
+
+    pDat_0[0] = accu2; pDat_0[1] = accu1;
+    pDat_1[0] = accu4; pDat_1[1] = -accu3;
+  }
+  if (M&1)
+  {
+    FIXP_DBL accu1,accu2;
+
+    accu1 = pDat_1[1]; accu2 = dst ? -pDat_0[0] : pDat_0[0];
+
+    cplxMultDiv2(&accu1, &accu2, accu1, accu2, twiddle[i]);
+
+    pDat_0[0] = accu2; pDat_0[1] = accu1;
+  }
+}
+
+/*
+ * Iteration i of the C loop reads pair i-1 from the top and pair i from the bottom, and writes
+ * the other halves of both as well as of pair i-1 at the bottom and pair i at the top. All it
+ * reads is still unchanged, except for pair i-1 from the top, which the C code carries over in
+ * accu1/accu2; so four iterations take the four top pairs below the next ones plus that carry.
+ */
+static inline void dct_IV_post_neon(int M, const FIXP_STP *sin_twiddle, int sin_step, FIXP_DBL *pDat, int dst)
+{
+  FIXP_DBL *RESTRICT pDat_0 = &pDat[0];
+  FIXP_DBL *RESTRICT pDat_1 = &pDat[2*M - 2];
+  FIXP_DBL accu1,accu2,accu3,accu4;
+  int idx, i;
+
+  /* Sin and Cos values are 0.0f and 1.0f */
+  accu1 = pDat_1[0];
+  accu2 = pDat_1[1];
+
+  if (dst) {
+    pDat_1[1] = -(pDat_0[0]>>1);
+    pDat_0[0] = (pDat_0[1]>>1);
+  } else {
+    pDat_1[1] = -(pDat_0[1]>>1);
+    pDat_0[0] = (pDat_0[0]>>1);
+  }
+
+  for (idx = sin_step,i=1; i+3<(M+1)>>1; i+=4, idx+=4*sin_step, pDat_0+=8, pDat_1-=8)
+  {
+    int16x4x2_t twd = vld2_dup_s16((const int16_t *)&sin_twiddle[idx]);
+    int32x4x2_t f = vld2q_s32((const int32_t *)pDat_0 + 2);
+    int32x4x2_t b = vld2q_s32((const int32_t *)pDat_1 - 8);
+    int32x4_t re, im, b0, b1, a3, a4, f3, f4;
+
+    twd = vld2_lane_s16((const int16_t *)&sin_twiddle[idx +   sin_step], twd, 1);
+    twd = vld2_lane_s16((const int16_t *)&sin_twiddle[idx + 2*sin_step], twd, 2);
+    twd = vld2_lane_s16((const int16_t *)&sin_twiddle[idx + 3*sin_step], twd, 3);
+    re = FX_SGL2NEON(twd.val[0]);
+    im = FX_SGL2NEON(twd.val[1]);
+
+    b0 = fReverse_neon(b.val[0]);
+    b1 = fReverse_neon(b.val[1]);
+    cplxMultDiv2_neon(&a3, &a4, vextq_s32(vdupq_n_s32(accu1), b0, 3), vextq_s32(vdupq_n_s32(accu2), b1, 3), re, im);
+    cplxMultDiv2_neon(&f3, &f4, f.val[1], f.val[0], re, im);
+    accu1 = vgetq_lane_s32(b0, 3);
+    accu2 = vgetq_lane_s32(b1, 3);
+
+    if (dst) {
+      f.val[0] = vnegq_s32(a4);               /* pDat_0[1] of i-1 */
+      f.val[1] = f3;                          /* pDat_0[0] of i */
+      b.val[0] = fReverse_neon(vnegq_s32(f4));  /* pDat_1[1] of i */
+      b.val[1] = fReverse_neon(vnegq_s32(a3));  /* pDat_1[0] of i-1 */
+    } else {
+      f.val[0] = a3;
+      f.val[1] = f4;
+      b.val[0] = fReverse_neon(vnegq_s32(f3));
+      b.val[1] = fReverse_neon(a4);
+    }
+
+    vst2q_s32((int32_t *)pDat_0 + 1, f);
+    vst2q_s32((int32_t *)pDat_1 - 7, b);
+  }
+  for (; i<(M+1)>>1; i++, idx+=sin_step)
+  {
+    FIXP_STP twd = sin_twiddle[idx];
+
+    cplxMultDiv2(&accu3, &accu4, accu1, accu2, twd);
+    if (dst) {
+      pDat_1[0] = -accu3;
+      pDat_0[1] = -accu4;
+    } else {
+      pDat_0[1] =  accu3;
+      pDat_1[0] =  accu4;
+    }
+
+    pDat_0+=2;
+    pDat_1-=2;
+
+    cplxMultDiv2(&accu3, &accu4, pDat_0[1], pDat_0[0], twd);
+
+    accu1 = pDat_1[0];
+    accu2 = pDat_1[1];
+
+    if (dst) {
+      pDat_0[0] =  accu3;
+      pDat_1[1] = -accu4;
+    } else {
+      pDat_1[1] = -accu3;
+      pDat_0[0] =  accu4;
+    }
+  }
+
+  if ( (M&1) == 0 )
+  {
+    /* Last Sin and Cos value pair are the same */
+    accu1 = fMultDiv2(accu1, WTC(0x5a82799a));
+    accu2 = fMultDiv2(accu2, WTC(0x5a82799a));
+
+    if (dst) {
+      pDat_0[1] = - accu1 - accu2;
+      pDat_1[0] =   accu2 - accu1;
+    } else {
+      pDat_1[0] = accu1 + accu2;
+      pDat_0[1] = accu1 - accu2;
+    }
+  }
+}
+
+void dct_IV_func1_neon(int M, const FIXP_WTP *twiddle, FIXP_DBL *pDat)
+{
+  dct_IV_pre_neon(M, twiddle, pDat, 0);
+}
+
+void dct_IV_func2_neon(int M, const FIXP_STP *sin_twiddle, int sin_step, FIXP_DBL *pDat)
+{
+  dct_IV_post_neon(M, sin_twiddle, sin_step, pDat, 0);
+}
+
+void dst_IV_func1_neon(int M, const FIXP_WTP *twiddle, FIXP_DBL *pDat)
+{
+  dct_IV_pre_neon(M, twiddle, pDat, 1);
+}
+
+void dst_IV_func2_neon(int M, const FIXP_STP *sin_twiddle, int sin_step, FIXP_DBL *pDat)
+{
+  dct_IV_post_neon(M, sin_twiddle, sin_step, pDat, 1);
+}
+
+#endif /* FDK_NEON */
@@ -0,0 +1,371 @@
+/** \file   fft_rad2_neon.cpp
+ *  \brief  NEON version of dit_fft() from fft_rad2.cpp.
+ *
+ *  Same stages as the C code, with the same rounding in each, four butterflies at a time:
+ *  the radix 4 stage over four groups, stages with m <= 64 a block of m values at a time, and
+ *  bigger ones by four neighbouring twiddle factors across all blocks.
+ */
+
+#include "FDK_neon.h"
+
+#if defined(FDK_NEON)
+
+#include "fft_rad2.h"
+#include "scramble.h"
+#include "fixmul_neon.h"
+
+/* Stages up to this m use dit_fft_stage_block_neon(). */
+#define DIT_FFT_BLOCK_MAX_MH 32
+
+/*
+ * 1+2 stage radix 4 for four groups of four complex values. The groups are split into
+ * one vector per value and component, run through the C code's sums and put back.
+ */
+static inline void dit_fft_rad4_neon(FIXP_DBL *x)
+{
+  int32x4x4_t lo = vld4q_s32((const int32_t *)x);
+  int32x4x4_t hi = vld4q_s32((const int32_t *)x + 16);
+  int32x4x2_t reAC = vuzpq_s32(lo.val[0], hi.val[0]);
+  int32x4x2_t imAC = vuzpq_s32(lo.val[1], hi.val[1]);
+  int32x4x2_t reBD = vuzpq_s32(lo.val[2], hi.val[2]);
+  int32x4x2_t imBD = vuzpq_s32(lo.val[3], hi.val[3]);
+  int32x4_t a00, a10, a20, a30;
+
+  a00 = vshrq_n_s32(vaddq_s32(reAC.val[0], reBD.val[0]), 1);  /* Re A + Re B */
+  a10 = vshrq_n_s32(vaddq_s32(reAC.val[1], reBD.val[1]), 1);  /* Re C + Re D */
+  a20 = vshrq_n_s32(vaddq_s32(imAC.val[0], imBD.val[0]), 1);  /* Im A + Im B */
+  a30 = vshrq_n_s32(vaddq_s32(imAC.val[1], imBD.val[1]), 1);  /* Im C + Im D */
+
+  reAC.val[0] = vaddq_s32(a00, a10);       /* Re A' */
+  reAC.val[1] = vsubq_s32(a00, a10);       /* Re C' */
+  imAC.val[0] = vaddq_s32(a20, a30);       /* Im A' */
+  imAC.val[1] = vsubq_s32(a20, a30);       /* Im C' */
+
+  a00 = vsubq_s32(a00, reBD.val[0]);       /* Re A - Re B */
+  a10 = vsubq_s32(a10, reBD.val[1]);       /* Re C - Re D */
+  a20 = vsubq_s32(a20, imBD.val[0]);       /* Im A - Im B */
+  a30 = vsubq_s32(a30, imBD.val[1]);       /* Im C - Im D */
+
+  reBD.val[0] = vaddq_s32(a00, a30);       /* Re B' */
+  reBD.val[1] = vsubq_s32(a00, a30);       /* Re D' */
+  imBD.val[0] = vsubq_s32(a20, a10);       /* Im B' */
+  imBD.val[1] = vaddq_s32(a20, a10);       /* Im D' */
+
+  reAC = vzipq_s32(reAC.val[0], reAC.val[1]);
+  imAC = vzipq_s32(imAC.val[0], imAC.val[1]);
+  reBD = vzipq_s32(reBD.val[0], reBD.val[1]);
+  imBD = vzipq_s32(imBD.val[0], imBD.val[1]);
+
+  lo.val[0] = reAC.val[0]; hi.val[0] = reAC.val[1];
+  lo.val[1] = imAC.val[0]; hi.val[1] = imAC.val[1];
+  lo.val[2] = reBD.val[0]; hi.val[2] = reBD.val[1];
+  lo.val[3] = imBD.val[0]; hi.val[3] = imBD.val[1];
+
+  vst4q_s32((int32_t *)x, lo);
+  vst4q_s32((int32_t *)x + 16, hi);
+}
+
+/*
+ * Four butterflies between the complex values at p1 and at p2. All four butterflies of the C code
+ * come down to
+ *
+ *   dr = M(x2i,s) + M(x2r,c),  di = M(x2i,c) - M(x2r,s)
+ *   x1 = u/2 + (dr,di),  x2 = u/2 - (dr,di)
+ *
+ * with M = fMultDiv2: the first one as is, the third with c and s swapped, and the second and
+ * fourth like the first and third but with (dr,di) turned into (di,-dr).
+ */
+static inline void dit_fft_bfly_neon(FIXP_DBL *p1, FIXP_DBL *p2, int32x4_t c, int32x4_t s, int turn)
+{
+  int32x4x2_t u = vld2q_s32((const int32_t *)p1);
+  int32x4x2_t v = vld2q_s32((const int32_t *)p2);
+  int32x4_t dr = vaddq_s32(fMultDiv2_neon(v.val[1], s), fMultDiv2_neon(v.val[0], c));
+  int32x4_t di = vsubq_s32(fMultDiv2_neon(v.val[1], c), fMultDiv2_neon(v.val[0], s));
+  int32x4_t ur = vshrq_n_s32(u.val[0], 1);
+  int32x4_t ui = vshrq_n_s32(u.val[1], 1);
+
+  if (turn) {
+    int32x4_t t = dr;
+    dr = di;
+    di = vnegq_s32(t);
+  }
+
+  u.val[0] = vaddq_s32(ur, dr);
+  u.val[1] = vaddq_s32(ui, di);
+  v.val[0] = vsubq_s32(ur, dr);
+  v.val[1] = vsubq_s32(ui, di);
+
+  vst2q_s32((int32_t *)p1, u);
+  vst2q_s32((int32_t *)p2, v);
+}
+
+/*
+ * One stage with mh <= DIT_FFT_BLOCK_MAX_MH, four of the first mh values of each block of m at a
+ * time. What dit_fft_bfly_neon() needs per value comes from a small table built first: within
+ * each half of mh, u up to mh/4 goes with cs = trigdata[u*trigstep], the rest with mh/2-u and c
+ * and s swapped, and the second half is turned. u = 0 takes shifts instead of M(x,1.0) like the
+ * C code, and u = mh/4 its cos = sin constant.
+ */
+static void dit_fft_stage_block_neon(FIXP_DBL *x, INT n, INT mh, const FIXP_STP *trigdata, INT trigstep)
+{
+  INT m = mh<<1;
+  INT r, u;
+  const FIXP_STB sqrt05 = STC(0x5a82799a);
+  FIXP_SGL c[DIT_FFT_BLOCK_MAX_MH], s[DIT_FFT_BLOCK_MAX_MH];
+  INT shift[DIT_FFT_BLOCK_MAX_MH], turn[DIT_FFT_BLOCK_MAX_MH];
+
+  FDK_ASSERT(mh >= 4 && mh <= DIT_FFT_BLOCK_MAX_MH);
+
+  for (u = 0; u < mh; u++)
+  {
+    INT v = (u < mh/2) ? u : u - mh/2;
+    INT j = (v <= mh/4) ? v : mh/2 - v;
+
+    shift[u] = (j == 0) ? -1 : 0;
+    turn[u] = (u < mh/2) ? 0 : -1;
+
+    if (j == 0) {
+      c[u] = (FIXP_SGL)0;
+      s[u] = (FIXP_SGL)0;
+    } else if (j == mh/4) {
+      c[u] = sqrt05;
+      s[u] = sqrt05;
+    } else if (v == j) {
+      c[u] = trigdata[j*trigstep].v.re;
+      s[u] = trigdata[j*trigstep].v.im;
+    } else {
+      c[u] = trigdata[j*trigstep].v.im;
+      s[u] = trigdata[j*trigstep].v.re;
+    }
+  }
+
+  for (u = 0; u < mh; u += 4)
+  {
+    int32x4_t cu = FX_SGL2NEON(vld1_s16(c + u));
+    int32x4_t su = FX_SGL2NEON(vld1_s16(s + u));
+    uint32x4_t shiftu = vreinterpretq_u32_s32(vld1q_s32((const int32_t *)shift + u));
+    uint32x4_t turnu = vreinterpretq_u32_s32(vld1q_s32((const int32_t *)turn + u));
+
+    for (r = 0; r < n; r += m)
+    {
+      FIXP_DBL *p1 = x + ((r+u)<<1);
+      FIXP_DBL *p2 = p1 + (mh<<1);
+      int32x4x2_t x1 = vld2q_s32((const int32_t *)p1);
+      int32x4x2_t x2 = vld2q_s32((const int32_t *)p2);
+      int32x4_t prc = vbslq_s32(shiftu, vshrq_n_s32(x2.val[0], 1), fMultDiv2_neon(x2.val[0], cu));
+      int32x4_t pic = vbslq_s32(shiftu, vshrq_n_s32(x2.val[1], 1), fMultDiv2_neon(x2.val[1], cu));
+      int32x4_t dr = vaddq_s32(fMultDiv2_neon(x2.val[1], su), prc);
+      int32x4_t di = vsubq_s32(pic, fMultDiv2_neon(x2.val[0], su));
+      int32x4_t ur = vshrq_n_s32(x1.val[0], 1);
+      int32x4_t ui = vshrq_n_s32(x1.val[1], 1);
+      int32x4_t t = dr;
+
+      dr = vbslq_s32(turnu, di, dr);
+      di = vbslq_s32(turnu, vnegq_s32(t), di);
+
+      x1.val[0] = vaddq_s32(ur, dr);
+      x1.val[1] = vaddq_s32(ui, di);
+      x2.val[0] = vsubq_s32(ur, dr);
+      x2.val[1] = vsubq_s32(ui, di);
+
+      vst2q_s32((int32_t *)p1, x1);
+      vst2q_s32((int32_t *)p2, x2);
+    }
+  }
+}
+
+/* The C code's butterflies for one j > 0 across all blocks; the last two only for j < mh/4. */
+static void dit_fft_stage_j(FIXP_DBL *x, INT n, INT mh, INT j, FIXP_SGL c, FIXP_SGL s)
+{
+  INT m = mh<<1;
+  INT r;
+
+  for(r=0; r<n; r+=m)
+  {
+    INT t1 = (r+j)<<1;
+    INT t2 = t1 + (mh<<1);
+    FIXP_DBL vr,vi,ur,ui;
+
+    cplxMultDiv2(&vi, &vr, x[t2+1], x[t2], c, s);
+
+    ur = x[t1]>>1;
+    ui = x[t1+1]>>1;
+
+    x[t1]   = ur+vr;
+    x[t1+1] = ui+vi;
+
+    x[t2]   = ur-vr;
+    x[t2+1] = ui-vi;
+
+    t1 += mh;
+    t2 = t1+(mh<<1);
+
+    cplxMultDiv2(&vr, &vi, x[t2+1], x[t2], c, s);
+
+    ur = x[t1]>>1;
+    ui = x[t1+1]>>1;
+
+    x[t1]   = ur+vr;
+    x[t1+1] = ui-vi;
+
+    x[t2]   = ur-vr;
+    x[t2+1] = ui+vi;
+
+    if (j == mh/4)
+      continue;
+
+    /* Same as above but for t1,t2 with j>mh/4 and thus cs swapped */
+    t1 = (r+mh/2-j)<<1;
+    t2 = t1 + (mh<<1);
+
+    cplxMultDiv2(&vi, &vr, x[t2], x[t2+1], c, s);
+
+    ur = x[t1]>>1;
+    ui = x[t1+1]>>1;
+
+    x[t1]   = ur+vr;
+    x[t1+1] = ui-vi;
+
+    x[t2]   = ur-vr;
+    x[t2+1] = ui+vi;
+
+    t1 += mh;
+    t2 = t1+(mh<<1);
+
+    cplxMultDiv2(&vr, &vi, x[t2], x[t2+1], c, s);
+
+    ur = x[t1]>>1;
+    ui = x[t1+1]>>1;
+
+    x[t1]   = ur-vr;
+    x[t1+1] = ui-vi;
+
+    x[t2]   = ur+vr;
+    x[t2+1] = ui+vi;
+  }
+}
+
+void dit_fft_neon(FIXP_DBL *x, const INT ldn, const FIXP_STP *trigdata, const INT trigDataSize)
+{
+    const INT n=1<<ldn;
+    INT trigstep,i,ldm;
+
+    scramble(x,n);
+
+    /*
+     * 1+2 stage radix 4
+     */
+    for (i=0;i+32<=n*2;i+=32)
+    {
+      dit_fft_rad4_neon(x+i);
+    }
+    for (;i<n*2;i+=8)
+    {
+      FIXP_DBL a00, a10, a20, a30;
+      a00 = (x[i + 0] + x[i + 2])>>1;  /* Re A + Re B */
+      a10 = (x[i + 4] + x[i + 6])>>1;  /* Re C + Re D */
+      a20 = (x[i + 1] + x[i + 3])>>1;  /* Im A + Im B */
+      a30 = (x[i + 5] + x[i + 7])>>1;  /* Im C + Im D */
+
+      x[i + 0] = a00 + a10;       /* Re A' = Re A + Re B + Re C + Re D */
+      x[i + 4] = a00 - a10;       /* Re C' = Re A + Re B - Re C - Re D */
+      x[i + 1] = a20 + a30;       /* Im A' = Im A + Im B + Im C + Im D */
+      x[i + 5] = a20 - a30;       /* Im C' = Im A + Im B - Im C - Im D */
+
+      a00 = a00 - x[i + 2];       /* Re A - Re B */
+      a10 = a10 - x[i + 6];       /* Re C - Re D */
+      a20 = a20 - x[i + 3];       /* Im A - Im B */
+      a30 = a30 - x[i + 7];       /* Im C - Im D */
+
+      x[i + 2] = a00 + a30;       /* Re B' = Re A - Re B + Im C - Im D */
+      x[i + 6] = a00 - a30;       /* Re D' = Re A - Re B - Im C + Im D */
+      x[i + 3] = a20 - a10;       /* Im B' = Im A - Im B - Re C + Re D */
+      x[i + 7] = a20 + a10;       /* Im D' = Im A - Im B + Re C - Re D */
+    }
+
+    for(ldm=3; ldm<=ldn; ++ldm)
+    {
+        INT m=(1<<ldm);
+        INT mh=(m>>1);
+        INT j,r;
+
+        trigstep=((trigDataSize << 2)>>ldm);
+
+        FDK_ASSERT(trigstep > 0);
+
+        if (mh <= DIT_FFT_BLOCK_MAX_MH) {
+          dit_fft_stage_block_neon(x, n, mh, trigdata, trigstep);
+          continue;
+        }
+
+        /* j = 0 with c=1.0 and s=0.0, as in the C code. */
+        for(r=0; r<n; r+=m)
+        {
+            INT t1 = r<<1;
+            INT t2 = t1 + (mh<<1);
+            FIXP_DBL vr,vi,ur,ui;
+
+            vi = x[t2+1]>>1;
+            vr = x[t2]>>1;
+
+            ur = x[t1]>>1;
+            ui = x[t1+1]>>1;
+
+            x[t1]   = ur+vr;
+            x[t1+1] = ui+vi;
+
+            x[t2]   = ur-vr;
+            x[t2+1] = ui-vi;
+
+            t1 += mh;
+            t2 = t1+(mh<<1);
+
+            vr = x[t2+1]>>1;
+            vi = x[t2]>>1;
+
+            ur = x[t1]>>1;
+            ui = x[t1+1]>>1;
+
+            x[t1]   = ur+vr;
+            x[t1+1] = ui-vi;
+
+            x[t2]   = ur-vr;
+            x[t2+1] = ui+vi;
+        }
+
+        /* Four j at a time. Going up from mh/2-j and mh-j, the swapped halves see them backwards. */
+        for(j=1; j+3<mh/4; j+=4)
+        {
+            int16x4x2_t cs = vld2_dup_s16((const int16_t *)&trigdata[j*trigstep]);
+            int32x4_t c, s, cRev, sRev;
+
+            cs = vld2_lane_s16((const int16_t *)&trigdata[(j+1)*trigstep], cs, 1);
+            cs = vld2_lane_s16((const int16_t *)&trigdata[(j+2)*trigstep], cs, 2);
+            cs = vld2_lane_s16((const int16_t *)&trigdata[(j+3)*trigstep], cs, 3);
+
+            c = FX_SGL2NEON(cs.val[0]);
+            s = FX_SGL2NEON(cs.val[1]);
+            cRev = FX_SGL2NEON(vrev64_s16(cs.val[0]));
+            sRev = FX_SGL2NEON(vrev64_s16(cs.val[1]));
+
+            for(r=0; r<n; r+=m)
+            {
+                FIXP_DBL *p = x + ((r+j)<<1);
+                FIXP_DBL *q = x + ((r+mh/2-(j+3))<<1);
+
+                dit_fft_bfly_neon(p,      p + (mh<<1),      c,    s,    0);
+                dit_fft_bfly_neon(p + mh, p + mh + (mh<<1), c,    s,    1);
+                dit_fft_bfly_neon(q,      q + (mh<<1),      sRev, cRev, 0);
+                dit_fft_bfly_neon(q + mh, q + mh + (mh<<1), sRev, cRev, 1);
+            }
+        }
+        for(; j<mh/4; ++j)
+        {
+            dit_fft_stage_j(x, n, mh, j, trigdata[j*trigstep].v.re, trigdata[j*trigstep].v.im);
+        }
+
+        dit_fft_stage_j(x, n, mh, mh/4, STC(0x5a82799a), STC(0x5a82799a));
+    }
+}
+
+#endif /* FDK_NEON */
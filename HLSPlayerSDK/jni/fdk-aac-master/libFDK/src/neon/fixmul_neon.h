@@ -0,0 +1,27 @@
+/** \file   fixmul_neon.h
+ *  \brief  Fixed point helpers shared by the NEON kernels in this directory.
+ */
+
+#if !defined(__FIXMUL_NEON_H__)
+#define __FIXMUL_NEON_H__
+
+#include <arm_neon.h>
+
+/* Four FIXP_SGL factors in the form fMultDiv2_neon() takes them. */
+#define FX_SGL2NEON(b) vshll_n_s16((b), 15)
+
+/* Four fMultDiv2(FIXP_DBL, FIXP_SGL) at once, with b from FX_SGL2NEON(). vqdmulh of a by b<<15
+   is floor(a*b/2^16), exactly what the C code gets, and it never saturates since b<<15 can't be -1.0. */
+static inline int32x4_t fMultDiv2_neon(int32x4_t a, int32x4_t b)
+{
+  return vqdmulhq_s32(a, b);
+}
+
+/* Lanes in reverse order. */
+static inline int32x4_t fReverse_neon(int32x4_t a)
+{
+  a = vrev64q_s32(a);
+  return vcombine_s32(vget_high_s32(a), vget_low_s32(a));
+}
+
+#endif /* __FIXMUL_NEON_H__ */
@@ -0,0 +1,145 @@
+/** \file   qmf_neon.cpp
+ *  \brief  NEON versions of qmfSynPrototypeFirSlot() and qmfAnaPrototypeFirSlot() from qmf.cpp.
+ */
+
+#include "FDK_neon.h"
+
+#if defined(FDK_NEON)
+
+#include "fixmul_neon.h"
+
+/*!
+  \brief Perform Synthesis Prototype Filtering on a single slot of input data.
+
+  Per channel, the eight states that move up by one are done as an even and an odd half:
+  sta[0,2,4,6] take sta[1,3,5,7] plus imag weighted with p_flt[4..1], sta[1,3,5,7] take
+  sta[2,4,6,8] plus real weighted with p_fltm[1..4].
+*/
+void qmfSynPrototypeFirSlot_neon(HANDLE_QMF_FILTER_BANK qmf,
+                                 FIXP_QMF *RESTRICT realSlot,
+                                 FIXP_QMF *RESTRICT imagSlot,
+                                 INT_PCM  *RESTRICT timeOut,
+                                 int       stride)
+{
+  int       no_channels = qmf->no_channels;
+  const FIXP_PFT *p_Filter = qmf->p_filter;
+  int p_stride = qmf->p_stride;
+  int j;
+  FIXP_QSS *RESTRICT sta = (FIXP_QSS*)qmf->FilterStates;
+  const FIXP_PFT *RESTRICT p_flt, *RESTRICT p_fltm;
+  int scale = ((DFRACT_BITS-SAMPLE_BITS)-1-qmf->outScalefactor);
+
+  p_flt  = p_Filter+p_stride*QMF_NO_POLY;
+  p_fltm = p_Filter+(qmf->FilterSize/2)-p_stride*QMF_NO_POLY;
+
+  FDK_ASSERT(SAMPLE_BITS-1-qmf->outScalefactor >= 0);
+
+  for (j = no_channels-1; j >= 0; j--) {
+    FIXP_QMF imag  =  imagSlot[j];
+    FIXP_QMF real  =  realSlot[j];
+    {
+      INT_PCM tmp;
+      FIXP_DBL Are = sta[0] + fMultDiv2( p_fltm[0] , real);
+
+      if (qmf->outGain!=(FIXP_DBL)0x80000000) {
+        Are = fMult(Are,qmf->outGain);
+      }
+
+      tmp = (INT_PCM)(SATURATE_RIGHT_SHIFT(fAbs(Are), scale, SAMPLE_BITS));
+      if (Are < (FIXP_QMF)0) {
+        tmp = -tmp;
+      }
+      timeOut[ (j)*stride ] = tmp;
+    }
+    {
+      int32x4x2_t s = vld2q_s32((const int32_t *)sta);
+      int32x4_t next = vextq_s32(s.val[0], vdupq_n_s32(sta[8]), 1);
+      int32x4_t cIm = FX_SGL2NEON(vrev64_s16(vld1_s16(p_flt+1)));
+      int32x4_t cRe = FX_SGL2NEON(vld1_s16(p_fltm+1));
+
+      s.val[0] = vaddq_s32(s.val[1], fMultDiv2_neon(cIm, vdupq_n_s32(imag)));
+      s.val[1] = vaddq_s32(next, fMultDiv2_neon(cRe, vdupq_n_s32(real)));
+      vst2q_s32((int32_t *)sta, s);
+      sta[8] = fMultDiv2( p_flt [0] , imag );
+    }
+
+    p_flt  += (p_stride*QMF_NO_POLY);
+    p_fltm -= (p_stride*QMF_NO_POLY);
+    sta    += 9; // = (2*QMF_NO_POLY-1);
+  }
+}
+
+/* One analysis FIR filter, the scalar way. */
+static FIXP_DBL qmfAnaFir(const FIXP_PFT *RESTRICT p_flt, const FIXP_QAS *RESTRICT sta, int staStep)
+{
+  FIXP_DBL accu;
+
+  accu =  fMultDiv2( p_flt[0], *sta);  sta += staStep;
+  accu += fMultDiv2( p_flt[1], *sta);  sta += staStep;
+  accu += fMultDiv2( p_flt[2], *sta);  sta += staStep;
+  accu += fMultDiv2( p_flt[3], *sta);  sta += staStep;
+  accu += fMultDiv2( p_flt[4], *sta);
+
+  return accu;
+}
+
+/*!
+  \brief Perform Analysis Prototype Filtering on a single slot of input data.
+
+  Coefficient set m (at p_filter + m*5*p_stride) is used twice: for analysisBuffer[m], over the
+  states running back from the end, and for analysisBuffer[2*no_channels-m], over the states
+  running forward from the start. Four neighbouring sets are done at once; states and
+  coefficients are both 16 bit, so the products are exact.
+*/
+void qmfAnaPrototypeFirSlot_neon(FIXP_QMF *analysisBuffer,
+                                 int       no_channels,
+                                 const FIXP_PFT *p_filter,
+                                 int       p_stride,
+                                 FIXP_QAS *RESTRICT pFilterStates)
+{
+  const FIXP_QAS *RESTRICT sta_0 = pFilterStates;
+  const FIXP_QAS *RESTRICT sta_1 = pFilterStates + (2*QMF_NO_POLY*no_channels) - 1;
+  int pfltStep = QMF_NO_POLY * (p_stride);
+  int staStep = no_channels<<1;
+  int m;
+
+  /* FIR filter 0 */
+  analysisBuffer[0] = FX_DBL2FX_QMF(qmfAnaFir(p_filter, sta_1, -staStep)<<1);
+
+  /* FIR filters 1..63 127..65 */
+  for (m = 1; m+3 < no_channels; m += 4)
+  {
+    const FIXP_PFT *RESTRICT p_flt = p_filter + m*pfltStep;
+    int32x4_t accu0 = vdupq_n_s32(0);
+    int32x4_t accu1 = vdupq_n_s32(0);
+    int p;
+
+    for (p = 0; p < QMF_NO_POLY; p++)
+    {
+      int16x4_t c = vdup_n_s16(0);
+
+      c = vld1_lane_s16(p_flt + p,              c, 0);
+      c = vld1_lane_s16(p_flt + p +   pfltStep, c, 1);
+      c = vld1_lane_s16(p_flt + p + 2*pfltStep, c, 2);
+      c = vld1_lane_s16(p_flt + p + 3*pfltStep, c, 3);
+
+      accu0 = vmlal_s16(accu0, c, vld1_s16(sta_0 + (m-1) + p*staStep));
+      accu1 = vmlal_s16(accu1, c, vrev64_s16(vld1_s16(sta_1 - (m+3) - p*staStep)));
+    }
+
+    vst1q_s32((int32_t *)analysisBuffer + 2*no_channels - (m+3), fReverse_neon(vshlq_n_s32(accu0, 1)));
+    vst1q_s32((int32_t *)analysisBuffer + m, vshlq_n_s32(accu1, 1));
+  }
+  for (; m < no_channels; m++)
+  {
+    const FIXP_PFT *RESTRICT p_flt = p_filter + m*pfltStep;
+
+    analysisBuffer[2*no_channels - m] = FX_DBL2FX_QMF(qmfAnaFir(p_flt, sta_0 + (m-1), staStep)<<1);
+    analysisBuffer[m] = FX_DBL2FX_QMF(qmfAnaFir(p_flt, sta_1 - m, -staStep)<<1);
+  }
+
+  /* FIR filter 64 */
+  analysisBuffer[no_channels] = FX_DBL2FX_QMF(qmfAnaFir(p_filter + no_channels*pfltStep, sta_0 + (no_channels-1), staStep)<<1);
+}
+
+#endif /* FDK_NEON */
@@ -121,6 +121,7 @@ amm-info@iis.fraunhofer.de
 
 #include "fixpoint_math.h"
 #include "dct.h"
+#include "FDK_neon.h"
 
 #ifdef QMFSYN_STATES_16BIT
 #define QSSCALE (7)
@@ -574,6 +575,16 @@ qmfAnalysisFilteringSlot( HANDLE_QMF_FILTER_BANK anaQmf,  /*!< Handle of Qmf Syn
                               (FIXP_QAS*)anaQmf->FilterStates
                             );
     } else {
+#if defined(FDK_NEON)
+      if (FDK_neonAvailable())
+        qmfAnaPrototypeFirSlot_neon( pWorkBuffer,
+                                     anaQmf->no_channels,
+                                     anaQmf->p_filter,
+                                     anaQmf->p_stride,
+                                     (FIXP_QAS*)anaQmf->FilterStates
+                                   );
+      else
+#endif /* FDK_NEON */
       qmfAnaPrototypeFirSlot( pWorkBuffer,
                               anaQmf->no_channels,
                               anaQmf->p_filter,
@@ -874,6 +885,16 @@ void qmfSynthesisFilteringSlot( HANDLE_QMF_FILTER_BANK  synQmf,
                                  stride
                                );
     } else {
+#if defined(FDK_NEON)
+      if (FDK_neonAvailable())
+        qmfSynPrototypeFirSlot_neon ( synQmf,
+                                      pWorkBuffer,
+                                      pWorkBuffer+synQmf->no_channels,
+                                      timeOut,
+                                      stride
+                                    );
+      else
+#endif /* FDK_NEON */
         qmfSynPrototypeFirSlot ( synQmf,
                                  pWorkBuffer,
                                  pWorkBuffer+synQmf->no_channels,
@@ -107,6 +107,8 @@ amm-info@iis.fraunhofer.de
 
 #include "sbrdec_drc.h"
 
+#include "FDK_bench.h"
+
 
 
 static void assignLcTimeSlots( HANDLE_SBR_DEC hSbrDec,                     /*!< handle to Decoder channel */
@@ -357,6 +359,7 @@ sbr_dec ( HANDLE_SBR_DEC hSbrDec,            /*!< handle to Decoder channel */
   {
     C_AALLOC_SCRATCH_START(qmfTemp, FIXP_DBL, 2*(64));
 
+    FDK_BENCH_ENTER(FDK_BENCH_QMF);
     qmfAnalysisFiltering( &hSbrDec->AnalysiscQMF,
                            QmfBufferReal + ov_len,
                            QmfBufferImag + ov_len,
@@ -365,6 +368,7 @@ sbr_dec ( HANDLE_SBR_DEC hSbrDec,            /*!< handle to Decoder channel */
                            strideIn,
                            qmfTemp
                          );
+    FDK_BENCH_LEAVE();
 
     C_AALLOC_SCRATCH_END(qmfTemp, FIXP_DBL, 2*(64));
   }
@@ -523,6 +527,7 @@ sbr_dec ( HANDLE_SBR_DEC hSbrDec,            /*!< handle to Decoder channel */
       {
         C_AALLOC_SCRATCH_START(qmfTemp, FIXP_DBL, 2*(64));
 
+        FDK_BENCH_ENTER(FDK_BENCH_QMF);
         qmfSynthesisFiltering( &hSbrDec->SynthesisQMF,
                                 QmfBufferReal,
                                 (flags & SBRDEC_LOW_POWER) ? NULL : QmfBufferImag,
@@ -531,6 +536,7 @@ sbr_dec ( HANDLE_SBR_DEC hSbrDec,            /*!< handle to Decoder channel */
                                 timeOut,
                                 strideOut,
                                 qmfTemp);
+        FDK_BENCH_LEAVE();
 
         C_AALLOC_SCRATCH_END(qmfTemp, FIXP_DBL, 2*(64));
       }
@@ -611,6 +617,7 @@ sbr_dec ( HANDLE_SBR_DEC hSbrDec,            /*!< handle to Decoder channel */
 
 
         {
+          FDK_BENCH_ENTER(FDK_BENCH_PS);
           if ( i == h_ps_d->bsData[h_ps_d->processSlot].mpeg.aEnvStartStop[env] ) {
             initSlotBasedRotation( h_ps_d, env, hHeaderData->freqBandData.highSubband );
             env++;
@@ -621,6 +628,7 @@ sbr_dec ( HANDLE_SBR_DEC hSbrDec,            /*!< handle to Decoder channel */
                       (QmfBufferImag + i),       /* one timeslot of left/mono channel */
                        rQmfReal,                 /* one timeslot or right channel     */
                        rQmfImag);                /* one timeslot or right channel     */
+          FDK_BENCH_LEAVE();
         }
 
 
@@ -655,6 +663,7 @@ sbr_dec ( HANDLE_SBR_DEC hSbrDec,            /*!< handle to Decoder channel */
         qmfChangeOutScalefactor( synQmfRight, outScalefactorR );
 
         {
+          FDK_BENCH_ENTER(FDK_BENCH_QMF);
 
           qmfSynthesisFilteringSlot( synQmfRight,
                                      rQmfReal,                /* QMF real buffer */
@@ -674,6 +683,7 @@ sbr_dec ( HANDLE_SBR_DEC hSbrDec,            /*!< handle to Decoder channel */
                                      strideOut,
                                      pWorkBuffer);
 
+          FDK_BENCH_LEAVE();
         }
       } /* no_col loop  i  */
 
@@ -133,6 +133,8 @@ amm-info@iis.fraunhofer.de
 
 #include "psbitdec.h"
 
+#include "FDK_bench.h"
+
 
 /* Decoder library info */
 #define SBRDECODER_LIB_VL0 2
@@ -1316,7 +1318,9 @@ sbrDecoder_DecodeElement (
     /* define which frame delay line slot to process */
     h_ps_d->processSlot = hSbrElement->useFrameSlot;
 
+    FDK_BENCH_ENTER(FDK_BENCH_PS);
     applyPs = DecodePs(h_ps_d, hSbrHeader->frameErrorFlag);
+    FDK_BENCH_LEAVE();
     self->flags |= (applyPs) ? SBRDEC_PS_DECODED : 0;
   }
 
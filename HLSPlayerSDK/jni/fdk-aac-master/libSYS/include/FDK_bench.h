@@ -0,0 +1,40 @@
+/** \file   FDK_bench.h
+ *  \brief  Per module timing hooks for the host decode benchmark (Tools/AACBench).
+ *
+ *  The decoder marks where its main modules start and end with FDK_BENCH_ENTER()
+ *  and FDK_BENCH_LEAVE(). Unless FDK_BENCH is defined these compile to nothing,
+ *  so device builds are unchanged. With FDK_BENCH defined, whoever links the
+ *  library supplies FDK_benchEnter() and FDK_benchLeave(). Modules nest: time
+ *  spent in a module entered from inside another is not counted twice.
+ */
+
+#if !defined(__FDK_BENCH_H__)
+#define __FDK_BENCH_H__
+
+typedef enum
+{
+  FDK_BENCH_CORE = 0,   /*!< AAC core decoding, CAacDecoder_DecodeFrame(). */
+  FDK_BENCH_SBR,        /*!< SBR envelope decoding and high band generation. */
+  FDK_BENCH_PS,         /*!< Parametric stereo, bitstream and per slot processing. */
+  FDK_BENCH_QMF,        /*!< SBR analysis and synthesis filter banks. */
+
+  FDK_BENCH_MODULES
+
+} FDK_BENCH_MODULE;
+
+#if defined(FDK_BENCH)
+
+void FDK_benchEnter(FDK_BENCH_MODULE module);
+void FDK_benchLeave(void);
+
+#define FDK_BENCH_ENTER(module) FDK_benchEnter(module)
+#define FDK_BENCH_LEAVE()       FDK_benchLeave()
+
+#else
+
+#define FDK_BENCH_ENTER(module)
+#define FDK_BENCH_LEAVE()
+
+#endif
+
+#endif /* __FDK_BENCH_H__ */
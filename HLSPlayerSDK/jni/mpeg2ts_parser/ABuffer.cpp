@@ -21,11 +21,78 @@
 #include "ADebug.h"
 //#include "ALooper.h"
 #include "AMessage.h"
+#include "threads.h"
 
 namespace android {
 
+// Pool size classes run from 1KB to 2MB. Anything outside that goes
+// straight to malloc.
+static const size_t kMinPoolShift = 10;
+static const size_t kMaxPoolShift = 21;
+static const size_t kNumPoolClasses = kMaxPoolShift - kMinPoolShift + 1;
+static const size_t kMaxBlocksPerClass = 8;
+static const size_t kMaxPooledBytes = 4 * 1024 * 1024;
+
+static Mutex gPoolLock;
+static void *gPool[kNumPoolClasses][kMaxBlocksPerClass];
+static size_t gPoolCount[kNumPoolClasses];
+static size_t gPooledBytes = 0;
+
+static ssize_t poolClassFor(size_t capacity) {
+    if (capacity == 0 || capacity > ((size_t)1 << kMaxPoolShift)) {
+        return -1;
+    }
+
+    size_t shift = kMinPoolShift;
+    while (((size_t)1 << shift) < capacity) {
+        ++shift;
+    }
+
+    return shift - kMinPoolShift;
+}
+
+// static
+void *ABuffer::allocPooled(size_t capacity) {
+    ssize_t cls = poolClassFor(capacity);
+    if (cls < 0) {
+        return malloc(capacity);
+    }
+
+    {
+        Mutex::Autolock autoLock(gPoolLock);
+        if (gPoolCount[cls] > 0) {
+            gPooledBytes -= (size_t)1 << (cls + kMinPoolShift);
+            return gPool[cls][--gPoolCount[cls]];
+        }
+    }
+
+    return malloc((size_t)1 << (cls + kMinPoolShift));
+}
+
+// static
+void ABuffer::freePooled(void *data, size_t capacity) {
+    if (data == NULL) {
+        return;
+    }
+
+    ssize_t cls = poolClassFor(capacity);
+    if (cls >= 0) {
+        size_t blockSize = (size_t)1 << (cls + kMinPoolShift);
+
+        Mutex::Autolock autoLock(gPoolLock);
+        if (gPoolCount[cls] < kMaxBlocksPerClass
+                && gPooledBytes + blockSize <= kMaxPooledBytes) {
+            gPool[cls][gPoolCount[cls]++] = data;
+            gPooledBytes += blockSize;
+            return;
+        }
+    }
+
+    free(data);
+}
+
 ABuffer::ABuffer(size_t capacity)
-    : mData(malloc(capacity)),
+    : mData(allocPooled(capacity)),
       mCapacity(capacity),
       mRangeOffset(0),
       mRangeLength(capacity),
@@ -42,10 +109,21 @@ ABuffer::ABuffer(void *data, size_t capacity)
       mOwnsData(false) {
 }
 
+ABuffer::ABuffer(const sp<ABuffer> &parent, size_t offset, size_t size)
+    : mParent(parent),
+      mData(parent->base() + offset),
+      mCapacity(size),
+      mRangeOffset(0),
+      mRangeLength(size),
+      mInt32Data(0),
+      mOwnsData(false) {
+    CHECK_LE(offset + size, parent->capacity());
+}
+
 ABuffer::~ABuffer() {
     if (mOwnsData) {
         if (mData != NULL) {
-            free(mData);
+            freePooled(mData, mCapacity);
             mData = NULL;
         }
     }
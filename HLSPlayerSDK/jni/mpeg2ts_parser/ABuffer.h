@@ -32,6 +32,10 @@ struct ABuffer : public RefBase {
     ABuffer(size_t capacity);
     ABuffer(void *data, size_t capacity);
 
+    // A buffer over [offset, offset + size) of |parent|'s storage, which it
+    // keeps alive. Nothing is copied.
+    ABuffer(const sp<ABuffer> &parent, size_t offset, size_t size);
+
     void setFarewellMessage(const sp<AMessage> msg);
 
     uint8_t *base() { return (uint8_t *)mData; }
@@ -47,12 +51,19 @@ struct ABuffer : public RefBase {
 
     sp<AMessage> meta();
 
+    // Backing store for owned buffers comes from a small pool of power of
+    // two sized blocks, so steady state demuxing doesn't hit malloc for
+    // every access unit.
+    static void *allocPooled(size_t capacity);
+    static void freePooled(void *data, size_t capacity);
+
 protected:
     virtual ~ABuffer();
 
 private:
     sp<AMessage> mFarewell;
     sp<AMessage> mMeta;
+    sp<ABuffer> mParent;
 
     void *mData;
     size_t mCapacity;
@@ -25,7 +25,7 @@
 
 #include "AnotherPacketSource.h"
 #include "ESQueue.h"
-//#include "include/avc_utils.h"
+#include "avc_utils.h"
 
 #include "ABitReader.h"
 #include "ABuffer.h"
@@ -38,6 +38,14 @@
 //#include <media/IStreamSource.h>
 #include "KeyedVector.h"
 
+#include <pthread.h>
+
+#if defined(HAVE_TS_NEON) && defined(__arm__)
+#include <cpu-features.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 //#define LOG_VERBOSE(...) ((void)ALOG(ANDROID_LOG_VERBOSE, LOG_TAG, __VA_ARGS__))
 //#define ALOG(...) ((void)ALOG(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__))
 #define ALOGI(...) ((void)ALOG(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__))
@@ -51,6 +59,135 @@ namespace android {
 
 
 static const size_t kTSPacketSize = 188;
+static const uint8_t kTSSyncByte = 0x47;
+
+// Cap on the access unit index, about two minutes of 30fps video. The oldest
+// half goes when it's reached; seeks only ever look near the read position.
+static const size_t kMaxAccessUnitIndexEntries = 4096;
+
+// Number of packet boundaries, including the candidate itself, that must
+// carry a sync byte before we trust a new alignment after losing sync.
+static const size_t kTSResyncPackets = 3;
+
+#ifdef HAVE_TS_NEON
+// ATSParser_neon.cpp, built with NEON enabled.
+size_t findByteNEON(const uint8_t *data, size_t size, uint8_t value);
+
+static bool gHasNEON = false;
+static pthread_once_t gNEONOnce = PTHREAD_ONCE_INIT;
+
+static void checkNEON() {
+#if defined(__arm__)
+    gHasNEON = android_getCpuFamily() == ANDROID_CPU_FAMILY_ARM
+            && (android_getCpuFeatures() & ANDROID_CPU_ARM_FEATURE_NEON) != 0;
+#else
+    gHasNEON = true;  // Always there on arm64.
+#endif
+}
+#endif
+
+// Returns the offset of the first sync byte in data[0..size), or size if
+// there is none. With NEON (checked for at runtime on armeabi-v7a) or SSE2
+// this tests 16 bytes at a time; otherwise it's left to memchr.
+static size_t findSyncByte(const uint8_t *data, size_t size) {
+    size_t offset = 0;
+
+#if defined(HAVE_TS_NEON)
+    pthread_once(&gNEONOnce, checkNEON);
+    if (gHasNEON) {
+        return findByteNEON(data, size, kTSSyncByte);
+    }
+#elif defined(__SSE2__)
+    const __m128i sync = _mm_set1_epi8(kTSSyncByte);
+    for (; offset + 16 <= size; offset += 16) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+                _mm_loadu_si128((const __m128i *)(data + offset)), sync));
+
+        if (mask != 0) {
+            return offset + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    const void *match = memchr(data + offset, kTSSyncByte, size - offset);
+    return match ? (const uint8_t *)match - data : size;
+}
+
+// Finds the next offset in data[0..size) that starts a run of packets, i.e.
+// a sync byte followed by sync bytes at 188 byte stride for the next
+// kTSResyncPackets - 1 packets. Returns size if there is none.
+//
+// A candidate whose run goes past the end of the buffer can't be checked
+// fully. It's returned with |*confirmed| false, having passed as much of the
+// check as the buffer holds.
+static size_t findPacketBoundary(
+        const uint8_t *data, size_t size, bool *confirmed) {
+    size_t offset = 0;
+
+    *confirmed = true;
+    while ((offset += findSyncByte(data + offset, size - offset)) < size) {
+        size_t i = 1;
+        while (i < kTSResyncPackets
+                && offset + i * kTSPacketSize < size
+                && data[offset + i * kTSPacketSize] == kTSSyncByte) {
+            ++i;
+        }
+
+        if (i == kTSResyncPackets) {
+            return offset;
+        }
+
+        if (offset + i * kTSPacketSize >= size) {
+            *confirmed = false;
+            return offset;
+        }
+
+        ++offset;
+    }
+
+    return size;
+}
+
+// Reads the PTS out of the PES header at the start of data[0..size), for
+// PROBE_ONLY parsing. |*PTS| is -1 if the header carries none. Returns
+// false if there's no complete header with an optional part there.
+static bool probePESHeader(
+        const uint8_t *data, size_t size, int64_t *PTS, size_t *headerSize) {
+    if (size < 9 || data[0] != 0x00 || data[1] != 0x00 || data[2] != 0x01) {
+        return false;
+    }
+
+    unsigned stream_id = data[3];
+    if (stream_id == 0xbc || stream_id == 0xbe || stream_id == 0xbf
+            || stream_id == 0xf0 || stream_id == 0xf1 || stream_id == 0xff
+            || stream_id == 0xf2 || stream_id == 0xf8) {
+        return false;
+    }
+
+    if ((data[6] >> 6) != 2) {
+        return false;
+    }
+
+    unsigned PTS_DTS_flags = data[7] >> 6;
+    unsigned PES_header_data_length = data[8];
+
+    *headerSize = 9 + PES_header_data_length;
+    if (*headerSize > size) {
+        return false;
+    }
+
+    *PTS = -1;
+    if ((PTS_DTS_flags == 2 || PTS_DTS_flags == 3)
+            && PES_header_data_length >= 5) {
+        *PTS = ((int64_t)((data[9] >> 1) & 7) << 30)
+            | (data[10] << 22)
+            | ((data[11] >> 1) << 15)
+            | (data[12] << 7)
+            | (data[13] >> 1);
+    }
+
+    return true;
+}
 
 struct ATSParser::Program : public RefBase {
     Program(ATSParser *parser, unsigned programNumber, unsigned programMapPID);
@@ -61,17 +198,31 @@ struct ATSParser::Program : public RefBase {
     bool parsePID(
             unsigned pid, unsigned continuity_counter,
             unsigned payload_unit_start_indicator,
-            ABitReader *br, status_t *err);
+            const uint8_t *payload, size_t payloadSize, status_t *err);
 
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
 
     void signalEOS(status_t finalResult);
 
+    void skipUntil(int64_t timeUs, bool keepReferenceFrames);
+    void resetStreams();
+
     sp<AnotherPacketSource> getSource(SourceType type);
 
+    bool getProbeInfo(SourceType type, ProbeInfo *info) const;
+    bool probeComplete() const;
+
     int64_t convertPTSToTimestamp(uint64_t PTS);
 
+    off64_t packetOffset() const {
+        return mParser->mPacketOffset;
+    }
+
+    void addIndexEntry(int64_t timeUs, off64_t offset, bool isSync) {
+        mParser->addIndexEntry(timeUs, offset, isSync);
+    }
+
     bool PTSTimeDeltaEstablished() const {
         return mFirstPTSValid;
     }
@@ -116,15 +267,23 @@ struct ATSParser::Stream : public RefBase {
     status_t parse(
             unsigned continuity_counter,
             unsigned payload_unit_start_indicator,
-            ABitReader *br);
+            const uint8_t *payload, size_t payloadSize);
 
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
 
     void signalEOS(status_t finalResult);
 
+    void skipUntil(int64_t timeUs, bool keepReferenceFrames);
+    void reset();
+
     sp<AnotherPacketSource> getSource(SourceType type);
 
+    bool isAudio() const;
+    bool isVideo() const;
+
+    const ProbeInfo &probeInfo() const { return mProbeInfo; }
+
 protected:
     virtual ~Stream();
 
@@ -143,6 +302,28 @@ private:
 
     ElementaryStreamQueue *mQueue;
 
+    // Where the PES packets whose payload is still in mQueue started. The
+    // queue only hands out an access unit once the next one has begun, so
+    // they're matched up by time when it does.
+    enum { kMaxPendingPESStarts = 8 };
+    struct PESStart {
+        int64_t timeUs;
+        off64_t offset;
+    };
+    off64_t mPESOffset;
+    PESStart mPendingPESStarts[kMaxPendingPESStarts];
+    size_t mNumPendingPESStarts;
+
+    // See ATSParser::skipUntil(); mSkipUntilUs is -1 when not skipping.
+    int64_t mSkipUntilUs;
+    bool mSkipKeepsReferenceFrames;
+    bool mSkipSawSyncFrame;
+
+    // PROBE_ONLY state. The window holds the last four payload bytes seen,
+    // for finding NAL unit start codes across packet boundaries.
+    ProbeInfo mProbeInfo;
+    uint32_t mProbeWindow;
+
     status_t flush();
     status_t parsePES(ABitReader *br);
 
@@ -152,8 +333,12 @@ private:
 
     void extractAACFrames(const sp<ABuffer> &buffer);
 
-    bool isAudio() const;
-    bool isVideo() const;
+    void indexAccessUnit(int64_t timeUs, bool isSync);
+    bool shouldSkip(int64_t timeUs, bool isSync, bool isReference);
+
+    void probe(
+            unsigned payload_unit_start_indicator,
+            const uint8_t *payload, size_t payloadSize);
 
     DISALLOW_EVIL_CONSTRUCTORS(Stream);
 };
@@ -207,7 +392,7 @@ bool ATSParser::Program::parsePSISection(
 bool ATSParser::Program::parsePID(
         unsigned pid, unsigned continuity_counter,
         unsigned payload_unit_start_indicator,
-        ABitReader *br, status_t *err) {
+        const uint8_t *payload, size_t payloadSize, status_t *err) {
     *err = OK;
 
     ssize_t index = mStreams.indexOfKey(pid);
@@ -216,7 +401,8 @@ bool ATSParser::Program::parsePID(
     }
 
     *err = mStreams.editValueAt(index)->parse(
-            continuity_counter, payload_unit_start_indicator, br);
+            continuity_counter, payload_unit_start_indicator,
+            payload, payloadSize);
 
     return true;
 }
@@ -242,6 +428,18 @@ void ATSParser::Program::signalEOS(status_t finalResult) {
     }
 }
 
+void ATSParser::Program::skipUntil(int64_t timeUs, bool keepReferenceFrames) {
+    for (size_t i = 0; i < mStreams.size(); ++i) {
+        mStreams.editValueAt(i)->skipUntil(timeUs, keepReferenceFrames);
+    }
+}
+
+void ATSParser::Program::resetStreams() {
+    for (size_t i = 0; i < mStreams.size(); ++i) {
+        mStreams.editValueAt(i)->reset();
+    }
+}
+
 struct StreamInfo {
     unsigned mType;
     unsigned mPID;
@@ -441,6 +639,46 @@ sp<AnotherPacketSource> ATSParser::Program::getSource(SourceType type) {
     return NULL;
 }
 
+bool ATSParser::Program::getProbeInfo(
+        SourceType type, ProbeInfo *info) const {
+    for (size_t i = 0; i < mStreams.size(); ++i) {
+        const sp<Stream> &stream = mStreams.valueAt(i);
+
+        if ((type == VIDEO && stream->isVideo())
+                || (type == AUDIO && stream->isAudio())) {
+            *info = stream->probeInfo();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ATSParser::Program::probeComplete() const {
+    if (mStreams.isEmpty()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < mStreams.size(); ++i) {
+        const sp<Stream> &stream = mStreams.valueAt(i);
+
+        if (!stream->isVideo() && !stream->isAudio()) {
+            continue;
+        }
+
+        const ProbeInfo &info = stream->probeInfo();
+        if (info.firstPTS < 0) {
+            return false;
+        }
+
+        if (stream->type() == STREAMTYPE_H264 && !info.hasSyncFrame) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 int64_t ATSParser::Program::convertPTSToTimestamp(uint64_t PTS) {
     if (!(mParser->mFlags & TS_TIMESTAMPS_ARE_ABSOLUTE)) {
         if (!mFirstPTSValid) {
@@ -485,8 +723,22 @@ ATSParser::Stream::Stream(
       mExpectedContinuityCounter(-1),
       mPayloadStarted(false),
       mPrevPTS(0),
-      mQueue(NULL) {
-    switch (mStreamType) {
+      mQueue(NULL),
+      mPESOffset(0),
+      mNumPendingPESStarts(0),
+      mSkipUntilUs(-1),
+      mSkipKeepsReferenceFrames(false),
+      mSkipSawSyncFrame(false),
+      mProbeWindow(0xffffffff) {
+    mProbeInfo.firstPTS = -1;
+    mProbeInfo.lastPTS = -1;
+    mProbeInfo.hasSyncFrame = false;
+
+    // Probing needs neither the queue nor the PES buffer.
+    unsigned queueType =
+        (mProgram->parserFlags() & PROBE_ONLY) ? 0 : mStreamType;
+
+    switch (queueType) {
         case STREAMTYPE_H264:
             mQueue = new ElementaryStreamQueue(
                     ElementaryStreamQueue::H264,
@@ -537,7 +789,13 @@ ATSParser::Stream::~Stream() {
 
 status_t ATSParser::Stream::parse(
         unsigned continuity_counter,
-        unsigned payload_unit_start_indicator, ABitReader *br) {
+        unsigned payload_unit_start_indicator,
+        const uint8_t *payload, size_t payloadSize) {
+    if (mProgram->parserFlags() & PROBE_ONLY) {
+        probe(payload_unit_start_indicator, payload, payloadSize);
+        return OK;
+    }
+
     if (mQueue == NULL) {
         return OK;
     }
@@ -579,16 +837,14 @@ status_t ATSParser::Stream::parse(
         }
 
         mPayloadStarted = true;
+        mPESOffset = mProgram->packetOffset();
     }
 
     if (!mPayloadStarted) {
         return OK;
     }
 
-    size_t payloadSizeBits = br->numBitsLeft();
-    CHECK_EQ(payloadSizeBits % 8, 0u);
-
-    size_t neededSize = mBuffer->size() + payloadSizeBits / 8;
+    size_t neededSize = mBuffer->size() + payloadSize;
     if (mBuffer->capacity() < neededSize) {
         // Increment in multiples of 64K.
         neededSize = (neededSize + 65535) & ~65535;
@@ -601,8 +857,8 @@ status_t ATSParser::Stream::parse(
         mBuffer = newBuffer;
     }
 
-    memcpy(mBuffer->data() + mBuffer->size(), br->data(), payloadSizeBits / 8);
-    mBuffer->setRange(0, mBuffer->size() + payloadSizeBits / 8);
+    memcpy(mBuffer->data() + mBuffer->size(), payload, payloadSize);
+    mBuffer->setRange(0, mBuffer->size() + payloadSize);
 
     return OK;
 }
@@ -681,6 +937,131 @@ void ATSParser::Stream::signalEOS(status_t finalResult) {
     }
 }
 
+void ATSParser::Stream::skipUntil(int64_t timeUs, bool keepReferenceFrames) {
+    mSkipUntilUs = timeUs;
+    mSkipKeepsReferenceFrames = keepReferenceFrames;
+    mSkipSawSyncFrame = false;
+}
+
+void ATSParser::Stream::reset() {
+    mExpectedContinuityCounter = -1;
+    mProbeWindow = 0xffffffff;
+
+    if (mQueue == NULL) {
+        return;
+    }
+
+    mPayloadStarted = false;
+    mBuffer->setRange(0, 0);
+    mNumPendingPESStarts = 0;
+    mQueue->clear(false /* clearFormat */);
+
+    if (mSource != NULL) {
+        mSource->flush();
+    }
+}
+
+// Timestamps are taken straight from the packet that starts each PES packet,
+// the header always fits in it in practice. H.264 payloads are scanned for an
+// IDR slice NAL unit until one turns up, start codes can't occur anywhere
+// else in the elementary stream.
+void ATSParser::Stream::probe(
+        unsigned payload_unit_start_indicator,
+        const uint8_t *payload, size_t payloadSize) {
+    if (!isVideo() && !isAudio()) {
+        return;
+    }
+
+    if (payload_unit_start_indicator) {
+        int64_t PTS;
+        size_t headerSize;
+        if (!probePESHeader(payload, payloadSize, &PTS, &headerSize)) {
+            LOGATS("stream 0x%04x: no PES header to probe", mElementaryPID);
+            return;
+        }
+
+        if (PTS >= 0) {
+            if (mProbeInfo.firstPTS < 0 || PTS < mProbeInfo.firstPTS) {
+                mProbeInfo.firstPTS = PTS;
+            }
+            if (PTS > mProbeInfo.lastPTS) {
+                mProbeInfo.lastPTS = PTS;
+            }
+        }
+
+        payload += headerSize;
+        payloadSize -= headerSize;
+    }
+
+    if (mStreamType != STREAMTYPE_H264 || mProbeInfo.hasSyncFrame) {
+        return;
+    }
+
+    uint32_t window = mProbeWindow;
+    for (size_t i = 0; i < payloadSize; ++i) {
+        window = (window << 8) | payload[i];
+
+        if ((window & 0xffffff00) == 0x00000100 && (window & 0x1f) == 5) {
+            mProbeInfo.hasSyncFrame = true;
+            break;
+        }
+    }
+    mProbeWindow = window;
+}
+
+void ATSParser::Stream::indexAccessUnit(int64_t timeUs, bool isSync) {
+    off64_t offset = mPESOffset;
+
+    size_t i = 0;
+    while (i < mNumPendingPESStarts
+            && mPendingPESStarts[i].timeUs != timeUs) {
+        ++i;
+    }
+
+    if (i < mNumPendingPESStarts) {
+        offset = mPendingPESStarts[i].offset;
+        mNumPendingPESStarts -= i + 1;
+        memmove(mPendingPESStarts, mPendingPESStarts + i + 1,
+                mNumPendingPESStarts * sizeof(PESStart));
+    } else if (mNumPendingPESStarts > 0) {
+        // No PES with this time; the earliest one we know of is the safe
+        // choice, anything before the sync frame is skipped after a seek.
+        offset = mPendingPESStarts[0].offset;
+    }
+
+    mProgram->addIndexEntry(timeUs, offset, isSync);
+}
+
+bool ATSParser::Stream::shouldSkip(
+        int64_t timeUs, bool isSync, bool isReference) {
+    if (mSkipUntilUs < 0) {
+        return false;
+    }
+
+    if (mSkipKeepsReferenceFrames && isVideo()) {
+        // Nothing decodes without the sync frame before it.
+        if (isSync) {
+            mSkipSawSyncFrame = true;
+        }
+
+        if (!mSkipSawSyncFrame) {
+            return true;
+        }
+
+        if (timeUs < mSkipUntilUs) {
+            return !isReference;
+        }
+    } else if (timeUs < mSkipUntilUs) {
+        return true;
+    }
+
+    ALOGI("stream 0x%04x reached %lld us, no longer skipping",
+          mElementaryPID, mSkipUntilUs);
+
+    mSkipUntilUs = -1;
+    return false;
+}
+
 status_t ATSParser::Stream::parsePES(ABitReader *br) {
     unsigned packet_startcode_prefix = br->getBits(24);
 
@@ -891,8 +1272,39 @@ void ATSParser::Stream::onPayloadData(
         return;
     }
 
+    if (isVideo()) {
+        // Entries are only left behind by PES packets the queue never made
+        // an access unit of, so when full the oldest can go.
+        if (mNumPendingPESStarts == kMaxPendingPESStarts) {
+            --mNumPendingPESStarts;
+            memmove(mPendingPESStarts, mPendingPESStarts + 1,
+                    mNumPendingPESStarts * sizeof(PESStart));
+        }
+
+        PESStart &start = mPendingPESStarts[mNumPendingPESStarts++];
+        start.timeUs = timeUs;
+        start.offset = mPESOffset;
+    }
+
     sp<ABuffer> accessUnit;
     while ((accessUnit = mQueue->dequeueAccessUnit()) != NULL) {
+        int64_t accessUnitTimeUs;
+        if (accessUnit->meta()->findInt64("timeUs", &accessUnitTimeUs)) {
+            bool isSync = true;
+            bool isReference = true;
+            if (mStreamType == STREAMTYPE_H264) {
+                GetAVCFrameType(accessUnit, &isSync, &isReference);
+            }
+
+            if (isVideo()) {
+                indexAccessUnit(accessUnitTimeUs, isSync);
+            }
+
+            if (shouldSkip(accessUnitTimeUs, isSync, isReference)) {
+                continue;
+            }
+        }
+
         if (mSource == NULL) {
             sp<android_video_shim::MetaData> meta = mQueue->getFormat();
 
@@ -949,6 +1361,9 @@ ATSParser::ATSParser(uint32_t flags)
       mTimeOffsetValid(false),
       mTimeOffsetUs(0ll),
       mNumTSPacketsParsed(0),
+      mNumBytesSkipped(0),
+      mResyncPending(false),
+      mPacketOffset(0),
       mNumPCRs(0) {
     mPSISections.add(0 /* PID */, new PSISection);
 }
@@ -959,8 +1374,51 @@ ATSParser::~ATSParser() {
 status_t ATSParser::feedTSPacket(const void *data, size_t size) {
     CHECK_EQ(size, kTSPacketSize);
 
-    ABitReader br((const uint8_t *)data, kTSPacketSize);
-    return parseTS(&br);
+    status_t err = parseTS((const uint8_t *)data);
+    mPacketOffset += kTSPacketSize;
+
+    return err;
+}
+
+status_t ATSParser::feedTSPackets(
+        const void *data, size_t size, size_t *consumed, bool moreData) {
+    const uint8_t *ptr = (const uint8_t *)data;
+    size_t offset = 0;
+    status_t err = OK;
+    off64_t streamOffset = mPacketOffset;
+
+    while (err == OK && offset + kTSPacketSize <= size) {
+        if (ptr[offset] != kTSSyncByte || mResyncPending) {
+            bool confirmed;
+            size_t skip = findPacketBoundary(
+                    ptr + offset, size - offset, &confirmed);
+
+            if (skip > 0) {
+                mNumBytesSkipped += skip;
+
+                ALOGI("lost TS sync, skipped %d bytes (%d so far)",
+                      skip, mNumBytesSkipped);
+
+                offset += skip;
+            }
+
+            // The candidate is checked again once the data after it is in.
+            mResyncPending = !confirmed && moreData;
+            if (mResyncPending) {
+                break;
+            }
+            continue;
+        }
+
+        mPacketOffset = streamOffset + offset;
+        err = parseTS(ptr + offset);
+        offset += kTSPacketSize;
+    }
+
+    *consumed = offset;
+    mPacketOffset = streamOffset + offset;
+
+    return err;
 }
 
 void ATSParser::signalDiscontinuity(
@@ -1000,6 +1458,86 @@ void ATSParser::signalEOS(status_t finalResult) {
     }
 }
 
+void ATSParser::addIndexEntry(int64_t timeUs, off64_t offset, bool isSync) {
+    if (mAccessUnitIndex.size() >= kMaxAccessUnitIndexEntries) {
+        mAccessUnitIndex.removeItemsAt(0, kMaxAccessUnitIndexEntries / 2);
+    }
+
+    AccessUnitIndexEntry entry;
+    entry.timeUs = timeUs;
+    entry.offset = offset;
+    entry.isSync = isSync;
+    mAccessUnitIndex.push(entry);
+}
+
+bool ATSParser::findSyncPoint(
+        int64_t timeUs, AccessUnitIndexEntry *entry) const {
+    // Times go backwards at a discontinuity, so take the last match rather
+    // than stopping at the first entry past |timeUs|.
+    for (size_t i = mAccessUnitIndex.size(); i-- > 0;) {
+        const AccessUnitIndexEntry &e = mAccessUnitIndex.itemAt(i);
+        if (e.isSync && e.timeUs <= timeUs) {
+            *entry = e;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int64_t ATSParser::getIndexedTimeUs() const {
+    return mAccessUnitIndex.isEmpty() ? -1 : mAccessUnitIndex.top().timeUs;
+}
+
+void ATSParser::skipUntil(int64_t timeUs, bool keepReferenceFrames) {
+    for (size_t i = 0; i < mPrograms.size(); ++i) {
+        mPrograms.editItemAt(i)->skipUntil(timeUs, keepReferenceFrames);
+    }
+}
+
+void ATSParser::resetStreams(off64_t offset) {
+    for (size_t i = 0; i < mPrograms.size(); ++i) {
+        mPrograms.editItemAt(i)->resetStreams();
+    }
+
+    for (size_t i = 0; i < mPSISections.size(); ++i) {
+        mPSISections.editValueAt(i)->clear();
+    }
+
+    // Everything from |offset| on is about to be indexed again.
+    while (!mAccessUnitIndex.isEmpty()
+            && mAccessUnitIndex.top().offset >= offset) {
+        mAccessUnitIndex.pop();
+    }
+
+    mResyncPending = false;
+    mPacketOffset = offset;
+}
+
+bool ATSParser::getProbeInfo(SourceType type, ProbeInfo *info) const {
+    for (size_t i = 0; i < mPrograms.size(); ++i) {
+        if (mPrograms.itemAt(i)->getProbeInfo(type, info)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ATSParser::probeComplete() const {
+    if (mPrograms.isEmpty()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < mPrograms.size(); ++i) {
+        if (!mPrograms.itemAt(i)->probeComplete()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 void ATSParser::parseProgramAssociationTable(ABitReader *br) {
     unsigned table_id = br->getBits(8);
     LOGATS("  table_id = %u", table_id);
@@ -1065,7 +1603,7 @@ void ATSParser::parseProgramAssociationTable(ABitReader *br) {
 }
 
 status_t ATSParser::parsePID(
-        ABitReader *br, unsigned PID,
+        const uint8_t *payload, size_t payloadSize, unsigned PID,
         unsigned continuity_counter,
         unsigned payload_unit_start_indicator) {
     ssize_t sectionIndex = mPSISections.indexOfKey(PID);
@@ -1076,12 +1614,17 @@ status_t ATSParser::parsePID(
         if (payload_unit_start_indicator) {
             CHECK(section->isEmpty());
 
-            unsigned skip = br->getBits(8);
-            br->skipBits(skip * 8);
+            size_t skip = payloadSize > 0 ? 1 + payload[0] : 1;
+            if (skip > payloadSize) {
+                ALOGE("PID 0x%04x: pointer_field past end of packet", PID);
+                return OK;
+            }
+
+            payload += skip;
+            payloadSize -= skip;
         }
 
-        CHECK(((br->numBitsLeft() % 8) == 0));
-        status_t err = section->append(br->data(), br->numBitsLeft() / 8);
+        status_t err = section->append(payload, payloadSize);
 
         if (err != OK) {
             return err;
@@ -1130,7 +1673,7 @@ status_t ATSParser::parsePID(
         status_t err;
         if (mPrograms.editItemAt(i)->parsePID(
                     PID, continuity_counter, payload_unit_start_indicator,
-                    br, &err)) {
+                    payload, payloadSize, &err)) {
             if (err != OK) {
                 return err;
             }
@@ -1147,96 +1690,107 @@ status_t ATSParser::parsePID(
     return OK;
 }
 
-void ATSParser::parseAdaptationField(ABitReader *br, unsigned PID) {
-    unsigned adaptation_field_length = br->getBits(8);
-
-    if (adaptation_field_length > 0) {
-        unsigned discontinuity_indicator = br->getBits(1);
-
-        if (discontinuity_indicator) {
-            LOGATS("PID 0x%04x: discontinuity_indicator = 1 (!!!)", PID);
-        }
+// |field| points just past adaptation_field_length and holds |size| bytes.
+void ATSParser::parseAdaptationField(
+        const uint8_t *field, size_t size, unsigned PID) {
+    if (size == 0) {
+        return;
+    }
 
-        br->skipBits(2);
-        unsigned PCR_flag = br->getBits(1);
+    unsigned discontinuity_indicator = field[0] >> 7;
 
-        size_t numBitsRead = 4;
+    if (discontinuity_indicator) {
+        LOGATS("PID 0x%04x: discontinuity_indicator = 1 (!!!)", PID);
+    }
 
-        if (PCR_flag) {
-            br->skipBits(4);
-            uint64_t PCR_base = br->getBits(32);
-            PCR_base = (PCR_base << 1) | br->getBits(1);
+    unsigned PCR_flag = (field[0] >> 4) & 1;
 
-            br->skipBits(6);
-            unsigned PCR_ext = br->getBits(9);
+    if (!PCR_flag) {
+        return;
+    }
 
-            // The number of bytes from the start of the current
-            // MPEG2 transport stream packet up and including
-            // the final byte of this PCR_ext field.
-            size_t byteOffsetFromStartOfTSPacket =
-                (188 - br->numBitsLeft() / 8);
+    if (size < 7) {
+        ALOGE("PID 0x%04x: adaptation field too short for PCR", PID);
+        return;
+    }
 
-            uint64_t PCR = PCR_base * 300 + PCR_ext;
+    uint64_t PCR_base =
+        ((uint64_t)field[1] << 25)
+            | (field[2] << 17)
+            | (field[3] << 9)
+            | (field[4] << 1)
+            | (field[5] >> 7);
 
-            LOGATS("PID 0x%04x: PCR = 0x%016llx (%.2f)",
-                  PID, PCR, PCR / 27E6);
+    unsigned PCR_ext = ((field[5] & 1) << 8) | field[6];
 
-            // The number of bytes received by this parser up to and
-            // including the final byte of this PCR_ext field.
-            size_t byteOffsetFromStart =
-                mNumTSPacketsParsed * 188 + byteOffsetFromStartOfTSPacket;
+    // The number of bytes from the start of the current
+    // MPEG2 transport stream packet up and including
+    // the final byte of this PCR_ext field.
+    size_t byteOffsetFromStartOfTSPacket = 12;
 
-            for (size_t i = 0; i < mPrograms.size(); ++i) {
-                updatePCR(PID, PCR, byteOffsetFromStart);
-            }
+    uint64_t PCR = PCR_base * 300 + PCR_ext;
 
-            numBitsRead += 52;
-        }
+    LOGATS("PID 0x%04x: PCR = 0x%016llx (%.2f)",
+          PID, PCR, PCR / 27E6);
 
-        CHECK_GE(adaptation_field_length * 8, numBitsRead);
+    // The number of bytes received by this parser up to and
+    // including the final byte of this PCR_ext field.
+    size_t byteOffsetFromStart =
+        mNumTSPacketsParsed * 188 + byteOffsetFromStartOfTSPacket;
 
-        br->skipBits(adaptation_field_length * 8 - numBitsRead);
+    for (size_t i = 0; i < mPrograms.size(); ++i) {
+        updatePCR(PID, PCR, byteOffsetFromStart);
     }
 }
 
-status_t ATSParser::parseTS(ABitReader *br) {
+// The 4 byte header is decoded directly rather than through an ABitReader,
+// this runs once per packet.
+status_t ATSParser::parseTS(const uint8_t *packet) {
     LOGATS("---");
 
-    unsigned sync_byte = br->getBits(8);
-    CHECK_EQ(sync_byte, 0x47u);
+    if (packet[0] != kTSSyncByte) {
+        ALOGE("TS packet without sync byte (0x%02x), dropping it", packet[0]);
+        return OK;
+    }
 
-    if (br->getBits(1)) {  // transport_error_indicator
+    if (packet[1] & 0x80) {  // transport_error_indicator
         // silently ignore.
         return OK;
     }
 
-    unsigned payload_unit_start_indicator = br->getBits(1);
-    LOGATS("payload_unit_start_indicator = %u", payload_unit_start_indicator);
-
-    MY_LOGV("transport_priority = %u", br->getBits(1));
+    unsigned payload_unit_start_indicator = (packet[1] >> 6) & 1;
+    unsigned PID = ((packet[1] & 0x1f) << 8) | packet[2];
+    unsigned adaptation_field_control = (packet[3] >> 4) & 3;
+    unsigned continuity_counter = packet[3] & 0x0f;
 
-    unsigned PID = br->getBits(13);
-    LOGATS("PID = 0x%04x", PID);
+    LOGATS("PID = 0x%04x, payload_unit_start_indicator = %u, "
+           "adaptation_field_control = %u, continuity_counter = %u",
+           PID, payload_unit_start_indicator,
+           adaptation_field_control, continuity_counter);
 
-    MY_LOGV("transport_scrambling_control = %u", br->getBits(2));
+    size_t payloadOffset = 4;
 
-    unsigned adaptation_field_control = br->getBits(2);
-    LOGATS("adaptation_field_control = %u", adaptation_field_control);
+    if (adaptation_field_control == 2 || adaptation_field_control == 3) {
+        size_t adaptation_field_length = packet[4];
+        payloadOffset += 1 + adaptation_field_length;
 
-    unsigned continuity_counter = br->getBits(4);
-    LOGATS("PID = 0x%04x, continuity_counter = %u", PID, continuity_counter);
+        if (payloadOffset > kTSPacketSize) {
+            ALOGE("PID 0x%04x: adaptation_field_length %d past end of packet",
+                  PID, adaptation_field_length);
 
-    // ALOGI("PID = 0x%04x, continuity_counter = %u", PID, continuity_counter);
+            ++mNumTSPacketsParsed;
+            return OK;
+        }
 
-    if (adaptation_field_control == 2 || adaptation_field_control == 3) {
-        parseAdaptationField(br, PID);
+        parseAdaptationField(packet + 5, adaptation_field_length, PID);
     }
 
     status_t err = OK;
 
     if (adaptation_field_control == 1 || adaptation_field_control == 3) {
         err = parsePID(
-                br, PID, continuity_counter, payload_unit_start_indicator);
+                packet + payloadOffset, kTSPacketSize - payloadOffset,
+                PID, continuity_counter, payload_unit_start_indicator);
     }
 
     ++mNumTSPacketsParsed;
@@ -61,12 +61,30 @@ struct ATSParser : public RefBase {
         TS_TIMESTAMPS_ARE_ABSOLUTE = 1,
         // Video PES packets contain exactly one (aligned) access unit.
         ALIGNED_VIDEO_DATA         = 2,
+        // Only look at PES headers, and at H.264 payloads until the first
+        // IDR. Nothing is queued or assembled into access units, sources
+        // stay NULL; see getProbeInfo().
+        PROBE_ONLY                 = 4,
     };
 
     ATSParser(uint32_t flags = 0);
 
     status_t feedTSPacket(const void *data, size_t size);
 
+    // Parses as many whole packets as |data| holds. Bytes that are not at a
+    // 188 byte packet boundary are skipped until sync is found again.
+    // |*consumed| is set to the number of bytes used up; anything after it
+    // (a trailing partial packet) should be passed in again with more data.
+    //
+    // Sync is only trusted again once a few packets in a row line up. If
+    // |moreData| is set and |data| ends before they all could be checked,
+    // parsing stops at the candidate packet instead, to be checked again
+    // when the caller passes it in with what follows. Without it, whatever
+    // the buffer holds of the check is enough.
+    status_t feedTSPackets(
+            const void *data, size_t size, size_t *consumed,
+            bool moreData = false);
+
     void signalDiscontinuity(
             DiscontinuityType type, const sp<AMessage> &extra);
 
@@ -81,6 +99,50 @@ struct ATSParser : public RefBase {
 
     bool PTSTimeDeltaEstablished();
 
+    // Index of the video access units parsed so far, for seeking. |offset|
+    // is where the TS packet starting the access unit's PES packet sits in
+    // the stream, counting from the offset given to resetStreams() (0 to
+    // begin with) and advancing with every byte fed in.
+    struct AccessUnitIndexEntry {
+        int64_t timeUs;
+        off64_t offset;
+        bool isSync;
+    };
+
+    // The latest sync (IDR) access unit at or before |timeUs|.
+    bool findSyncPoint(int64_t timeUs, AccessUnitIndexEntry *entry) const;
+
+    // Time of the latest video access unit indexed, -1 if there's none.
+    int64_t getIndexedTimeUs() const;
+
+    // Access units before |timeUs| are dropped instead of being queued. With
+    // |keepReferenceFrames| set, video reference frames from the first sync
+    // frame on are kept, the decoder needs them to build the frame at
+    // |timeUs|. Each stream goes back to queueing everything once it gets
+    // there.
+    void skipUntil(int64_t timeUs, bool keepReferenceFrames);
+
+    // Forget all partially parsed data, and anything queued on the sources,
+    // ahead of being fed from |offset| in the stream instead of where we
+    // were. Formats are kept.
+    void resetStreams(off64_t offset);
+
+    // What a PROBE_ONLY parser has seen of a stream so far. PTS values are
+    // the raw 90kHz ones from the PES headers, -1 if there were none.
+    struct ProbeInfo {
+        int64_t firstPTS;  // lowest
+        int64_t lastPTS;   // highest
+        bool hasSyncFrame;  // an H.264 IDR slice, never set for other codecs
+    };
+
+    // False if there is no stream of |type|.
+    bool getProbeInfo(SourceType type, ProbeInfo *info) const;
+
+    // True once the program map is in and every audio and video stream has
+    // a PTS, and H.264 streams an IDR. Feeding more of the start of the
+    // segment won't change the start time after that.
+    bool probeComplete() const;
+
     enum {
         // From ISO/IEC 13818-1: 2000 (E), Table 2-29
         STREAMTYPE_RESERVED             = 0x00,
@@ -116,18 +178,31 @@ private:
     int64_t mTimeOffsetUs;
 
     size_t mNumTSPacketsParsed;
+    size_t mNumBytesSkipped;
+
+    // Stopped on a packet boundary candidate feedTSPackets() couldn't
+    // confirm yet; the next call checks it again.
+    bool mResyncPending;
+
+    // Stream offset of the TS packet being parsed.
+    off64_t mPacketOffset;
+
+    Vector<AccessUnitIndexEntry> mAccessUnitIndex;
+
+    void addIndexEntry(int64_t timeUs, off64_t offset, bool isSync);
 
     void parseProgramAssociationTable(ABitReader *br);
     void parseProgramMap(ABitReader *br);
     void parsePES(ABitReader *br);
 
     status_t parsePID(
-        ABitReader *br, unsigned PID,
+        const uint8_t *payload, size_t payloadSize, unsigned PID,
         unsigned continuity_counter,
         unsigned payload_unit_start_indicator);
 
-    void parseAdaptationField(ABitReader *br, unsigned PID);
-    status_t parseTS(ABitReader *br);
+    void parseAdaptationField(
+        const uint8_t *field, size_t size, unsigned PID);
+    status_t parseTS(const uint8_t *packet);
 
     void updatePCR(unsigned PID, uint64_t PCR, size_t byteOffsetFromStart);
 
@@ -0,0 +1,37 @@
+// NEON sync byte scan for ATSParser. Built with NEON enabled only on the ABIs
+// that can have it (see Android.mk); armeabi-v7a checks for it at runtime
+// before this gets used.
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+
+#include <arm_neon.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace android {
+
+// Returns the offset of the first |value| in data[0..size), or size if there
+// is none. Tests 16 bytes at a time; a block with a match is narrowed to a
+// nibble per byte so the first one can be counted to.
+size_t findByteNEON(const uint8_t *data, size_t size, uint8_t value) {
+    const uint8x16_t match = vdupq_n_u8(value);
+    size_t offset = 0;
+
+    for (; offset + 16 <= size; offset += 16) {
+        uint8x16_t eq = vceqq_u8(vld1q_u8(data + offset), match);
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+                vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+
+        if (mask != 0) {
+            return offset + __builtin_ctzll(mask) / 4;
+        }
+    }
+
+    const void *tail = memchr(data + offset, value, size - offset);
+    return tail ? (const uint8_t *)tail - data : size;
+}
+
+}  // namespace android
+
+#endif
@@ -34,6 +34,35 @@ namespace android {
 
 const int64_t kNearEOSMarkUs = 2000000ll; // 2 secs
 
+// Keeps an access unit alive for as long as the codec holds the
+// MediaBuffer wrapping it, so read() can hand it over without a copy.
+struct AccessUnitObserver : public android_video_shim::MediaBufferObserver {
+    AccessUnitObserver(const sp<ABuffer> &buffer)
+        : mBuffer(buffer) {
+    }
+
+    virtual void signalBufferReturned(MediaBuffer *buffer) {
+        // Detach so release() deletes the MediaBuffer, then drop the AU.
+        buffer->setObserver(NULL);
+        buffer->release();
+        delete this;
+    }
+
+private:
+    sp<ABuffer> mBuffer;
+
+    DISALLOW_EVIL_CONSTRUCTORS(AccessUnitObserver);
+};
+
+static bool canWrapAccessUnits() {
+    static int canWrap = -1;
+    if (canWrap < 0) {
+        canWrap = MediaBuffer::canWrapExternalData() ? 1 : 0;
+        LOGI("Zero copy access units %s", canWrap ? "enabled" : "unavailable");
+    }
+    return canWrap != 0;
+}
+
 AnotherPacketSource::AnotherPacketSource(const sp<MetaData> &meta)
     : mIsAudio(false),
       mFormat(NULL),
@@ -165,9 +194,18 @@ status_t AnotherPacketSource::read(
 
         LOGTIMING("read %lld, isAudio=%d, bufferSize=%d", timeUs, mIsAudio, buffer->size() );
 
-        // Copy data into a MediaBuffer.
-        MediaBuffer *mediaBuffer = new MediaBuffer(buffer->size());
-        memcpy(mediaBuffer->data(), buffer->data(), buffer->size());
+        MediaBuffer *mediaBuffer;
+        if (canWrapAccessUnits()) {
+            // Hand the access unit over by reference. The observer holds
+            // the ABuffer until the codec releases the MediaBuffer.
+            mediaBuffer = new MediaBuffer(buffer->data(), buffer->size());
+            mediaBuffer->setObserver(new AccessUnitObserver(buffer));
+            mediaBuffer->add_ref();
+        } else {
+            // Copy data into a MediaBuffer.
+            mediaBuffer = new MediaBuffer(buffer->size());
+            memcpy(mediaBuffer->data(), buffer->data(), buffer->size());
+        }
         mediaBuffer->meta_data()->setInt64(kKeyTime, timeUs);
 
         *out = mediaBuffer;
@@ -227,6 +265,14 @@ void AnotherPacketSource::clear() {
     mLatestEnqueuedMeta = NULL;
 }
 
+void AnotherPacketSource::flush() {
+    Mutex::Autolock autoLock(mLock);
+
+    mBuffers.clear();
+    mLastQueuedTimeUs = 0;
+    mLatestEnqueuedMeta = NULL;
+}
+
 void AnotherPacketSource::queueDiscontinuity(
         ATSParser::DiscontinuityType type,
         const sp<AMessage> &extra) {
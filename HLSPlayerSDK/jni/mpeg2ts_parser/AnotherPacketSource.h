@@ -44,6 +44,9 @@ struct AnotherPacketSource : public RefBase {
 
     void clear();
 
+    // Drops everything queued but, unlike clear(), keeps the format.
+    void flush();
+
     bool hasBufferAvailable(status_t *finalResult);
 
     // Returns the difference between the last and the first queued
@@ -41,7 +41,17 @@ namespace android {
 
 ElementaryStreamQueue::ElementaryStreamQueue(Mode mode, uint32_t flags)
     : mMode(mode),
-      mFlags(flags) {
+      mFlags(flags),
+      mBufferShared(false),
+      mRangeInfos(NULL),
+      mRangeInfoCapacity(0),
+      mRangeInfoHead(0),
+      mRangeInfoCount(0) {
+}
+
+ElementaryStreamQueue::~ElementaryStreamQueue() {
+    delete[] mRangeInfos;
+    mRangeInfos = NULL;
 }
 
 sp<android_video_shim::MetaData> ElementaryStreamQueue::getFormat() {
@@ -49,17 +59,69 @@ sp<android_video_shim::MetaData> ElementaryStreamQueue::getFormat() {
 }
 
 void ElementaryStreamQueue::clear(bool clearFormat) {
-    if (mBuffer != NULL) {
+    if (mBufferShared) {
+        mBuffer.clear();
+        mBufferShared = false;
+    } else if (mBuffer != NULL) {
         mBuffer->setRange(0, 0);
     }
 
-    mRangeInfos.clear();
+    mRangeInfoHead = 0;
+    mRangeInfoCount = 0;
 
     if (clearFormat) {
         mFormat.clear();
     }
 }
 
+void ElementaryStreamQueue::pushRangeInfo(const RangeInfo &info) {
+    if (mRangeInfoCount == mRangeInfoCapacity) {
+        size_t capacity =
+            (mRangeInfoCapacity == 0) ? 16 : 2 * mRangeInfoCapacity;
+
+        RangeInfo *infos = new RangeInfo[capacity];
+        for (size_t i = 0; i < mRangeInfoCount; ++i) {
+            infos[i] = mRangeInfos[
+                (mRangeInfoHead + i) & (mRangeInfoCapacity - 1)];
+        }
+
+        delete[] mRangeInfos;
+        mRangeInfos = infos;
+        mRangeInfoCapacity = capacity;
+        mRangeInfoHead = 0;
+    }
+
+    mRangeInfos[(mRangeInfoHead + mRangeInfoCount)
+            & (mRangeInfoCapacity - 1)] = info;
+    ++mRangeInfoCount;
+}
+
+ElementaryStreamQueue::RangeInfo *ElementaryStreamQueue::frontRangeInfo() {
+    if (mRangeInfoCount == 0) {
+        return NULL;
+    }
+
+    return &mRangeInfos[mRangeInfoHead];
+}
+
+void ElementaryStreamQueue::popRangeInfo() {
+    CHECK_GT(mRangeInfoCount, 0u);
+
+    mRangeInfoHead = (mRangeInfoHead + 1) & (mRangeInfoCapacity - 1);
+    --mRangeInfoCount;
+}
+
+void ElementaryStreamQueue::consume(size_t size) {
+    CHECK_LE(size, mBuffer->size());
+
+    if (size == mBuffer->size() && !mBufferShared) {
+        // Nothing left, start over at the front for free.
+        mBuffer->setRange(0, 0);
+    } else {
+        mBuffer->setRange(mBuffer->offset() + size, mBuffer->size() - size);
+    }
+}
+
 static bool IsSeeminglyValidADTSHeader(const uint8_t *ptr, size_t size) {
     if (size < 3) {
         // Not enough data to verify header.
@@ -264,30 +326,46 @@ status_t ElementaryStreamQueue::appendData(
         }
     }
 
-    size_t neededSize = (mBuffer == NULL ? 0 : mBuffer->size()) + size;
-    if (mBuffer == NULL || neededSize > mBuffer->capacity()) {
-        neededSize = (neededSize + 65535) & ~65535;
+    size_t pendingSize = (mBuffer == NULL) ? 0 : mBuffer->size();
+    size_t neededSize = pendingSize + size;
+
+    if (mBuffer == NULL
+            || mBuffer->offset() + neededSize > mBuffer->capacity()) {
+        if (mBuffer != NULL && !mBufferShared
+                && neededSize <= mBuffer->capacity() / 2) {
+            // The consumed prefix is at least half the buffer, so moving
+            // the pending bytes down costs no more than what was dequeued
+            // since the last time we got here.
+            memmove(mBuffer->base(), mBuffer->data(), pendingSize);
+            mBuffer->setRange(0, pendingSize);
+        } else {
+            // Grow geometrically and leave at least as much room again as
+            // is pending, which keeps the compaction above amortized O(1).
+            size_t capacity = 65536;
+            while (capacity < 2 * neededSize) {
+                capacity *= 2;
+            }
 
-        LOGV("resizing buffer to size %d", neededSize);
+            LOGV("resizing buffer to size %d", capacity);
 
-        sp<ABuffer> buffer = new ABuffer(neededSize);
-        if (mBuffer != NULL) {
-            memcpy(buffer->data(), mBuffer->data(), mBuffer->size());
-            buffer->setRange(0, mBuffer->size());
-        } else {
-            buffer->setRange(0, 0);
-        }
+            sp<ABuffer> buffer = new ABuffer(capacity);
+            if (mBuffer != NULL) {
+                memcpy(buffer->data(), mBuffer->data(), pendingSize);
+            }
+            buffer->setRange(0, pendingSize);
 
-        mBuffer = buffer;
+            mBuffer = buffer;
+            mBufferShared = false;
+        }
     }
 
     memcpy(mBuffer->data() + mBuffer->size(), data, size);
-    mBuffer->setRange(0, mBuffer->size() + size);
+    mBuffer->setRange(mBuffer->offset(), mBuffer->size() + size);
 
     RangeInfo info;
     info.mLength = size;
     info.mTimestampUs = timeUs;
-    mRangeInfos.push_back(info);
+    pushRangeInfo(info);
 
 #if 0
     if (mMode == AAC) {
@@ -301,22 +379,18 @@ status_t ElementaryStreamQueue::appendData(
 
 sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnit() {
     if ((mFlags & kFlag_AlignedData) && mMode == H264 && !AVSHIM_HAS_OMXRENDERERPATH) {
-        if (mRangeInfos.empty()) {
+        if (frontRangeInfo() == NULL) {
             return NULL;
         }
 
-        RangeInfo info = *mRangeInfos.begin();
-        mRangeInfos.erase(mRangeInfos.begin());
+        RangeInfo info = *frontRangeInfo();
+        popRangeInfo();
 
         sp<ABuffer> accessUnit = new ABuffer(info.mLength);
         memcpy(accessUnit->data(), mBuffer->data(), info.mLength);
         accessUnit->meta()->setInt64("timeUs", info.mTimestampUs);
 
-        memmove(mBuffer->data(),
-                mBuffer->data() + info.mLength,
-                mBuffer->size() - info.mLength);
-
-        mBuffer->setRange(0, mBuffer->size() - info.mLength);
+        consume(info.mLength);
 
         if (mFormat == NULL) {
             mFormat = MakeAVCCodecSpecificData(accessUnit);
@@ -386,12 +460,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitPCMAudio() {
         ptr[i] = ntohs(ptr[i]);
     }
 
-    memmove(
-            mBuffer->data(),
-            mBuffer->data() + 4 + payloadSize,
-            mBuffer->size() - 4 - payloadSize);
-
-    mBuffer->setRange(0, mBuffer->size() - 4 - payloadSize);
+    consume(4 + payloadSize);
 
     return accessUnit;
 }
@@ -453,9 +522,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitAAC_23() {
                frameSizes.itemAt(i));
         dstOffset += frameSizes.itemAt(i);
     }
-    memmove(mBuffer->data(), mBuffer->data() + offset,
-            mBuffer->size() - offset);
-    mBuffer->setRange(0, mBuffer->size() - offset);
+    consume(offset);
 
     int64_t timeUs = fetchTimestamp(offset);
 
@@ -471,9 +538,9 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitAAC() {
         return NULL;
     }
 
-    CHECK(!mRangeInfos.empty());
+    CHECK(frontRangeInfo() != NULL);
 
-    const RangeInfo &info = *mRangeInfos.begin();
+    const RangeInfo &info = *frontRangeInfo();
     if (mBuffer->size() < info.mLength) {
         return NULL;
     }
@@ -556,9 +623,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitAAC() {
     sp<ABuffer> accessUnit = new ABuffer(offset);
     memcpy(accessUnit->data(), mBuffer->data(), offset);
 
-    memmove(mBuffer->data(), mBuffer->data() + offset,
-            mBuffer->size() - offset);
-    mBuffer->setRange(0, mBuffer->size() - offset);
+    consume(offset);
 
     accessUnit->meta()->setInt64("timeUs", timeUs);
 
@@ -570,9 +635,8 @@ int64_t ElementaryStreamQueue::fetchTimestamp(size_t size) {
     bool first = true;
 
     while (size > 0) {
-        CHECK(!mRangeInfos.empty());
-
-        RangeInfo *info = &*mRangeInfos.begin();
+        RangeInfo *info = frontRangeInfo();
+        CHECK(info != NULL);
 
         if (first) {
             timeUs = info->mTimestampUs;
@@ -585,7 +649,7 @@ int64_t ElementaryStreamQueue::fetchTimestamp(size_t size) {
         } else {
             size -= info->mLength;
 
-            mRangeInfos.erase(mRangeInfos.begin());
+            popRangeInfo();
             info = NULL;
         }
 
@@ -603,6 +667,34 @@ struct NALPosition {
     size_t nalSize;
 };
 
+// True if data[0, end of the last NAL unit) is already a valid Annex B
+// access unit: every NAL unit preceded by nothing but a startcode (zero bytes
+// then 0x01), the first by a four byte one. That's what the encoder usually
+// wrote, give or take three byte startcodes, so it can be passed on as it
+// is instead of being copied out with each startcode rewritten.
+static bool IsAnnexBAccessUnit(
+        const uint8_t *data, const Vector<NALPosition> &nals) {
+    size_t offset = 0;
+    for (size_t i = 0; i < nals.size(); ++i) {
+        const NALPosition &pos = nals.itemAt(i);
+
+        if (pos.nalOffset < offset + (i == 0 ? 4 : 3)
+                || data[pos.nalOffset - 1] != 0x01) {
+            return false;
+        }
+
+        for (size_t j = offset; j + 1 < pos.nalOffset; ++j) {
+            if (data[j] != 0x00) {
+                return false;
+            }
+        }
+
+        offset = pos.nalOffset + pos.nalSize;
+    }
+
+    return true;
+}
+
 sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
     const uint8_t *data = mBuffer->data();
 
@@ -643,49 +735,49 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitH264() {
 
         if (flush) {
             // The access unit will contain all nal units up to, but excluding
-            // the current one, separated by 0x00 0x00 0x00 0x01 startcodes.
-
-            size_t auSize = 4 * nals.size() + totalSize;
-            sp<ABuffer> accessUnit = new ABuffer(auSize);
+            // the current one, separated by startcodes.
+            const NALPosition &last = nals.itemAt(nals.size() - 1);
+            size_t nextScan = last.nalOffset + last.nalSize;
 
 #if !LOG_NDEBUG
             AString out;
-#endif
-
-            size_t dstOffset = 0;
             for (size_t i = 0; i < nals.size(); ++i) {
-                const NALPosition &pos = nals.itemAt(i);
-
-                unsigned nalType = mBuffer->data()[pos.nalOffset] & 0x1f;
-
-#if !LOG_NDEBUG
                 char tmp[128];
-                sprintf(tmp, "0x%02x", nalType);
+                sprintf(tmp, "0x%02x",
+                        mBuffer->data()[nals.itemAt(i).nalOffset] & 0x1f);
                 if (i > 0) {
                     out.append(", ");
                 }
                 out.append(tmp);
+            }
 #endif
 
-                memcpy(accessUnit->data() + dstOffset, "\x00\x00\x00\x01", 4);
+            sp<ABuffer> accessUnit;
+            if (IsAnnexBAccessUnit(mBuffer->data(), nals)) {
+                // Already laid out as one, so hand out mBuffer's own bytes.
+                accessUnit = new ABuffer(mBuffer, mBuffer->offset(), nextScan);
+                mBufferShared = true;
+            } else {
+                size_t auSize = 4 * nals.size() + totalSize;
+                accessUnit = new ABuffer(auSize);
 
-                memcpy(accessUnit->data() + dstOffset + 4,
-                       mBuffer->data() + pos.nalOffset,
-                       pos.nalSize);
+                size_t dstOffset = 0;
+                for (size_t i = 0; i < nals.size(); ++i) {
+                    const NALPosition &pos = nals.itemAt(i);
 
-                dstOffset += pos.nalSize + 4;
-            }
+                    memcpy(accessUnit->data() + dstOffset, "\x00\x00\x00\x01", 4);
 
-            LOGV("accessUnit contains nal types %s", out.c_str());
+                    memcpy(accessUnit->data() + dstOffset + 4,
+                           mBuffer->data() + pos.nalOffset,
+                           pos.nalSize);
 
-            const NALPosition &pos = nals.itemAt(nals.size() - 1);
-            size_t nextScan = pos.nalOffset + pos.nalSize;
+                    dstOffset += pos.nalSize + 4;
+                }
+            }
 
-            memmove(mBuffer->data(),
-                    mBuffer->data() + nextScan,
-                    mBuffer->size() - nextScan);
+            LOGV("accessUnit contains nal types %s", out.c_str());
 
-            mBuffer->setRange(0, mBuffer->size() - nextScan);
+            consume(nextScan);
 
             int64_t timeUs = fetchTimestamp(nextScan);
             CHECK_GE(timeUs, 0ll);
@@ -737,11 +829,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGAudio() {
     sp<ABuffer> accessUnit = new ABuffer(frameSize);
     memcpy(accessUnit->data(), data, frameSize);
 
-    memmove(mBuffer->data(),
-            mBuffer->data() + frameSize,
-            mBuffer->size() - frameSize);
-
-    mBuffer->setRange(0, mBuffer->size() - frameSize);
+    consume(frameSize);
 
     int64_t timeUs = fetchTimestamp(frameSize);
     CHECK_GE(timeUs, 0ll);
@@ -837,11 +925,11 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
         currentStartCode = data[offset + 3];
 
         if (currentStartCode == 0xb3 && mFormat == NULL) {
-            memmove(mBuffer->data(), mBuffer->data() + offset, size - offset);
+            consume(offset);
+            data = mBuffer->data();
             size -= offset;
             (void)fetchTimestamp(offset);
             offset = 0;
-            mBuffer->setRange(0, size);
         }
 
         if ((prevStartCode == 0xb3 && currentStartCode != 0xb5)
@@ -867,11 +955,8 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
                 sp<ABuffer> csd = new ABuffer(offset);
                 memcpy(csd->data(), data, offset);
 
-                memmove(mBuffer->data(),
-                        mBuffer->data() + offset,
-                        mBuffer->size() - offset);
-
-                mBuffer->setRange(0, mBuffer->size() - offset);
+                consume(offset);
+                data = mBuffer->data();
                 size -= offset;
                 (void)fetchTimestamp(offset);
                 offset = 0;
@@ -895,11 +980,7 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
                 sp<ABuffer> accessUnit = new ABuffer(offset);
                 memcpy(accessUnit->data(), data, offset);
 
-                memmove(mBuffer->data(),
-                        mBuffer->data() + offset,
-                        mBuffer->size() - offset);
-
-                mBuffer->setRange(0, mBuffer->size() - offset);
+                consume(offset);
 
                 int64_t timeUs = fetchTimestamp(offset);
                 CHECK_GE(timeUs, 0ll);
@@ -1056,9 +1137,9 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
                     sp<ABuffer> accessUnit = new ABuffer(offset);
                     memcpy(accessUnit->data(), data, offset);
 
-                    memmove(data, &data[offset], size - offset);
+                    consume(offset);
+                    data = mBuffer->data();
                     size -= offset;
-                    mBuffer->setRange(0, size);
 
                     int64_t timeUs = fetchTimestamp(offset);
                     CHECK_GE(timeUs, 0ll);
@@ -1087,10 +1168,10 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEG4Video() {
 
         if (discard) {
             (void)fetchTimestamp(offset);
-            memmove(data, &data[offset], size - offset);
+            consume(offset);
+            data = mBuffer->data();
             size -= offset;
             offset = 0;
-            mBuffer->setRange(0, size);
         } else {
             offset += chunkSize;
         }
@@ -20,7 +20,6 @@
 
 #include "ABase.h"
 //#include <utils/Errors.h>
-#include "List.h"
 //#include <utils/RefBase.h>
 
 namespace android {
@@ -43,6 +42,7 @@ struct ElementaryStreamQueue {
         kFlag_AlignedData = 1,
     };
     ElementaryStreamQueue(Mode mode, uint32_t flags = 0);
+    ~ElementaryStreamQueue();
 
     status_t appendData(const void *data, size_t size, int64_t timeUs);
     void clear(bool clearFormat);
@@ -60,8 +60,29 @@ private:
     Mode mMode;
     uint32_t mFlags;
 
+    // Pending data is always the contiguous range [offset, offset + size)
+    // of mBuffer. Dequeuing only advances the range offset, the consumed
+    // prefix is reclaimed in appendData once the tail runs out of room.
     sp<ABuffer> mBuffer;
-    List<RangeInfo> mRangeInfos;
+
+    // Set once an access unit has been handed out over mBuffer's own bytes
+    // (see dequeueAccessUnitH264). Nothing already written there may be
+    // written over again, so appendData moves on to a new buffer instead of
+    // reclaiming the consumed prefix.
+    bool mBufferShared;
+
+    // FIFO of RangeInfos, a power of two sized circular array.
+    RangeInfo *mRangeInfos;
+    size_t mRangeInfoCapacity;
+    size_t mRangeInfoHead;
+    size_t mRangeInfoCount;
+
+    void pushRangeInfo(const RangeInfo &info);
+    RangeInfo *frontRangeInfo();
+    void popRangeInfo();
+
+    // drops the first "size" bytes of pending data.
+    void consume(size_t size);
 
     sp<android_video_shim::MetaData> mFormat;
 
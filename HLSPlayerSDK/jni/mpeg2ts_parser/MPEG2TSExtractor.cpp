@@ -27,10 +27,19 @@
 
 #include "AnotherPacketSource.h"
 #include "ATSParser.h"
+#include "avc_utils.h"
 
 namespace android {
 
 static const size_t kTSPacketSize = 188;
+static const uint8_t kTSSyncByte = 0x47;
+
+// Packets parsed per feedMore() call. Small enough that a reader waiting on
+// one track doesn't demux far past what it needs.
+static const size_t kPacketsPerFeed = 16;
+
+// Default for how far ahead of the readers the demux thread runs.
+static const int64_t kDefaultBufferWatermarkUs = 3000000ll;
 
 struct MPEG2TSSource : public RefBase {
 
@@ -48,7 +57,27 @@ struct MPEG2TSSource : public RefBase {
     status_t read(
             MediaBuffer **buffer, const android_video_shim::MediaSource::ReadOptions *options = NULL);
 
+    void setNext(
+            const sp<MPEG2TSExtractor> &extractor,
+            const sp<AnotherPacketSource> &impl);
+
+    sp<MPEG2TSExtractor> getExtractor();
+
 private:
+    // Guards the switch from mExtractor/mImpl over to mNextExtractor/
+    // mNextImpl, separately from |lock| which read() holds while it waits
+    // for data.
+    pthread_mutex_t mNextLock;
+    sp<MPEG2TSExtractor> mNextExtractor;
+    sp<AnotherPacketSource> mNextImpl;
+    bool mNeedCodecConfig;
+
+    status_t readCurrent(
+            MediaBuffer **out, const android_video_shim::MediaSource::ReadOptions *options);
+
+    bool switchToNext();
+    void prependCodecConfig(MediaBuffer **buffer);
+
     sp<MPEG2TSExtractor> mExtractor;
     sp<AnotherPacketSource> mImpl;
 
@@ -65,10 +94,12 @@ MPEG2TSSource::MPEG2TSSource(
         bool seekable)
     : mExtractor(extractor),
       mImpl(impl),
-      mSeekable(seekable) 
+      mSeekable(seekable),
+      mNeedCodecConfig(false)
 {
     LOGI("ctor %p mImpl=%p", this, impl.get());
     initRecursivePthreadMutex(&lock);
+    pthread_mutex_init(&mNextLock, NULL);
 }
 
 status_t MPEG2TSSource::start(MetaData *params) {
@@ -90,6 +121,151 @@ sp<MetaData> MPEG2TSSource::getFormat() {
 status_t MPEG2TSSource::read(
         MediaBuffer **out, const android_video_shim::MediaSource::ReadOptions *options) {
     AutoLock locker(&lock);
+
+    status_t err = readCurrent(out, options);
+
+    // Carry on from the next source rather than let the decoder see the
+    // end of stream; it's never told the source changed.
+    if (err == ERROR_END_OF_STREAM && switchToNext()) {
+        err = readCurrent(out, options);
+    }
+
+    if (err == OK && mNeedCodecConfig) {
+        prependCodecConfig(out);
+        mNeedCodecConfig = false;
+    }
+
+    return err;
+}
+
+void MPEG2TSSource::setNext(
+        const sp<MPEG2TSExtractor> &extractor,
+        const sp<AnotherPacketSource> &impl) {
+    AutoLock locker(&mNextLock);
+    mNextExtractor = extractor;
+    mNextImpl = impl;
+}
+
+sp<MPEG2TSExtractor> MPEG2TSSource::getExtractor() {
+    AutoLock locker(&mNextLock);
+    return mExtractor;
+}
+
+// Called with |lock| held, after the current source ran out.
+bool MPEG2TSSource::switchToNext() {
+    AutoLock locker(&mNextLock);
+
+    // A stopped extractor ends its tracks too (seeking, tearing down);
+    // that isn't the end of the data.
+    if (mNextImpl == NULL || mExtractor->isStopping()) {
+        return false;
+    }
+
+    LOGI("%p switching from extractor %p to %p", this, mExtractor.get(), mNextExtractor.get());
+
+    mExtractor = mNextExtractor;
+    mImpl = mNextImpl;
+    mNextExtractor.clear();
+    mNextImpl.clear();
+
+    const char *mime;
+    sp<MetaData> format = mImpl->getFormat();
+    mNeedCodecConfig = format != NULL
+        && format->findCString(kKeyMIMEType, &mime)
+        && !strcasecmp(mime, MEDIA_MIMETYPE_VIDEO_AVC);
+
+    return true;
+}
+
+// Walks the SPS and PPS in an avcC, calling out 4 byte start codes with
+// each. Returns the size of the result, or 0 if the avcC is malformed.
+// |out| may be NULL to only measure.
+static size_t avccToAnnexB(const uint8_t *avcc, size_t avccSize, uint8_t *out) {
+    static const uint8_t kStartCode[4] = { 0, 0, 0, 1 };
+
+    // 5 header bytes, then a count of SPS and of PPS, each set prefixed
+    // with a 16 bit length.
+    size_t total = 0;
+    size_t offset = 5;
+    for (int pass = 0; pass < 2; ++pass) {
+        if (offset >= avccSize) {
+            return 0;
+        }
+
+        size_t count = avcc[offset++] & (pass == 0 ? 0x1f : 0xff);
+        for (size_t i = 0; i < count; ++i) {
+            if (offset + 2 > avccSize) {
+                return 0;
+            }
+
+            size_t length = (avcc[offset] << 8) | avcc[offset + 1];
+            offset += 2;
+            if (offset + length > avccSize) {
+                return 0;
+            }
+
+            if (out != NULL) {
+                memcpy(out + total, kStartCode, 4);
+                memcpy(out + total + 4, avcc + offset, length);
+            }
+            total += 4 + length;
+            offset += length;
+        }
+    }
+
+    return total;
+}
+
+static bool hasSeqParamSet(const uint8_t *data, size_t size) {
+    const uint8_t *nalStart;
+    size_t nalSize;
+    while (getNextNALUnit(&data, &size, &nalStart, &nalSize, true) == OK) {
+        if (nalSize > 0 && (nalStart[0] & 0x1f) == 7) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// The decoder was configured from the old stream's SPS/PPS. If the first
+// access unit after a switch doesn't carry its own, put the new stream's in
+// front of it, taken from its avcC.
+void MPEG2TSSource::prependCodecConfig(MediaBuffer **buffer) {
+    const uint8_t *data = (const uint8_t *)(*buffer)->data() + (*buffer)->range_offset();
+    size_t size = (*buffer)->range_length();
+
+    if (hasSeqParamSet(data, size)) {
+        return;
+    }
+
+    uint32_t type;
+    const uint8_t *avcc;
+    size_t avccSize;
+    if (!mImpl->getFormat()->findData(kKeyAVCC, &type, (const void **)&avcc, &avccSize)) {
+        return;
+    }
+
+    size_t configSize = avccToAnnexB(avcc, avccSize, NULL);
+    if (configSize == 0) {
+        return;
+    }
+
+    int64_t timeUs;
+    CHECK((*buffer)->meta_data()->findInt64(kKeyTime, &timeUs));
+
+    MediaBuffer *out = new MediaBuffer(configSize + size);
+    avccToAnnexB(avcc, avccSize, (uint8_t *)out->data());
+    memcpy((uint8_t *)out->data() + configSize, data, size);
+    out->meta_data()->setInt64(kKeyTime, timeUs);
+
+    (*buffer)->release();
+    *buffer = out;
+
+    LOGI("%p prepended %d bytes of codec config after switching", this, configSize);
+}
+
+status_t MPEG2TSSource::readCurrent(
+        MediaBuffer **out, const android_video_shim::MediaSource::ReadOptions *options) {
     *out = NULL;
 
     int64_t seekTimeUs;
@@ -98,6 +274,13 @@ status_t MPEG2TSSource::read(
         return ERROR_UNSUPPORTED;
     }
 
+    if (mExtractor->isDemuxing()) {
+        // The demux thread does the parsing, we just wait on the queue.
+        status_t err = mImpl->read(out, options);
+        mExtractor->onAccessUnitRead();
+        return err;
+    }
+
     status_t finalResult;
     while (!mImpl->hasBufferAvailable(&finalResult)) {
         if (finalResult != OK) {
@@ -422,12 +605,60 @@ android_video_shim::MediaSource23 *MPEG2TSExtractor::getTrackProxy23(size_t inde
     return proxy;
 }
 
+// The proxies are only ever the ones handed out above.
+bool MPEG2TSExtractor::setNextTrack(
+        android_video_shim::MediaSource *proxy,
+        const sp<MPEG2TSExtractor> &next, size_t index) {
+    if (proxy == NULL || next == NULL || index >= next->mSourceImpls.size()) {
+        return false;
+    }
+
+    static_cast<MPEG2TSTrackProxy *>(proxy)->realSource->setNext(
+            next, next->mSourceImpls.editItemAt(index));
+    return true;
+}
+
+bool MPEG2TSExtractor::setNextTrack23(
+        android_video_shim::MediaSource23 *proxy,
+        const sp<MPEG2TSExtractor> &next, size_t index) {
+    if (proxy == NULL || next == NULL || index >= next->mSourceImpls.size()) {
+        return false;
+    }
+
+    static_cast<MPEG2TSTrackProxy23 *>(proxy)->realSource->setNext(
+            next, next->mSourceImpls.editItemAt(index));
+    return true;
+}
+
+sp<MPEG2TSExtractor> MPEG2TSExtractor::getTrackExtractor(
+        android_video_shim::MediaSource *proxy) {
+    if (proxy == NULL) {
+        return NULL;
+    }
+    return static_cast<MPEG2TSTrackProxy *>(proxy)->realSource->getExtractor();
+}
+
+sp<MPEG2TSExtractor> MPEG2TSExtractor::getTrackExtractor23(
+        android_video_shim::MediaSource23 *proxy) {
+    if (proxy == NULL) {
+        return NULL;
+    }
+    return static_cast<MPEG2TSTrackProxy23 *>(proxy)->realSource->getExtractor();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 MPEG2TSExtractor::MPEG2TSExtractor(const sp<HLSDataSource> &source)
     : mDataSource(source),
       mParser(new ATSParser(ATSParser::TS_TIMESTAMPS_ARE_ABSOLUTE)),
-      mOffset(0) {
+      mOffset(0),
+      mReadAheadOffset(0),
+      mReadAheadLength(0),
+      mReadAheadAtEnd(false),
+      mReadAheadNeedsMore(false),
+      mDemuxing(false),
+      mStopDemuxing(false),
+      mBufferWatermarkUs(kDefaultBufferWatermarkUs) {
 	LOGV("mParser->flags=%d", mParser->getFlags());
     init();
 }
@@ -475,7 +706,6 @@ sp<MetaData> MPEG2TSExtractor::getMetaData() {
 void MPEG2TSExtractor::init() {
     bool haveAudio = false;
     bool haveVideo = false;
-    int numPacketsParsed = 0;
 
     while (feedMore() == OK) {
         ATSParser::SourceType type;
@@ -504,7 +734,7 @@ void MPEG2TSExtractor::init() {
             }
         }
 
-        if (++numPacketsParsed > 10000) {
+        if (mOffset > 10000 * (off64_t)kTSPacketSize) {
             break;
         }
     }
@@ -515,21 +745,229 @@ void MPEG2TSExtractor::init() {
 status_t MPEG2TSExtractor::feedMore() {
     Mutex::Autolock autoLock(mLock);
 
-    uint8_t packet[kTSPacketSize];
-    ssize_t n = mDataSource->readAt(mOffset, packet, kTSPacketSize);
+    if (mReadAheadOffset + kTSPacketSize > mReadAheadLength
+            || mReadAheadNeedsMore) {
+        // Window exhausted, refill it with as much as the data source can
+        // give us. mOffset always points at the first unparsed byte so a
+        // trailing partial packet is simply read again.
+        ssize_t n = mDataSource->readAt(mOffset, mReadAhead, kReadAheadSize);
+
+        if (n < (ssize_t)kTSPacketSize) {
+            mReadAheadOffset = mReadAheadLength = 0;
+            return (n < 0) ? (status_t)n : ERROR_END_OF_STREAM;
+        }
+
+        mReadAheadOffset = 0;
+        mReadAheadLength = n;
+        mReadAheadAtEnd = n < kReadAheadSize;
+        mReadAheadNeedsMore = false;
+    }
+
+    // Hand the parser up to kPacketsPerFeed packets at a time. Out of sync,
+    // it gets the rest of the window, so whether a sync byte starts a run
+    // of packets isn't decided at the edge of a slice.
+    size_t left = mReadAheadLength - mReadAheadOffset;
+    size_t size = left;
+    if (mReadAhead[mReadAheadOffset] == kTSSyncByte
+            && size > kPacketsPerFeed * kTSPacketSize) {
+        size = kPacketsPerFeed * kTSPacketSize;
+    }
+
+    // Only a window that came back short reaches the end of the data.
+    bool moreData = size < left || !mReadAheadAtEnd;
+
+    size_t consumed;
+    status_t err = mParser->feedTSPackets(
+            mReadAhead + mReadAheadOffset, size, &consumed, moreData);
+
+    mReadAheadOffset += consumed;
+    mOffset += consumed;
+
+    // A whole packet left over means the parser stopped on a sync byte it
+    // needs the following bytes to check. Past the end of the window,
+    // that takes a refill starting from it.
+    if (err == OK && size - consumed >= kTSPacketSize && size == left) {
+        mReadAheadNeedsMore = true;
+    }
+
+    return err;
+}
+
+void MPEG2TSExtractor::rewindTo(off64_t offset) {
+    Mutex::Autolock autoLock(mLock);
+
+    mOffset = offset;
+    mReadAheadOffset = mReadAheadLength = 0;
+    mReadAheadNeedsMore = false;
+    mParser->resetStreams(offset);
+}
+
+status_t MPEG2TSExtractor::seekTo(int64_t seekTimeUs) {
+    CHECK(!isDemuxing());
+
+    ATSParser::AccessUnitIndexEntry syncPoint;
+    syncPoint.timeUs = -1;
+    syncPoint.offset = 0;
+
+    if (mParser->getSource(ATSParser::VIDEO) != NULL) {
+        // Nothing from this pass gets queued, we only want the index.
+        for (size_t i = 0; i < mSourceImpls.size(); ++i) {
+            mSourceImpls.editItemAt(i)->flush();
+        }
+        mParser->skipUntil(seekTimeUs, false /* keepReferenceFrames */);
+
+        while (mParser->getIndexedTimeUs() < seekTimeUs) {
+            if (feedMore() != OK) {
+                break;
+            }
+        }
 
-    if (n < (ssize_t)kTSPacketSize) {
-        return (n < 0) ? (status_t)n : ERROR_END_OF_STREAM;
+        if (!mParser->findSyncPoint(seekTimeUs, &syncPoint)) {
+            ALOGI("no sync frame before %lld us, seeking from the start",
+                  seekTimeUs);
+            syncPoint.offset = 0;
+        }
     }
 
-    mOffset += n;
-    return mParser->feedTSPacket(packet, kTSPacketSize);
+    ALOGI("seeking to %lld us from sync frame at %lld us, offset %lld",
+          seekTimeUs, syncPoint.timeUs, syncPoint.offset);
+
+    rewindTo(syncPoint.offset);
+    mParser->skipUntil(seekTimeUs, true /* keepReferenceFrames */);
+
+    return OK;
 }
 
 uint32_t MPEG2TSExtractor::flags() const {
     return 0; //CAN_PAUSE;
 }
 
+void MPEG2TSExtractor::setBufferWatermarkUs(int64_t watermarkUs) {
+    Mutex::Autolock autoLock(mDemuxLock);
+    mBufferWatermarkUs = watermarkUs;
+    mDemuxCondition.signal();
+}
+
+void MPEG2TSExtractor::startDemuxing() {
+    Mutex::Autolock autoLock(mDemuxLock);
+    mDemuxing = true;
+    mStopDemuxing = false;
+}
+
+void MPEG2TSExtractor::cancelDemuxing() {
+    Mutex::Autolock autoLock(mDemuxLock);
+    mDemuxing = false;
+    mStopDemuxing = true;
+}
+
+bool MPEG2TSExtractor::isDemuxing() {
+    Mutex::Autolock autoLock(mDemuxLock);
+    return mDemuxing;
+}
+
+bool MPEG2TSExtractor::isStopping() {
+    Mutex::Autolock autoLock(mDemuxLock);
+    return mStopDemuxing;
+}
+
+void MPEG2TSExtractor::onAccessUnitRead() {
+    Mutex::Autolock autoLock(mDemuxLock);
+    mDemuxCondition.signal();
+}
+
+int64_t MPEG2TSExtractor::getBufferedDurationUs() {
+    int64_t minDurationUs = -1;
+
+    for (size_t i = 0; i < mSourceImpls.size(); ++i) {
+        status_t finalResult;
+        int64_t durationUs =
+            mSourceImpls.editItemAt(i)->getBufferedDurationUs(&finalResult);
+
+        if (finalResult != OK) {
+            continue;
+        }
+
+        if (minDurationUs < 0 || durationUs < minDurationUs) {
+            minDurationUs = durationUs;
+        }
+    }
+
+    return minDurationUs < 0 ? 0 : minDurationUs;
+}
+
+// True once every track that hasn't ended holds at least the watermark, or
+// any one of them holds four times that (a track the stream stopped feeding
+// would otherwise have us read to the end of the data source).
+bool MPEG2TSExtractor::isBufferFull_l() {
+    int64_t minDurationUs = -1;
+    int64_t maxDurationUs = 0;
+
+    for (size_t i = 0; i < mSourceImpls.size(); ++i) {
+        status_t finalResult;
+        int64_t durationUs =
+            mSourceImpls.editItemAt(i)->getBufferedDurationUs(&finalResult);
+
+        if (finalResult != OK) {
+            continue;
+        }
+
+        if (minDurationUs < 0 || durationUs < minDurationUs) {
+            minDurationUs = durationUs;
+        }
+
+        if (durationUs > maxDurationUs) {
+            maxDurationUs = durationUs;
+        }
+    }
+
+    return minDurationUs >= mBufferWatermarkUs
+        || maxDurationUs >= 4 * mBufferWatermarkUs;
+}
+
+status_t MPEG2TSExtractor::demuxUntilStopped() {
+    status_t err = OK;
+
+    for (;;) {
+        {
+            Mutex::Autolock autoLock(mDemuxLock);
+            while (!mStopDemuxing && isBufferFull_l()) {
+                mDemuxCondition.wait(mDemuxLock);
+            }
+
+            if (mStopDemuxing) {
+                break;
+            }
+        }
+
+        // Parsing, and any wait on the data source, happens without
+        // mDemuxLock so readers can keep dequeuing meanwhile.
+        err = feedMore();
+
+        if (err != OK) {
+            ALOGI("demux thread stopping, feedMore returned %d", err);
+
+            for (size_t i = 0; i < mSourceImpls.size(); ++i) {
+                mSourceImpls.editItemAt(i)->signalEOS(err);
+            }
+            break;
+        }
+    }
+
+    return err;
+}
+
+void MPEG2TSExtractor::stopDemuxing() {
+    {
+        Mutex::Autolock autoLock(mDemuxLock);
+        mStopDemuxing = true;
+        mDemuxCondition.signal();
+    }
+
+    for (size_t i = 0; i < mSourceImpls.size(); ++i) {
+        mSourceImpls.editItemAt(i)->signalEOS(ERROR_END_OF_STREAM);
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 bool SniffMPEG2TS(
@@ -39,6 +39,50 @@ struct MPEG2TSExtractor : public android_video_shim::MediaExtractor
 
     virtual sp<MetaData> getMetaData();
     virtual uint32_t flags() const;
+
+    // Seeks by demuxing, without decoding, until the parser's access unit
+    // index reaches |seekTimeUs|, then starting over from the sync frame at
+    // or before it. Whatever comes before |seekTimeUs| that the decoders
+    // don't need to get there is dropped. Call before startDemuxing().
+    status_t seekTo(int64_t seekTimeUs);
+
+    // Demux thread support. After startDemuxing(), track reads only dequeue
+    // and a thread sitting in demuxUntilStopped() keeps every track filled
+    // to the watermark. stopDemuxing() makes that thread return and ends
+    // the tracks with ERROR_END_OF_STREAM so nobody is left waiting.
+    // cancelDemuxing() undoes startDemuxing() when no thread could be
+    // started, and track reads go back to demuxing themselves.
+    void setBufferWatermarkUs(int64_t watermarkUs);
+    void startDemuxing();
+    void cancelDemuxing();
+    status_t demuxUntilStopped();
+    void stopDemuxing();
+    bool isDemuxing();
+    bool isStopping();
+    void onAccessUnitRead();
+
+    // Seamless switching. Once the source behind |proxy| (one of ours) runs
+    // out of data, its reads carry on from track |index| of |next| without
+    // the reader seeing the end of stream. Not if it ran out because
+    // demuxing was stopped. H.264 gets the new SPS/PPS in band ahead of its
+    // first access unit if that doesn't carry them already.
+    static bool setNextTrack(
+            android_video_shim::MediaSource *proxy,
+            const sp<MPEG2TSExtractor> &next, size_t index);
+    static bool setNextTrack23(
+            android_video_shim::MediaSource23 *proxy,
+            const sp<MPEG2TSExtractor> &next, size_t index);
+
+    // The extractor |proxy| is reading from now.
+    static sp<MPEG2TSExtractor> getTrackExtractor(
+            android_video_shim::MediaSource *proxy);
+    static sp<MPEG2TSExtractor> getTrackExtractor23(
+            android_video_shim::MediaSource23 *proxy);
+
+    // Media time demuxed and waiting to be read, on the track that has the
+    // least. Tracks that have ended don't count.
+    int64_t getBufferedDurationUs();
+
 private:
 
     //virtual sp<MediaSource> getTrack(size_t index);
@@ -49,8 +93,30 @@ private:
     sp<ATSParser> mParser;
     Vector< sp<AnotherPacketSource> > mSourceImpls;
     off64_t mOffset;
+
+    // Read-ahead window so we don't pay a full HLSSegmentCache round trip
+    // for every 188 byte packet. Sized to the largest multiple of the TS
+    // packet size that fits in 64KB. mReadAheadOffset is the position of
+    // the next unparsed byte within the window. mReadAheadAtEnd is set when
+    // the window reaches the end of the data source, mReadAheadNeedsMore
+    // when the parser is waiting on bytes past the window to resync.
+    enum { kReadAheadSize = (65536 / 188) * 188 };
+    uint8_t mReadAhead[kReadAheadSize];
+    size_t mReadAheadOffset;
+    size_t mReadAheadLength;
+    bool mReadAheadAtEnd;
+    bool mReadAheadNeedsMore;
+
+    Mutex mDemuxLock;
+    Condition mDemuxCondition;
+    bool mDemuxing;
+    bool mStopDemuxing;
+    int64_t mBufferWatermarkUs;
+
     void init();
     status_t feedMore();
+    void rewindTo(off64_t offset);
+    bool isBufferFull_l();
     DISALLOW_EVIL_CONSTRUCTORS(MPEG2TSExtractor);
 };
 bool SniffMPEG2TS(
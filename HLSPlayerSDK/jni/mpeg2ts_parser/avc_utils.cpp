@@ -337,6 +337,42 @@ bool IsAVCReferenceFrame(const sp<ABuffer> &accessUnit) {
     }
     return true;
 }
+void GetAVCFrameType(
+        const sp<ABuffer> &accessUnit, bool *isIDR, bool *isReference) {
+    *isIDR = false;
+    *isReference = true;
+
+    const uint8_t *data = accessUnit->data();
+    size_t size = accessUnit->size();
+
+    // Hop from start code to start code, looking at just the NAL unit
+    // header after each, until we get to a slice.
+    size_t offset = 0;
+    while (offset + 3 < size) {
+        const uint8_t *p = (const uint8_t *)memchr(
+                data + offset + 2, 0x01, size - offset - 3);
+        if (p == NULL) {
+            break;
+        }
+
+        offset = p - data - 2;
+        if (p[-1] != 0x00 || p[-2] != 0x00) {
+            offset += 1;
+            continue;
+        }
+
+        unsigned nalType = p[1] & 0x1f;
+        if (nalType == 5) {
+            *isIDR = true;
+            return;
+        } else if (nalType == 1) {
+            *isReference = ((p[1] >> 5) & 3) != 0;
+            return;
+        }
+
+        offset += 3;
+    }
+}
 sp<android_video_shim::MetaData> MakeAACCodecSpecificData(
         unsigned profile, unsigned sampling_freq_index,
         unsigned channel_configuration) {
@@ -44,6 +44,12 @@ status_t getNextNALUnit(
 sp<android_video_shim::MetaData> MakeAVCCodecSpecificData(const sp<ABuffer> &accessUnit);
 bool IsIDR(const sp<ABuffer> &accessUnit);
 bool IsAVCReferenceFrame(const sp<ABuffer> &accessUnit);
+
+// IsIDR() and IsAVCReferenceFrame() in one go. Only looks as far as the
+// first slice header, so doesn't scan the whole access unit the way IsIDR()
+// does for non-IDR frames.
+void GetAVCFrameType(
+        const sp<ABuffer> &accessUnit, bool *isIDR, bool *isReference);
 const char *AVCProfileToString(uint8_t profile);
 sp<android_video_shim::MetaData> MakeAACCodecSpecificData(
         unsigned profile, unsigned sampling_freq_index,
@@ -18,6 +18,7 @@
 
 #define HEXDUMP_H_
 
+#include <stddef.h>
 #include <sys/types.h>
 
 namespace android {
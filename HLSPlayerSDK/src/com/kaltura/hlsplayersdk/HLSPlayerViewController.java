@@ -119,6 +119,13 @@ TextTracksInterface, AlternateAudioTracksInterface, QualityTracksInterface, Segm
     public native boolean AllowAllProfiles();
     public native void SetSegmentCountToBuffer(int segmentCount);
     public native int GetSegmentCountToBuffer();
+    public native void SetDemuxWatermarkMS(int watermarkMS);
+    public native void SetBufferWatermarks(double lowSeconds, double highSeconds);
+    public native double GetLowBufferWatermark();
+    public native double GetHighBufferWatermark();
+    public native double GetBufferedSeconds();
+    public native void SetABRMode(int mode);
+    public native double GetThroughputEstimate();
 
     private native int GetState();
     private native void InitNativeDecoder();
@@ -128,7 +135,10 @@ TextTracksInterface, AlternateAudioTracksInterface, QualityTracksInterface, Segm
     private native void StopPlayer();
     private native void Pause(boolean pause);
     private native int NextFrame();
-    private native void FeedSegment(String url, int quality, int continuityEra, String altAudioURL, int altAudioIndex, double startTime, int cryptoId, int altCryptoId);
+    private native void SetABRLadder(int[] bitrates);
+    private native void NoteSegmentDownload(long bytes, double seconds);
+    private native int SelectQuality(int currentQuality);
+    private native void FeedSegment(String url, int quality, int continuityEra, String altAudioURL, int altAudioIndex, double startTime, double duration, int cryptoId, int altCryptoId);
     private native void SeekTo(double timeInSeconds);
     private native void ApplyFormatChange();
     private native int DroppedFramesPerSecond();
@@ -680,6 +690,7 @@ TextTracksInterface, AlternateAudioTracksInterface, QualityTracksInterface, Segm
         StreamHandler.EDGE_BUFFER_SEGMENT_COUNT = p.segments.size() - edgeBufferSegmentCount > 0 ? edgeBufferSegmentCount : p.segments.size() - 1; // prevent this from being larger than the number of available segments
 
         setBufferTime(mTimeToBuffer);
+        setABRLadder();
 
         mSubtitleHandler = new SubtitleHandler(parser);
 
@@ -776,7 +787,7 @@ TextTracksInterface, AlternateAudioTracksInterface, QualityTracksInterface, Segm
             // We need to feed the segment before calling precache so that the datasource can be initialized before we
             // supply the event handler to the segment cache. In the case where the segment is already in the cache, the
             // event handler can be called immediately.
-            FeedSegment(seg.uri, seg.quality, seg.continuityEra, seg.altAudioSegment.uri, seg.altAudioSegment.altAudioIndex, seg.startTime, seg.cryptoId, seg.altAudioSegment.cryptoId);
+            FeedSegment(seg.uri, seg.quality, seg.continuityEra, seg.altAudioSegment.uri, seg.altAudioSegment.altAudioIndex, seg.startTime, seg.duration, seg.cryptoId, seg.altAudioSegment.cryptoId);
             HLSSegmentCache.precache(seg, true, this, getInterfaceThreadHandler());
             postAudioTrackSwitchingStart(-1, seg.altAudioSegment.altAudioIndex);
             postAudioTrackSwitchingEnd(seg.altAudioSegment.altAudioIndex);
@@ -786,7 +797,7 @@ TextTracksInterface, AlternateAudioTracksInterface, QualityTracksInterface, Segm
             // We need to feed the segment before calling precache so that the datasource can be initialized before we
             // supply the event handler to the segment cache. In the case where the segment is already in the cache, the
             // event handler can be called immediately.
-            FeedSegment(seg.uri, seg.quality, seg.continuityEra, null, -1, seg.startTime, seg.cryptoId, -1);
+            FeedSegment(seg.uri, seg.quality, seg.continuityEra, null, -1, seg.startTime, seg.duration, seg.cryptoId, -1);
             HLSSegmentCache.precache(seg, true, this, getInterfaceThreadHandler());
         }
 
@@ -905,6 +916,8 @@ TextTracksInterface, AlternateAudioTracksInterface, QualityTracksInterface, Segm
         if (currentController == null)
             return -1;
 
+        currentController.autoSwitchQuality();
+
         ManifestSegment seg = currentController.getStreamHandler().getNextFile(mQualityLevel);
         if(seg == null)
         {
@@ -920,11 +933,11 @@ TextTracksInterface, AlternateAudioTracksInterface, QualityTracksInterface, Segm
         HLSSegmentCache.precache(seg, false, currentController.getStreamHandler(), getInterfaceThreadHandler());
         if (seg.altAudioSegment != null)
         {
-            currentController.FeedSegment(seg.uri, seg.quality, seg.continuityEra, seg.altAudioSegment.uri, seg.altAudioSegment.altAudioIndex, seg.startTime, seg.cryptoId, seg.altAudioSegment.cryptoId);
+            currentController.FeedSegment(seg.uri, seg.quality, seg.continuityEra, seg.altAudioSegment.uri, seg.altAudioSegment.altAudioIndex, seg.startTime, seg.duration, seg.cryptoId, seg.altAudioSegment.cryptoId);
         }
         else
         {
-            currentController.FeedSegment(seg.uri, seg.quality, seg.continuityEra, null, -1, seg.startTime, seg.cryptoId, -1);
+            currentController.FeedSegment(seg.uri, seg.quality, seg.continuityEra, null, -1, seg.startTime, seg.duration, seg.cryptoId, -1);
         }
         return seg.startTime;
     }
@@ -949,11 +962,11 @@ TextTracksInterface, AlternateAudioTracksInterface, QualityTracksInterface, Segm
         HLSSegmentCache.precache(seg, false, currentController.getStreamHandler(), getInterfaceThreadHandler());
         if (seg.altAudioSegment != null)
         {
-            currentController.FeedSegment(seg.uri, seg.quality, seg.continuityEra, seg.altAudioSegment.uri, seg.altAudioSegment.altAudioIndex, seg.startTime, seg.cryptoId, seg.altAudioSegment.cryptoId);
+            currentController.FeedSegment(seg.uri, seg.quality, seg.continuityEra, seg.altAudioSegment.uri, seg.altAudioSegment.altAudioIndex, seg.startTime, seg.duration, seg.cryptoId, seg.altAudioSegment.cryptoId);
         }
         else
         {
-            currentController.FeedSegment(seg.uri, seg.quality, seg.continuityEra, null, -1, seg.startTime, seg.cryptoId, -1);
+            currentController.FeedSegment(seg.uri, seg.quality, seg.continuityEra, null, -1, seg.startTime, seg.duration, seg.cryptoId, -1);
         }
 
         return seg.startTime;
@@ -1376,10 +1389,69 @@ TextTracksInterface, AlternateAudioTracksInterface, QualityTracksInterface, Segm
             }
         }
     }
+    // Native ABR modes, see ABREngine.h.
+    public static final int ABR_MODE_THROUGHPUT = 0;
+    public static final int ABR_MODE_BOLA = 1;
+    public static final int ABR_MODE_DYNAMIC = 2;
+
+    private boolean mAutoSwitch = false;
+
     @Override
     public void setAutoSwitch(boolean autoSwitch) {
-        postError(OnErrorListener.MEDIA_ERROR_UNSUPPORTED, "setAutoSwitch");
+        Log.i("HLSPlayerViewController.setAutoSwitch", "autoSwitch=" + autoSwitch);
+        mAutoSwitch = autoSwitch;
+    }
 
+    /**
+     * Pick how auto switching chooses a quality level: by throughput alone
+     * (ABR_MODE_THROUGHPUT, the default), by buffer level (BOLA), or
+     * throughput at low buffer and BOLA after (ABR_MODE_DYNAMIC).
+     */
+    public void setABRMode(int mode)
+    {
+        SetABRMode(mode);
+    }
+
+    /**
+     * The native throughput estimate auto switching goes by, in bits per
+     * second. -1 until a segment has been downloaded.
+     */
+    public double getThroughputEstimate()
+    {
+        return GetThroughputEstimate();
+    }
+
+    // Called by the segment cache for every segment download that finishes.
+    public void noteSegmentDownload(long bytes, long millis)
+    {
+        NoteSegmentDownload(bytes, millis / 1000.0);
+    }
+
+    private void setABRLadder()
+    {
+        List<QualityTrack> tracks = mStreamHandler.getQualityTrackList();
+        int [] bitrates = new int[tracks.size()];
+        for (int i = 0; i < bitrates.length; ++i)
+            bitrates[i] = tracks.get(i).bitrate;
+        SetABRLadder(bitrates);
+    }
+
+    // Switch to whatever quality the native ABR engine picks for the next
+    // segment, unless a switch is still under way.
+    private void autoSwitchQuality()
+    {
+        if (!mAutoSwitch || mStreamHandler == null)
+            return;
+
+        if (mStreamHandler.lastQuality != mQualityLevel)
+            return;
+
+        int newQuality = SelectQuality(mQualityLevel);
+        if (newQuality != mQualityLevel)
+        {
+            Log.i("HLSPlayerViewController.autoSwitchQuality", "Switching from " + mQualityLevel + " to " + newQuality);
+            switchQualityTrack(newQuality);
+        }
     }
 
     private OnQualityTracksListListener mOnQualityTracksListListener = null;
@@ -1512,15 +1584,38 @@ TextTracksInterface, AlternateAudioTracksInterface, QualityTracksInterface, Segm
         return segments;
     }
 
+    // Segments are requested by seconds buffered ahead of playback: once the
+    // buffer drains below two thirds of the buffer time, fill it back up to
+    // the buffer time. The segment count is kept for segments that come
+    // without a duration.
     @Override
     public void setBufferTime(int newTime) {
         mTimeToBuffer = newTime;
         if (mStreamHandler != null && mStreamHandler.baseManifest != null)
         {
             SetSegmentsToBuffer();
+            SetBufferWatermarks(newTime * 2.0 / 3.0, newTime);
         }
     }
 
+    /**
+     * Set the buffer levels, in seconds, segment requests start below and
+     * stop at. Overrides what setBufferTime picked until it's called again.
+     */
+    public void setBufferWatermarks(double lowSeconds, double highSeconds)
+    {
+        SetBufferWatermarks(lowSeconds, highSeconds);
+    }
+
+    /**
+     * Seconds of media buffered ahead of playback when last checked, -1 if
+     * not known.
+     */
+    public double getBufferedSeconds()
+    {
+        return GetBufferedSeconds();
+    }
+
     //////////////////////////////////////////////////////////
     // End Buffering
     //////////////////////////////////////////////////////////
@@ -11,15 +11,14 @@ import android.util.Log;
 
 import com.kaltura.hlsplayersdk.cache.HLSSegmentCache;
 import com.kaltura.hlsplayersdk.cache.SegmentCachedListener;
-import com.kaltura.hlsplayersdk.manifest.M2TSParser;
 import com.kaltura.hlsplayersdk.manifest.ManifestEncryptionKey;
 import com.kaltura.hlsplayersdk.manifest.ManifestParser;
 import com.kaltura.hlsplayersdk.manifest.ManifestPlaylist;
 import com.kaltura.hlsplayersdk.manifest.ManifestReloader;
 import com.kaltura.hlsplayersdk.manifest.ManifestSegment;
 import com.kaltura.hlsplayersdk.manifest.ManifestStream;
+import com.kaltura.hlsplayersdk.manifest.SegmentProbe;
 import com.kaltura.hlsplayersdk.subtitles.SubtitleHandler;
-import com.kaltura.hlsplayersdk.types.ByteArray;
 import com.kaltura.hlsplayersdk.types.TrackType;
 
 
@@ -1136,9 +1135,7 @@ public class StreamHandler implements ManifestParser.ReloadEventListener, Manife
 		
 		for (String url : uri)
 		{
-			ByteArray ba = new ByteArray(HLSSegmentCache.getByteArray(url));
-			
-			long pts = getPTS(ba, url);
+			long pts = getPTS(HLSSegmentCache.getByteArray(url), url);
 			if (pts != -1)
 			{
 				double startTime = (double)((double)pts / (double)90000);
@@ -1253,22 +1250,12 @@ public class StreamHandler implements ManifestParser.ReloadEventListener, Manife
 	}
 	
 
-	private final int _bufferCopySize = 0x4000;  
-	private long getPTS(ByteArray segmentBytes, String uri)
+	private long getPTS(byte[] segmentBytes, String uri)
 	{
-		M2TSParser tsParser = new M2TSParser();
-					
-		long pts = -1;
-		int offset = 0;
-		while (pts == -1 && offset < segmentBytes.length())
-		{
-			int len = Math.min(_bufferCopySize, segmentBytes.length() - offset);
-			tsParser.appendBytes(segmentBytes, offset, len );
-			pts = tsParser.pts;
-			offset += len;
-		}
+		SegmentProbe probe = SegmentProbe.probe(segmentBytes);
+		long pts = probe != null ? probe.getStartPTS() : -1;
 		
-		Log.i("StreamHandler.bestEffortListener.onSegmentCompleted", "Found PTS ( " + pts + " / " + ((long)(((double)pts / (double)90000) * (double)1000 * (double)1000)) + " / " + (double)((double)pts / 90000.0 )+  " )  in first " + offset + " bytes for " + uri);
+		Log.i("StreamHandler.getPTS", "Found PTS ( " + pts + " / " + (double)((double)pts / 90000.0 ) + " ) for " + uri + (probe != null ? ", duration " + probe.getDuration() + (probe.hasIDR ? ", IDR" : "") : ""));
 
 		return pts;
 	}
@@ -1301,9 +1288,7 @@ public class StreamHandler implements ManifestParser.ReloadEventListener, Manife
 				{
 					if (!req.downloadComplete) continue;
 					
-					ByteArray ba = new ByteArray(HLSSegmentCache.getByteArray(req.segment.uri));
-					
-					long pts = getPTS(ba, req.segment.uri);
+					long pts = getPTS(HLSSegmentCache.getByteArray(req.segment.uri), req.segment.uri);
 					
 					if (req.type == BestEffortRequest.TYPE_VIDEO) // check the base - i should be 0
 					{
@@ -1325,8 +1310,7 @@ public class StreamHandler implements ManifestParser.ReloadEventListener, Manife
 						startTimeWitnesses.put(req.segment.uri, req.segment.startTime);
 						
 						// Have to get the PTS for the alt audio separately.
-						ByteArray baa = new ByteArray(HLSSegmentCache.getByteArray(req.segment.altAudioSegment.uri));
-						pts = getPTS(baa, req.segment.altAudioSegment.uri);
+						pts = getPTS(HLSSegmentCache.getByteArray(req.segment.altAudioSegment.uri), req.segment.altAudioSegment.uri);
 						
 						req.segment.altAudioSegment.startTime = (double)((double)pts / (double)90000);
 						startTimeWitnesses.put(req.segment.altAudioSegment.uri, req.segment.altAudioSegment.startTime);
@@ -128,7 +128,11 @@ public class HLSSegmentCache
 		sce.notifySegmentCached();
 		
 		if (sce.downloadCompletedTime != 0 && sce.downloadStartTime != 0 && sce.downloadCompletedTime != sce.downloadStartTime)
+		{
 			lastDownloadDataRate = (double)sce.dataSize() / (sce.downloadCompletedTime - sce.downloadStartTime);
+			if (HLSPlayerViewController.currentController != null)
+				HLSPlayerViewController.currentController.noteSegmentDownload(sce.dataSize(), sce.downloadCompletedTime - sce.downloadStartTime);
+		}
 		
 		expire();
 	}
@@ -469,28 +473,7 @@ public static String bytesToHex(ByteBuffer bytes) {
 			sci.ensureDecryptedTo(offset + size);
 
 			// If we have decrypted to the end, look for padding and adjust length.
-			if(sci.isFullyDecrypted() && sci.hasCrypto() && sci.forceSize == -1)
-			{
-				// Look for padding.
-				byte padByte = sci.data[sci.data.length - 1];
-
-				boolean isPadded = true;
-				for(int i=sci.data.length-padByte; i<sci.data.length; i++)
-				{
-					if(sci.data[i] == padByte)
-						continue;
-
-					isPadded = false;
-					break;
-				}
-
-				if(isPadded)
-				{
-					// Note new size.
-					sci.forceSize = sci.data.length - padByte;
-					Log.i("HLS Cache", "Forcing segment size to " + sci.forceSize);
-				}
-			} 
+			sci.checkPadding();
 			
 			// Truncate length based on forced size.
 			if(sci.forceSize != -1)
@@ -502,7 +485,9 @@ public static String bytesToHex(ByteBuffer bytes) {
 				}
 			}
 			
-			// Copy the available bytes.
+			// Copy the available bytes. Native reuses the same buffer across
+			// reads, so always write from the start.
+			output.clear();
 			output.put(sci.data, (int)offset, (int)size);
 			
 //			if(adjusted)
@@ -523,6 +508,163 @@ public static String bytesToHex(ByteBuffer bytes) {
 	}
 	
 	
+	/**
+	 * Native side of the segment cache. Segments the demuxer is going to
+	 * read are handed over once, fully decrypted, so that reads never have
+	 * to come back through JNI.
+	 */
+	public static native boolean isNativeSegmentExpected(String segmentUri);
+	public static native boolean storeNativeSegment(String segmentUri, ByteBuffer data, long size);
+	public static native void failNativeSegment(String segmentUri, boolean fallbackToJava);
+	
+	/**
+	 * Called from native when the demuxer queues a segment. Hands the bytes
+	 * over now if we have them, otherwise makes sure the download is running
+	 * and postSegmentSucceeded will hand them over when it completes.
+	 */
+	static public void requestNativeStore(String segmentUri, int cryptoId)
+	{
+		initialize();
+		
+		SegmentCacheItem sci = null;
+		synchronized (segmentCache)
+		{
+			SegmentCacheEntry sce = segmentCache.get(segmentUri);
+			if (sce != null)
+				sci = sce.getItem(segmentUri);
+		}
+		
+		if (sci != null && sci.data != null)
+		{
+			offerToNative(sci);
+			return;
+		}
+		
+		precache(segmentUri, cryptoId);
+	}
+	
+	static void offerToNative(SegmentCacheItem sci)
+	{
+		if (sci.data == null)
+		{
+			// Nothing to hand over; let native fall back to reading through us.
+			failNativeSegment(sci.uri, true);
+			return;
+		}
+		
+		if (!isNativeSegmentExpected(sci.uri))
+			return;
+		
+		// Segments are several hundred KB, so the copies into the direct
+		// buffer are made outside the lock; only picking the source is done
+		// under it.
+		ByteBuffer buffer = null;
+		long size = 0;
+		byte[] data = null;
+		boolean decryptCopy = false;
+		synchronized (segmentCache)
+		{
+			long decrypted = sci.getDecryptResult(false);
+			if (decrypted == SegmentCacheItem.DECRYPT_PENDING)
+			{
+				// The decrypt pool hands it over itself when it finishes.
+				return;
+			}
+			else if (decrypted >= 0)
+			{
+				buffer = sci.decryptBuffer;
+				size = decrypted;
+			}
+			else if (sci.data == null)
+			{
+				size = -1;
+			}
+			else if (sci.hasCrypto() && sci.decryptHighWaterMark == 0)
+			{
+				// Nothing decrypted on the Java side yet, so decrypt the
+				// direct copy instead; the array never has to be handed to JNI.
+				data = sci.data;
+				decryptCopy = true;
+			}
+			else
+			{
+				// Once fully decrypted the array doesn't change any more.
+				sci.ensureDecryptedTo(sci.data.length);
+				sci.checkPadding();
+				
+				data = sci.data;
+				size = (sci.forceSize != -1) ? sci.forceSize : sci.data.length;
+			}
+		}
+		
+		if (decryptCopy)
+		{
+			buffer = ByteBuffer.allocateDirect(data.length);
+			buffer.put(data);
+			
+			synchronized (segmentCache)
+			{
+				// A reader started decrypting the array in place while we
+				// were copying it, so the copy is no good; start over.
+				if (sci.decryptHighWaterMark != 0)
+				{
+					offerToNative(sci);
+					return;
+				}
+			}
+			
+			size = SegmentCacheItem.decryptDirect(sci.cryptoHandle, buffer, data.length);
+		}
+		else if (data != null)
+		{
+			buffer = ByteBuffer.allocateDirect((int)size);
+			buffer.put(data, 0, (int)size);
+		}
+		
+		if (size < 0)
+		{
+			failNativeSegment(sci.uri, true);
+			return;
+		}
+		
+		if (!storeNativeSegment(sci.uri, buffer, size))
+			Log.i("HLS Cache", "Native store declined " + sci.uri);
+	}
+	
+	/**
+	 * Called from native every so often while the demuxer is blocked on a
+	 * segment it expects, and once more when it stops. Marks the segment as
+	 * waited on and posts progress the way waitForLoad does, then makes sure
+	 * the segment is still coming: once the download is over it's offered
+	 * again, which either hands it over or sends native back to reading
+	 * through us.
+	 */
+	static public void nativeSegmentWait(String segmentUri, boolean waiting)
+	{
+		initialize();
+		
+		SegmentCacheItem sci = null;
+		synchronized (segmentCache)
+		{
+			SegmentCacheEntry sce = segmentCache.get(segmentUri);
+			if (sce != null)
+			{
+				sce.setWaiting(segmentUri, waiting);
+				sci = sce.getItem(segmentUri);
+			}
+		}
+		
+		if (!waiting)
+			return;
+		
+		postProgressUpdate(false);
+		
+		if (sci == null)
+			failNativeSegment(segmentUri, true);
+		else if (!sci.running)
+			offerToNative(sci);
+	}
+	
 	static public byte[] getByteArray(String segmentUri)
 	{
 		boolean adjusted = false;
@@ -555,28 +697,7 @@ public static String bytesToHex(ByteBuffer bytes) {
 			sci.ensureDecryptedTo(sci.data.length);
 
 			// If we have decrypted to the end, look for padding and adjust length.
-			if(sci.isFullyDecrypted() && sci.hasCrypto() && sci.forceSize == -1)
-			{
-				// Look for padding.
-				byte padByte = sci.data[sci.data.length - 1];
-
-				boolean isPadded = true;
-				for(int i=sci.data.length-padByte; i<sci.data.length; i++)
-				{
-					if(sci.data[i] == padByte)
-						continue;
-
-					isPadded = false;
-					break;
-				}
-
-				if(isPadded)
-				{
-					// Note new size.
-					sci.forceSize = sci.data.length - padByte;
-					Log.i("HLS Cache", "Forcing segment size to " + sci.forceSize);
-				}
-			} 
+			sci.checkPadding();
 
 			return sci.data;
 		}
@@ -53,7 +53,10 @@ public class SegmentCacheEntry
 	public void clear()
 	{
 		for (int i = 0; i < mItems.length; ++i)
+		{
+			mItems[i].releaseDecryptJob();
 			mItems[i].data = null;
+		}
 	}
 	
 	public void cancel()
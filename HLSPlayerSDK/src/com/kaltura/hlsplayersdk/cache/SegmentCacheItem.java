@@ -1,5 +1,7 @@
 package com.kaltura.hlsplayersdk.cache;
 
+import java.nio.ByteBuffer;
+
 import android.os.Handler;
 import android.util.Log;
 
@@ -25,6 +27,11 @@ public class SegmentCacheItem {
 	protected long decryptHighWaterMark = 0;
 	private boolean fullyDecrypted = false;
 	
+	// Native decrypt pool job working on a direct copy of data, -1 if none.
+	protected int decryptJob = -1;
+	protected ByteBuffer decryptBuffer = null;
+	public static final long DECRYPT_PENDING = -2;
+	
 	// We will retry 3 times before giving up
 	private static final int maxRetries = 3;
 	private int curRetries = 0;
@@ -34,6 +41,23 @@ public class SegmentCacheItem {
 	public static native void freeCryptoState(int id);
 	public static native long decrypt(int cryptoHandle, byte[] data, long start, long length);
 	
+	/**
+	 * Decrypt the first length bytes of a direct ByteBuffer in place, as a
+	 * whole segment starting from the key's IV. Doesn't affect where decrypt()
+	 * carries on from. Returns the length with padding removed, or -1.
+	 */
+	public static native long decryptDirect(int cryptoHandle, ByteBuffer data, long length);
+	
+	/**
+	 * Native decrypt pool. submitDecrypt queues a direct ByteBuffer holding a
+	 * whole segment and returns a job id (or -1); getDecryptResult returns the
+	 * decrypted length with padding removed, -1 on failure, or DECRYPT_PENDING
+	 * if the job isn't done and we didn't wait.
+	 */
+	public static native int submitDecrypt(int cryptoHandle, String uri, ByteBuffer data, long length);
+	public static native long getDecryptResult(int job, boolean wait);
+	public static native void releaseDecrypt(int job);
+	
 	public RequestHandle request = null;
 	
 	SegmentCacheEntry cacheEntry = null;
@@ -53,6 +77,7 @@ public class SegmentCacheItem {
 			Log.i("HLS Cache", "Cancelling " + uri);
 			running = false;
 			waiting = false;
+			HLSSegmentCache.failNativeSegment(uri, true);
 		}
 		
 	}
@@ -71,10 +96,60 @@ public class SegmentCacheItem {
 			Log.i("setCryptoHandle", "Tried to change an existing cryptoHandle (" + cryptoHandle + ") to (" + handle + ")");
 	}
 
+	/**
+	 * Hand a copy of the freshly downloaded segment to the native decrypt
+	 * pool, so it's decrypted before anyone gets round to reading it.
+	 */
+	public void startDecrypt()
+	{
+		if (cryptoHandle == -1 || data == null || decryptJob != -1 || decryptHighWaterMark != 0)
+			return;
+		
+		decryptBuffer = ByteBuffer.allocateDirect(data.length);
+		decryptBuffer.put(data);
+		decryptJob = submitDecrypt(cryptoHandle, uri, decryptBuffer, data.length);
+		if (decryptJob == -1)
+			decryptBuffer = null;
+	}
+	
+	/**
+	 * Result of the decrypt pool job as per getDecryptResult, -1 if there isn't one.
+	 */
+	public long getDecryptResult(boolean wait)
+	{
+		if (decryptJob == -1)
+			return -1;
+		return getDecryptResult(decryptJob, wait);
+	}
+	
+	public void releaseDecryptJob()
+	{
+		if (decryptJob == -1)
+			return;
+		
+		releaseDecrypt(decryptJob);
+		decryptJob = -1;
+		decryptBuffer = null;
+	}
+	
 	public void ensureDecryptedTo(long offset)
 	{
 		if(cryptoHandle == -1)
 			return;
+		
+		if (decryptJob != -1)
+		{
+			// Normally done long before anyone reads. Take the whole segment,
+			// or fall back to decrypting here if the job failed.
+			if (getDecryptResult(true) >= 0)
+			{
+				decryptBuffer.clear();
+				decryptBuffer.get(data);
+				decryptHighWaterMark = data.length;
+			}
+			releaseDecryptJob();
+		}
+		
 //		if (offset == 188)
 //		{
 //			Log.i("HLS Cache", "Decrypting " + uri);
@@ -99,6 +174,34 @@ public class SegmentCacheItem {
 		return (decryptHighWaterMark == data.length);
 	}
 	
+	/**
+	 * If we have decrypted to the end, look for padding and adjust length.
+	 */
+	public void checkPadding()
+	{
+		if(!isFullyDecrypted() || !hasCrypto() || forceSize != -1)
+			return;
+
+		byte padByte = data[data.length - 1];
+
+		boolean isPadded = true;
+		for(int i=data.length-padByte; i<data.length; i++)
+		{
+			if(data[i] == padByte)
+				continue;
+
+			isPadded = false;
+			break;
+		}
+
+		if(isPadded)
+		{
+			// Note new size.
+			forceSize = data.length - padByte;
+			Log.i("HLS Cache", "Forcing segment size to " + forceSize);
+		}
+	}
+	
 	private boolean retry()
 	{
 		++curRetries;
@@ -118,6 +221,7 @@ public class SegmentCacheItem {
 		{
 			Log.i("SegmentCacheItem.postOnSegmentFailed", "Segment download failed. No More Retries Left: " + uri + " : " + statusCode);
 			running = false;
+			HLSSegmentCache.failNativeSegment(uri, false);
 			cacheEntry.postItemFailed(this, statusCode);
 		}
 	}
@@ -127,6 +231,11 @@ public class SegmentCacheItem {
 		if (statusCode == 200)
 		{
 			data = responseData;
+			synchronized (HLSSegmentCache.segmentCache)
+			{
+				startDecrypt();
+			}
+			HLSSegmentCache.offerToNative(this);
 			
 			downloadCompletedTime = System.currentTimeMillis();
 			Log.i("SegmentCacheItem.postSegmentSucceeded", "Got " + (responseData != null ? responseData.length + " bytes for " : " null document for " )  + uri);
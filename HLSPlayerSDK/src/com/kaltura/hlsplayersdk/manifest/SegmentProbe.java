@@ -0,0 +1,73 @@
+package com.kaltura.hlsplayersdk.manifest;
+
+/**
+ * First and last PTS of the streams in a TS segment, found natively from the
+ * PES headers near the start and end of the segment rather than by parsing
+ * all of it. See jni/SegmentProbe.h.
+ */
+public class SegmentProbe
+{
+	// How much of the end of the segment the last timestamps are looked for in.
+	public static final int DEFAULT_TAIL_BYTES = 32 * 1024;
+
+	// Raw 90kHz timestamps, -1 if the stream isn't there.
+	public long videoFirstPTS = -1;
+	public long videoLastPTS = -1;
+	public long audioFirstPTS = -1;
+	public long audioLastPTS = -1;
+
+	// Whether the video has an IDR frame (H.264 only).
+	public boolean hasIDR = false;
+
+	public static SegmentProbe probe(byte[] data)
+	{
+		if (data == null) return null;
+		return probe(data, data.length, 0, DEFAULT_TAIL_BYTES);
+	}
+
+	/**
+	 * Probe the first length bytes of data.
+	 * @param headBytes Give up looking for the start time after this many bytes, 0 for no limit.
+	 * @param tailBytes Look for the end time in this many bytes at the end, 0 to not bother.
+	 * @return null if no timestamps were found.
+	 */
+	public static SegmentProbe probe(byte[] data, int length, int headBytes, int tailBytes)
+	{
+		if (data == null) return null;
+
+		long[] out = new long[5];
+		if (!nativeProbe(data, length, headBytes, tailBytes, out))
+			return null;
+
+		SegmentProbe probe = new SegmentProbe();
+		probe.videoFirstPTS = out[0];
+		probe.videoLastPTS = out[1];
+		probe.audioFirstPTS = out[2];
+		probe.audioLastPTS = out[3];
+		probe.hasIDR = out[4] != 0;
+		return probe;
+	}
+
+	// The earliest first PTS of any stream.
+	public long getStartPTS()
+	{
+		if (videoFirstPTS == -1) return audioFirstPTS;
+		if (audioFirstPTS == -1) return videoFirstPTS;
+		return Math.min(videoFirstPTS, audioFirstPTS);
+	}
+
+	public double getStartTime()
+	{
+		return (double)getStartPTS() / 90000.0;
+	}
+
+	// Longest first to last PTS span of any stream, in seconds. Doesn't
+	// include the duration of the last PES packet.
+	public double getDuration()
+	{
+		long span = Math.max(videoLastPTS - videoFirstPTS, audioLastPTS - audioFirstPTS);
+		return (double)span / 90000.0;
+	}
+
+	private static native boolean nativeProbe(byte[] data, int length, int headBytes, int tailBytes, long[] out);
+}
@@ -0,0 +1,381 @@
+// Decodes an AAC file with the bundled fdk-aac the way AudioFDK drives it
+// (aacDecoder_Fill, then aacDecoder_DecodeFrame until it wants more), and
+// reports how much faster than real time it ran, where the time went, and a
+// CRC-32 of the decoded PCM.
+//
+// The CRC covers the interleaved 16 bit little endian samples, the same bytes
+// -o writes after the WAV header, so it can be checked against any other
+// decoder's output, and -x turns a run into a pass/fail conformance check.
+//
+// AAC-LC, HE-AAC and HE-AACv2 in ADTS, LOAS/LATM or ADIF are all handled; the
+// transport is guessed from the first bytes unless -t says otherwise. The
+// time spent in the core decoder, SBR, parametric stereo and the SBR QMF
+// banks comes from the FDK_BENCH hooks, each counted without the modules it
+// calls; "other" is everything else (transport parsing, PCM post processing).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+#include "aacdecoder_lib.h"
+#include "wav_file.h"
+#include "FDK_bench.h"
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Cycles where the CPU has a counter we can read from user space,
+// nanoseconds otherwise.
+#if defined(__i386__) || defined(__x86_64__)
+static const char *kTickName = "cycles";
+static inline unsigned long long ticks()
+{
+	return __rdtsc();
+}
+#else
+static const char *kTickName = "ns";
+static inline unsigned long long ticks()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+//----------------------------------------------------------------------------
+// FDK_BENCH hooks
+
+static const char *kModuleNames[FDK_BENCH_MODULES] = { "core", "sbr", "ps", "qmf" };
+
+static unsigned long long gModuleTicks[FDK_BENCH_MODULES];
+static FDK_BENCH_MODULE gModuleStack[16];
+static int gModuleDepth;
+static unsigned long long gLastTick;
+
+void FDK_benchEnter(FDK_BENCH_MODULE module)
+{
+	unsigned long long t = ticks();
+	if (gModuleDepth > 0)
+		gModuleTicks[gModuleStack[gModuleDepth - 1]] += t - gLastTick;
+	gModuleStack[gModuleDepth++] = module;
+	gLastTick = t;
+}
+
+void FDK_benchLeave(void)
+{
+	unsigned long long t = ticks();
+	gModuleTicks[gModuleStack[--gModuleDepth]] += t - gLastTick;
+	gLastTick = t;
+}
+
+//----------------------------------------------------------------------------
+
+static unsigned int gCRCTable[256];
+
+static void initCRC()
+{
+	for (unsigned int i = 0; i < 256; ++i)
+	{
+		unsigned int c = i;
+		for (int k = 0; k < 8; ++k)
+			c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+		gCRCTable[i] = c;
+	}
+}
+
+// Running CRC-32; start from 0.
+static unsigned int updateCRC(unsigned int crc, const INT_PCM *samples, size_t count)
+{
+	crc = ~crc;
+	for (size_t i = 0; i < count; ++i)
+	{
+		unsigned short s = (unsigned short)samples[i];
+		crc = gCRCTable[(crc ^ s) & 0xff] ^ (crc >> 8);
+		crc = gCRCTable[(crc ^ (s >> 8)) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+static TRANSPORT_TYPE guessTransport(const std::vector<unsigned char> &data)
+{
+	if (data.size() >= 4 && !memcmp(&data[0], "ADIF", 4))
+		return TT_MP4_ADIF;
+	if (data.size() >= 2 && data[0] == 0xff && (data[1] & 0xf6) == 0xf0)
+		return TT_MP4_ADTS;
+	if (data.size() >= 2 && data[0] == 0x56 && (data[1] & 0xe0) == 0xe0)
+		return TT_MP4_LOAS;
+	return TT_UNKNOWN;
+}
+
+// ADTS and LOAS streams usually signal SBR and PS implicitly, so go by what
+// the decoder ended up doing as well as what the configuration says.
+static const char *profileName(const CStreamInfo *info)
+{
+	if (info->aot == AOT_PS || info->extAot == AOT_PS || info->numChannels > info->aacNumChannels)
+		return "HE-AACv2";
+	if (info->aot == AOT_SBR || info->extAot == AOT_SBR || info->sampleRate > info->aacSampleRate)
+		return "HE-AAC";
+	if (info->aot == AOT_AAC_LC)
+		return "AAC-LC";
+	return "other";
+}
+
+struct DecodeStats
+{
+	double seconds;
+	unsigned long long ticks;
+	unsigned long long moduleTicks[FDK_BENCH_MODULES];
+	long frames;
+	long errors;
+	long long samples; // per channel
+	unsigned int crc;
+};
+
+// Decodes the whole of data once. info is filled in from the last frame.
+static bool decode(const std::vector<unsigned char> &data, TRANSPORT_TYPE transport, HANDLE_WAV wav,
+		DecodeStats *stats, CStreamInfo *info)
+{
+	HANDLE_AACDECODER decoder = aacDecoder_Open(transport, 1);
+	if (!decoder)
+	{
+		fprintf(stderr, "aacDecoder_Open failed\n");
+		return false;
+	}
+
+	// Enough for 8 channels of a 2048 sample (SBR) frame.
+	std::vector<INT_PCM> pcm(2048 * 8);
+
+	memset(stats, 0, sizeof(*stats));
+	memset(gModuleTicks, 0, sizeof(gModuleTicks));
+	gModuleDepth = 0;
+
+	size_t position = 0;
+	bool ok = true;
+	double start = now();
+	for (;;)
+	{
+		unsigned long long frameStart = ticks();
+
+		if (position < data.size())
+		{
+			UCHAR *buffer = (UCHAR *)&data[position];
+			UINT size = data.size() - position;
+			UINT valid = size;
+			aacDecoder_Fill(decoder, &buffer, &size, &valid);
+			position = data.size() - valid;
+		}
+
+		AAC_DECODER_ERROR err = aacDecoder_DecodeFrame(decoder, &pcm[0], pcm.size(), 0);
+		stats->ticks += ticks() - frameStart;
+
+		if (err == AAC_DEC_NOT_ENOUGH_BITS)
+		{
+			if (position >= data.size())
+				break;
+			continue;
+		}
+		if (IS_INIT_ERROR(err))
+		{
+			fprintf(stderr, "Decoder could not be set up for this stream: 0x%x\n", err);
+			ok = false;
+			break;
+		}
+		if (err != AAC_DEC_OK)
+		{
+			++stats->errors;
+			continue;
+		}
+
+		CStreamInfo *frameInfo = aacDecoder_GetStreamInfo(decoder);
+		*info = *frameInfo;
+		size_t count = frameInfo->frameSize * frameInfo->numChannels;
+		stats->crc = updateCRC(stats->crc, &pcm[0], count);
+		stats->samples += frameInfo->frameSize;
+		++stats->frames;
+
+		if (wav)
+			WAV_OutputWrite(wav, &pcm[0], count, 16, 16);
+	}
+	stats->seconds = now() - start;
+	memcpy(stats->moduleTicks, gModuleTicks, sizeof(gModuleTicks));
+
+	aacDecoder_Close(decoder);
+	return ok;
+}
+
+static bool readFile(const char *path, std::vector<unsigned char> *data)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f)
+		return false;
+
+	unsigned char chunk[65536];
+	size_t n;
+	while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+		data->insert(data->end(), chunk, chunk + n);
+	fclose(f);
+	return true;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "usage: %s [-t adts|loas|adif] [-n iterations] [-o out.wav] [-x crc] file.aac\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	const char *path = NULL;
+	const char *wavPath = NULL;
+	const char *transportName = NULL;
+	const char *expected = NULL;
+	int iterations = 5;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-t") && i + 1 < argc)
+			transportName = argv[++i];
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			iterations = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			wavPath = argv[++i];
+		else if (!strcmp(argv[i], "-x") && i + 1 < argc)
+			expected = argv[++i];
+		else if (argv[i][0] == '-')
+		{
+			usage(argv[0]);
+			return 1;
+		}
+		else
+			path = argv[i];
+	}
+
+	if (path == NULL || iterations < 1)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	std::vector<unsigned char> data;
+	if (!readFile(path, &data) || data.empty())
+	{
+		fprintf(stderr, "Could not read %s\n", path);
+		return 1;
+	}
+
+	TRANSPORT_TYPE transport;
+	if (transportName == NULL)
+		transport = guessTransport(data);
+	else if (!strcmp(transportName, "adts"))
+		transport = TT_MP4_ADTS;
+	else if (!strcmp(transportName, "loas"))
+		transport = TT_MP4_LOAS;
+	else if (!strcmp(transportName, "adif"))
+		transport = TT_MP4_ADIF;
+	else
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (transport == TT_UNKNOWN)
+	{
+		fprintf(stderr, "%s doesn't start with an ADTS, LOAS or ADIF header, use -t\n", path);
+		return 1;
+	}
+
+	initCRC();
+
+	// The first run also writes the WAV, and is the one the others have to
+	// match.
+	DecodeStats first;
+	CStreamInfo info;
+	memset(&info, 0, sizeof(info));
+
+	HANDLE_WAV wav = NULL;
+	if (wavPath)
+	{
+		// The format is only known once a frame has been decoded.
+		DecodeStats probe;
+		if (!decode(data, transport, NULL, &probe, &info) || probe.frames == 0)
+		{
+			fprintf(stderr, "No frames decoded from %s\n", path);
+			return 1;
+		}
+		if (WAV_OutputOpen(&wav, wavPath, info.sampleRate, info.numChannels, 16) != 0)
+		{
+			fprintf(stderr, "Could not create %s\n", wavPath);
+			return 1;
+		}
+	}
+
+	bool ok = decode(data, transport, wav, &first, &info);
+	if (wav)
+		WAV_OutputClose(&wav);
+	if (!ok || first.frames == 0)
+	{
+		fprintf(stderr, "No frames decoded from %s\n", path);
+		return 1;
+	}
+
+	printf("%s: %s, %d Hz (core %d Hz), %d channels, %d samples per frame\n", path, profileName(&info),
+			info.sampleRate, info.aacSampleRate, info.numChannels, info.frameSize);
+
+	double audioSeconds = (double)first.samples / info.sampleRate;
+	printf("%ld frames, %.2f s of audio, %ld frame errors, crc32 %08x\n", first.frames, audioSeconds,
+			first.errors, first.crc);
+
+	// Keep the fastest run, the others only add noise from the rest of the
+	// system.
+	DecodeStats best = first;
+	for (int i = 1; i < iterations; ++i)
+	{
+		DecodeStats stats;
+		CStreamInfo runInfo;
+		decode(data, transport, NULL, &stats, &runInfo);
+		if (stats.crc != first.crc)
+		{
+			printf("Run %d decoded differently: crc32 %08x\n", i + 1, stats.crc);
+			return 2;
+		}
+		if (stats.ticks < best.ticks)
+			best = stats;
+	}
+
+	printf("\nbest of %d: %.1f ms, %.1fx real time\n", iterations, best.seconds * 1000, audioSeconds / best.seconds);
+
+	unsigned long long attributed = 0;
+	printf("%-8s %14s %12s %7s\n", "module", kTickName, "per frame", "share");
+	for (int m = 0; m < FDK_BENCH_MODULES; ++m)
+	{
+		printf("%-8s %14llu %12llu %6.1f%%\n", kModuleNames[m], best.moduleTicks[m],
+				best.moduleTicks[m] / best.frames, 100.0 * best.moduleTicks[m] / best.ticks);
+		attributed += best.moduleTicks[m];
+	}
+	unsigned long long other = best.ticks > attributed ? best.ticks - attributed : 0;
+	printf("%-8s %14llu %12llu %6.1f%%\n", "other", other, other / best.frames, 100.0 * other / best.ticks);
+	printf("%-8s %14llu %12llu\n", "total", best.ticks, best.ticks / best.frames);
+
+	if (expected)
+	{
+		unsigned int want = strtoul(expected, NULL, 16);
+		if (want != first.crc)
+		{
+			printf("\nFAIL: expected crc32 %08x\n", want);
+			return 2;
+		}
+		printf("\nPASS\n");
+	}
+
+	return 0;
+}
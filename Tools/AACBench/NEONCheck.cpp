@@ -0,0 +1,409 @@
+// Checks the fdk-aac NEON kernels in libFDK/src/neon against the C code they
+// replace, on random input, and exits non-zero if anything differs by a
+// single bit:
+//
+//   - the DCT-IV/DST-IV pre and post twiddle loops, for every M up to 600
+//     with random twiddle tables
+//   - dit_fft_neon() against dit_fft() for 4 to 1024 points
+//   - dct_IV(), dst_IV() and fft() as a whole, through the dispatch, against
+//     the C builds in NEONCheckRef.cpp
+//   - the symmetric QMF analysis and synthesis banks, slot by slot,
+//     including their filter states, scalefactor and gain changes
+//
+// On the host the kernels are built against neon/arm_neon.h, a scalar
+// stand-in for the intrinsics; on an ARM device the same program checks the
+// real instructions. "make check" runs it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "qmf.h"
+#include "dct.h"
+#include "fft.h"
+#include "fft_rad2.h"
+#include "FDK_neon.h"
+
+#if !defined(FDK_NEON)
+#error NEONCheck needs HAVE_FDK_NEON and the 16 bit coefficient tables
+#endif
+
+// NEONCheckRef.cpp.
+void ref_dct_IV(FIXP_DBL *pDat, int L, int *pDat_e);
+void ref_dst_IV(FIXP_DBL *pDat, int L, int *pDat_e);
+void ref_fft(int length, FIXP_DBL *pInput, INT *scalefactor);
+int ref_qmfInitAnalysisFilterBank(HANDLE_QMF_FILTER_BANK, FIXP_QAS *, int, int, int, int, int);
+int ref_qmfInitSynthesisFilterBank(HANDLE_QMF_FILTER_BANK, FIXP_QSS *, int, int, int, int, int);
+void ref_qmfAnalysisFilteringSlot(HANDLE_QMF_FILTER_BANK, FIXP_QMF *, FIXP_QMF *, const INT_PCM *, const int, FIXP_QMF *);
+void ref_qmfSynthesisFilteringSlot(HANDLE_QMF_FILTER_BANK, const FIXP_QMF *, const FIXP_QMF *, const int, const int, INT_PCM *, const int, FIXP_QMF *);
+void ref_qmfChangeOutScalefactor(HANDLE_QMF_FILTER_BANK, int);
+void ref_qmfChangeOutGain(HANDLE_QMF_FILTER_BANK, FIXP_DBL);
+
+// xorshift64, so every run checks the same cases.
+static unsigned long long gRandState = 88172645463325252ULL;
+
+static unsigned int nextRandom()
+{
+	gRandState ^= gRandState << 13;
+	gRandState ^= gRandState >> 7;
+	gRandState ^= gRandState << 17;
+	return (unsigned int)(gRandState >> 11);
+}
+
+// A random value that fits in bits bits, sign included.
+static INT randomValue(int bits)
+{
+	int v = (int)nextRandom();
+	return bits >= 32 ? v : v >> (32 - bits);
+}
+
+static void fillRandom(FIXP_DBL *x, int n, int bits)
+{
+	for (int i = 0; i < n; i++)
+		x[i] = randomValue(bits);
+}
+
+static void fillRandom(FIXP_SPK *table, int n)
+{
+	for (int i = 0; i < n; i++)
+	{
+		table[i].v.re = (FIXP_SGL)randomValue(16);
+		table[i].v.im = (FIXP_SGL)randomValue(16);
+	}
+}
+
+// Only the first few failures are printed.
+static int gFailures = 0;
+
+#define CHECK(cond, ...) \
+	do \
+	{ \
+		if (!(cond) && gFailures++ < 20) \
+		{ \
+			printf("FAIL: "); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+		} \
+	} while (0)
+
+// The twiddle loops from dct_IV() and dst_IV() in dct.cpp, taking any table
+// rather than the one getTables() picks for L.
+static void preTwiddle(int M, const FIXP_WTP *twiddle, FIXP_DBL *pDat, bool dst)
+{
+	int L = 2 * M;
+	FIXP_DBL *pDat_0 = &pDat[0];
+	FIXP_DBL *pDat_1 = &pDat[L - 2];
+	int i;
+
+	for (i = 0; i < M - 1; i += 2, pDat_0 += 2, pDat_1 -= 2)
+	{
+		FIXP_DBL accu1, accu2, accu3, accu4;
+		accu1 = pDat_1[1];
+		accu2 = dst ? -pDat_0[0] : pDat_0[0];
+		accu3 = pDat_0[1];
+		accu4 = dst ? -pDat_1[0] : pDat_1[0];
+
+		cplxMultDiv2(&accu1, &accu2, accu1, accu2, twiddle[i]);
+		cplxMultDiv2(&accu3, &accu4, accu4, accu3, twiddle[i + 1]);
+
+		pDat_0[0] = accu2;
+		pDat_0[1] = accu1;
+		pDat_1[0] = accu4;
+		pDat_1[1] = -accu3;
+	}
+	if (M & 1)
+	{
+		FIXP_DBL accu1 = pDat_1[1];
+		FIXP_DBL accu2 = dst ? -pDat_0[0] : pDat_0[0];
+
+		cplxMultDiv2(&accu1, &accu2, accu1, accu2, twiddle[i]);
+
+		pDat_0[0] = accu2;
+		pDat_0[1] = accu1;
+	}
+}
+
+static void postTwiddleDCT(int M, const FIXP_STP *sin_twiddle, int sin_step, FIXP_DBL *pDat)
+{
+	int L = 2 * M;
+	FIXP_DBL *pDat_0 = &pDat[0];
+	FIXP_DBL *pDat_1 = &pDat[L - 2];
+	FIXP_DBL accu1, accu2, accu3, accu4;
+	int idx, i;
+
+	accu1 = pDat_1[0];
+	accu2 = pDat_1[1];
+	pDat_1[1] = -(pDat_0[1] >> 1);
+	pDat_0[0] = pDat_0[0] >> 1;
+
+	for (idx = sin_step, i = 1; i < (M + 1) >> 1; i++, idx += sin_step)
+	{
+		FIXP_STP twd = sin_twiddle[idx];
+
+		cplxMultDiv2(&accu3, &accu4, accu1, accu2, twd);
+		pDat_0[1] = accu3;
+		pDat_1[0] = accu4;
+
+		pDat_0 += 2;
+		pDat_1 -= 2;
+
+		cplxMultDiv2(&accu3, &accu4, pDat_0[1], pDat_0[0], twd);
+		accu1 = pDat_1[0];
+		accu2 = pDat_1[1];
+		pDat_1[1] = -accu3;
+		pDat_0[0] = accu4;
+	}
+	if ((M & 1) == 0)
+	{
+		accu1 = fMultDiv2(accu1, WTC(0x5a82799a));
+		accu2 = fMultDiv2(accu2, WTC(0x5a82799a));
+		pDat_1[0] = accu1 + accu2;
+		pDat_0[1] = accu1 - accu2;
+	}
+}
+
+static void postTwiddleDST(int M, const FIXP_STP *sin_twiddle, int sin_step, FIXP_DBL *pDat)
+{
+	int L = 2 * M;
+	FIXP_DBL *pDat_0 = &pDat[0];
+	FIXP_DBL *pDat_1 = &pDat[L - 2];
+	FIXP_DBL accu1, accu2, accu3, accu4;
+	int idx, i;
+
+	accu1 = pDat_1[0];
+	accu2 = pDat_1[1];
+	pDat_1[1] = -(pDat_0[0] >> 1);
+	pDat_0[0] = pDat_0[1] >> 1;
+
+	for (idx = sin_step, i = 1; i < (M + 1) >> 1; i++, idx += sin_step)
+	{
+		FIXP_STP twd = sin_twiddle[idx];
+
+		cplxMultDiv2(&accu3, &accu4, accu1, accu2, twd);
+		pDat_1[0] = -accu3;
+		pDat_0[1] = -accu4;
+
+		pDat_0 += 2;
+		pDat_1 -= 2;
+
+		cplxMultDiv2(&accu3, &accu4, pDat_0[1], pDat_0[0], twd);
+		accu1 = pDat_1[0];
+		accu2 = pDat_1[1];
+		pDat_0[0] = accu3;
+		pDat_1[1] = -accu4;
+	}
+	if ((M & 1) == 0)
+	{
+		accu1 = fMultDiv2(accu1, WTC(0x5a82799a));
+		accu2 = fMultDiv2(accu2, WTC(0x5a82799a));
+		pDat_0[1] = -accu1 - accu2;
+		pDat_1[0] = accu2 - accu1;
+	}
+}
+
+// Full scale input down to small values, so both the saturating and the
+// quiet ends of the arithmetic get exercised.
+static const int kInputBits[] = { 32, 31, 28, 20, 8 };
+static const int kInputBitsCount = sizeof(kInputBits) / sizeof(kInputBits[0]);
+
+static FIXP_DBL gA[4096], gB[4096];
+static FIXP_SPK gTable[8192];
+
+static void checkTwiddles()
+{
+	for (int M = 1; M <= 600; M++)
+	{
+		for (int b = 0; b < kInputBitsCount; b++)
+		{
+			for (int rep = 0; rep < 3; rep++)
+			{
+				fillRandom(gTable, 8192);
+				int step = 1 + nextRandom() % 4;
+
+				for (int dst = 0; dst < 2; dst++)
+				{
+					fillRandom(gA, 2 * M, kInputBits[b]);
+					memcpy(gB, gA, sizeof(FIXP_DBL) * 2 * M);
+					preTwiddle(M, gTable, gA, dst);
+					if (dst)
+						dst_IV_func1_neon(M, gTable, gB);
+					else
+						dct_IV_func1_neon(M, gTable, gB);
+					CHECK(!memcmp(gA, gB, sizeof(FIXP_DBL) * 2 * M), "pre twiddle M=%d dst=%d", M, dst);
+
+					if (M < 2)
+						continue;
+
+					fillRandom(gA, 2 * M, kInputBits[b]);
+					memcpy(gB, gA, sizeof(FIXP_DBL) * 2 * M);
+					if (dst)
+					{
+						postTwiddleDST(M, gTable, step, gA);
+						dst_IV_func2_neon(M, gTable, step, gB);
+					}
+					else
+					{
+						postTwiddleDCT(M, gTable, step, gA);
+						dct_IV_func2_neon(M, gTable, step, gB);
+					}
+					CHECK(!memcmp(gA, gB, sizeof(FIXP_DBL) * 2 * M), "post twiddle M=%d dst=%d step=%d", M, dst, step);
+				}
+			}
+		}
+	}
+	printf("DCT-IV/DST-IV twiddles checked, %d failures so far\n", gFailures);
+}
+
+static void checkDitFFT()
+{
+	for (int ldn = 2; ldn <= 10; ldn++)
+	{
+		int n = 1 << ldn;
+		for (int rep = 0; rep < 50; rep++)
+		{
+			// Every other run with a random table instead of the real one.
+			const FIXP_STP *table = SineTable512;
+			int tableSize = 512;
+			if (rep & 1)
+			{
+				fillRandom(gTable, 8192);
+				table = gTable;
+				tableSize = ldn > 9 ? 2048 : 512;
+			}
+
+			fillRandom(gA, 2 * n, kInputBits[rep % kInputBitsCount]);
+			memcpy(gB, gA, sizeof(FIXP_DBL) * 2 * n);
+			dit_fft(gA, ldn, table, tableSize);
+			dit_fft_neon(gB, ldn, table, tableSize);
+			CHECK(!memcmp(gA, gB, sizeof(FIXP_DBL) * 2 * n), "dit_fft ldn=%d rep=%d", ldn, rep);
+		}
+	}
+	printf("dit_fft checked, %d failures so far\n", gFailures);
+}
+
+static void checkTransforms()
+{
+	static const int kLengths[] = { 32, 64, 128, 512, 1024, 120, 480, 960 };
+	for (unsigned int l = 0; l < sizeof(kLengths) / sizeof(kLengths[0]); l++)
+	{
+		int L = kLengths[l];
+		for (int rep = 0; rep < 40; rep++)
+		{
+			for (int dst = 0; dst < 2; dst++)
+			{
+				int expA = 0, expB = 0;
+				fillRandom(gA, L, kInputBits[rep % kInputBitsCount]);
+				memcpy(gB, gA, sizeof(FIXP_DBL) * L);
+				if (dst)
+				{
+					ref_dst_IV(gA, L, &expA);
+					dst_IV(gB, L, &expB);
+				}
+				else
+				{
+					ref_dct_IV(gA, L, &expA);
+					dct_IV(gB, L, &expB);
+				}
+				CHECK(expA == expB && !memcmp(gA, gB, sizeof(FIXP_DBL) * L), "%s L=%d", dst ? "dst_IV" : "dct_IV", L);
+			}
+		}
+	}
+
+	static const int kFFTLengths[] = { 64, 256, 512 };
+	for (unsigned int l = 0; l < sizeof(kFFTLengths) / sizeof(kFFTLengths[0]); l++)
+	{
+		int n = kFFTLengths[l];
+		for (int rep = 0; rep < 40; rep++)
+		{
+			int scaleA = 0, scaleB = 0;
+			fillRandom(gA, 2 * n, kInputBits[rep % kInputBitsCount]);
+			memcpy(gB, gA, sizeof(FIXP_DBL) * 2 * n);
+			ref_fft(n, gA, &scaleA);
+			fft(n, gB, &scaleB);
+			CHECK(scaleA == scaleB && !memcmp(gA, gB, sizeof(FIXP_DBL) * 2 * n), "fft %d", n);
+		}
+	}
+	printf("dct_IV, dst_IV, fft checked, %d failures so far\n", gFailures);
+}
+
+static void checkQMF()
+{
+	static FIXP_QAS anaStatesA[10 * 64], anaStatesB[10 * 64];
+	static FIXP_QSS synStatesA[9 * 64], synStatesB[9 * 64];
+	static FIXP_DBL re[64], im[64], reA[64], imA[64], reB[64], imB[64], work[2 * 64];
+	static INT_PCM pcm[64 * 2], outA[64 * 2], outB[64 * 2];
+	static const int kFlags[] = { 0, QMF_FLAG_LP, QMF_FLAG_DOWNSAMPLED };
+
+	for (int channels = 32; channels <= 64; channels += 32)
+	{
+		for (int f = 0; f < 3; f++)
+		{
+			int flags = kFlags[f];
+			QMF_FILTER_BANK anaA, anaB, synA, synB;
+
+			memset(anaStatesA, 0, sizeof(anaStatesA));
+			memset(anaStatesB, 0, sizeof(anaStatesB));
+			memset(synStatesA, 0, sizeof(synStatesA));
+			memset(synStatesB, 0, sizeof(synStatesB));
+			CHECK(ref_qmfInitAnalysisFilterBank(&anaA, anaStatesA, 16, channels, channels, channels, flags) == 0, "analysis init");
+			CHECK(qmfInitAnalysisFilterBank(&anaB, anaStatesB, 16, channels, channels, channels, flags) == 0, "analysis init");
+			CHECK(ref_qmfInitSynthesisFilterBank(&synA, synStatesA, 16, channels, channels, channels, flags) == 0, "synthesis init");
+			CHECK(qmfInitSynthesisFilterBank(&synB, synStatesB, 16, channels, channels, channels, flags) == 0, "synthesis init");
+
+			for (int slot = 0; slot < 400; slot++)
+			{
+				for (int i = 0; i < channels * 2; i++)
+					pcm[i] = (INT_PCM)randomValue(16);
+				ref_qmfAnalysisFilteringSlot(&anaA, reA, imA, pcm, 2, work);
+				qmfAnalysisFilteringSlot(&anaB, reB, imB, pcm, 2, work);
+				CHECK(!memcmp(reA, reB, sizeof(FIXP_DBL) * channels)
+						&& ((flags & QMF_FLAG_LP) || !memcmp(imA, imB, sizeof(FIXP_DBL) * channels)),
+						"analysis channels=%d flags=%d slot=%d", channels, flags, slot);
+				CHECK(!memcmp(anaStatesA, anaStatesB, sizeof(anaStatesA)), "analysis states channels=%d flags=%d slot=%d", channels, flags, slot);
+
+				// Now and then a new output scale and gain, full scale included.
+				if (slot % 50 == 0)
+				{
+					int scale = nextRandom() % 8;
+					FIXP_DBL gain = slot % 100 ? (FIXP_DBL)randomValue(31) : (FIXP_DBL)0x80000000;
+					ref_qmfChangeOutScalefactor(&synA, scale);
+					qmfChangeOutScalefactor(&synB, scale);
+					ref_qmfChangeOutGain(&synA, gain);
+					qmfChangeOutGain(&synB, gain);
+				}
+
+				int bits = 20 + slot % 12;
+				for (int i = 0; i < channels; i++)
+				{
+					re[i] = randomValue(bits);
+					im[i] = randomValue(bits);
+				}
+				int scaleLow = nextRandom() % 4, scaleHigh = nextRandom() % 4;
+				ref_qmfSynthesisFilteringSlot(&synA, re, im, scaleLow, scaleHigh, outA, 2, work);
+				qmfSynthesisFilteringSlot(&synB, re, im, scaleLow, scaleHigh, outB, 2, work);
+				CHECK(!memcmp(outA, outB, sizeof(outA)), "synthesis channels=%d flags=%d slot=%d", channels, flags, slot);
+				CHECK(!memcmp(synStatesA, synStatesB, sizeof(synStatesA)), "synthesis states channels=%d flags=%d slot=%d", channels, flags, slot);
+			}
+		}
+	}
+	printf("QMF banks checked, %d failures so far\n", gFailures);
+}
+
+int main()
+{
+	setvbuf(stdout, NULL, _IONBF, 0);
+
+	if (!FDK_neonAvailable())
+	{
+		printf("NEON isn't available, nothing to check\n");
+		return 1;
+	}
+
+	checkTwiddles();
+	checkDitFFT();
+	checkTransforms();
+	checkQMF();
+
+	printf(gFailures ? "\nFAIL\n" : "\nPASS\n");
+	return gFailures != 0;
+}
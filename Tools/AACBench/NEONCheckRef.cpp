@@ -0,0 +1,26 @@
+// The C filter banks and transforms NEONCheck compares the NEON ones with:
+// qmf.cpp, dct.cpp and fft.cpp built again without HAVE_FDK_NEON, with their
+// entry points renamed so they can sit beside the versions that dispatch to
+// the kernels. dit_fft() is shared; it is what dit_fft_neon() replaces, not
+// anything that dispatches.
+
+#define dct_II ref_dct_II
+#define dct_III ref_dct_III
+#define dct_IV ref_dct_IV
+#define dst_IV ref_dst_IV
+#define fft ref_fft
+#define fft_16 ref_fft_16
+#define fft_32 ref_fft_32
+#define ifft ref_ifft
+#define qmfAnalysisFiltering ref_qmfAnalysisFiltering
+#define qmfAnalysisFilteringSlot ref_qmfAnalysisFilteringSlot
+#define qmfChangeOutGain ref_qmfChangeOutGain
+#define qmfChangeOutScalefactor ref_qmfChangeOutScalefactor
+#define qmfInitAnalysisFilterBank ref_qmfInitAnalysisFilterBank
+#define qmfInitSynthesisFilterBank ref_qmfInitSynthesisFilterBank
+#define qmfSynthesisFiltering ref_qmfSynthesisFiltering
+#define qmfSynthesisFilteringSlot ref_qmfSynthesisFilteringSlot
+
+#include "qmf.cpp"
+#include "dct.cpp"
+#include "fft.cpp"
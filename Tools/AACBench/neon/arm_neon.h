@@ -0,0 +1,273 @@
+// Scalar stand-in for <arm_neon.h>, covering the intrinsics the fdk-aac NEON
+// kernels in libFDK/src/neon use, so they can be built and checked against
+// the C code on a host without NEON. See "make check" in the Makefile.
+//
+// Each intrinsic does what the ARM reference says it does, lane by lane,
+// including vqdmulhq_s32's saturation and the wraparound of the plain adds,
+// subtracts and shifts. Speed is no concern; only the bits matter.
+
+#ifndef AACBENCH_ARM_NEON_H
+#define AACBENCH_ARM_NEON_H
+
+#include <stdint.h>
+
+struct int16x4_t { int16_t v[4]; };
+struct int32x2_t { int32_t v[2]; };
+struct int32x4_t { int32_t v[4]; };
+struct uint32x4_t { uint32_t v[4]; };
+struct int16x4x2_t { int16x4_t val[2]; };
+struct int16x4x4_t { int16x4_t val[4]; };
+struct int32x4x2_t { int32x4_t val[2]; };
+struct int32x4x4_t { int32x4_t val[4]; };
+
+// Loads and stores.
+
+static inline int32x4_t vld1q_s32(const int32_t *p)
+{
+	int32x4_t r;
+	for (int i = 0; i < 4; i++)
+		r.v[i] = p[i];
+	return r;
+}
+
+static inline void vst1q_s32(int32_t *p, int32x4_t a)
+{
+	for (int i = 0; i < 4; i++)
+		p[i] = a.v[i];
+}
+
+static inline int16x4_t vld1_s16(const int16_t *p)
+{
+	int16x4_t r;
+	for (int i = 0; i < 4; i++)
+		r.v[i] = p[i];
+	return r;
+}
+
+static inline int16x4_t vld1_lane_s16(const int16_t *p, int16x4_t a, const int lane)
+{
+	a.v[lane] = *p;
+	return a;
+}
+
+static inline int32x4x2_t vld2q_s32(const int32_t *p)
+{
+	int32x4x2_t r;
+	for (int i = 0; i < 4; i++)
+	{
+		r.val[0].v[i] = p[2 * i];
+		r.val[1].v[i] = p[2 * i + 1];
+	}
+	return r;
+}
+
+static inline void vst2q_s32(int32_t *p, int32x4x2_t a)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		p[2 * i] = a.val[0].v[i];
+		p[2 * i + 1] = a.val[1].v[i];
+	}
+}
+
+static inline int32x4x4_t vld4q_s32(const int32_t *p)
+{
+	int32x4x4_t r;
+	for (int i = 0; i < 4; i++)
+		for (int k = 0; k < 4; k++)
+			r.val[k].v[i] = p[4 * i + k];
+	return r;
+}
+
+static inline void vst4q_s32(int32_t *p, int32x4x4_t a)
+{
+	for (int i = 0; i < 4; i++)
+		for (int k = 0; k < 4; k++)
+			p[4 * i + k] = a.val[k].v[i];
+}
+
+static inline int16x4x4_t vld4_s16(const int16_t *p)
+{
+	int16x4x4_t r;
+	for (int i = 0; i < 4; i++)
+		for (int k = 0; k < 4; k++)
+			r.val[k].v[i] = p[4 * i + k];
+	return r;
+}
+
+static inline int16x4x2_t vld2_dup_s16(const int16_t *p)
+{
+	int16x4x2_t r;
+	for (int i = 0; i < 4; i++)
+	{
+		r.val[0].v[i] = p[0];
+		r.val[1].v[i] = p[1];
+	}
+	return r;
+}
+
+static inline int16x4x2_t vld2_lane_s16(const int16_t *p, int16x4x2_t a, const int lane)
+{
+	a.val[0].v[lane] = p[0];
+	a.val[1].v[lane] = p[1];
+	return a;
+}
+
+// Moving lanes about.
+
+static inline int16x4_t vdup_n_s16(int16_t x)
+{
+	int16x4_t r = {{ x, x, x, x }};
+	return r;
+}
+
+static inline int32x4_t vdupq_n_s32(int32_t x)
+{
+	int32x4_t r = {{ x, x, x, x }};
+	return r;
+}
+
+static inline int32x2_t vget_low_s32(int32x4_t a)
+{
+	int32x2_t r = {{ a.v[0], a.v[1] }};
+	return r;
+}
+
+static inline int32x2_t vget_high_s32(int32x4_t a)
+{
+	int32x2_t r = {{ a.v[2], a.v[3] }};
+	return r;
+}
+
+static inline int32x4_t vcombine_s32(int32x2_t a, int32x2_t b)
+{
+	int32x4_t r = {{ a.v[0], a.v[1], b.v[0], b.v[1] }};
+	return r;
+}
+
+static inline int32_t vgetq_lane_s32(int32x4_t a, const int lane)
+{
+	return a.v[lane];
+}
+
+static inline int32x4_t vrev64q_s32(int32x4_t a)
+{
+	int32x4_t r = {{ a.v[1], a.v[0], a.v[3], a.v[2] }};
+	return r;
+}
+
+static inline int16x4_t vrev64_s16(int16x4_t a)
+{
+	int16x4_t r = {{ a.v[3], a.v[2], a.v[1], a.v[0] }};
+	return r;
+}
+
+static inline int32x4_t vextq_s32(int32x4_t a, int32x4_t b, const int n)
+{
+	int32x4_t r;
+	for (int i = 0; i < 4; i++)
+		r.v[i] = i + n < 4 ? a.v[i + n] : b.v[i + n - 4];
+	return r;
+}
+
+static inline int32x4x2_t vuzpq_s32(int32x4_t a, int32x4_t b)
+{
+	int32x4x2_t r = {{ {{ a.v[0], a.v[2], b.v[0], b.v[2] }}, {{ a.v[1], a.v[3], b.v[1], b.v[3] }} }};
+	return r;
+}
+
+static inline int32x4x2_t vzipq_s32(int32x4_t a, int32x4_t b)
+{
+	int32x4x2_t r = {{ {{ a.v[0], b.v[0], a.v[1], b.v[1] }}, {{ a.v[2], b.v[2], a.v[3], b.v[3] }} }};
+	return r;
+}
+
+static inline uint32x4_t vreinterpretq_u32_s32(int32x4_t a)
+{
+	uint32x4_t r;
+	for (int i = 0; i < 4; i++)
+		r.v[i] = (uint32_t)a.v[i];
+	return r;
+}
+
+static inline int32x4_t vbslq_s32(uint32x4_t m, int32x4_t a, int32x4_t b)
+{
+	int32x4_t r;
+	for (int i = 0; i < 4; i++)
+		r.v[i] = (int32_t)((m.v[i] & (uint32_t)a.v[i]) | (~m.v[i] & (uint32_t)b.v[i]));
+	return r;
+}
+
+// Arithmetic. Everything but vqdmulhq_s32 wraps.
+
+static inline int32x4_t vaddq_s32(int32x4_t a, int32x4_t b)
+{
+	int32x4_t r;
+	for (int i = 0; i < 4; i++)
+		r.v[i] = (int32_t)((uint32_t)a.v[i] + (uint32_t)b.v[i]);
+	return r;
+}
+
+static inline int32x4_t vsubq_s32(int32x4_t a, int32x4_t b)
+{
+	int32x4_t r;
+	for (int i = 0; i < 4; i++)
+		r.v[i] = (int32_t)((uint32_t)a.v[i] - (uint32_t)b.v[i]);
+	return r;
+}
+
+static inline int32x4_t vnegq_s32(int32x4_t a)
+{
+	int32x4_t r;
+	for (int i = 0; i < 4; i++)
+		r.v[i] = (int32_t)(0u - (uint32_t)a.v[i]);
+	return r;
+}
+
+static inline int32x4_t vshrq_n_s32(int32x4_t a, const int n)
+{
+	int32x4_t r;
+	for (int i = 0; i < 4; i++)
+		r.v[i] = a.v[i] >> n;
+	return r;
+}
+
+static inline int32x4_t vshlq_n_s32(int32x4_t a, const int n)
+{
+	int32x4_t r;
+	for (int i = 0; i < 4; i++)
+		r.v[i] = (int32_t)((uint32_t)a.v[i] << n);
+	return r;
+}
+
+static inline int32x4_t vshll_n_s16(int16x4_t a, const int n)
+{
+	int32x4_t r;
+	for (int i = 0; i < 4; i++)
+		r.v[i] = (int32_t)((uint32_t)(int32_t)a.v[i] << n);
+	return r;
+}
+
+static inline int32x4_t vmlal_s16(int32x4_t acc, int16x4_t a, int16x4_t b)
+{
+	for (int i = 0; i < 4; i++)
+		acc.v[i] = (int32_t)((uint32_t)acc.v[i] + (uint32_t)((int32_t)a.v[i] * b.v[i]));
+	return acc;
+}
+
+// Doubling multiply, high half: (2 * a * b) >> 32, saturated. Only
+// INT32_MIN * INT32_MIN overflows.
+static inline int32x4_t vqdmulhq_s32(int32x4_t a, int32x4_t b)
+{
+	int32x4_t r;
+	for (int i = 0; i < 4; i++)
+	{
+		if (a.v[i] == INT32_MIN && b.v[i] == INT32_MIN)
+			r.v[i] = INT32_MAX;
+		else
+			r.v[i] = (int32_t)(((int64_t)a.v[i] * b.v[i]) >> 31);
+	}
+	return r;
+}
+
+#endif
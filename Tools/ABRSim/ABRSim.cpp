@@ -0,0 +1,367 @@
+// Replays bandwidth traces against a bitrate ladder through ABREngine, the
+// way HLSPlayer drives it, and reports how each ABR mode fares.
+//
+// The player model follows the device: segments are fetched one at a time
+// while BufferController's hysteresis says to fill (below the low
+// watermark, until the high one), each download's size and time go to
+// ABREngine::AddSample, and the next level is picked with the buffer level
+// at the time of the request. Playback starts once the first segment is in
+// and stalls whenever the buffer runs dry.
+//
+// A trace is a text file of "<time> <bandwidth>" lines: bandwidth holds
+// from its time to the next line's, and the trace loops once it runs out.
+// Bandwidth is in kbit/s, or Mbit/s with -mbps (the Pensieve / FCC cooked
+// trace format). Lines starting with # are skipped.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "ABREngine.h"
+
+struct Trace
+{
+	std::string name;
+	std::vector<double> times;
+	std::vector<double> bitsPerSecond;
+	double period;
+};
+
+struct Options
+{
+	std::vector<int> ladder;
+	double segmentSeconds;
+	double mediaSeconds;
+	double lowSeconds;
+	double highSeconds;
+	double rttSeconds;
+	int startQuality;
+	bool mbps;
+	bool verbose;
+	int mode;			// -1 for all of them
+};
+
+struct Result
+{
+	double stallSeconds;
+	int stallCount;
+	double startupSeconds;
+	double averageBitrate;
+	int switches;
+	int segments;
+};
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage: ABRSim (-m master.m3u8 | -l kbps,kbps,...) [options] trace...\n"
+		"  -d seconds     segment duration (10)\n"
+		"  -t seconds     media length (the trace length, at least 300)\n"
+		"  -w low,high    buffer watermarks in seconds (20,30)\n"
+		"  -rtt ms        request latency added to every download (100)\n"
+		"  -q level       starting quality level (0)\n"
+		"  -a mode        throughput, bola or dynamic (all of them)\n"
+		"  -mbps          trace bandwidth is in Mbit/s rather than kbit/s\n"
+		"  -v             print every segment\n");
+	exit(1);
+}
+
+static bool readTrace(const char *path, bool mbps, Trace *trace)
+{
+	FILE *f = fopen(path, "r");
+	if (f == NULL)
+		return false;
+
+	const char *slash = strrchr(path, '/');
+	trace->name = slash ? slash + 1 : path;
+
+	char line[256];
+	while (fgets(line, sizeof(line), f))
+	{
+		if (line[0] == '#')
+			continue;
+
+		double t, bw;
+		if (sscanf(line, "%lf %lf", &t, &bw) != 2)
+			continue;
+		if (!trace->times.empty() && t <= trace->times.back())
+			continue;
+
+		trace->times.push_back(t);
+		trace->bitsPerSecond.push_back(bw * (mbps ? 1e6 : 1e3));
+	}
+	fclose(f);
+
+	if (trace->times.size() < 2)
+		return false;
+
+	// The last line only marks where the one before it ends.
+	trace->period = trace->times.back() - trace->times.front();
+	trace->times.pop_back();
+	trace->bitsPerSecond.pop_back();
+	return true;
+}
+
+// Same as ManifestParser: every EXT-X-STREAM-INF BANDWIDTH, ascending.
+static bool readLadder(const char *path, std::vector<int> *ladder)
+{
+	FILE *f = fopen(path, "r");
+	if (f == NULL)
+		return false;
+
+	char line[4096];
+	while (fgets(line, sizeof(line), f))
+	{
+		if (strncmp(line, "#EXT-X-STREAM-INF:", 18))
+			continue;
+
+		const char *bw = strstr(line, "BANDWIDTH=");
+		if (bw && (bw == line + 18 || bw[-1] == ',' || bw[-1] == ':'))
+			ladder->push_back(atoi(bw + 10));
+	}
+	fclose(f);
+
+	std::sort(ladder->begin(), ladder->end());
+	return !ladder->empty();
+}
+
+static void parseList(const char *s, std::vector<int> *out, int scale)
+{
+	while (*s)
+	{
+		out->push_back((int)(atof(s) * scale));
+		const char *comma = strchr(s, ',');
+		if (comma == NULL)
+			break;
+		s = comma + 1;
+	}
+}
+
+// Seconds it takes to download bytes starting at time t.
+static double downloadTime(const Trace &trace, double t, double bytes)
+{
+	double bits = bytes * 8.0;
+	double start = t;
+
+	double offset = fmod(t - trace.times[0], trace.period);
+	size_t i = std::upper_bound(trace.times.begin(), trace.times.end(), trace.times[0] + offset) - trace.times.begin() - 1;
+
+	for (;;)
+	{
+		double end = (i + 1 < trace.times.size() ? trace.times[i + 1] : trace.times[0] + trace.period) - trace.times[0];
+		double span = end - offset;
+		double rate = trace.bitsPerSecond[i];
+
+		if (rate * span >= bits)
+			return t + (rate > 0 ? bits / rate : 0) - start;
+
+		bits -= rate * span;
+		t += span;
+		offset = end;
+		if (++i == trace.times.size())
+		{
+			i = 0;
+			offset = 0;
+		}
+	}
+}
+
+static Result simulate(const Options &opt, const Trace &trace, ABREngine::Mode mode)
+{
+	ABREngine engine;
+	engine.SetLadder(&opt.ladder[0], (int)opt.ladder.size());
+	engine.SetBufferTarget(opt.highSeconds);
+	engine.SetMode(mode);
+
+	Result r;
+	memset(&r, 0, sizeof(r));
+
+	int count = (int)ceil(opt.mediaSeconds / opt.segmentSeconds);
+	double t = 0;
+	double buffer = 0;
+	bool playing = false;
+	bool filling = true;
+	int quality = opt.startQuality;
+	double bitrateSum = 0;
+
+	for (int seg = 0; seg < count; ++seg)
+	{
+		// Wait for the buffer to drain to the low watermark.
+		if (!filling)
+		{
+			t += buffer - opt.lowSeconds;
+			buffer = opt.lowSeconds;
+			filling = true;
+		}
+
+		int next = engine.SelectQuality(quality, playing ? buffer : -1);
+		if (seg > 0 && next != quality)
+			++r.switches;
+		quality = next;
+
+		double bytes = opt.ladder[quality] / 8.0 * opt.segmentSeconds;
+		double dt = opt.rttSeconds + downloadTime(trace, t + opt.rttSeconds, bytes);
+
+		if (playing)
+		{
+			if (dt > buffer)
+			{
+				r.stallSeconds += dt - buffer;
+				++r.stallCount;
+				buffer = 0;
+			}
+			else
+			{
+				buffer -= dt;
+			}
+		}
+
+		t += dt;
+		engine.AddSample((int64_t)bytes, dt - opt.rttSeconds);
+
+		buffer += opt.segmentSeconds;
+		bitrateSum += opt.ladder[quality];
+
+		if (!playing)
+		{
+			playing = true;
+			r.startupSeconds = t;
+		}
+
+		if (buffer >= opt.highSeconds)
+			filling = false;
+
+		if (opt.verbose)
+			printf("  %-10s seg %4d  t %8.2f  q %d  %5.0f kbps  dl %6.2f s  buffer %6.2f s  est %6.0f kbps\n",
+					ABREngine::GetModeName(mode), seg, t, quality, opt.ladder[quality] / 1e3, dt, buffer,
+					engine.GetThroughput() / 1e3);
+	}
+
+	r.segments = count;
+	r.averageBitrate = bitrateSum / count;
+	return r;
+}
+
+int main(int argc, char **argv)
+{
+	Options opt;
+	opt.segmentSeconds = 10;
+	opt.mediaSeconds = 0;
+	opt.lowSeconds = 20;
+	opt.highSeconds = 30;
+	opt.rttSeconds = 0.1;
+	opt.startQuality = 0;
+	opt.mbps = false;
+	opt.verbose = false;
+	opt.mode = -1;
+
+	std::vector<const char *> tracePaths;
+	for (int i = 1; i < argc; ++i)
+	{
+		const char *arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (!strcmp(arg, "-m") && hasValue)
+		{
+			if (!readLadder(argv[++i], &opt.ladder))
+			{
+				fprintf(stderr, "No BANDWIDTH entries in %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (!strcmp(arg, "-l") && hasValue)
+			parseList(argv[++i], &opt.ladder, 1000);
+		else if (!strcmp(arg, "-d") && hasValue)
+			opt.segmentSeconds = atof(argv[++i]);
+		else if (!strcmp(arg, "-t") && hasValue)
+			opt.mediaSeconds = atof(argv[++i]);
+		else if (!strcmp(arg, "-w") && hasValue)
+		{
+			std::vector<int> w;
+			parseList(argv[++i], &w, 1000);
+			if (w.size() != 2 || w[0] > w[1])
+				usage();
+			opt.lowSeconds = w[0] / 1000.0;
+			opt.highSeconds = w[1] / 1000.0;
+		}
+		else if (!strcmp(arg, "-rtt") && hasValue)
+			opt.rttSeconds = atof(argv[++i]) / 1000.0;
+		else if (!strcmp(arg, "-q") && hasValue)
+			opt.startQuality = atoi(argv[++i]);
+		else if (!strcmp(arg, "-a") && hasValue)
+		{
+			const char *name = argv[++i];
+			for (int m = 0; m < ABREngine::MODE_COUNT; ++m)
+			{
+				if (!strcmp(name, ABREngine::GetModeName((ABREngine::Mode)m)))
+					opt.mode = m;
+			}
+			if (opt.mode < 0)
+				usage();
+		}
+		else if (!strcmp(arg, "-mbps"))
+			opt.mbps = true;
+		else if (!strcmp(arg, "-v"))
+			opt.verbose = true;
+		else if (arg[0] == '-')
+			usage();
+		else
+			tracePaths.push_back(arg);
+	}
+
+	if (opt.ladder.empty() || tracePaths.empty() || opt.segmentSeconds <= 0)
+		usage();
+	if (opt.startQuality < 0 || opt.startQuality >= (int)opt.ladder.size())
+		opt.startQuality = 0;
+
+	printf("ladder (kbps):");
+	for (size_t i = 0; i < opt.ladder.size(); ++i)
+		printf(" %d", opt.ladder[i] / 1000);
+	printf("\nsegments %.1f s, watermarks %.0f / %.0f s, rtt %.0f ms\n\n",
+			opt.segmentSeconds, opt.lowSeconds, opt.highSeconds, opt.rttSeconds * 1000);
+
+	printf("%-24s %-10s %9s %8s %7s %9s %10s %8s\n",
+			"trace", "mode", "rebuffer", "stalls", "startup", "avg kbps", "trace kbps", "switches");
+
+	for (size_t i = 0; i < tracePaths.size(); ++i)
+	{
+		Trace trace;
+		if (!readTrace(tracePaths[i], opt.mbps, &trace))
+		{
+			fprintf(stderr, "Couldn't read a trace from %s\n", tracePaths[i]);
+			continue;
+		}
+
+		double traceAverage = 0;
+		for (size_t j = 0; j < trace.times.size(); ++j)
+		{
+			double end = j + 1 < trace.times.size() ? trace.times[j + 1] : trace.times[0] + trace.period;
+			traceAverage += trace.bitsPerSecond[j] * (end - trace.times[j]);
+		}
+		traceAverage /= trace.period;
+
+		Options run = opt;
+		if (run.mediaSeconds <= 0)
+			run.mediaSeconds = trace.period > 300 ? trace.period : 300;
+
+		for (int m = 0; m < ABREngine::MODE_COUNT; ++m)
+		{
+			if (opt.mode >= 0 && m != opt.mode)
+				continue;
+
+			Result r = simulate(run, trace, (ABREngine::Mode)m);
+			double ratio = r.stallSeconds / (r.segments * run.segmentSeconds + r.stallSeconds);
+
+			printf("%-24s %-10s %8.2f%% %8d %6.1fs %9.0f %10.0f %8d\n",
+					trace.name.c_str(), ABREngine::GetModeName((ABREngine::Mode)m), ratio * 100.0,
+					r.stallCount, r.startupSeconds, r.averageBitrate / 1e3, traceAverage / 1e3, r.switches);
+		}
+	}
+
+	return 0;
+}
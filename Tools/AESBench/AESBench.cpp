@@ -0,0 +1,144 @@
+// Measures AES-128-CBC decrypt throughput of each AESDecrypt back end the
+// host supports, next to the aes.c path SegmentCacheItem.decrypt used to
+// take (decrypt into a temporary buffer, then copy back).
+//
+// Each back end is first checked against aes.c, both over a whole segment
+// and over the same segment fed in uneven chunks the way the Java cache
+// advances its decrypt high water mark.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "AESDecrypt.h"
+#include "aes.h"
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void fillRandom(unsigned char *p, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+		p[i] = (unsigned char)(rand() >> 7);
+}
+
+static void legacyDecrypt(const unsigned char *key, const unsigned char *iv, unsigned char *data, size_t length)
+{
+	AesCtx ctx;
+	AesCtxIni(&ctx, (unsigned char *)iv, (unsigned char *)key, KEY128, CBC);
+
+	unsigned char *tmp = (unsigned char *)malloc(length);
+	AesDecrypt(&ctx, data, tmp, length);
+	memcpy(data, tmp, length);
+	free(tmp);
+}
+
+static bool verify(AESDecrypt::Backend backend, const unsigned char *key, const unsigned char *iv,
+		const std::vector<unsigned char> &cipher, const std::vector<unsigned char> &plain)
+{
+	std::vector<unsigned char> work(cipher);
+	AESDecrypt whole(key, iv, backend);
+	whole.decryptFromStart(&work[0], work.size());
+	if (work != plain)
+	{
+		printf("  %s: whole segment mismatch\n", AESDecrypt::getBackendName(backend));
+		return false;
+	}
+
+	// Uneven, block aligned steps, including single blocks and runs that
+	// don't divide by the four block stride of the hardware paths.
+	static const size_t kSteps[] = { 16, 48, 188 * 16, 80, 4096, 112, 65536 };
+	work = cipher;
+	AESDecrypt chained(key, iv, backend);
+	size_t offset = 0;
+	for (int i = 0; offset < work.size(); ++i)
+	{
+		size_t step = kSteps[i % (sizeof(kSteps) / sizeof(kSteps[0]))];
+		if (offset + step > work.size())
+			step = work.size() - offset;
+		chained.decrypt(&work[offset], step);
+		offset += step;
+	}
+	if (work != plain)
+	{
+		printf("  %s: chained decrypt mismatch\n", AESDecrypt::getBackendName(backend));
+		return false;
+	}
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	size_t megabytes = 2;
+	int iterations = 50;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-s") && i + 1 < argc)
+			megabytes = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			iterations = atoi(argv[++i]);
+		else
+		{
+			fprintf(stderr, "usage: %s [-s megabytes] [-n iterations]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	size_t length = megabytes * 1024 * 1024;
+	unsigned char key[16], iv[16];
+	srand(1234);
+	fillRandom(key, sizeof(key));
+	fillRandom(iv, sizeof(iv));
+
+	std::vector<unsigned char> cipher(length);
+	fillRandom(&cipher[0], length);
+
+	std::vector<unsigned char> plain(cipher);
+	legacyDecrypt(key, iv, &plain[0], length);
+
+	printf("AES-128-CBC decrypt, %u MB x %d\n", (unsigned)megabytes, iterations);
+
+	std::vector<unsigned char> work(cipher);
+	double start = now();
+	for (int i = 0; i < iterations; ++i)
+		legacyDecrypt(key, iv, &work[0], length);
+	double elapsed = now() - start;
+	printf("  %-8s %8.1f MB/s\n", "aes.c", megabytes * iterations / elapsed);
+
+	int failures = 0;
+	for (int b = 0; b < AESDecrypt::BACKEND_COUNT; ++b)
+	{
+		AESDecrypt::Backend backend = (AESDecrypt::Backend)b;
+		const char *name = AESDecrypt::getBackendName(backend);
+		if (!AESDecrypt::isSupported(backend))
+		{
+			printf("  %-8s      n/a\n", name);
+			continue;
+		}
+
+		if (!verify(backend, key, iv, cipher, plain))
+		{
+			++failures;
+			continue;
+		}
+
+		AESDecrypt aes(key, iv, backend);
+		start = now();
+		for (int i = 0; i < iterations; ++i)
+			aes.decryptFromStart(&work[0], length);
+		elapsed = now() - start;
+		printf("  %-8s %8.1f MB/s%s\n", name, megabytes * iterations / elapsed,
+				backend == AESDecrypt::getBestBackend() ? "  (selected)" : "");
+	}
+
+	return failures ? 1 : 0;
+}
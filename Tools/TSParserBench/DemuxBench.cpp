@@ -0,0 +1,369 @@
+// Demuxes a directory of .ts segments through HLSDataSource, ATSParser and
+// AnotherPacketSource the way MPEG2TSExtractor and the decoder threads do on
+// device, and reports packets/s, access units/s, bytes copied and
+// allocations per segment.
+//
+// Segments are appended to a single file-backed HLSDataSource in name order
+// and read through a 64KB window, 16 packets per ATSParser::feedTSPackets
+// call and resyncing over the rest of the window, like
+// MPEG2TSExtractor::feedMore (-packet feeds them one at a time through
+// feedTSPacket instead). Access units are pulled with
+// AnotherPacketSource::read and released straight away, standing in for the
+// codec.
+//
+// Copies and allocations are counted by wrapping memcpy/memmove/malloc/
+// calloc/realloc at link time (see the Makefile) and replacing operator new.
+// Copies the compiler inlines (small constant sizes) are not seen.
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include <algorithm>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "ATSParser.h"
+#include "AnotherPacketSource.h"
+
+using namespace android;
+
+static uint64_t gBytesCopied = 0;
+static uint64_t gAllocations = 0;
+
+extern "C" {
+
+void *__real_memcpy(void *dst, const void *src, size_t n);
+void *__real_memmove(void *dst, const void *src, size_t n);
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_memcpy(void *dst, const void *src, size_t n)
+{
+	gBytesCopied += n;
+	return __real_memcpy(dst, src, n);
+}
+
+void *__wrap_memmove(void *dst, const void *src, size_t n)
+{
+	gBytesCopied += n;
+	return __real_memmove(dst, src, n);
+}
+
+void *__wrap_malloc(size_t size)
+{
+	++gAllocations;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+	++gAllocations;
+	return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	++gAllocations;
+	return __real_realloc(ptr, size);
+}
+
+}
+
+void *operator new(size_t size) throw(std::bad_alloc)
+{
+	++gAllocations;
+	void *p = __real_malloc(size ? size : 1);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](size_t size) throw(std::bad_alloc)
+{
+	return operator new(size);
+}
+
+void operator delete(void *p) throw()
+{
+	free(p);
+}
+
+void operator delete[](void *p) throw()
+{
+	free(p);
+}
+
+static const size_t kTSPacketSize = 188;
+static const size_t kWindowSize = (65536 / kTSPacketSize) * kTSPacketSize;
+static const size_t kPacketsPerFeed = 16;
+
+static bool gFeedPackets = false;
+
+struct SegmentStats
+{
+	uint64_t packets;
+	uint64_t accessUnits;
+	uint64_t accessUnitBytes;
+	uint64_t bytesCopied;
+	uint64_t allocations;
+};
+
+struct Demuxer
+{
+	sp<ATSParser> parser;
+	sp<AnotherPacketSource> sources[ATSParser::NUM_SOURCE_TYPES];
+	uint64_t accessUnits;
+	uint64_t accessUnitBytes;
+
+	Demuxer()
+	: parser(new ATSParser(ATSParser::TS_TIMESTAMPS_ARE_ABSOLUTE)),
+	  accessUnits(0), accessUnitBytes(0)
+	{
+	}
+
+	// Pull everything the parser has queued, as the decoder threads would.
+	void drain()
+	{
+		for (int i = 0; i < ATSParser::NUM_SOURCE_TYPES; ++i)
+		{
+			if (sources[i] == NULL)
+			{
+				sources[i] = parser->getSource((ATSParser::SourceType)i);
+				if (sources[i] == NULL)
+					continue;
+			}
+
+			status_t finalResult;
+			while (sources[i]->hasBufferAvailable(&finalResult))
+			{
+				MediaBuffer *buffer = NULL;
+				status_t err = sources[i]->read(&buffer);
+				if (err == INFO_DISCONTINUITY)
+					continue;
+				if (err != OK)
+					break;
+
+				++accessUnits;
+				accessUnitBytes += buffer->range_length();
+				buffer->release();
+			}
+		}
+	}
+};
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool listSegments(const char *dir, std::vector<std::string> *out)
+{
+	DIR *d = opendir(dir);
+	if (d == NULL)
+		return false;
+
+	struct dirent *entry;
+	while ((entry = readdir(d)) != NULL)
+	{
+		size_t len = strlen(entry->d_name);
+		if (len > 3 && !strcmp(entry->d_name + len - 3, ".ts"))
+			out->push_back(std::string(dir) + "/" + entry->d_name);
+	}
+	closedir(d);
+
+	std::sort(out->begin(), out->end());
+	return true;
+}
+
+// One pass over all segments, filling in stats for each of them.
+static void demux(const std::vector<std::string> &segments, const std::vector<off64_t> &ends, std::vector<SegmentStats> *stats)
+{
+	sp<HLSDataSource> source = new HLSDataSource();
+	for (size_t i = 0; i < segments.size(); ++i)
+		source->append(segments[i].c_str(), 0, 0, 0.0, -1);
+
+	std::vector<uint8_t> window(kWindowSize);
+	Demuxer demuxer;
+
+	size_t segment = 0;
+	SegmentStats current;
+	memset(&current, 0, sizeof(current));
+	uint64_t copiedAtStart = gBytesCopied;
+	uint64_t allocationsAtStart = gAllocations;
+	uint64_t accessUnitsAtStart = 0;
+	uint64_t accessUnitBytesAtStart = 0;
+
+	off64_t offset = 0;
+	for (;;)
+	{
+		ssize_t n = source->readAt(offset, &window[0], kWindowSize);
+		if (n < (ssize_t)kTSPacketSize)
+			break;
+
+		// Out of sync the parser gets the rest of the window, and stops on a
+		// sync byte it can't check before the window ends; the window is
+		// then refilled from there.
+		bool atEnd = n < (ssize_t)kWindowSize;
+		bool needsMore = false;
+		size_t i = 0;
+		while (!needsMore && i + kTSPacketSize <= (size_t)n)
+		{
+			size_t consumed = kTSPacketSize;
+			if (gFeedPackets)
+				demuxer.parser->feedTSPacket(&window[i], kTSPacketSize);
+			else
+			{
+				size_t left = (size_t)n - i;
+				size_t size = left;
+				if (window[i] == 0x47 && size > kPacketsPerFeed * kTSPacketSize)
+					size = kPacketsPerFeed * kTSPacketSize;
+				demuxer.parser->feedTSPackets(&window[i], size, &consumed, size < left || !atEnd);
+				needsMore = size == left && size - consumed >= kTSPacketSize;
+			}
+
+			demuxer.drain();
+			current.packets += consumed / kTSPacketSize;
+			i += consumed;
+			offset += consumed;
+
+			if (segment < ends.size() && offset >= ends[segment])
+			{
+				current.accessUnits = demuxer.accessUnits - accessUnitsAtStart;
+				current.accessUnitBytes = demuxer.accessUnitBytes - accessUnitBytesAtStart;
+				current.bytesCopied = gBytesCopied - copiedAtStart;
+				current.allocations = gAllocations - allocationsAtStart;
+				(*stats)[segment++] = current;
+
+				memset(&current, 0, sizeof(current));
+				accessUnitsAtStart = demuxer.accessUnits;
+				accessUnitBytesAtStart = demuxer.accessUnitBytes;
+				copiedAtStart = gBytesCopied;
+				allocationsAtStart = gAllocations;
+			}
+		}
+	}
+
+	demuxer.parser->signalEOS(ERROR_END_OF_STREAM);
+	demuxer.drain();
+	if (segment > 0)
+	{
+		SegmentStats &last = (*stats)[segment - 1];
+		last.accessUnits += demuxer.accessUnits - accessUnitsAtStart;
+		last.accessUnitBytes += demuxer.accessUnitBytes - accessUnitBytesAtStart;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	const char *dir = NULL;
+	int iterations = 1;
+	bool verbose = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-copy"))
+			gMediaBufferCanWrap = false;
+		else if (!strcmp(argv[i], "-packet"))
+			gFeedPackets = true;
+		else if (!strcmp(argv[i], "-v"))
+			verbose = true;
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			iterations = atoi(argv[++i]);
+		else
+			dir = argv[i];
+	}
+
+	if (dir == NULL || iterations < 1)
+	{
+		fprintf(stderr, "usage: %s [-copy] [-packet] [-v] [-n iterations] segment_dir\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<std::string> segments;
+	if (!listSegments(dir, &segments) || segments.empty())
+	{
+		fprintf(stderr, "No .ts segments in %s\n", dir);
+		return 1;
+	}
+
+	std::vector<off64_t> ends;
+	off64_t totalBytes = 0;
+	for (size_t i = 0; i < segments.size(); ++i)
+	{
+		struct stat st;
+		if (stat(segments[i].c_str(), &st) != 0)
+		{
+			fprintf(stderr, "Could not stat %s\n", segments[i].c_str());
+			return 1;
+		}
+		totalBytes += st.st_size;
+		ends.push_back(totalBytes);
+	}
+
+	std::vector<SegmentStats> stats(segments.size());
+	std::vector<SegmentStats> totals(segments.size());
+	memset(&totals[0], 0, totals.size() * sizeof(SegmentStats));
+
+	double elapsed = 0;
+	for (int i = 0; i < iterations; ++i)
+	{
+		memset(&stats[0], 0, stats.size() * sizeof(SegmentStats));
+
+		double start = now();
+		demux(segments, ends, &stats);
+		elapsed += now() - start;
+
+		for (size_t j = 0; j < stats.size(); ++j)
+		{
+			totals[j].packets += stats[j].packets;
+			totals[j].accessUnits += stats[j].accessUnits;
+			totals[j].accessUnitBytes += stats[j].accessUnitBytes;
+			totals[j].bytesCopied += stats[j].bytesCopied;
+			totals[j].allocations += stats[j].allocations;
+		}
+	}
+
+	SegmentStats sum;
+	memset(&sum, 0, sizeof(sum));
+	if (verbose)
+		printf("%-32s %9s %7s %12s %12s %9s\n", "segment", "packets", "AUs", "AU bytes", "copied", "allocs");
+	for (size_t j = 0; j < totals.size(); ++j)
+	{
+		const SegmentStats &s = totals[j];
+		if (verbose)
+		{
+			const char *name = strrchr(segments[j].c_str(), '/') + 1;
+			printf("%-32s %9llu %7llu %12llu %12llu %9llu\n", name,
+					(unsigned long long)s.packets / iterations,
+					(unsigned long long)s.accessUnits / iterations,
+					(unsigned long long)s.accessUnitBytes / iterations,
+					(unsigned long long)s.bytesCopied / iterations,
+					(unsigned long long)s.allocations / iterations);
+		}
+		sum.packets += s.packets;
+		sum.accessUnits += s.accessUnits;
+		sum.accessUnitBytes += s.accessUnitBytes;
+		sum.bytesCopied += s.bytesCopied;
+		sum.allocations += s.allocations;
+	}
+
+	double perSegment = (double)iterations * segments.size();
+	printf("%zu segments, %.2f MB, %d iterations, %s access units, %.3f s\n",
+			segments.size(), totalBytes / (1024.0 * 1024.0), iterations,
+			gMediaBufferCanWrap ? "wrapped" : "copied", elapsed);
+	printf("  %12.0f packets/s\n", sum.packets / elapsed);
+	printf("  %12.0f access units/s\n", sum.accessUnits / elapsed);
+	printf("  %12.1f MB/s\n", (double)totalBytes * iterations / (1024.0 * 1024.0) / elapsed);
+	printf("  %12.0f bytes copied per segment (%.2fx the segment size)\n",
+			sum.bytesCopied / perSegment, (double)sum.bytesCopied / ((double)totalBytes * iterations));
+	printf("  %12.0f allocations per segment\n", sum.allocations / perSegment);
+	return 0;
+}
@@ -0,0 +1,247 @@
+// Replays the H.264 and AAC elementary streams of a captured TS segment
+// through ElementaryStreamQueue and reports the throughput of each mode.
+//
+// The segment is demuxed into PES payloads up front (PAT/PMT are parsed to
+// find the first AVC and ADTS streams), so the timed loop only measures
+// appendData() and dequeueAccessUnit().
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "ESQueue.h"
+#include "ABuffer.h"
+
+using namespace android;
+
+struct PESPayload
+{
+	std::vector<uint8_t> data;
+	int64_t timeUs;
+};
+
+struct ElementaryStream
+{
+	int pid;
+	std::vector<uint8_t> pending;	// PES packet being reassembled.
+	std::vector<PESPayload> payloads;
+	size_t bytes;
+};
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool readFile(const char *path, std::vector<uint8_t> *out)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f)
+		return false;
+
+	uint8_t chunk[65536];
+	size_t n;
+	while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+		out->insert(out->end(), chunk, chunk + n);
+
+	fclose(f);
+	return true;
+}
+
+// Strips the PES header off a complete PES packet and queues the payload.
+static void flushPES(ElementaryStream *es)
+{
+	const std::vector<uint8_t> &pes = es->pending;
+	if (pes.size() < 9 || pes[0] != 0 || pes[1] != 0 || pes[2] != 1)
+	{
+		es->pending.clear();
+		return;
+	}
+
+	size_t headerLength = 9 + pes[8];
+	if (headerLength > pes.size())
+	{
+		es->pending.clear();
+		return;
+	}
+
+	int64_t timeUs = -1;
+	if ((pes[7] & 0x80) && pes.size() >= 14)
+	{
+		uint64_t PTS = ((uint64_t)(pes[9] & 0x0e) << 29)
+				| (pes[10] << 22) | ((pes[11] & 0xfe) << 14)
+				| (pes[12] << 7) | (pes[13] >> 1);
+		timeUs = (PTS * 100) / 9;
+	}
+
+	// Payloads without their own PTS belong to the previous one.
+	if (timeUs < 0 && !es->payloads.empty())
+		timeUs = es->payloads.back().timeUs;
+
+	if (timeUs >= 0 && headerLength < pes.size())
+	{
+		es->payloads.push_back(PESPayload());
+		es->payloads.back().data.assign(pes.begin() + headerLength, pes.end());
+		es->payloads.back().timeUs = timeUs;
+		es->bytes += pes.size() - headerLength;
+	}
+
+	es->pending.clear();
+}
+
+static bool demux(const std::vector<uint8_t> &ts, ElementaryStream *video, ElementaryStream *audio)
+{
+	int pmtPid = -1;
+
+	for (size_t offset = 0; offset + 188 <= ts.size(); offset += 188)
+	{
+		const uint8_t *packet = &ts[offset];
+		if (packet[0] != 0x47)
+		{
+			fprintf(stderr, "Lost sync at offset %zu\n", offset);
+			return false;
+		}
+
+		bool payloadUnitStart = (packet[1] & 0x40) != 0;
+		int pid = ((packet[1] & 0x1f) << 8) | packet[2];
+		unsigned adaptationFieldControl = (packet[3] >> 4) & 3;
+
+		size_t start = 4;
+		if (adaptationFieldControl & 2)
+			start += 1 + packet[4];
+		if (!(adaptationFieldControl & 1) || start >= 188)
+			continue;
+
+		const uint8_t *payload = packet + start;
+		size_t payloadSize = 188 - start;
+
+		if ((pid == 0 || pid == pmtPid) && payloadUnitStart)
+		{
+			// Skip the pointer field, assume the section fits in the packet.
+			size_t pointer = payload[0];
+			if (1 + pointer + 12 > payloadSize)
+				continue;
+			const uint8_t *section = payload + 1 + pointer;
+			size_t sectionEnd = 3 + (((section[1] & 0x0f) << 8) | section[2]);
+			if (sectionEnd > payloadSize - 1 - pointer)
+				sectionEnd = payloadSize - 1 - pointer;
+
+			if (pid == 0)
+			{
+				for (size_t i = 8; i + 4 <= sectionEnd - 4; i += 4)
+				{
+					unsigned program = (section[i] << 8) | section[i + 1];
+					if (program != 0)
+					{
+						pmtPid = ((section[i + 2] & 0x1f) << 8) | section[i + 3];
+						break;
+					}
+				}
+			}
+			else
+			{
+				size_t i = 12 + (((section[10] & 0x0f) << 8) | section[11]);
+				while (i + 5 <= sectionEnd - 4)
+				{
+					unsigned streamType = section[i];
+					int esPid = ((section[i + 1] & 0x1f) << 8) | section[i + 2];
+					if (streamType == 0x1b && video->pid < 0)
+						video->pid = esPid;
+					else if (streamType == 0x0f && audio->pid < 0)
+						audio->pid = esPid;
+					i += 5 + (((section[i + 3] & 0x0f) << 8) | section[i + 4]);
+				}
+			}
+			continue;
+		}
+
+		ElementaryStream *es = NULL;
+		if (pid == video->pid)
+			es = video;
+		else if (pid == audio->pid)
+			es = audio;
+		if (es == NULL)
+			continue;
+
+		if (payloadUnitStart)
+			flushPES(es);
+		es->pending.insert(es->pending.end(), payload, payload + payloadSize);
+	}
+
+	flushPES(video);
+	flushPES(audio);
+	return true;
+}
+
+static void run(const char *name, ElementaryStreamQueue::Mode mode, const ElementaryStream &es, int iterations)
+{
+	if (es.payloads.empty())
+	{
+		printf("%-5s no stream found\n", name);
+		return;
+	}
+
+	size_t accessUnits = 0;
+	size_t accessUnitBytes = 0;
+
+	double start = now();
+	for (int i = 0; i < iterations; ++i)
+	{
+		ElementaryStreamQueue queue(mode);
+		for (size_t j = 0; j < es.payloads.size(); ++j)
+		{
+			const PESPayload &p = es.payloads[j];
+			if (queue.appendData(&p.data[0], p.data.size(), p.timeUs) != OK)
+				continue;
+
+			sp<ABuffer> accessUnit;
+			while ((accessUnit = queue.dequeueAccessUnit()) != NULL)
+			{
+				++accessUnits;
+				accessUnitBytes += accessUnit->size();
+			}
+		}
+	}
+	double elapsed = now() - start;
+
+	double mb = (double)es.bytes * iterations / (1024.0 * 1024.0);
+	printf("%-5s %6zu PES %8.2f MB in %7.3f s  %8.1f MB/s  %zu AUs (%zu bytes) per pass\n",
+			name, es.payloads.size(), mb, elapsed, mb / elapsed,
+			accessUnits / iterations, accessUnitBytes / iterations);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		fprintf(stderr, "usage: %s segment.ts [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	int iterations = argc > 2 ? atoi(argv[2]) : 50;
+	if (iterations < 1)
+		iterations = 1;
+
+	std::vector<uint8_t> ts;
+	if (!readFile(argv[1], &ts))
+	{
+		fprintf(stderr, "Could not read %s\n", argv[1]);
+		return 1;
+	}
+
+	ElementaryStream video = { -1 };
+	ElementaryStream audio = { -1 };
+	video.bytes = audio.bytes = 0;
+	if (!demux(ts, &video, &audio))
+		return 1;
+
+	printf("%s: %zu bytes, %d iterations\n", argv[1], ts.size(), iterations);
+	run("H264", ElementaryStreamQueue::H264, video, iterations);
+	run("AAC", ElementaryStreamQueue::AAC, audio, iterations);
+	return 0;
+}
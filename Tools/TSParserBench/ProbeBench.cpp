@@ -0,0 +1,273 @@
+// Compares SegmentProbe against a full demux of each segment in a directory:
+// checks the probe finds the same first and last PTS and IDR presence as
+// the access units the parser produces, and times both.
+//
+// The full demux stands in for what segment start time discovery used to
+// cost (the Java M2TSParser went through the whole TS layer as well).
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "ATSParser.h"
+#include "AnotherPacketSource.h"
+#include "SegmentProbe.h"
+
+using namespace android;
+
+static const size_t kTSPacketSize = 188;
+
+struct StreamTimes
+{
+	bool present;
+	int64_t firstUs;
+	int64_t lastUs;
+};
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool listSegments(const char *dir, std::vector<std::string> *out)
+{
+	DIR *d = opendir(dir);
+	if (d == NULL)
+		return false;
+
+	struct dirent *entry;
+	while ((entry = readdir(d)) != NULL)
+	{
+		size_t len = strlen(entry->d_name);
+		if (len > 3 && !strcmp(entry->d_name + len - 3, ".ts"))
+			out->push_back(std::string(dir) + "/" + entry->d_name);
+	}
+	closedir(d);
+
+	std::sort(out->begin(), out->end());
+	return true;
+}
+
+static bool readFile(const char *path, std::vector<uint8_t> *out)
+{
+	FILE *f = fopen(path, "rb");
+	if (f == NULL)
+		return false;
+
+	fseek(f, 0, SEEK_END);
+	out->resize(ftell(f));
+	fseek(f, 0, SEEK_SET);
+	bool ok = out->empty() || fread(&(*out)[0], out->size(), 1, f) == 1;
+	fclose(f);
+	return ok;
+}
+
+// A copy of the segment that can be fed to a parser straight after it: the
+// continuity counters carry on from where the original leaves them, or the
+// parser would drop what it was holding.
+static void makeRepeat(const std::vector<uint8_t> &data, std::vector<uint8_t> *repeat)
+{
+	// Packets are taken to be aligned from the first pair of sync bytes.
+	size_t first = 0;
+	while (first + kTSPacketSize < data.size()
+			&& (data[first] != 0x47 || data[first + kTSPacketSize] != 0x47))
+		++first;
+
+	int counters[0x2000];
+	memset(counters, 0, sizeof(counters));
+	for (size_t i = first; i + kTSPacketSize <= data.size(); i += kTSPacketSize)
+	{
+		if (data[i] == 0x47 && (data[i + 3] & 0x10))
+			counters[((data[i + 1] & 0x1f) << 8) | data[i + 2]] = (data[i + 3] & 0x0f) + 1;
+	}
+
+	*repeat = data;
+	for (size_t i = first; i + kTSPacketSize <= repeat->size(); i += kTSPacketSize)
+	{
+		uint8_t *p = &(*repeat)[i];
+		if (p[0] != 0x47 || !(p[3] & 0x10))
+			continue;
+
+		int &counter = counters[((p[1] & 0x1f) << 8) | p[2]];
+		p[3] = (p[3] & 0xf0) | (counter & 0x0f);
+		++counter;
+	}
+}
+
+// Parse the whole segment and pull every access unit, noting the time range
+// of each stream and whether any video access unit was a sync frame.
+//
+// The last PES packet of each stream only comes out of the parser once the
+// next one starts. For the ranges to cover it, repeat (see makeRepeat())
+// is fed after the segment; it has the same timestamps so doesn't change
+// them otherwise.
+static void demux(const std::vector<uint8_t> &data, const std::vector<uint8_t> *repeat,
+		StreamTimes times[ATSParser::NUM_SOURCE_TYPES], bool *hasSync)
+{
+	sp<ATSParser> parser = new ATSParser(ATSParser::TS_TIMESTAMPS_ARE_ABSOLUTE);
+	size_t consumed = 0;
+	parser->feedTSPackets(&data[0], data.size(), &consumed);
+	if (repeat != NULL)
+		parser->feedTSPackets(&(*repeat)[0], repeat->size(), &consumed);
+	parser->signalEOS(ERROR_END_OF_STREAM);
+
+	for (int i = 0; i < ATSParser::NUM_SOURCE_TYPES; ++i)
+	{
+		StreamTimes &t = times[i];
+		t.present = false;
+		t.firstUs = t.lastUs = -1;
+
+		sp<AnotherPacketSource> source = parser->getSource((ATSParser::SourceType)i);
+		if (source == NULL)
+			continue;
+
+		status_t finalResult;
+		while (source->hasBufferAvailable(&finalResult))
+		{
+			MediaBuffer *buffer = NULL;
+			if (source->read(&buffer) != OK)
+				break;
+
+			int64_t timeUs;
+			if (buffer->meta_data()->findInt64(kKeyTime, &timeUs))
+			{
+				if (!t.present || timeUs < t.firstUs)
+					t.firstUs = timeUs;
+				if (!t.present || timeUs > t.lastUs)
+					t.lastUs = timeUs;
+				t.present = true;
+			}
+			buffer->release();
+		}
+	}
+
+	ATSParser::AccessUnitIndexEntry entry;
+	*hasSync = parser->findSyncPoint(INT64_MAX, &entry);
+}
+
+static int64_t toUs(int64_t PTS)
+{
+	return PTS < 0 ? -1 : (PTS * 100) / 9;
+}
+
+// The probe only sees PES packet times. Video has one access unit per PES
+// packet so they should match exactly; an audio PES packet holds several
+// frames, the last of which can be up to kMaxAudioPESUs later.
+static const int64_t kMaxAudioPESUs = 500000;
+
+static bool check(const char *name, const char *what, const StreamTimes &expected, bool present, const ATSParser::ProbeInfo &info, int64_t slackUs)
+{
+	int64_t lastUs = toUs(info.lastPTS);
+	if (expected.present != present
+			|| (present && (toUs(info.firstPTS) != expected.firstUs
+					|| lastUs > expected.lastUs || expected.lastUs - lastUs > slackUs)))
+	{
+		printf("%s: %s probed %lld-%lld us, demuxed %lld-%lld us\n", name, what,
+				(long long)toUs(info.firstPTS), (long long)toUs(info.lastPTS),
+				(long long)expected.firstUs, (long long)expected.lastUs);
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	const char *dir = NULL;
+	int iterations = 20;
+	size_t headBytes = 0;
+	size_t tailBytes = 32 * 1024;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			iterations = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-head") && i + 1 < argc)
+			headBytes = atoi(argv[++i]) * 1024;
+		else if (!strcmp(argv[i], "-tail") && i + 1 < argc)
+			tailBytes = atoi(argv[++i]) * 1024;
+		else
+			dir = argv[i];
+	}
+
+	std::vector<std::string> segments;
+	if (dir == NULL || iterations < 1)
+	{
+		fprintf(stderr, "usage: %s [-n iterations] [-head KB] [-tail KB] segment_dir\n", argv[0]);
+		return 1;
+	}
+	if (!listSegments(dir, &segments) || segments.empty())
+	{
+		fprintf(stderr, "No .ts segments in %s\n", dir);
+		return 1;
+	}
+
+	int failures = 0;
+	double demuxTime = 0, probeTime = 0;
+	for (size_t s = 0; s < segments.size(); ++s)
+	{
+		const char *name = strrchr(segments[s].c_str(), '/') + 1;
+		std::vector<uint8_t> data;
+		if (!readFile(segments[s].c_str(), &data) || data.empty())
+		{
+			fprintf(stderr, "Could not read %s\n", segments[s].c_str());
+			return 1;
+		}
+
+		StreamTimes times[ATSParser::NUM_SOURCE_TYPES];
+		bool hasSync = false;
+		double start = now();
+		for (int i = 0; i < iterations; ++i)
+			demux(data, NULL, times, &hasSync);
+		demuxTime += now() - start;
+
+		std::vector<uint8_t> repeat;
+		makeRepeat(data, &repeat);
+		demux(data, &repeat, times, &hasSync);
+
+		SegmentProbe::Result result;
+		bool found = false;
+		start = now();
+		for (int i = 0; i < iterations; ++i)
+			found = SegmentProbe::probe(&data[0], data.size(), headBytes, tailBytes, &result);
+		probeTime += now() - start;
+
+		if (!found)
+		{
+			// Fine if there was nothing to find, e.g. no PAT or PMT.
+			bool demuxed = times[ATSParser::VIDEO].present || times[ATSParser::AUDIO].present;
+			printf("%-24s nothing found%s\n", name, demuxed ? ", but the demuxer found access units" : "");
+			if (demuxed)
+				++failures;
+			continue;
+		}
+
+		bool ok = check(name, "video", times[ATSParser::VIDEO], result.hasVideo, result.video, 0);
+		ok = check(name, "audio", times[ATSParser::AUDIO], result.hasAudio, result.audio, kMaxAudioPESUs) && ok;
+		if (result.hasVideo && result.video.hasSyncFrame != hasSync)
+		{
+			printf("%s: probe says IDR %d, demux %d\n", name, result.video.hasSyncFrame, hasSync);
+			ok = false;
+		}
+		if (!ok)
+			++failures;
+
+		printf("%-24s start %.3f s, duration %.3f s%s\n", name,
+				result.getStartPTS() / 90000.0, result.getDurationPTS() / 90000.0,
+				result.video.hasSyncFrame ? ", IDR" : "");
+	}
+
+	double perSegment = 1e6 / ((double)iterations * segments.size());
+	printf("%zu segments, %d iterations\n", segments.size(), iterations);
+	printf("  full demux %10.1f us per segment\n", demuxTime * perSegment);
+	printf("  probe      %10.1f us per segment (%.1fx faster)\n", probeTime * perSegment, demuxTime / probeTime);
+	return failures ? 1 : 0;
+}
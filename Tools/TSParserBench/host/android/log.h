@@ -0,0 +1,36 @@
+#ifndef _ANDROID_LOG_H
+#define _ANDROID_LOG_H
+
+// Host stand-in for the NDK logging header. Warnings and errors go to
+// stderr, everything else is dropped so it doesn't skew the benchmarks.
+
+#include <stdarg.h>
+#include <stdio.h>
+
+typedef enum android_LogPriority {
+	ANDROID_LOG_UNKNOWN = 0,
+	ANDROID_LOG_DEFAULT,
+	ANDROID_LOG_VERBOSE,
+	ANDROID_LOG_DEBUG,
+	ANDROID_LOG_INFO,
+	ANDROID_LOG_WARN,
+	ANDROID_LOG_ERROR,
+	ANDROID_LOG_FATAL,
+	ANDROID_LOG_SILENT,
+} android_LogPriority;
+
+static inline int __android_log_print(int prio, const char *tag, const char *fmt, ...)
+{
+	if (prio < ANDROID_LOG_WARN)
+		return 0;
+
+	va_list ap;
+	va_start(ap, fmt);
+	fprintf(stderr, "%s: ", tag);
+	int res = vfprintf(stderr, fmt, ap);
+	fputc('\n', stderr);
+	va_end(ap);
+	return res;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#include "androidVideoShim.h"
+
+namespace android_video_shim
+{
+	int gAPILevel = 19;
+
+	bool gMediaBufferCanWrap = true;
+
+	// Media Mime Types
+	const char *MEDIA_MIMETYPE_VIDEO_AVC = "video/avc";
+	const char *MEDIA_MIMETYPE_VIDEO_MPEG4 = "video/mp4v-es";
+	const char *MEDIA_MIMETYPE_VIDEO_MPEG2 = "video/mpeg2";
+	const char *MEDIA_MIMETYPE_AUDIO_MPEG = "audio/mpeg";
+	const char *MEDIA_MIMETYPE_AUDIO_MPEG_LAYER_I = "audio/mpeg-L1";
+	const char *MEDIA_MIMETYPE_AUDIO_MPEG_LAYER_II = "audio/mpeg-L2";
+	const char *MEDIA_MIMETYPE_AUDIO_AAC = "audio/mp4a-latm";
+	const char *MEDIA_MIMETYPE_AUDIO_RAW = "audio/raw";
+	const char *MEDIA_MIMETYPE_CONTAINER_MPEG2TS = "video/mp2ts";
+}
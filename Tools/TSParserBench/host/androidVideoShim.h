@@ -0,0 +1,600 @@
+#ifndef _ANDROIDVIDEOSHIM_H_
+#define _ANDROIDVIDEOSHIM_H_
+
+// Host build stand-in for HLSPlayerSDK/jni/androidVideoShim.h.
+//
+// The mpeg2ts_parser sources include "../androidVideoShim.h", so the Makefile
+// copies them next to this file. Everything the parser needs from the shim is
+// implemented natively here instead of being looked up in libstagefright.
+
+#include <errno.h>
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+
+#include <android/log.h>
+
+#include <map>
+#include <vector>
+
+#include "debug.h"
+
+// Handy pthreads autolocker.
+class AutoLock
+{
+public:
+	AutoLock(pthread_mutex_t * lock, const char* path="")
+	: lock(lock), mPath(path)
+	{
+		pthread_mutex_lock(lock);
+	}
+
+	~AutoLock()
+	{
+		pthread_mutex_unlock(lock);
+	}
+
+private:
+	pthread_mutex_t * lock;
+	const char* mPath;
+};
+
+inline int initRecursivePthreadMutex(pthread_mutex_t *lock)
+{
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	return pthread_mutex_init(lock, &attr);
+}
+
+namespace android_video_shim
+{
+	inline void initLibraries() {}
+	inline void *searchSymbol(const char *symName) { return NULL; }
+
+	// The host build behaves like the newest platform we support.
+	extern int gAPILevel;
+	#define AVSHIM_USE_NEWMEDIASOURCE (android_video_shim::gAPILevel >= 14)
+	#define AVSHIM_USE_NEWMEDIASOURCEVTABLE (android_video_shim::gAPILevel > 14)
+	#define AVSHIM_USE_NEWDATASOURCEVTABLE (android_video_shim::gAPILevel > 14)
+	#define AVSHIM_HAS_OMXRENDERERPATH (android_video_shim::gAPILevel < 11)
+
+	typedef int32_t     status_t;
+
+	enum {
+		OK                = 0,    // Everything's swell.
+		NO_ERROR          = 0,    // No errors.
+
+		UNKNOWN_ERROR       = 0x80000000,
+
+		NO_MEMORY           = -ENOMEM,
+		INVALID_OPERATION   = -ENOSYS,
+		BAD_VALUE           = -EINVAL,
+		BAD_TYPE            = 0x80000001,
+		NAME_NOT_FOUND      = -ENOENT,
+		PERMISSION_DENIED   = -EPERM,
+		NO_INIT             = -ENODEV,
+		ALREADY_EXISTS      = -EEXIST,
+		DEAD_OBJECT         = -EPIPE,
+		FAILED_TRANSACTION  = 0x80000002,
+		BAD_INDEX           = -EOVERFLOW,
+		NOT_ENOUGH_DATA     = -ENODATA,
+		WOULD_BLOCK         = -EWOULDBLOCK,
+		TIMED_OUT           = -ETIMEDOUT,
+		UNKNOWN_TRANSACTION = -EBADMSG,
+		FDS_NOT_ALLOWED     = 0x80000007,
+	};
+
+	enum {
+		MEDIA_ERROR_BASE        = -1000,
+
+		ERROR_ALREADY_CONNECTED = MEDIA_ERROR_BASE,
+		ERROR_NOT_CONNECTED     = MEDIA_ERROR_BASE - 1,
+		ERROR_UNKNOWN_HOST      = MEDIA_ERROR_BASE - 2,
+		ERROR_CANNOT_CONNECT    = MEDIA_ERROR_BASE - 3,
+		ERROR_IO                = MEDIA_ERROR_BASE - 4,
+		ERROR_CONNECTION_LOST   = MEDIA_ERROR_BASE - 5,
+		ERROR_MALFORMED         = MEDIA_ERROR_BASE - 7,
+		ERROR_OUT_OF_RANGE      = MEDIA_ERROR_BASE - 8,
+		ERROR_BUFFER_TOO_SMALL  = MEDIA_ERROR_BASE - 9,
+		ERROR_UNSUPPORTED       = MEDIA_ERROR_BASE - 10,
+		ERROR_END_OF_STREAM     = MEDIA_ERROR_BASE - 11,
+
+		// Not technically an error.
+		INFO_FORMAT_CHANGED    = MEDIA_ERROR_BASE - 12,
+		INFO_DISCONTINUITY     = MEDIA_ERROR_BASE - 13,
+		INFO_OUTPUT_BUFFERS_CHANGED = MEDIA_ERROR_BASE - 14,
+	};
+
+	extern const char *MEDIA_MIMETYPE_VIDEO_AVC;
+	extern const char *MEDIA_MIMETYPE_VIDEO_MPEG4;
+	extern const char *MEDIA_MIMETYPE_VIDEO_MPEG2;
+	extern const char *MEDIA_MIMETYPE_AUDIO_MPEG;
+	extern const char *MEDIA_MIMETYPE_AUDIO_MPEG_LAYER_I;
+	extern const char *MEDIA_MIMETYPE_AUDIO_MPEG_LAYER_II;
+	extern const char *MEDIA_MIMETYPE_AUDIO_AAC;
+	extern const char *MEDIA_MIMETYPE_AUDIO_RAW;
+	extern const char *MEDIA_MIMETYPE_CONTAINER_MPEG2TS;
+
+	// Plain intrusive refcount in place of libutils' RefBase.
+	class RefBase
+	{
+	public:
+		void incStrong(const void *id) const
+		{
+			__sync_fetch_and_add(&mStrong, 1);
+		}
+
+		void decStrong(const void *id) const
+		{
+			if (__sync_sub_and_fetch(&mStrong, 1) == 0)
+				delete this;
+		}
+
+		int32_t getStrongCount() const { return mStrong; }
+
+	protected:
+		RefBase() : mStrong(0) {}
+		virtual ~RefBase() {}
+
+	private:
+		mutable int32_t mStrong;
+	};
+
+	#define COMPARE(_op_)                                           \
+	inline bool operator _op_ (const sp<T>& o) const {              \
+		return m_ptr _op_ o.m_ptr;                                  \
+	}                                                               \
+	inline bool operator _op_ (const T* o) const {                  \
+		return m_ptr _op_ o;                                        \
+	}                                                               \
+	template<typename U>                                            \
+	inline bool operator _op_ (const sp<U>& o) const {              \
+		return m_ptr _op_ o.m_ptr;                                  \
+	}                                                               \
+	template<typename U>                                            \
+	inline bool operator _op_ (const U* o) const {                  \
+		return m_ptr _op_ o;                                        \
+	}
+
+	template<typename T>
+	class sp {
+	public:
+		inline sp() : m_ptr(0) { }
+		sp(T* other) : m_ptr(other) { if (m_ptr) m_ptr->incStrong(this); }
+		sp(const sp<T>& other) : m_ptr(other.m_ptr) { if (m_ptr) m_ptr->incStrong(this); }
+		template<typename U> sp(U* other) : m_ptr(other) { if (m_ptr) m_ptr->incStrong(this); }
+		template<typename U> sp(const sp<U>& other) : m_ptr(other.m_ptr) { if (m_ptr) m_ptr->incStrong(this); }
+		~sp() { if (m_ptr) m_ptr->decStrong(this); }
+
+		sp& operator = (T* other) { set(other); return *this; }
+		sp& operator = (const sp<T>& other) { set(other.m_ptr); return *this; }
+		template<typename U> sp& operator = (const sp<U>& other) { set(other.m_ptr); return *this; }
+		template<typename U> sp& operator = (U* other) { set(other); return *this; }
+
+		void clear() { set(NULL); }
+
+		inline  T&      operator* () const  { return *m_ptr; }
+		inline  T*      operator-> () const { return m_ptr;  }
+		inline  T*      get() const         { return m_ptr; }
+
+		COMPARE(==)
+		COMPARE(!=)
+		COMPARE(>)
+		COMPARE(<)
+		COMPARE(<=)
+		COMPARE(>=)
+
+	private:
+		template<typename Y> friend class sp;
+
+		void set(T* other)
+		{
+			if (other)
+				other->incStrong(this);
+			if (m_ptr)
+				m_ptr->decStrong(this);
+			m_ptr = other;
+		}
+
+		T* m_ptr;
+	};
+	#undef COMPARE
+
+	// The following keys map to int32_t data unless indicated otherwise.
+	enum {
+		kKeyMIMEType          = 'mime',  // cstring
+		kKeyWidth             = 'widt',  // int32_t, image pixel
+		kKeyHeight            = 'heig',  // int32_t, image pixel
+		kKeyChannelCount      = '#chn',  // int32_t
+		kKeySampleRate        = 'srte',  // int32_t (audio sampling rate Hz)
+		kKeyESDS              = 'esds',  // raw data
+		kKeyAVCC              = 'avcc',  // raw data
+		kTypeAVCC             = 'avcc',
+		kKeyIsSyncFrame       = 'sync',  // int32_t (bool)
+		kKeyTime              = 'time',  // int64_t (usecs)
+		kKeyDuration          = 'dura',  // int64_t (usecs)
+		kKeySARWidth = 'sarW',
+		kKeySARHeight = 'sarH',
+		kKeyIsADTS            = 'adts',  // bool (int32_t)
+		kTypeESDS        = 'esds',
+	};
+
+	// Map backed MetaData with the same accessors as the libstagefright one.
+	class MetaData : public RefBase
+	{
+	public:
+		enum {
+			TYPE_C_STRING = 'cstr',
+			TYPE_INT32    = 'in32',
+			TYPE_INT64    = 'in64',
+			TYPE_POINTER  = 'ptr ',
+		};
+
+		bool setCString(uint32_t key, const char *value)
+		{
+			return setData(key, TYPE_C_STRING, value, strlen(value) + 1);
+		}
+
+		bool setInt32(uint32_t key, int32_t value)
+		{
+			return setData(key, TYPE_INT32, &value, sizeof(value));
+		}
+
+		bool setInt64(uint32_t key, int64_t value)
+		{
+			return setData(key, TYPE_INT64, &value, sizeof(value));
+		}
+
+		bool setPointer(uint32_t key, void *value)
+		{
+			return setData(key, TYPE_POINTER, &value, sizeof(value));
+		}
+
+		bool setData(uint32_t key, uint32_t type, const void *data, size_t size)
+		{
+			bool overwrote = mItems.find(key) != mItems.end();
+			Item &item = mItems[key];
+			item.type = type;
+			item.data.assign((const uint8_t *)data, (const uint8_t *)data + size);
+			return overwrote;
+		}
+
+		bool findCString(uint32_t key, const char **value)
+		{
+			const Item *item = find(key, TYPE_C_STRING);
+			if (item == NULL)
+				return false;
+			*value = (const char *)&item->data[0];
+			return true;
+		}
+
+		bool findInt32(uint32_t key, int32_t *value)
+		{
+			const Item *item = find(key, TYPE_INT32);
+			if (item == NULL)
+				return false;
+			memcpy(value, &item->data[0], sizeof(*value));
+			return true;
+		}
+
+		bool findInt64(uint32_t key, int64_t *value)
+		{
+			const Item *item = find(key, TYPE_INT64);
+			if (item == NULL)
+				return false;
+			memcpy(value, &item->data[0], sizeof(*value));
+			return true;
+		}
+
+		bool findPointer(uint32_t key, void **value)
+		{
+			const Item *item = find(key, TYPE_POINTER);
+			if (item == NULL)
+				return false;
+			memcpy(value, &item->data[0], sizeof(*value));
+			return true;
+		}
+
+		bool findData(uint32_t key, uint32_t *type, const void **data, size_t *size)
+		{
+			std::map<uint32_t, Item>::const_iterator it = mItems.find(key);
+			if (it == mItems.end())
+				return false;
+			*type = it->second.type;
+			*data = it->second.data.empty() ? NULL : &it->second.data[0];
+			*size = it->second.data.size();
+			return true;
+		}
+
+		void clear()
+		{
+			mItems.clear();
+		}
+
+		void dumpToLog() {}
+
+	private:
+		struct Item
+		{
+			uint32_t type;
+			std::vector<uint8_t> data;
+		};
+
+		const Item *find(uint32_t key, uint32_t type) const
+		{
+			std::map<uint32_t, Item>::const_iterator it = mItems.find(key);
+			if (it == mItems.end() || it->second.type != type)
+				return NULL;
+			return &it->second;
+		}
+
+		std::map<uint32_t, Item> mItems;
+	};
+	class MediaBufferObserver;
+
+	// Mirrors libstagefright's MediaBuffer reference counting, so the zero
+	// copy hand off in AnotherPacketSource behaves as it does on device.
+	class MediaBuffer
+	{
+	public:
+		MediaBuffer(void *data, size_t size)
+		: mData(data), mSize(size), mRangeOffset(0), mRangeLength(size),
+		  mOwnsData(false), mRefCount(0), mObserver(NULL), mMetaData(new MetaData)
+		{
+		}
+
+		MediaBuffer(size_t size)
+		: mData(malloc(size)), mSize(size), mRangeOffset(0), mRangeLength(size),
+		  mOwnsData(true), mRefCount(0), mObserver(NULL), mMetaData(new MetaData)
+		{
+		}
+
+		// Set gMediaBufferCanWrap to false to exercise the copying path.
+		static bool canWrapExternalData();
+
+		void setObserver(MediaBufferObserver *observer)
+		{
+			assert(observer == NULL || mObserver == NULL);
+			mObserver = observer;
+		}
+
+		void release();
+
+		void add_ref()
+		{
+			__sync_fetch_and_add(&mRefCount, 1);
+		}
+
+		void *data() { return mData; }
+		size_t size() { return mSize; }
+		size_t range_offset() { return mRangeOffset; }
+		size_t range_length() { return mRangeLength; }
+
+		void set_range(size_t offset, size_t length)
+		{
+			assert(offset + length <= mSize);
+			mRangeOffset = offset;
+			mRangeLength = length;
+		}
+
+		sp<MetaData> meta_data() { return mMetaData; }
+
+		int refcount() const { return mRefCount; }
+
+	private:
+		~MediaBuffer()
+		{
+			if (mOwnsData)
+				free(mData);
+		}
+
+		void *mData;
+		size_t mSize;
+		size_t mRangeOffset;
+		size_t mRangeLength;
+		bool mOwnsData;
+		int32_t mRefCount;
+		MediaBufferObserver *mObserver;
+		sp<MetaData> mMetaData;
+
+		MediaBuffer(const MediaBuffer &);
+		MediaBuffer &operator=(const MediaBuffer &);
+	};
+
+	class MediaBufferObserver {
+	public:
+		MediaBufferObserver() {}
+		virtual ~MediaBufferObserver() {}
+
+		virtual void signalBufferReturned(MediaBuffer *buffer) = 0;
+
+	private:
+		MediaBufferObserver(const MediaBufferObserver &);
+		MediaBufferObserver &operator=(const MediaBufferObserver &);
+	};
+
+	extern bool gMediaBufferCanWrap;
+
+	inline bool MediaBuffer::canWrapExternalData()
+	{
+		return gMediaBufferCanWrap;
+	}
+
+	inline void MediaBuffer::release()
+	{
+		if (mObserver == NULL)
+		{
+			assert(mRefCount == 0);
+			delete this;
+			return;
+		}
+
+		if (__sync_fetch_and_sub(&mRefCount, 1) == 1)
+		{
+			if (mObserver == NULL)
+			{
+				delete this;
+				return;
+			}
+			mObserver->signalBufferReturned(this);
+		}
+	}
+
+	class MediaSource : public virtual RefBase
+	{
+	public:
+		// Options that modify read() behaviour. The host build never seeks.
+		struct ReadOptions {
+			enum SeekMode {
+				SEEK_PREVIOUS_SYNC,
+				SEEK_NEXT_SYNC,
+				SEEK_CLOSEST_SYNC,
+				SEEK_CLOSEST,
+			};
+
+			bool getSeekTo(int64_t *time_us, SeekMode *mode) const
+			{
+				return false;
+			}
+		};
+	};
+
+	// HLSDataSource over a list of segment files on disk. Offsets run across
+	// the segments in append order, the same as the HLSSegmentCache backed
+	// one, and reads may span a segment boundary.
+	class HLSDataSource : public RefBase
+	{
+	public:
+		HLSDataSource() : mSourceIdx(0), mSegmentReadCount(0), mReadCount(0)
+		{
+			initRecursivePthreadMutex(&lock);
+		}
+
+		virtual ~HLSDataSource()
+		{
+			clearSources();
+			pthread_mutex_destroy(&lock);
+		}
+
+		void clearSources()
+		{
+			AutoLock locker(&lock, __func__);
+			for (size_t i = 0; i < mSources.size(); ++i)
+			{
+				fclose(mSources[i].file);
+				free(mSources[i].uri);
+			}
+			mSources.clear();
+			mSourceIdx = 0;
+			mSegmentReadCount = 0;
+		}
+
+		status_t append(const char* uri, int quality = 0, int continuityEra = 0, double startTime = 0, int cryptoId = -1)
+		{
+			AutoLock locker(&lock, __func__);
+
+			FILE *file = fopen(uri, "rb");
+			if (file == NULL)
+			{
+				LOGE("Could not open %s", uri);
+				return NAME_NOT_FOUND;
+			}
+
+			Segment seg;
+			seg.uri = strdup(uri);
+			seg.file = file;
+			seg.start = mSources.empty() ? 0 : mSources.back().start + mSources.back().size;
+			fseeko(file, 0, SEEK_END);
+			seg.size = ftello(file);
+			mSources.push_back(seg);
+			return OK;
+		}
+
+		ssize_t readAt(off64_t offset, void* data, size_t size)
+		{
+			AutoLock locker(&lock, __func__);
+
+			size_t readSize = 0;
+			while (readSize < size && mSourceIdx < mSources.size())
+			{
+				Segment &seg = mSources[mSourceIdx];
+				off64_t pos = offset + readSize;
+
+				if (pos < seg.start && mSourceIdx > 0)
+				{
+					--mSourceIdx;
+					mSegmentReadCount = 0;
+					continue;
+				}
+				if (pos >= seg.start + seg.size)
+				{
+					++mSourceIdx;
+					mSegmentReadCount = 0;
+					continue;
+				}
+
+				size_t chunk = size - readSize;
+				if (pos + (off64_t)chunk > seg.start + seg.size)
+					chunk = seg.start + seg.size - pos;
+
+				fseeko(seg.file, pos - seg.start, SEEK_SET);
+				size_t n = fread((uint8_t *)data + readSize, 1, chunk, seg.file);
+				mSegmentReadCount++;
+				mReadCount++;
+				readSize += n;
+				if (n < chunk)
+					break;
+			}
+
+			return readSize;
+		}
+
+		// Index of the segment the last read ended in.
+		uint32_t getSegmentIndex()
+		{
+			AutoLock locker(&lock, __func__);
+			return mSourceIdx;
+		}
+
+		uint32_t getSegmentReadCount()
+		{
+			AutoLock locker(&lock, __func__);
+			return mSegmentReadCount;
+		}
+
+		// Total number of reads made against the files, for the benchmarks.
+		uint64_t getReadCount()
+		{
+			AutoLock locker(&lock, __func__);
+			return mReadCount;
+		}
+
+		int getPreloadedSegmentCount()
+		{
+			AutoLock locker(&lock, __func__);
+			return (mSources.size() - mSourceIdx) - 1;
+		}
+
+	private:
+		struct Segment
+		{
+			char *uri;
+			FILE *file;
+			off64_t start;
+			off64_t size;
+		};
+
+		pthread_mutex_t lock;
+		std::vector<Segment> mSources;
+		uint32_t mSourceIdx;
+		uint32_t mSegmentReadCount;
+		uint64_t mReadCount;
+	};
+}
+
+#endif
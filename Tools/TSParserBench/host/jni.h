@@ -0,0 +1,32 @@
+#ifndef _JNI_H
+#define _JNI_H
+
+// Host stand-in for the NDK JNI header, just enough for the JNI entry points
+// in the sources built here to compile. Nothing calls them.
+
+#include <stdint.h>
+
+typedef uint8_t jboolean;
+typedef int8_t jbyte;
+typedef int32_t jint;
+typedef int64_t jlong;
+typedef jint jsize;
+
+class _jobject {};
+typedef _jobject *jobject;
+typedef jobject jclass;
+typedef jobject jarray;
+typedef jarray jbyteArray;
+typedef jarray jlongArray;
+
+#define JNI_ABORT 2
+
+struct JNIEnv
+{
+	jsize GetArrayLength(jarray) { return 0; }
+	void *GetPrimitiveArrayCritical(jarray, jboolean *) { return 0; }
+	void ReleasePrimitiveArrayCritical(jarray, void *, jint) { }
+	void SetLongArrayRegion(jlongArray, jsize, jsize, const jlong *) { }
+};
+
+#endif
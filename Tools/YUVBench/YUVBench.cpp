@@ -0,0 +1,238 @@
+// Checks and times each YUVRowConverter back end the host supports, next to
+// the per pixel loop ColorConverter_Local and ColorConverter444 used to run.
+//
+// Every back end is first compared pixel for pixel with that loop over
+// planar, semi-planar (both chroma orders) and CbYCrY rows, with and without
+// swapped red and blue, at widths that exercise the vector bodies and their
+// C tails, on random data and on the extremes that hit the clamps.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "YUVRowConverter.h"
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Random bytes, with a good share of 0, 16, 128, 235 and 255 among them.
+static void fillRandom(uint8_t *p, size_t n)
+{
+	static const uint8_t kExtremes[] = { 0, 16, 128, 235, 255 };
+	for (size_t i = 0; i < n; ++i)
+	{
+		int r = rand();
+		p[i] = (r & 3) == 0 ? kExtremes[(r >> 2) % 5] : (uint8_t)(r >> 7);
+	}
+}
+
+//----------------------------------------------------------------------------
+// The original conversion, clip table and all.
+
+static uint8_t gClip[535 + 278 + 1];
+static uint8_t *kAdjustedClip = &gClip[278];
+
+static void initClip()
+{
+	for (int i = -278; i <= 535; ++i)
+		kAdjustedClip[i] = (i < 0) ? 0 : (i > 255) ? 255 : (uint8_t)i;
+}
+
+static uint16_t legacyPixel(int y, int u, int v, bool swapRB)
+{
+	signed y1 = y - 16;
+	u -= 128;
+	v -= 128;
+
+	signed tmp1 = y1 * 298;
+	signed b1 = (tmp1 + u * 517) / 256;
+	signed g1 = (tmp1 + -v * 208 + -u * 100) / 256;
+	signed r1 = (tmp1 + v * 409) / 256;
+
+	if (swapRB)
+	{
+		signed t = r1;
+		r1 = b1;
+		b1 = t;
+	}
+
+	return ((kAdjustedClip[r1] >> 3) << 11)
+		| ((kAdjustedClip[g1] >> 2) << 5)
+		| (kAdjustedClip[b1] >> 3);
+}
+
+static void legacyRow(const uint8_t *y, const uint8_t *u, const uint8_t *v, size_t chromaStep,
+		uint16_t *dst, size_t width, bool swapRB)
+{
+	for (size_t x = 0; x < width; ++x)
+		dst[x] = legacyPixel(y[x], u[(x / 2) * chromaStep], v[(x / 2) * chromaStep], swapRB);
+}
+
+static void legacyCbYCrYRow(const uint8_t *src, uint16_t *dst, size_t width)
+{
+	for (size_t x = 0; x < width; ++x)
+		dst[x] = legacyPixel(src[2 * x + 1], src[(x & ~1) * 2], src[(x & ~1) * 2 + 2], false);
+}
+
+//----------------------------------------------------------------------------
+
+struct Layout
+{
+	const char *name;
+	size_t chromaStep;
+	bool vFirst;
+	bool swapRB;
+};
+
+static const Layout kLayouts[] =
+{
+	{ "planar", 1, false, false },
+	{ "qcom semi-planar", 2, false, true },
+	{ "semi-planar", 2, true, true },
+	{ "ti semi-planar", 2, false, false },
+};
+
+static bool verify(YUVRowConverter::Backend backend)
+{
+	YUVRowConverter::setBackend(backend);
+	const char *name = YUVRowConverter::getBackendName(backend);
+
+	// Guard space past the end, where nothing may be written.
+	static const size_t kMaxWidth = 300;
+	static const size_t kGuard = 16;
+	std::vector<uint8_t> y(kMaxWidth + kGuard), chroma(kMaxWidth + kGuard), packed(2 * kMaxWidth + kGuard);
+	std::vector<uint16_t> expected(kMaxWidth + kGuard), actual(kMaxWidth + kGuard);
+
+	for (int round = 0; round < 20; ++round)
+	{
+		fillRandom(&y[0], y.size());
+		fillRandom(&chroma[0], chroma.size());
+		fillRandom(&packed[0], packed.size());
+
+		for (size_t width = 1; width <= kMaxWidth; ++width)
+		{
+			for (size_t l = 0; l < sizeof(kLayouts) / sizeof(kLayouts[0]); ++l)
+			{
+				const Layout &layout = kLayouts[l];
+				const uint8_t *u, *v;
+				if (layout.chromaStep == 1)
+				{
+					u = &chroma[0];
+					v = &chroma[(kMaxWidth + 1) / 2];
+				}
+				else
+				{
+					u = &chroma[layout.vFirst ? 1 : 0];
+					v = &chroma[layout.vFirst ? 0 : 1];
+				}
+
+				expected.assign(expected.size(), 0xdead);
+				actual.assign(actual.size(), 0xdead);
+				legacyRow(&y[0], u, v, layout.chromaStep, &expected[0], width, layout.swapRB);
+				YUVRowConverter::convertRow(&y[0], u, v, layout.chromaStep, &actual[0], width, layout.swapRB);
+				if (actual != expected)
+				{
+					printf("  %s: %s mismatch at width %u\n", name, layout.name, (unsigned)width);
+					return false;
+				}
+			}
+
+			expected.assign(expected.size(), 0xdead);
+			actual.assign(actual.size(), 0xdead);
+			legacyCbYCrYRow(&packed[0], &expected[0], width);
+			YUVRowConverter::convertCbYCrYRow(&packed[0], &actual[0], width);
+			if (actual != expected)
+			{
+				printf("  %s: CbYCrY mismatch at width %u\n", name, (unsigned)width);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	size_t width = 1280;
+	size_t height = 720;
+	int iterations = 100;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-w") && i + 1 < argc)
+			width = atoi(argv[++i]) & ~1;
+		else if (!strcmp(argv[i], "-h") && i + 1 < argc)
+			height = atoi(argv[++i]) & ~1;
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+			iterations = atoi(argv[++i]);
+		else
+		{
+			fprintf(stderr, "usage: %s [-w width] [-h height] [-n iterations]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	initClip();
+	srand(1234);
+
+	// One semi-planar frame, converted the way ColorConverter_Local does.
+	std::vector<uint8_t> frame(width * height * 3 / 2);
+	fillRandom(&frame[0], frame.size());
+	std::vector<uint16_t> rgb(width * height);
+	const uint8_t *uvPlane = &frame[width * height];
+
+	printf("YUV420 semi-planar to RGB565, %ux%u x %d\n", (unsigned)width, (unsigned)height, iterations);
+
+	double start = now();
+	for (int i = 0; i < iterations; ++i)
+	{
+		for (size_t row = 0; row < height; ++row)
+		{
+			const uint8_t *uv = uvPlane + (row / 2) * width;
+			legacyRow(&frame[row * width], uv + 1, uv, 2, &rgb[row * width], width, true);
+		}
+	}
+	double elapsed = now() - start;
+	printf("  %-8s %8.1f frames/s\n", "legacy", iterations / elapsed);
+
+	int failures = 0;
+	for (int b = 0; b < YUVRowConverter::BACKEND_COUNT; ++b)
+	{
+		YUVRowConverter::Backend backend = (YUVRowConverter::Backend)b;
+		const char *name = YUVRowConverter::getBackendName(backend);
+		if (!YUVRowConverter::isSupported(backend))
+		{
+			printf("  %-8s      n/a\n", name);
+			continue;
+		}
+
+		if (!verify(backend))
+		{
+			++failures;
+			continue;
+		}
+
+		start = now();
+		for (int i = 0; i < iterations; ++i)
+		{
+			for (size_t row = 0; row < height; ++row)
+			{
+				const uint8_t *uv = uvPlane + (row / 2) * width;
+				YUVRowConverter::convertRow(&frame[row * width], uv + 1, uv, 2, &rgb[row * width], width, true);
+			}
+		}
+		elapsed = now() - start;
+		printf("  %-8s %8.1f frames/s%s\n", name, iterations / elapsed,
+				backend == YUVRowConverter::getBestBackend() ? "  (selected)" : "");
+	}
+
+	return failures ? 1 : 0;
+}